@@ -0,0 +1,54 @@
+// ac_bench.cpp : Runs thread pool benchmarks.
+//
+// Without arguments runs all benchmarks, otherwise only
+// benchmarks whose name is passed on the command line.
+//
+
+#include "ac_bench_thread_pool.h"
+
+#include <cstdio>
+#include <cstring>
+
+namespace {
+    struct benchmark {
+        char const *name;
+        void (*run)();
+    };
+
+    benchmark const benchmarks[] = {
+        {"fan_out", &bench_tp_fan_out},
+        {"submit_batch", &bench_tp_submit_batch},
+        {"timers", &bench_tp_timers},
+        {"timer_coalescing", &bench_tp_timer_coalescing},
+        {"priority", &bench_tp_priority},
+        {"adaptive", &bench_tp_adaptive},
+        {"blocking", &bench_tp_blocking},
+        {"coroutine", &bench_tp_coroutine},
+        {"sender", &bench_tp_sender},
+        {"parallel", &bench_tp_parallel},
+        {"graph", &bench_tp_graph},
+        {"future", &bench_tp_future},
+        {"strand", &bench_tp_strand},
+        {"active", &bench_tp_active},
+        {"keyed", &bench_tp_keyed},
+        {"bounded", &bench_tp_bounded},
+        {"cleanup", &bench_tp_cleanup},
+        {"churn", &bench_tp_churn},
+        {"scratch", &bench_tp_scratch},
+        {"rundown", &bench_tp_rundown},
+        {"wake", &bench_tp_wake},
+    };
+} // namespace
+
+int main(int argc, char **argv) {
+    for (benchmark const &b : benchmarks) {
+        bool selected = (argc < 2);
+        for (int i = 1; i < argc && !selected; ++i) {
+            selected = (0 == strcmp(argv[i], b.name));
+        }
+        if (selected) {
+            b.run();
+        }
+    }
+    return 0;
+}
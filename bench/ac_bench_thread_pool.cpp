@@ -0,0 +1,1732 @@
+#include "ac_bench_thread_pool.h"
+
+#include <stdio.h>
+
+#include <condition_variable>
+#include <future>
+#include <memory_resource>
+#include <mutex>
+#include <random>
+#include <string>
+#include <string_view>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <acactive.h>
+#include <actp.h>
+#include <actpcoro.h>
+#include <actpexec.h>
+#include <actpfuture.h>
+#include <actpgraph.h>
+#include <actpparallel.h>
+#include <actpstrand.h>
+#include <ackernelobject.h>
+
+namespace {
+
+    using bench_clock = std::chrono::steady_clock;
+
+    [[nodiscard]] double elapsed_ns(bench_clock::time_point start) {
+        return std::chrono::duration<double, std::nano>(bench_clock::now() - start).count();
+    }
+
+    [[nodiscard]] std::vector<unsigned long> thread_counts() {
+        unsigned long const hardware_threads{
+            std::max(1UL, static_cast<unsigned long>(std::thread::hardware_concurrency()))};
+        std::vector<unsigned long> counts;
+        for (unsigned long count = 1; count < hardware_threads; count *= 2) {
+            counts.push_back(count);
+        }
+        counts.push_back(hardware_threads);
+        return counts;
+    }
+
+    struct fan_out_state {
+        ac::tp::thread_pool *tp;
+        std::atomic<long long> remaining;
+        ac::event done{ac::event::manuel, ac::event::unsignaled};
+    };
+
+    constexpr int fan_out_width{8};
+    constexpr int fan_out_depth{6};
+
+    void fan_out(fan_out_state *state, int depth) {
+        if (0 < depth) {
+            for (int i = 0; i < fan_out_width; ++i) {
+                state->tp->submit_work(
+                    [state, depth](ac::tp::callback_instance &) { fan_out(state, depth - 1); });
+            }
+        }
+        if (1 == state->remaining.fetch_sub(1)) {
+            state->done.set();
+        }
+    }
+
+    [[nodiscard]] long long fan_out_task_count() {
+        long long count{0};
+        long long level{1};
+        for (int i = 0; i <= fan_out_depth; ++i) {
+            count += level;
+            level *= fan_out_width;
+        }
+        return count;
+    }
+
+} // namespace
+
+//
+// Every callback submits fan_out_width callbacks until tree reaches
+// fan_out_depth. All but the root submission come from pool threads.
+//
+void bench_tp_fan_out() {
+    printf("\n---- bench_tp_fan_out started, width %i, depth %i, tasks %lli\n",
+           fan_out_width,
+           fan_out_depth,
+           fan_out_task_count());
+
+    for (unsigned long threads : thread_counts()) {
+        ac::tp::thread_pool tp{threads, threads};
+        constexpr int iterations{5};
+        double best_ns{0};
+        for (int i = 0; i < iterations; ++i) {
+            fan_out_state state{&tp, fan_out_task_count()};
+            bench_clock::time_point start{bench_clock::now()};
+            tp.submit_work([&state](ac::tp::callback_instance &) { fan_out(&state, fan_out_depth); });
+            (void) state.done.wait();
+            double ns{elapsed_ns(start)};
+            if (0 == i || ns < best_ns) {
+                best_ns = ns;
+            }
+        }
+        printf("---- bench_tp_fan_out threads %3lu, %10.1f ns/task, %12.0f tasks/s\n",
+               threads,
+               best_ns / static_cast<double>(fan_out_task_count()),
+               static_cast<double>(fan_out_task_count()) * 1e9 / best_ns);
+    }
+    printf("---- bench_tp_fan_out complete\n");
+}
+
+namespace {
+
+    struct batch_state {
+        std::atomic<long long> remaining{0};
+        ac::event done{ac::event::manuel, ac::event::unsignaled};
+
+        void start(long long count) {
+            done.reset();
+            remaining = count;
+        }
+
+        void complete_one() {
+            if (1 == remaining.fetch_sub(1)) {
+                done.set();
+            }
+        }
+    };
+
+    struct batch_result {
+        double submit_ns{0};
+        double total_ns{0};
+    };
+
+    constexpr int batch_rounds{200};
+
+    template<typename S>
+    [[nodiscard]] batch_result run_batch_rounds(batch_state &state, int batch_size, S &&submit) {
+        batch_result result;
+        for (int round = 0; round < batch_rounds; ++round) {
+            state.start(batch_size);
+            bench_clock::time_point start{bench_clock::now()};
+            submit();
+            result.submit_ns += elapsed_ns(start);
+            (void) state.done.wait();
+            result.total_ns += elapsed_ns(start);
+        }
+        double const tasks{static_cast<double>(batch_rounds) * batch_size};
+        result.submit_ns /= tasks;
+        result.total_ns /= tasks;
+        return result;
+    }
+
+    void print_batch_result(char const *name, int batch_size, batch_result const &result) {
+        printf("---- bench_tp_submit_batch %-22s batch %5i, submit %8.1f ns/task, "
+               "submit to completion %8.1f ns/task\n",
+               name,
+               batch_size,
+               result.submit_ns,
+               result.total_ns);
+    }
+
+} // namespace
+
+//
+// Compares per task cost of submitting a batch one callback at a time
+// against submit_work_batch, and work_item::post() in a loop against
+// work_item::post(n). Submit cost is measured on the submitting thread,
+// completion cost is measured until the last callback of the batch ran.
+//
+void bench_tp_submit_batch() {
+    printf("\n---- bench_tp_submit_batch started\n");
+
+    unsigned long const threads{
+        std::max(1UL, static_cast<unsigned long>(std::thread::hardware_concurrency()))};
+    ac::tp::thread_pool tp{threads, threads};
+    batch_state state;
+
+    auto callback{[&state](ac::tp::callback_instance &) { state.complete_one(); }};
+
+    for (int batch_size : {16, 100, 1000}) {
+        std::vector<decltype(callback)> batch(static_cast<size_t>(batch_size), callback);
+
+        print_batch_result("submit_work loop", batch_size, run_batch_rounds(state, batch_size, [&] {
+                               for (auto &c : batch) {
+                                   tp.submit_work(c);
+                               }
+                           }));
+
+        print_batch_result("submit_work_batch", batch_size, run_batch_rounds(state, batch_size, [&] {
+                               tp.submit_work_batch(batch);
+                           }));
+
+        ac::tp::work_item_ptr work_item{tp.make_work_item(callback)};
+
+        print_batch_result("work_item post loop", batch_size, run_batch_rounds(state, batch_size, [&] {
+                               for (int i = 0; i < batch_size; ++i) {
+                                   work_item->post();
+                               }
+                           }));
+
+        print_batch_result("work_item post(n)", batch_size, run_batch_rounds(state, batch_size, [&] {
+                               work_item->post(static_cast<std::uint32_t>(batch_size));
+                           }));
+    }
+    printf("---- bench_tp_submit_batch complete\n");
+}
+
+namespace {
+
+    constexpr size_t timer_count{1'000'000};
+
+    //
+    // Runs operation for every timer, splitting timers evenly
+    // between threads, and returns ns it took for all threads
+    //
+    template<typename O>
+    [[nodiscard]] double run_on_threads(std::vector<ac::tp::timer_work_item_ptr> &timers,
+                                        unsigned long threads,
+                                        O &&operation) {
+        std::atomic<bool> go{false};
+        std::vector<std::thread> workers;
+        size_t const slice{(timers.size() + threads - 1) / threads};
+        for (unsigned long t = 0; t < threads; ++t) {
+            workers.emplace_back([&, t] {
+                while (!go.load()) {
+                    std::this_thread::yield();
+                }
+                size_t const end{std::min(timers.size(), (t + 1) * slice)};
+                for (size_t i = t * slice; i < end; ++i) {
+                    operation(*timers[i], i);
+                }
+            });
+        }
+        bench_clock::time_point start{bench_clock::now()};
+        go = true;
+        for (std::thread &w : workers) {
+            w.join();
+        }
+        return elapsed_ns(start);
+    }
+
+    void print_timer_result(char const *name, unsigned long threads, double ns) {
+        printf("---- bench_tp_timers %-8s threads %3lu, %8.1f ns/timer, %12.0f timers/s\n",
+               name,
+               threads,
+               ns / static_cast<double>(timer_count),
+               static_cast<double>(timer_count) * 1e9 / ns);
+    }
+
+} // namespace
+
+//
+// Arms and cancels timer_count timers from several threads at once.
+// Timers are armed with due times spread over an hour, so they land on
+// every level of the timing wheel and none of them expires. Last round
+// arms all timers to expire within one second and measures how long it
+// takes until all callbacks ran.
+//
+void bench_tp_timers() {
+    printf("\n---- bench_tp_timers started, timers %zu\n", timer_count);
+
+    batch_state state;
+    std::vector<ac::tp::timer_work_item_ptr> timers;
+    timers.reserve(timer_count);
+    for (size_t i = 0; i < timer_count; ++i) {
+        timers.push_back(ac::tp::timer_work_item::make(
+            [&state](ac::tp::callback_instance &) { state.complete_one(); }));
+    }
+
+    for (unsigned long threads : thread_counts()) {
+        double const arm_ns{run_on_threads(timers, threads, [](ac::tp::timer_work_item &timer, size_t i) {
+            timer.schedule(ac::tp::miliseconds{60'000 + static_cast<long long>((i * 7919) % 3'600'000)});
+        })};
+        print_timer_result("arm", threads, arm_ns);
+
+        double const cancel_ns{run_on_threads(timers, threads, [](ac::tp::timer_work_item &timer, size_t) {
+            timer.cancel_and_join();
+        })};
+        print_timer_result("cancel", threads, cancel_ns);
+    }
+
+    state.start(static_cast<long long>(timer_count));
+    bench_clock::time_point start{bench_clock::now()};
+    (void) run_on_threads(timers, 1, [](ac::tp::timer_work_item &timer, size_t i) {
+        timer.schedule(ac::tp::miliseconds{static_cast<long long>(i % 1000)});
+    });
+    (void) state.done.wait();
+    printf("---- bench_tp_timers expire all within 1 s, completed in %.1f ms\n",
+           elapsed_ns(start) / 1e6);
+    printf("---- bench_tp_timers complete\n");
+}
+
+namespace {
+
+    constexpr size_t coalescing_timer_count{2000};
+    constexpr std::chrono::milliseconds coalescing_run_time{2000};
+
+    struct coalescing_result {
+        double wakeups_per_second{0};
+        double callbacks_per_second{0};
+    };
+
+    [[nodiscard]] coalescing_result run_periodic_timers(ac::tp::miliseconds window_length) {
+        std::atomic<long long> callbacks{0};
+        std::vector<ac::tp::timer_work_item_ptr> timers;
+        timers.reserve(coalescing_timer_count);
+        for (size_t i = 0; i < coalescing_timer_count; ++i) {
+            timers.push_back(ac::tp::timer_work_item::make(
+                [&callbacks](ac::tp::callback_instance &) { callbacks.fetch_add(1); }));
+        }
+        ac::tp::details::timer_queue &queue{ac::tp::details::timer_queue::instance()};
+        std::uint64_t const wakeups_before{queue.get_wakeup_count()};
+        bench_clock::time_point start{bench_clock::now()};
+        for (size_t i = 0; i < coalescing_timer_count; ++i) {
+            //
+            // Housekeeping timers with periods between 100 and 250 ms
+            // and random phases
+            //
+            long long const period{100 + static_cast<long long>((i * 37) % 151)};
+            timers[i]->schedule(ac::tp::miliseconds{static_cast<long long>((i * 7919) % 1000)},
+                                ac::tp::miliseconds{period},
+                                window_length);
+        }
+        std::this_thread::sleep_for(coalescing_run_time);
+        for (ac::tp::timer_work_item_ptr &timer : timers) {
+            timer->cancel_and_join();
+        }
+        double const seconds{elapsed_ns(start) / 1e9};
+        return {static_cast<double>(queue.get_wakeup_count() - wakeups_before) / seconds,
+                static_cast<double>(callbacks.load()) / seconds};
+    }
+
+} // namespace
+
+//
+// Runs periodic timers with different tolerance windows, and reports
+// how many timer thread wakeups per second coalescing saves compared
+// to timers that expire exactly on time.
+//
+void bench_tp_timer_coalescing() {
+    printf("\n---- bench_tp_timer_coalescing started, timers %zu\n", coalescing_timer_count);
+
+    coalescing_result const exact{run_periodic_timers(ac::tp::miliseconds{0})};
+    for (long long window : {0LL, 10LL, 50LL, 100LL}) {
+        coalescing_result const result{
+            window ? run_periodic_timers(ac::tp::miliseconds{window}) : exact};
+        printf("---- bench_tp_timer_coalescing window %4lli ms, %8.1f wakeups/s, "
+               "%10.1f callbacks/s, %8.1f wakeups/s saved\n",
+               window,
+               result.wakeups_per_second,
+               result.callbacks_per_second,
+               exact.wakeups_per_second - result.wakeups_per_second);
+    }
+    printf("---- bench_tp_timer_coalescing complete\n");
+}
+
+namespace {
+
+    constexpr std::chrono::milliseconds flood_run_time{2000};
+    constexpr std::chrono::microseconds flood_task_time{20};
+
+    void spin_for(std::chrono::microseconds duration) {
+        bench_clock::time_point const end{bench_clock::now() + duration};
+        while (bench_clock::now() < end) {
+        }
+    }
+
+    void print_queue_wait(char const *name, ac::tp::queue_wait_histogram const &histogram) {
+        printf("---- bench_tp_priority %-34s %9llu callbacks, p50 %10.1f us, p99 %10.1f us\n",
+               name,
+               static_cast<unsigned long long>(histogram.count()),
+               static_cast<double>(histogram.percentile(0.5).count()) / 1e3,
+               static_cast<double>(histogram.percentile(0.99).count()) / 1e3);
+    }
+
+    //
+    // Keeps low priority queue a few thousand callbacks deep, and
+    // submits a latency sensitive callback every millisecond
+    //
+    void run_flood(ac::tp::thread_pool &tp, TP_CALLBACK_PRIORITY probe_priority) {
+        ac::tp::optional_callback_parameters low;
+        low.priority = TP_CALLBACK_PRIORITY_LOW;
+        ac::tp::optional_callback_parameters probe;
+        probe.priority = probe_priority;
+
+        std::atomic<long long> outstanding{0};
+        auto flood_callback{[&outstanding](ac::tp::callback_instance &) {
+            spin_for(flood_task_time);
+            outstanding.fetch_sub(1);
+        }};
+        auto probe_callback{[&outstanding](ac::tp::callback_instance &) { outstanding.fetch_sub(1); }};
+
+        bench_clock::time_point const end{bench_clock::now() + flood_run_time};
+        while (bench_clock::now() < end) {
+            while (outstanding.load() < 4000) {
+                outstanding.fetch_add(1);
+                tp.submit_work(flood_callback, &low);
+            }
+            outstanding.fetch_add(1);
+            tp.submit_work(probe_callback, &probe);
+            std::this_thread::sleep_for(std::chrono::milliseconds{1});
+        }
+        while (0 != outstanding.load()) {
+            std::this_thread::sleep_for(std::chrono::milliseconds{1});
+        }
+    }
+
+    void run_flood_and_report(ac::tp::thread_pool &tp, TP_CALLBACK_PRIORITY probe_priority, char const *name) {
+        ac::tp::queue_wait_histogram before{tp.get_queue_wait_histogram(probe_priority)};
+        run_flood(tp, probe_priority);
+        ac::tp::queue_wait_histogram after{tp.get_queue_wait_histogram(probe_priority)};
+        after -= before;
+        print_queue_wait(name, after);
+    }
+
+} // namespace
+
+//
+// Measures queue wait of latency sensitive callbacks while the pool
+// is flooded with low priority work. Probes run once with the same
+// priority as the flood, and once with high priority.
+//
+void bench_tp_priority() {
+    printf("\n---- bench_tp_priority started, flood callback %lli us\n",
+           static_cast<long long>(flood_task_time.count()));
+
+    unsigned long const threads{
+        std::max(1UL, static_cast<unsigned long>(std::thread::hardware_concurrency()))};
+    ac::tp::thread_pool tp{threads, threads};
+    tp.enable_queue_wait_histogram();
+
+    {
+        ac::tp::queue_wait_histogram idle_before{tp.get_queue_wait_histogram(TP_CALLBACK_PRIORITY_HIGH)};
+        ac::tp::optional_callback_parameters high;
+        high.priority = TP_CALLBACK_PRIORITY_HIGH;
+        std::atomic<int> remaining{1000};
+        for (int i = 0; i < 1000; ++i) {
+            tp.submit_work([&remaining](ac::tp::callback_instance &) { remaining.fetch_sub(1); }, &high);
+            std::this_thread::sleep_for(std::chrono::microseconds{100});
+        }
+        while (0 != remaining.load()) {
+            std::this_thread::sleep_for(std::chrono::milliseconds{1});
+        }
+        ac::tp::queue_wait_histogram idle_after{tp.get_queue_wait_histogram(TP_CALLBACK_PRIORITY_HIGH)};
+        idle_after -= idle_before;
+        print_queue_wait("high, idle pool", idle_after);
+    }
+
+    run_flood_and_report(tp, TP_CALLBACK_PRIORITY_LOW, "low, queued with low flood");
+    run_flood_and_report(tp, TP_CALLBACK_PRIORITY_HIGH, "high, under low flood");
+    printf("---- bench_tp_priority complete\n");
+}
+
+namespace {
+
+    constexpr std::chrono::milliseconds adaptive_run_time{3000};
+
+    char const *to_string(ac::tp::concurrency_adjustment::reason_t reason) {
+        switch (reason) {
+        case ac::tp::concurrency_adjustment::reason_t::climb:
+            return "climb";
+        case ac::tp::concurrency_adjustment::reason_t::reverse:
+            return "reverse";
+        case ac::tp::concurrency_adjustment::reason_t::trim:
+            return "trim";
+        case ac::tp::concurrency_adjustment::reason_t::starvation:
+            return "starvation";
+        case ac::tp::concurrency_adjustment::reason_t::probe:
+            return "probe";
+        }
+        return "unknown";
+    }
+
+    //
+    // Keeps the pool backlogged with callbacks, and lets controller
+    // settle on a worker count
+    //
+    template<typename C>
+    void run_adaptive(char const *name, C &&callback) {
+        ac::tp::thread_pool tp{1, 64};
+        unsigned long const start_threads{tp.get_thread_count()};
+        if (!tp.enable_adaptive_concurrency(std::chrono::milliseconds{50})) {
+            printf("---- bench_tp_adaptive %s failed to start controller\n", name);
+            return;
+        }
+        std::atomic<long long> outstanding{0};
+        std::atomic<long long> completed{0};
+        auto wrapped{[&](ac::tp::callback_instance &) {
+            callback();
+            completed.fetch_add(1);
+            outstanding.fetch_sub(1);
+        }};
+        bench_clock::time_point const start{bench_clock::now()};
+        bench_clock::time_point const end{start + adaptive_run_time};
+        long long completed_at_half{0};
+        bench_clock::time_point half{start + adaptive_run_time / 2};
+        bool half_taken{false};
+        while (bench_clock::now() < end) {
+            while (outstanding.load() < 512) {
+                outstanding.fetch_add(1);
+                tp.submit_work(wrapped);
+            }
+            if (!half_taken && bench_clock::now() >= half) {
+                completed_at_half = completed.load();
+                half = bench_clock::now();
+                half_taken = true;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds{1});
+        }
+        double const settled_seconds{std::chrono::duration<double>(bench_clock::now() - half).count()};
+        double const settled_throughput{static_cast<double>(completed.load() - completed_at_half) /
+                                        settled_seconds};
+        std::vector<ac::tp::concurrency_adjustment> adjustments{tp.get_concurrency_adjustments()};
+        tp.disable_adaptive_concurrency();
+        while (0 != outstanding.load()) {
+            std::this_thread::sleep_for(std::chrono::milliseconds{1});
+        }
+        printf("---- bench_tp_adaptive %-10s started with %2lu threads, settled on %2lu, "
+               "%10.0f callbacks/s in the second half, %zu adjustments\n",
+               name,
+               start_threads,
+               adjustments.empty() ? start_threads : adjustments.back().to_,
+               settled_throughput,
+               adjustments.size());
+        size_t const shown{std::min<size_t>(adjustments.size(), 8)};
+        for (size_t i = adjustments.size() - shown; i < adjustments.size(); ++i) {
+            printf("---- bench_tp_adaptive %-10s   %2lu -> %2lu %-10s at %10.0f callbacks/s\n",
+                   name,
+                   adjustments[i].from_,
+                   adjustments[i].to_,
+                   to_string(adjustments[i].reason_),
+                   adjustments[i].throughput_);
+        }
+    }
+
+} // namespace
+
+//
+// Runs CPU bound callbacks and blocking callbacks on a pool that
+// starts with one worker per CPU, and reports where the hill climbing
+// controller settled. CPU bound callbacks should stay close to the
+// number of CPUs, blocking callbacks should get more workers.
+//
+void bench_tp_adaptive() {
+    unsigned long const hardware_threads{
+        std::max(1UL, static_cast<unsigned long>(std::thread::hardware_concurrency()))};
+    printf("\n---- bench_tp_adaptive started, hardware threads %lu\n", hardware_threads);
+
+    run_adaptive("cpu bound", [] {
+        spin_for(std::chrono::microseconds{50});
+    });
+    run_adaptive("blocking", [] { std::this_thread::sleep_for(std::chrono::milliseconds{1}); });
+    printf("---- bench_tp_adaptive complete\n");
+}
+
+namespace {
+
+    constexpr int blocking_callback_count{20'000};
+    constexpr int blocking_percent{30};
+
+    [[nodiscard]] double process_cpu_seconds() {
+        timespec ts{};
+        clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+        return static_cast<double>(ts.tv_sec) + static_cast<double>(ts.tv_nsec) / 1e9;
+    }
+
+    //
+    // Every callback spins, and blocking_percent of them also
+    // sleep, with or without a blocking scope around the sleep
+    //
+    void run_blocking_mix(bool use_blocking_scope) {
+        unsigned long const threads{
+            std::max(1UL, static_cast<unsigned long>(std::thread::hardware_concurrency()))};
+        ac::tp::thread_pool tp{threads, threads * 8};
+        batch_state state;
+        state.start(blocking_callback_count);
+        std::uint64_t const compensations_before{tp.get_compensation_count()};
+        double const cpu_start{process_cpu_seconds()};
+        bench_clock::time_point const start{bench_clock::now()};
+        for (int i = 0; i < blocking_callback_count; ++i) {
+            bool const blocks{(i % 100) < blocking_percent};
+            tp.submit_work([&state, blocks, use_blocking_scope](ac::tp::callback_instance &instance) {
+                spin_for(std::chrono::microseconds{100});
+                if (blocks) {
+                    if (use_blocking_scope) {
+                        ac::tp::callback_instance::blocking_scope scope{instance};
+                        std::this_thread::sleep_for(std::chrono::microseconds{500});
+                    } else {
+                        std::this_thread::sleep_for(std::chrono::microseconds{500});
+                    }
+                }
+                state.complete_one();
+            });
+        }
+        (void) state.done.wait();
+        double const wall{elapsed_ns(start) / 1e9};
+        double const cpu{process_cpu_seconds() - cpu_start};
+        printf("---- bench_tp_blocking %-22s %7.3f s, CPU utilization %5.1f%%, compensating workers %llu\n",
+               use_blocking_scope ? "with blocking_scope" : "without blocking_scope",
+               wall,
+               100.0 * cpu / (wall * static_cast<double>(threads)),
+               static_cast<unsigned long long>(tp.get_compensation_count() - compensations_before));
+    }
+
+} // namespace
+
+//
+// Runs a mix where 30% of callbacks block, and reports how busy
+// CPUs were with and without telling the pool about blocking
+//
+void bench_tp_blocking() {
+    printf("\n---- bench_tp_blocking started, callbacks %i, %i%% block for 500 us\n",
+           blocking_callback_count,
+           blocking_percent);
+    run_blocking_mix(false);
+    run_blocking_mix(true);
+    printf("---- bench_tp_blocking complete\n");
+}
+
+namespace {
+
+    constexpr int coroutine_hops{200'000};
+    constexpr int coroutine_sleeps{2'000};
+
+    struct hop_chain_state {
+        ac::tp::thread_pool *tp;
+        int remaining;
+        ac::event done{ac::event::manuel, ac::event::unsignaled};
+    };
+
+    //
+    // Hand written continuation: every step submits the next one
+    //
+    void hop_chain(hop_chain_state *state) {
+        if (0 == --state->remaining) {
+            state->done.set();
+            return;
+        }
+        state->tp->submit_work([state](ac::tp::callback_instance &) { hop_chain(state); });
+    }
+
+    [[nodiscard]] ac::tp::task<int> hop_leaf(ac::tp::thread_pool &tp) {
+        co_await tp.schedule();
+        co_return 1;
+    }
+
+    [[nodiscard]] ac::tp::task<void> hop_loop(ac::tp::thread_pool &tp, int hops) {
+        for (int i = 0; i < hops; ++i) {
+            co_await tp.schedule();
+        }
+    }
+
+    [[nodiscard]] ac::tp::task<int> hop_nested(ac::tp::thread_pool &tp, int hops) {
+        int sum{0};
+        for (int i = 0; i < hops; ++i) {
+            sum += co_await hop_leaf(tp);
+        }
+        co_return sum;
+    }
+
+    [[nodiscard]] ac::tp::task<void> sleep_loop(ac::tp::thread_pool &tp, int sleeps) {
+        for (int i = 0; i < sleeps; ++i) {
+            co_await tp.sleep_for(std::chrono::milliseconds{1});
+        }
+    }
+
+    struct sleep_chain_state {
+        ac::tp::timer_work_item_ptr timer;
+        int remaining;
+        ac::event done{ac::event::manuel, ac::event::unsignaled};
+    };
+
+    void print_hop_result(char const *name, int hops, double ns) {
+        printf("---- bench_tp_coroutine %-28s %10.1f ns/step\n", name, ns / static_cast<double>(hops));
+    }
+
+} // namespace
+
+//
+// Compares a sequence of steps written as a chain of callbacks with
+// the same sequence written as one coroutine
+//
+void bench_tp_coroutine() {
+    printf("\n---- bench_tp_coroutine started, hops %i, 1 ms sleeps %i\n", coroutine_hops, coroutine_sleeps);
+    ac::tp::thread_pool tp{1, 1};
+    {
+        hop_chain_state state{&tp, coroutine_hops + 1};
+        bench_clock::time_point const start{bench_clock::now()};
+        tp.submit_work([&state](ac::tp::callback_instance &) { hop_chain(&state); });
+        (void) state.done.wait();
+        print_hop_result("submit_work chain", coroutine_hops, elapsed_ns(start));
+    }
+    {
+        bench_clock::time_point const start{bench_clock::now()};
+        ac::tp::sync_wait(hop_loop(tp, coroutine_hops));
+        print_hop_result("co_await schedule()", coroutine_hops, elapsed_ns(start));
+    }
+    {
+        bench_clock::time_point const start{bench_clock::now()};
+        (void) ac::tp::sync_wait(hop_nested(tp, coroutine_hops));
+        print_hop_result("co_await task<int>", coroutine_hops, elapsed_ns(start));
+    }
+    {
+        sleep_chain_state state{nullptr, coroutine_sleeps};
+        state.timer = tp.make_timer_work_item([&state](ac::tp::callback_instance &) {
+            if (0 == --state.remaining) {
+                state.done.set();
+            } else {
+                state.timer->schedule(std::chrono::milliseconds{1});
+            }
+        });
+        bench_clock::time_point const start{bench_clock::now()};
+        state.timer->schedule(std::chrono::milliseconds{1});
+        (void) state.done.wait();
+        print_hop_result("timer_work_item 1 ms chain", coroutine_sleeps, elapsed_ns(start));
+    }
+    {
+        bench_clock::time_point const start{bench_clock::now()};
+        ac::tp::sync_wait(sleep_loop(tp, coroutine_sleeps));
+        print_hop_result("co_await sleep_for(1 ms)", coroutine_sleeps, elapsed_ns(start));
+    }
+    printf("---- bench_tp_coroutine complete\n");
+}
+
+namespace {
+
+    constexpr int sender_round_trips{50'000};
+    constexpr int sender_bulk_shape{64};
+    constexpr int sender_bulk_rounds{5'000};
+
+    void print_sender_result(char const *name, double ns, int count) {
+        printf("---- bench_tp_sender %-34s %10.1f ns/op\n", name, ns / static_cast<double>(count));
+    }
+
+} // namespace
+
+//
+// Compares senders with the raw submit_work path. Round trip is
+// submit from the caller, run on a worker, and wake the caller.
+//
+void bench_tp_sender() {
+    printf("\n---- bench_tp_sender started, round trips %i, bulk shape %i\n",
+           sender_round_trips,
+           sender_bulk_shape);
+    unsigned long const threads{
+        std::max(1UL, static_cast<unsigned long>(std::thread::hardware_concurrency()))};
+    ac::tp::thread_pool tp{threads, threads};
+    ac::tp::exec::scheduler const sch{tp.get_scheduler()};
+    {
+        batch_state state;
+        bench_clock::time_point const start{bench_clock::now()};
+        for (int i = 0; i < sender_round_trips; ++i) {
+            state.start(1);
+            tp.submit_work([&state](ac::tp::callback_instance &) { state.complete_one(); });
+            (void) state.done.wait();
+        }
+        print_sender_result("submit_work round trip", elapsed_ns(start), sender_round_trips);
+    }
+    {
+        bench_clock::time_point const start{bench_clock::now()};
+        for (int i = 0; i < sender_round_trips; ++i) {
+            (void) ac::tp::exec::sync_wait(sch.schedule() | ac::tp::exec::then([] { return 1; }));
+        }
+        print_sender_result("sync_wait(schedule | then) round trip", elapsed_ns(start), sender_round_trips);
+    }
+    {
+        batch_state state;
+        bench_clock::time_point const start{bench_clock::now()};
+        for (int i = 0; i < sender_round_trips; ++i) {
+            state.start(4);
+            for (int j = 0; j < 4; ++j) {
+                tp.submit_work([&state](ac::tp::callback_instance &) { state.complete_one(); });
+            }
+            (void) state.done.wait();
+        }
+        print_sender_result("4 x submit_work", elapsed_ns(start), sender_round_trips);
+    }
+    {
+        bench_clock::time_point const start{bench_clock::now()};
+        for (int i = 0; i < sender_round_trips; ++i) {
+            (void) ac::tp::exec::sync_wait(
+                ac::tp::exec::when_all(sch.schedule(), sch.schedule(), sch.schedule(), sch.schedule()));
+        }
+        print_sender_result("when_all of 4 x schedule", elapsed_ns(start), sender_round_trips);
+    }
+    std::vector<std::uint64_t> values(sender_bulk_shape);
+    {
+        batch_state state;
+        auto const callbacks{std::views::iota(0, sender_bulk_shape) | std::views::transform([&state, &values](int i) {
+                                 return [&state, &values, i](ac::tp::callback_instance &) {
+                                     values[i] += i;
+                                     state.complete_one();
+                                 };
+                             })};
+        bench_clock::time_point const start{bench_clock::now()};
+        for (int round = 0; round < sender_bulk_rounds; ++round) {
+            state.start(sender_bulk_shape);
+            tp.submit_work_batch(callbacks);
+            (void) state.done.wait();
+        }
+        print_sender_result("submit_work_batch per item", elapsed_ns(start), sender_bulk_rounds * sender_bulk_shape);
+    }
+    {
+        bench_clock::time_point const start{bench_clock::now()};
+        for (int round = 0; round < sender_bulk_rounds; ++round) {
+            (void) ac::tp::exec::sync_wait(
+                sch.schedule() | ac::tp::exec::bulk(sender_bulk_shape, [&values](int i) { values[i] += i; }));
+        }
+        print_sender_result("bulk per item", elapsed_ns(start), sender_bulk_rounds * sender_bulk_shape);
+    }
+    printf("---- bench_tp_sender complete\n");
+}
+
+namespace {
+
+    constexpr size_t parallel_size{4'000'000};
+    constexpr int parallel_rounds{20};
+    constexpr int parallel_empty_loops{1'000'000};
+
+    //
+    // Memory light body, a few multiplications per element
+    //
+    [[nodiscard]] std::uint64_t parallel_mix(std::uint64_t value) noexcept {
+        for (int i = 0; i < 8; ++i) {
+            value = value * 6364136223846793005ULL + 1442695040888963407ULL;
+        }
+        return value;
+    }
+
+} // namespace
+
+//
+// Scaling of parallel loops with thread count, and cost of a loop
+// over an empty range
+//
+void bench_tp_parallel() {
+    printf("\n---- bench_tp_parallel started, elements %zu, rounds %i\n", parallel_size, parallel_rounds);
+    std::vector<std::uint64_t> values(parallel_size);
+    double single_thread_ns{0.0};
+    for (unsigned long threads : thread_counts()) {
+        ac::tp::thread_pool tp{threads, threads};
+        std::uint64_t checksum{0};
+        bench_clock::time_point const start{bench_clock::now()};
+        for (int round = 0; round < parallel_rounds; ++round) {
+            ac::tp::parallel_for(tp, values, [round](std::uint64_t &value) {
+                value = parallel_mix(value + static_cast<std::uint64_t>(round));
+            });
+            checksum += ac::tp::parallel_reduce(
+                tp, values, std::uint64_t{0}, std::plus<std::uint64_t>{});
+        }
+        double const ns{elapsed_ns(start)};
+        if (1 == threads) {
+            single_thread_ns = ns;
+        }
+        printf("---- bench_tp_parallel threads %3lu, %8.2f ns/element, speedup %5.2f, checksum %llx\n",
+               threads,
+               ns / static_cast<double>(parallel_size * parallel_rounds),
+               single_thread_ns / ns,
+               static_cast<unsigned long long>(checksum));
+    }
+    {
+        ac::tp::thread_pool tp;
+        std::uint64_t sum{0};
+        bench_clock::time_point const start{bench_clock::now()};
+        for (int i = 0; i < parallel_empty_loops; ++i) {
+            ac::tp::parallel_for(tp, 0, 0, [&sum](int i) { sum += static_cast<std::uint64_t>(i); });
+        }
+        printf("---- bench_tp_parallel empty parallel_for %10.1f ns/loop\n",
+               elapsed_ns(start) / static_cast<double>(parallel_empty_loops));
+    }
+    printf("---- bench_tp_parallel complete\n");
+}
+
+namespace {
+
+    constexpr int graph_stages{50};
+    constexpr int graph_runs{20'000};
+
+    //
+    // Chains stages by hand, each stage queues the next one
+    //
+    struct hand_chain {
+        ac::tp::thread_pool *tp;
+        batch_state *state;
+        std::uint64_t *values;
+
+        void stage(int index) {
+            tp->submit_work([this, index](ac::tp::callback_instance &) {
+                values[index] += static_cast<std::uint64_t>(index);
+                if (index + 1 < graph_stages) {
+                    stage(index + 1);
+                } else {
+                    state->complete_one();
+                }
+            });
+        }
+    };
+
+    void print_graph_result(char const *name, double ns) {
+        printf("---- bench_tp_graph %-36s %10.1f ns/run\n", name, ns / static_cast<double>(graph_runs));
+    }
+
+} // namespace
+
+//
+// Runs a pipeline of 50 stages chained by hand with submit_work, and
+// the same pipeline as a task_graph that is built once
+//
+void bench_tp_graph() {
+    printf("\n---- bench_tp_graph started, stages %i, runs %i\n", graph_stages, graph_runs);
+    unsigned long const threads{
+        std::max(1UL, static_cast<unsigned long>(std::thread::hardware_concurrency()))};
+    ac::tp::thread_pool tp{threads, threads};
+    std::vector<std::uint64_t> values(graph_stages);
+    {
+        batch_state state;
+        hand_chain chain{&tp, &state, values.data()};
+        bench_clock::time_point const start{bench_clock::now()};
+        for (int run = 0; run < graph_runs; ++run) {
+            state.start(1);
+            chain.stage(0);
+            (void) state.done.wait();
+        }
+        print_graph_result("chain, submit_work per stage", elapsed_ns(start));
+    }
+    {
+        ac::tp::task_graph graph;
+        for (int i = 0; i < graph_stages; ++i) {
+            ac::tp::task_graph::node_index const node{graph.add([&values, i](ac::tp::callback_instance &) {
+                values[i] += static_cast<std::uint64_t>(i);
+            })};
+            if (0 < i) {
+                graph.precede(node - 1, node);
+            }
+        }
+        bench_clock::time_point const start{bench_clock::now()};
+        for (int run = 0; run < graph_runs; ++run) {
+            graph.run(tp);
+        }
+        print_graph_result("chain, task_graph", elapsed_ns(start));
+    }
+    {
+        //
+        // Source, 48 independent stages, and a sink
+        //
+        ac::tp::task_graph graph;
+        auto const stage = [&values](int i) {
+            return [&values, i](ac::tp::callback_instance &) { values[i] += static_cast<std::uint64_t>(i); };
+        };
+        ac::tp::task_graph::node_index const source{graph.add(stage(0))};
+        ac::tp::task_graph::node_index const sink{graph.add(stage(graph_stages - 1))};
+        for (int i = 1; i < graph_stages - 1; ++i) {
+            ac::tp::task_graph::node_index const node{graph.add(stage(i))};
+            graph.precede(source, node);
+            graph.precede(node, sink);
+        }
+        bench_clock::time_point const start{bench_clock::now()};
+        for (int run = 0; run < graph_runs; ++run) {
+            graph.run(tp);
+        }
+        print_graph_result("fan out and in, task_graph", elapsed_ns(start));
+    }
+    printf("---- bench_tp_graph complete\n");
+}
+
+namespace {
+
+    constexpr int future_round_trips{50'000};
+
+    void print_future_result(char const *name, double ns) {
+        printf("---- bench_tp_future %-40s %10.1f ns/op\n", name, ns / static_cast<double>(future_round_trips));
+    }
+
+} // namespace
+
+//
+// Submit and join round trips that return a value
+//
+void bench_tp_future() {
+    printf("\n---- bench_tp_future started, round trips %i\n", future_round_trips);
+    unsigned long const threads{
+        std::max(1UL, static_cast<unsigned long>(std::thread::hardware_concurrency()))};
+    ac::tp::thread_pool tp{threads, threads};
+    long long sum{0};
+    {
+        bench_clock::time_point const start{bench_clock::now()};
+        for (int i = 0; i < future_round_trips; ++i) {
+            sum += std::async(std::launch::async, [i] { return i; }).get();
+        }
+        print_future_result("std::async", elapsed_ns(start));
+    }
+    {
+        bench_clock::time_point const start{bench_clock::now()};
+        for (int i = 0; i < future_round_trips; ++i) {
+            std::promise<int> promise;
+            std::future<int> result{promise.get_future()};
+            tp.submit_work([&promise, i](ac::tp::callback_instance &) { promise.set_value(i); });
+            sum += result.get();
+        }
+        print_future_result("submit_work and std::promise", elapsed_ns(start));
+    }
+    {
+        bench_clock::time_point const start{bench_clock::now()};
+        for (int i = 0; i < future_round_trips; ++i) {
+            sum += tp.async([i] { return i; }).get();
+        }
+        print_future_result("async", elapsed_ns(start));
+    }
+    {
+        bench_clock::time_point const start{bench_clock::now()};
+        for (int i = 0; i < future_round_trips; ++i) {
+            sum += tp.async([i] { return i; }).then([](int value) { return value + 1; }).get();
+        }
+        print_future_result("async then", elapsed_ns(start));
+    }
+    {
+        //
+        // Called from a worker, get() runs the callback itself
+        //
+        bench_clock::time_point const start{bench_clock::now()};
+        sum += tp.async([&tp] {
+                     long long inner{0};
+                     for (int i = 0; i < future_round_trips; ++i) {
+                         inner += tp.async([i] { return i; }).get();
+                     }
+                     return inner;
+                 }).get();
+        print_future_result("async from a worker", elapsed_ns(start));
+    }
+    printf("---- bench_tp_future complete, checksum %lld\n", sum);
+}
+
+namespace {
+
+    constexpr int strand_objects{64};
+    constexpr int strand_posts{2'000};
+    constexpr int strand_idle_count{1'000'000};
+
+    struct locked_object {
+        std::mutex lock;
+        std::uint64_t value{0};
+    };
+
+    void print_strand_result(char const *name, double ns) {
+        printf("---- bench_tp_strand %-36s %10.1f ns/callback\n",
+               name,
+               ns / static_cast<double>(strand_objects * strand_posts));
+    }
+
+} // namespace
+
+//
+// Serializes callbacks of each object with a lock taken in every
+// callback, and with a strand per object
+//
+void bench_tp_strand() {
+    printf("\n---- bench_tp_strand started, objects %i, posts per object %i\n", strand_objects, strand_posts);
+    unsigned long const threads{
+        std::max(1UL, static_cast<unsigned long>(std::thread::hardware_concurrency()))};
+    ac::tp::thread_pool tp{threads, threads};
+    std::uint64_t checksum{0};
+    {
+        std::vector<locked_object> objects(strand_objects);
+        batch_state state;
+        state.start(strand_objects * strand_posts);
+        bench_clock::time_point const start{bench_clock::now()};
+        for (int post = 0; post < strand_posts; ++post) {
+            for (locked_object &object : objects) {
+                tp.submit_work([&object, &state, post](ac::tp::callback_instance &) {
+                    {
+                        std::lock_guard<std::mutex> lock{object.lock};
+                        object.value += static_cast<std::uint64_t>(post);
+                    }
+                    state.complete_one();
+                });
+            }
+        }
+        (void) state.done.wait();
+        print_strand_result("submit_work and lock", elapsed_ns(start));
+        for (locked_object const &object : objects) {
+            checksum += object.value;
+        }
+    }
+    {
+        std::vector<std::uint64_t> values(strand_objects);
+        std::vector<std::unique_ptr<ac::tp::strand>> strands;
+        for (int i = 0; i < strand_objects; ++i) {
+            strands.push_back(std::make_unique<ac::tp::strand>(tp));
+        }
+        bench_clock::time_point const start{bench_clock::now()};
+        for (int post = 0; post < strand_posts; ++post) {
+            for (int i = 0; i < strand_objects; ++i) {
+                strands[i]->post([&values, i, post](ac::tp::callback_instance &) {
+                    values[i] += static_cast<std::uint64_t>(post);
+                });
+            }
+        }
+        for (std::unique_ptr<ac::tp::strand> const &s : strands) {
+            s->join();
+        }
+        print_strand_result("strand", elapsed_ns(start));
+        for (std::uint64_t value : values) {
+            checksum += value;
+        }
+    }
+    {
+        bench_clock::time_point const start{bench_clock::now()};
+        std::vector<ac::tp::strand> idle(strand_idle_count);
+        printf("---- bench_tp_strand %i idle strands, %zu bytes each, %.1f ns to construct one\n",
+               strand_idle_count,
+               sizeof(ac::tp::strand),
+               elapsed_ns(start) / static_cast<double>(strand_idle_count));
+    }
+    printf("---- bench_tp_strand complete, checksum %llu\n", static_cast<unsigned long long>(checksum));
+}
+
+namespace {
+
+    constexpr int active_objects{1'000};
+    constexpr int active_messages{200};
+
+    struct add_message {
+        std::uint64_t value;
+    };
+
+    struct flush_message {
+        batch_state *state;
+    };
+
+    class bench_active final: public ac::active<bench_active, add_message, flush_message> {
+    public:
+        explicit bench_active(ac::tp::thread_pool &tp)
+            : active{tp} {
+        }
+
+        ~bench_active() {
+            stop();
+        }
+
+        void on_message(add_message &message) {
+            sum += message.value;
+        }
+
+        void on_message(flush_message &message) {
+            message.state->complete_one();
+        }
+
+        std::uint64_t sum{0};
+    };
+
+} // namespace
+
+//
+// Thousands of active objects receiving messages from the caller.
+// Last message of every object signals that its mailbox drained.
+//
+void bench_tp_active() {
+    printf("\n---- bench_tp_active started, objects %i, messages per object %i\n", active_objects, active_messages);
+    unsigned long const threads{
+        std::max(1UL, static_cast<unsigned long>(std::thread::hardware_concurrency()))};
+    ac::tp::thread_pool tp{threads, threads};
+    std::vector<std::unique_ptr<bench_active>> objects;
+    for (int i = 0; i < active_objects; ++i) {
+        objects.push_back(std::make_unique<bench_active>(tp));
+    }
+    batch_state state;
+    state.start(active_objects);
+    double send_ns{0.0};
+    bench_clock::time_point const start{bench_clock::now()};
+    for (int message = 0; message < active_messages; ++message) {
+        bench_clock::time_point const send_start{bench_clock::now()};
+        for (std::unique_ptr<bench_active> const &object : objects) {
+            (void) object->send(add_message{static_cast<std::uint64_t>(message)});
+        }
+        send_ns += elapsed_ns(send_start);
+    }
+    for (std::unique_ptr<bench_active> const &object : objects) {
+        (void) object->send(flush_message{&state});
+    }
+    (void) state.done.wait();
+    double const total_ns{elapsed_ns(start)};
+    std::uint64_t checksum{0};
+    for (std::unique_ptr<bench_active> const &object : objects) {
+        checksum += object->sum;
+    }
+    double const messages{static_cast<double>(active_objects) * active_messages};
+    printf("---- bench_tp_active send %10.1f ns/message, end to end %10.1f ns/message, checksum %llu\n",
+           send_ns / messages,
+           total_ns / messages,
+           static_cast<unsigned long long>(checksum));
+    printf("---- bench_tp_active complete\n");
+}
+
+namespace {
+
+    constexpr int keyed_sessions{256};
+    constexpr int keyed_posts{200};
+    constexpr size_t keyed_session_bytes{16 * 1024};
+
+    struct keyed_session {
+        std::vector<std::uint64_t> state = std::vector<std::uint64_t>(keyed_session_bytes / sizeof(std::uint64_t));
+        std::mutex lock;
+    };
+
+    void touch_session(keyed_session &session, int post) {
+        for (std::uint64_t &value : session.state) {
+            value += static_cast<std::uint64_t>(post);
+        }
+    }
+
+    void print_keyed_result(char const *name, double ns) {
+        printf("---- bench_tp_keyed %-36s %10.1f ns/callback\n",
+               name,
+               ns / static_cast<double>(keyed_sessions * keyed_posts));
+    }
+
+} // namespace
+
+//
+// Callbacks update 16 KB of per session state. submit_work runs them
+// on any worker under a session lock, submit_keyed runs callbacks of
+// a session in order on the worker the session hashes to.
+//
+void bench_tp_keyed() {
+    printf("\n---- bench_tp_keyed started, sessions %i, posts per session %i\n", keyed_sessions, keyed_posts);
+    unsigned long const threads{
+        std::max(1UL, static_cast<unsigned long>(std::thread::hardware_concurrency()))};
+    ac::tp::thread_pool tp{threads, threads};
+    std::vector<keyed_session> sessions(keyed_sessions);
+    {
+        batch_state state;
+        state.start(keyed_sessions * keyed_posts);
+        bench_clock::time_point const start{bench_clock::now()};
+        for (int post = 0; post < keyed_posts; ++post) {
+            for (keyed_session &session : sessions) {
+                tp.submit_work([&session, &state, post](ac::tp::callback_instance &) {
+                    {
+                        std::lock_guard<std::mutex> lock{session.lock};
+                        touch_session(session, post);
+                    }
+                    state.complete_one();
+                });
+            }
+        }
+        (void) state.done.wait();
+        print_keyed_result("submit_work and session lock", elapsed_ns(start));
+    }
+    {
+        batch_state state;
+        state.start(keyed_sessions * keyed_posts);
+        bench_clock::time_point const start{bench_clock::now()};
+        for (int post = 0; post < keyed_posts; ++post) {
+            for (int key = 0; key < keyed_sessions; ++key) {
+                tp.submit_keyed(key, [&sessions, &state, key, post](ac::tp::callback_instance &) {
+                    touch_session(sessions[key], post);
+                    state.complete_one();
+                });
+            }
+        }
+        (void) state.done.wait();
+        print_keyed_result("submit_keyed", elapsed_ns(start));
+    }
+    std::uint64_t checksum{0};
+    for (keyed_session const &session : sessions) {
+        checksum += session.state.front();
+    }
+    printf("---- bench_tp_keyed complete, checksum %llu\n", static_cast<unsigned long long>(checksum));
+}
+
+namespace {
+
+    constexpr int overload_callbacks{100'000};
+    constexpr std::uint32_t overload_capacity{256};
+    constexpr std::chrono::microseconds overload_task_time{5};
+
+    //
+    // Producer submits faster than the pool runs callbacks. Reports
+    // the deepest backlog producer built up, and queue wait percentiles.
+    //
+    template<typename S>
+    void run_overload(char const *name, S &&submit) {
+        unsigned long const threads{
+            std::max(1UL, static_cast<unsigned long>(std::thread::hardware_concurrency()))};
+        ac::tp::thread_pool tp{threads, threads};
+        tp.enable_queue_wait_histogram();
+        tp.set_queue_capacity(overload_capacity);
+        batch_state state;
+        state.start(overload_callbacks);
+        long long deepest{0};
+        bench_clock::time_point const start{bench_clock::now()};
+        for (int i = 0; i < overload_callbacks; ++i) {
+            submit(tp, [&state](ac::tp::callback_instance &) {
+                spin_for(overload_task_time);
+                state.complete_one();
+            });
+            deepest = std::max(deepest, state.remaining.load(std::memory_order_relaxed) - (overload_callbacks - i - 1));
+        }
+        (void) state.done.wait();
+        double const total_ns{elapsed_ns(start)};
+        ac::tp::queue_wait_histogram const histogram{tp.get_queue_wait_histogram(TP_CALLBACK_PRIORITY_NORMAL)};
+        printf("---- bench_tp_bounded %-20s deepest backlog %7lld, total %8.1f ms, queue wait p50 %10.1f us, p99 %10.1f us\n",
+               name,
+               deepest,
+               total_ns / 1e6,
+               static_cast<double>(histogram.percentile(0.5).count()) / 1e3,
+               static_cast<double>(histogram.percentile(0.99).count()) / 1e3);
+    }
+
+} // namespace
+
+//
+// Producer floods the pool with 5 us callbacks, unbounded with
+// submit_work, and bounded with submit_work_or_wait
+//
+void bench_tp_bounded() {
+    printf("\n---- bench_tp_bounded started, callbacks %i, capacity %u\n", overload_callbacks, overload_capacity);
+    run_overload("submit_work", [](ac::tp::thread_pool &tp, auto &&callback) {
+        tp.submit_work(std::forward<decltype(callback)>(callback));
+    });
+    run_overload("submit_work_or_wait", [](ac::tp::thread_pool &tp, auto &&callback) {
+        tp.submit_work_or_wait(std::forward<decltype(callback)>(callback));
+    });
+    printf("---- bench_tp_bounded complete\n");
+}
+
+namespace {
+
+    constexpr int cleanup_objects{30'000};
+
+    struct cleanup_objects_set {
+        std::vector<ac::tp::work_item_ptr> works;
+        std::vector<ac::tp::timer_work_item_ptr> timers;
+        std::vector<ac::tp::wait_work_item_ptr> waits;
+    };
+
+    //
+    // Work items, timers armed a minute out, and waits on an event
+    // that is never signaled, cleanup_objects of each. Objects join
+    // group if there is one.
+    //
+    void make_cleanup_objects(cleanup_objects_set &set,
+                              ac::tp::thread_pool &tp,
+                              ac::tp::cleanup_group *group,
+                              HANDLE event) {
+        auto const work = [](ac::tp::callback_instance &) {};
+        auto const wait = [](ac::tp::callback_instance &, TP_WAIT_RESULT) {};
+        for (int i = 0; i < cleanup_objects; ++i) {
+            set.works.push_back(group ? group->make_work_item(tp, work) : tp.make_work_item(work));
+            set.timers.push_back(group ? group->make_timer_work_item(tp, work) : tp.make_timer_work_item(work));
+            set.timers.back()->schedule(std::chrono::minutes{1});
+            set.waits.push_back(group ? group->make_wait_work_item(tp, wait) : tp.make_wait_work_item(wait));
+            set.waits.back()->schedule_wait(event);
+        }
+    }
+
+    void destroy_cleanup_objects(cleanup_objects_set &set) {
+        set.works.clear();
+        set.timers.clear();
+        set.waits.clear();
+    }
+
+} // namespace
+
+//
+// Shuts down work, timer and wait items one at a time with
+// cancel_and_join, and with one cleanup_group::close_members
+//
+void bench_tp_cleanup() {
+    printf("\n---- bench_tp_cleanup started, objects %i\n", cleanup_objects * 3);
+    ac::tp::thread_pool tp;
+    ac::event event{ac::event::manuel, ac::event::unsignaled};
+    {
+        cleanup_objects_set set;
+        make_cleanup_objects(set, tp, nullptr, event.get_handle());
+        bench_clock::time_point const start{bench_clock::now()};
+        for (ac::tp::work_item_ptr &work : set.works) {
+            work->cancel_and_join();
+        }
+        for (ac::tp::timer_work_item_ptr &timer : set.timers) {
+            timer->cancel_and_join();
+        }
+        for (ac::tp::wait_work_item_ptr &wait : set.waits) {
+            wait->cancel_and_join();
+        }
+        destroy_cleanup_objects(set);
+        printf("---- bench_tp_cleanup %-32s %10.2f ms\n", "cancel_and_join every object", elapsed_ns(start) / 1e6);
+    }
+    {
+        ac::tp::cleanup_group group;
+        cleanup_objects_set set;
+        make_cleanup_objects(set, tp, &group, event.get_handle());
+        bench_clock::time_point const start{bench_clock::now()};
+        group.close_members();
+        destroy_cleanup_objects(set);
+        printf("---- bench_tp_cleanup %-32s %10.2f ms\n", "cleanup_group::close_members", elapsed_ns(start) / 1e6);
+    }
+    printf("---- bench_tp_cleanup complete\n");
+}
+
+namespace {
+
+    constexpr size_t churn_live_objects{100'000};
+    constexpr size_t churn_replacements{1'000'000};
+
+    [[nodiscard]] long long resident_kb() {
+        long long pages{0};
+        long long resident{0};
+        if (FILE *statm = fopen("/proc/self/statm", "r")) {
+            if (2 != fscanf(statm, "%lld %lld", &pages, &resident)) {
+                resident = 0;
+            }
+            fclose(statm);
+        }
+        return resident * sysconf(_SC_PAGESIZE) / 1024;
+    }
+
+    //
+    // Keeps churn_live_objects of each item type alive, and replaces
+    // random ones. Every replacement also allocates a buffer of random
+    // size, like a connection would, so items share the heap with
+    // other allocations. Then creates and destroys a work item back
+    // to back, where allocation is most of the cost.
+    //
+    template<typename W, typename T, typename M, typename N>
+    void run_churn(char const *name, M &&make_work, N &&make_timer) {
+        long long const start_kb{resident_kb()};
+        std::vector<W> works(churn_live_objects);
+        std::vector<T> timers(churn_live_objects);
+        std::vector<std::unique_ptr<char[]>> buffers(churn_live_objects);
+        std::mt19937 random{42};
+        auto const callback = [](ac::tp::callback_instance &) {};
+        for (size_t i = 0; i < churn_live_objects; ++i) {
+            works[i] = make_work(callback);
+            timers[i] = make_timer(callback);
+        }
+        bench_clock::time_point const start{bench_clock::now()};
+        for (size_t i = 0; i < churn_replacements; ++i) {
+            size_t const slot{random() % churn_live_objects};
+            works[slot] = make_work(callback);
+            timers[slot] = make_timer(callback);
+            buffers[slot] = std::make_unique<char[]>(16 + random() % 512);
+        }
+        double const churn_ns{elapsed_ns(start)};
+        long long const churn_kb{resident_kb() - start_kb};
+        bench_clock::time_point const back_to_back_start{bench_clock::now()};
+        for (size_t i = 0; i < churn_replacements; ++i) {
+            W work{make_work(callback)};
+        }
+        double const back_to_back_ns{elapsed_ns(back_to_back_start)};
+        works.clear();
+        timers.clear();
+        printf("---- bench_tp_churn %-18s churn %7.1f ns per item, resident %7lld KB, back to back %6.1f ns per item\n",
+               name,
+               churn_ns / (2.0 * churn_replacements),
+               churn_kb,
+               back_to_back_ns / static_cast<double>(churn_replacements));
+    }
+    //
+    // Each variant runs in its own process, so
+    // resident size is not shared between them
+    //
+    template<typename R>
+    void run_in_child(R &&run) {
+        fflush(stdout);
+        pid_t const child{fork()};
+        if (0 == child) {
+            run();
+            fflush(stdout);
+            _exit(0);
+        }
+        int status{0};
+        (void) waitpid(child, &status, 0);
+    }
+
+} // namespace
+
+//
+// Creation and destruction rate of work and timer items made with
+// std::make_unique, and with make() that takes them from node cache
+//
+void bench_tp_churn() {
+    printf("\n---- bench_tp_churn started, live items %zu, replacements %zu\n",
+           churn_live_objects * 2,
+           churn_replacements * 2);
+    run_in_child([] {
+        ac::tp::thread_pool tp;
+        ac::tp::callback_environment environment;
+        environment.set_thread_pool(tp.get_handle());
+        run_churn<std::unique_ptr<ac::tp::work_item>, std::unique_ptr<ac::tp::timer_work_item>>(
+            "std::make_unique",
+            [&environment](auto const &callback) {
+                return std::make_unique<ac::tp::work_item>(callback, &environment);
+            },
+            [&environment](auto const &callback) {
+                return std::make_unique<ac::tp::timer_work_item>(callback, &environment);
+            });
+    });
+    run_in_child([] {
+        ac::tp::thread_pool tp;
+        run_churn<ac::tp::work_item_ptr, ac::tp::timer_work_item_ptr>(
+            "node cache",
+            [&tp](auto const &callback) { return tp.make_work_item(callback); },
+            [&tp](auto const &callback) { return tp.make_timer_work_item(callback); });
+    });
+    printf("---- bench_tp_churn complete\n");
+}
+
+namespace {
+
+    constexpr int scratch_callbacks{200'000};
+
+    constexpr char const scratch_line[]{
+        "GET /api/v1/orders/1234567/items?limit=50&offset=100 HTTP/1.1 host=orders.example.com "
+        "user-agent=bench accept=application/json connection=keep-alive"};
+    constexpr int scratch_lines{4};
+    //
+    // Splits request lines into tokens, renders them into a string,
+    // and keeps a prefix of the rendered string for every token, the
+    // way a callback builds temporaries to handle its input
+    //
+    template<typename Tokens, typename String, typename Strings>
+    [[nodiscard]] size_t render_lines(Tokens &tokens, String &rendered, Strings &prefixes) {
+        for (int i = 0; i < scratch_lines; ++i) {
+            std::string_view const line{scratch_line};
+            size_t begin{0};
+            while (begin < line.size()) {
+                size_t end{begin};
+                while (end < line.size() && ' ' != line[end] && '/' != line[end] && '=' != line[end]) {
+                    ++end;
+                }
+                if (begin != end) {
+                    tokens.push_back(line.substr(begin, end - begin));
+                }
+                begin = end + 1;
+            }
+        }
+        prefixes.reserve(tokens.size());
+        for (std::string_view const token : tokens) {
+            rendered.append(token);
+            rendered.push_back(',');
+            prefixes.emplace_back(rendered.data(), std::min<size_t>(rendered.size(), 64));
+        }
+        size_t checksum{rendered.size()};
+        for (auto const &prefix : prefixes) {
+            checksum += prefix.size();
+        }
+        return checksum;
+    }
+
+    template<typename C>
+    void run_scratch(ac::tp::thread_pool &tp, char const *name, C &&callback) {
+        batch_state state;
+        state.start(scratch_callbacks);
+        std::atomic<size_t> checksum{0};
+        bench_clock::time_point const start{bench_clock::now()};
+        for (int i = 0; i < scratch_callbacks; ++i) {
+            tp.submit_work([&state, &checksum, &callback](ac::tp::callback_instance &instance) {
+                checksum.fetch_add(callback(instance), std::memory_order_relaxed);
+                state.complete_one();
+            });
+        }
+        (void) state.done.wait();
+        printf("---- bench_tp_scratch %-22s %8.1f ns/callback, checksum %zu\n",
+               name,
+               elapsed_ns(start) / scratch_callbacks,
+               checksum.load());
+    }
+
+} // namespace
+
+//
+// Callbacks render request lines into strings and vectors
+// that are dropped when callback returns. Temporaries come
+// from the heap, or from the scratch resource of callback_instance.
+//
+void bench_tp_scratch() {
+    printf("\n---- bench_tp_scratch started, callbacks %i\n", scratch_callbacks);
+    unsigned long const threads{
+        std::max(1UL, static_cast<unsigned long>(std::thread::hardware_concurrency()))};
+    ac::tp::thread_pool tp{threads, threads};
+    run_scratch(tp, "heap", [](ac::tp::callback_instance &) {
+        std::vector<std::string_view> tokens;
+        std::string rendered;
+        std::vector<std::string> prefixes;
+        return render_lines(tokens, rendered, prefixes);
+    });
+    run_scratch(tp, "scratch resource", [](ac::tp::callback_instance &instance) {
+        std::pmr::memory_resource &scratch{instance.get_scratch_resource()};
+        std::pmr::vector<std::string_view> tokens{&scratch};
+        std::pmr::string rendered{&scratch};
+        std::pmr::vector<std::pmr::string> prefixes{&scratch};
+        return render_lines(tokens, rendered, prefixes);
+    });
+    printf("---- bench_tp_scratch complete\n");
+}
+
+namespace {
+
+    constexpr int rundown_iterations{2'000'000};
+
+    //
+    // Every thread acquires and releases the same rundown
+    // rundown_iterations times
+    //
+    template<typename R>
+    void run_rundown(char const *name, unsigned long threads) {
+        R rundown;
+        std::atomic<unsigned long> ready{0};
+        std::atomic<bool> go{false};
+        std::vector<std::thread> workers;
+        for (unsigned long i = 0; i < threads; ++i) {
+            workers.emplace_back([&rundown, &ready, &go] {
+                ready.fetch_add(1);
+                while (!go.load(std::memory_order_acquire)) {
+                    std::this_thread::yield();
+                }
+                for (int iteration = 0; iteration < rundown_iterations; ++iteration) {
+                    if (rundown.try_acquire()) {
+                        rundown.release();
+                    }
+                }
+            });
+        }
+        while (threads != ready.load()) {
+            std::this_thread::yield();
+        }
+        bench_clock::time_point const start{bench_clock::now()};
+        go.store(true, std::memory_order_release);
+        for (std::thread &worker : workers) {
+            worker.join();
+        }
+        double const total_ns{elapsed_ns(start)};
+        printf("---- bench_tp_rundown %-16s threads %3lu %8.1f ns per acquire and release, %8.1f M pairs/s\n",
+               name,
+               threads,
+               total_ns / rundown_iterations,
+               threads * rundown_iterations / total_ns * 1'000.0);
+    }
+
+} // namespace
+
+//
+// Acquire and release throughput of rundown, slim_rundown and
+// sharded_rundown as threads are added
+//
+void bench_tp_rundown() {
+    printf("\n---- bench_tp_rundown started, iterations per thread %i\n", rundown_iterations);
+    for (unsigned long threads : thread_counts()) {
+        run_rundown<ac::rundown>("rundown", threads);
+        run_rundown<ac::slim_rundown>("slim_rundown", threads);
+        run_rundown<ac::sharded_rundown>("sharded_rundown", threads);
+    }
+    printf("---- bench_tp_rundown complete\n");
+}
+
+namespace {
+
+    constexpr int wake_round_trips{20'000};
+    constexpr std::uint32_t wake_spin_count{100};
+
+    void print_wake_result(char const *name, double total_ns) {
+        printf("---- bench_tp_wake %-34s %8.1f ns per wake and run\n", name, total_ns / (2.0 * wake_round_trips));
+    }
+    //
+    // Two threads pass a counter back and forth. Each one waits until
+    // counter becomes its turn, so every step is a wake of a thread
+    // that waits, and the time it takes that thread to run.
+    //
+    template<typename T>
+    void run_wake_on_address(char const *name, std::uint32_t spin_count) {
+        std::atomic<T> turn{0};
+        T const volatile *address{reinterpret_cast<T const volatile *>(&turn)};
+        auto const pass = [&turn, address, spin_count](T wait_for, T next) {
+            for (T current = turn.load(std::memory_order_acquire); wait_for != current;
+                 current = turn.load(std::memory_order_acquire)) {
+                (void) ac::wait_on_address::try_wait_for(address, current, std::chrono::nanoseconds{-1}, spin_count);
+            }
+            turn.store(next, std::memory_order_release);
+            ac::wait_on_address::wake_single(address);
+        };
+        bench_clock::time_point const start{bench_clock::now()};
+        std::thread peer{[&pass] {
+            for (int i = 0; i < wake_round_trips; ++i) {
+                pass(static_cast<T>(2 * i + 1), static_cast<T>(2 * i + 2));
+            }
+        }};
+        for (int i = 0; i < wake_round_trips; ++i) {
+            pass(static_cast<T>(2 * i), static_cast<T>(2 * i + 1));
+        }
+        peer.join();
+        print_wake_result(name, elapsed_ns(start));
+    }
+
+    void run_wake_condition_variable() {
+        std::mutex lock;
+        std::condition_variable changed;
+        int turn{0};
+        auto const pass = [&lock, &changed, &turn](int wait_for, int next) {
+            {
+                std::unique_lock<std::mutex> guard{lock};
+                changed.wait(guard, [&turn, wait_for] { return wait_for == turn; });
+                turn = next;
+            }
+            changed.notify_one();
+        };
+        bench_clock::time_point const start{bench_clock::now()};
+        std::thread peer{[&pass] {
+            for (int i = 0; i < wake_round_trips; ++i) {
+                pass(2 * i + 1, 2 * i + 2);
+            }
+        }};
+        for (int i = 0; i < wake_round_trips; ++i) {
+            pass(2 * i, 2 * i + 1);
+        }
+        peer.join();
+        print_wake_result("condition_variable", elapsed_ns(start));
+    }
+
+} // namespace
+
+//
+// Wake to run latency of wait_on_address on a futex, on the parking
+// lot, with a spin before it blocks, and of a condition variable
+//
+void bench_tp_wake() {
+    printf("\n---- bench_tp_wake started, round trips %i\n", wake_round_trips);
+    run_wake_condition_variable();
+    run_wake_on_address<std::uint32_t>("wait_on_address 4 bytes", 0);
+    run_wake_on_address<std::uint32_t>("wait_on_address 4 bytes spin", wake_spin_count);
+    run_wake_on_address<std::uint64_t>("wait_on_address 8 bytes", 0);
+    run_wake_on_address<std::uint64_t>("wait_on_address 8 bytes spin", wake_spin_count);
+    printf("---- bench_tp_wake complete\n");
+}
@@ -0,0 +1,26 @@
+#ifndef _AC_HELPERS_WIN32_LIBRARY_BENCH_TP_HEADER_
+#define _AC_HELPERS_WIN32_LIBRARY_BENCH_TP_HEADER_
+
+void bench_tp_fan_out();
+void bench_tp_submit_batch();
+void bench_tp_timers();
+void bench_tp_timer_coalescing();
+void bench_tp_priority();
+void bench_tp_adaptive();
+void bench_tp_blocking();
+void bench_tp_coroutine();
+void bench_tp_sender();
+void bench_tp_parallel();
+void bench_tp_graph();
+void bench_tp_future();
+void bench_tp_strand();
+void bench_tp_active();
+void bench_tp_keyed();
+void bench_tp_bounded();
+void bench_tp_cleanup();
+void bench_tp_churn();
+void bench_tp_scratch();
+void bench_tp_rundown();
+void bench_tp_wake();
+
+#endif //_AC_HELPERS_WIN32_LIBRARY_BENCH_TP_HEADER_
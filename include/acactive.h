@@ -0,0 +1,230 @@
+#ifndef _AC_HELPERS_WIN32_LIBRARY_ACTIVE_HEADER_
+#define _AC_HELPERS_WIN32_LIBRARY_ACTIVE_HEADER_
+
+#pragma once
+
+//
+// Active object. Derived class receives messages through a mailbox,
+// and handles them one at a time on workers of a thread pool.
+//
+//   struct counter final: public ac::active<counter, add, print> {
+//       explicit counter(ac::tp::thread_pool &pool)
+//           : active{pool} {
+//       }
+//       ~counter() {
+//           stop();
+//       }
+//       void on_message(add &message);
+//       void on_message(print &message);
+//   };
+//
+// Each message type must have an on_message overload, overload is
+// picked at compile time and there are no virtual calls.
+//
+// Mailbox is an intrusive lock free stack, and the same word tells
+// if the object is scheduled, so sending a message is one CAS. Object
+// posts its work item only when mailbox goes from idle to non-empty,
+// and the callback handles up to batch_size messages before it yields
+// the worker.
+//
+// Posted work item holds a slim_rundown reference. stop() runs the
+// rundown down, and once it returns no message handler runs anymore.
+// Messages that did not run by then are dropped. Derived class has
+// to call stop() in its destructor, because handlers use it.
+//
+
+#include "actp.h"
+
+#include <variant>
+
+namespace ac {
+
+    template<typename Derived, typename... Messages>
+    class active {
+    public:
+        using message_t = std::variant<Messages...>;
+
+        static constexpr std::uint32_t default_batch_size{64};
+
+        explicit active(tp::thread_pool &pool,
+                        std::uint32_t batch_size = default_batch_size,
+                        tp::optional_callback_parameters const *params = nullptr)
+            : batch_size_{batch_size ? batch_size : 1}
+            , work_{pool.make_work_item([this](tp::callback_instance &) { run(); }, params)} {
+        }
+        //
+        // Active object on the default pool
+        //
+        explicit active(std::uint32_t batch_size = default_batch_size)
+            : batch_size_{batch_size ? batch_size : 1}
+            , work_{tp::make_work_item([this](tp::callback_instance &) { run(); })} {
+        }
+
+        active(active const &) = delete;
+        active(active &&) = delete;
+        active &operator=(active const &) = delete;
+        active &operator=(active &&) = delete;
+
+        ~active() noexcept {
+            AC_CODDING_ERROR_IF_NOT(rundown_.is_rundown_complete(std::memory_order_acquire));
+            free_messages(std::exchange(ready_, nullptr));
+            node *posted{head_.exchange(nullptr, std::memory_order_acquire)};
+            free_messages(scheduled() == posted ? nullptr : posted);
+        }
+        //
+        // Queues message. Returns false if object was already stopped.
+        // Message sent while object is stopping is queued, but might be
+        // dropped without running.
+        //
+        template<typename M>
+        bool send(M &&message) {
+            using message_type = std::remove_cvref_t<M>;
+            return emplace<message_type>(std::forward<M>(message));
+        }
+
+        template<typename M, typename... A>
+        bool emplace(A &&...args) {
+            if (!rundown_.is_running()) {
+                return false;
+            }
+            node *n{tp::details::node_cache<node>::create(std::in_place_type<M>, std::forward<A>(args)...)};
+            node *previous{head_.load(std::memory_order_relaxed)};
+            do {
+                n->next_ = previous;
+            } while (!head_.compare_exchange_weak(previous, n, std::memory_order_release, std::memory_order_relaxed));
+            //
+            // If object started to stop after the check above, message
+            // stays in the mailbox, and destructor frees it. Mailbox
+            // stays non-empty, so nobody posts the work item again.
+            //
+            if (nullptr == previous && rundown_.try_acquire()) {
+                work_->post();
+            }
+            return true;
+        }
+        //
+        // Stops the object, and waits for the handler that is running.
+        // No handler runs once it returns. Must not be called from a
+        // handler, use request_stop there.
+        //
+        void stop() noexcept {
+            AC_CODDING_ERROR_IF(this == current_);
+            rundown_.join();
+        }
+        //
+        // Handlers do not run after the one that is running now
+        //
+        void request_stop() noexcept {
+            (void) rundown_.start_rundown();
+        }
+
+        [[nodiscard]] bool is_stopped() const noexcept {
+            return !rundown_.is_running();
+        }
+
+    private:
+        struct node final {
+            template<typename... A>
+            explicit node(A &&...args)
+                : message_(std::forward<A>(args)...) {
+            }
+
+            node *next_{nullptr};
+            message_t message_;
+        };
+        //
+        // Value of head_ while work item is posted, and nothing was
+        // sent since it took the last batch. nullptr means idle.
+        //
+        [[nodiscard]] static node *scheduled() noexcept {
+            return reinterpret_cast<node *>(std::uintptr_t{1});
+        }
+
+        void run() noexcept {
+            Derived &derived{static_cast<Derived &>(*this)};
+            active const *const outer{std::exchange(current_, this)};
+            std::uint32_t ran{0};
+            for (;;) {
+                if (!rundown_.is_running()) {
+                    //
+                    // Leave mailbox non-empty so nobody posts us again,
+                    // destructor frees what is left
+                    //
+                    break;
+                }
+                if (nullptr == ready_) {
+                    ready_ = take_posted();
+                    if (nullptr == ready_) {
+                        node *expected{scheduled()};
+                        if (head_.compare_exchange_strong(
+                                expected, nullptr, std::memory_order_acq_rel, std::memory_order_relaxed)) {
+                            break;
+                        }
+                        continue;
+                    }
+                }
+                if (ran == batch_size_) {
+                    current_ = outer;
+                    work_->post();
+                    return;
+                }
+                node *n{std::exchange(ready_, ready_->next_)};
+                std::visit([&derived](auto &message) { derived.on_message(message); }, n->message_);
+                tp::details::node_cache<node>::destroy(n);
+                ++ran;
+            }
+            current_ = outer;
+            //
+            // Object can be destroyed once reference is released.
+            // Destructor of the work item waits for this callback to
+            // return, so the object stays valid until then.
+            //
+            rundown_.release();
+        }
+        //
+        // Takes everything sent so far, and reverses it
+        // to the order it was sent in
+        //
+        [[nodiscard]] node *take_posted() noexcept {
+            node *n{head_.exchange(scheduled(), std::memory_order_acquire)};
+            node *ordered{nullptr};
+            while (nullptr != n && scheduled() != n) {
+                node *next{n->next_};
+                n->next_ = ordered;
+                ordered = n;
+                n = next;
+            }
+            return ordered;
+        }
+
+        static void free_messages(node *n) noexcept {
+            while (nullptr != n && scheduled() != n) {
+                node *next{n->next_};
+                tp::details::node_cache<node>::destroy(n);
+                n = next;
+            }
+        }
+
+        //
+        // Sent messages newest first, scheduled(), or nullptr
+        //
+        std::atomic<node *> head_{nullptr};
+        //
+        // Messages taken from head_ that did not run yet,
+        // oldest first. Only the running callback touches it.
+        //
+        node *ready_{nullptr};
+        slim_rundown rundown_;
+        std::uint32_t batch_size_;
+        //
+        // Declared last, so it is destroyed first, and waits for the
+        // running callback before the rest of the object goes away
+        //
+        tp::work_item_ptr work_;
+
+        inline static thread_local active const *current_{nullptr};
+    };
+
+} // namespace ac
+
+#endif //_AC_HELPERS_WIN32_LIBRARY_ACTIVE_HEADER_
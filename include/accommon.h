@@ -1,7 +1,11 @@
 #ifndef _AC_HELPERS_WIN32_LIBRARY_COMMON_HEADER_
 #define _AC_HELPERS_WIN32_LIBRARY_COMMON_HEADER_
 
+#ifdef _WIN32
 #include <windows.h>
+#else
+#include "acposix.h"
+#endif
 
 #include <chrono>
 #include <memory>
@@ -11,12 +15,24 @@
 #include <exception>
 #include <limits>
 #include <set>
+#include <optional>
+#include <string>
+#include <vector>
+#include <system_error>
 
+#ifdef _WIN32
 #define AC_PLATFORM_FAIL_FAST(EC) \
     {                             \
         __debugbreak();           \
         __fastfail(EC);           \
     }
+#else
+#define AC_PLATFORM_FAIL_FAST(EC) \
+    {                             \
+        (void) (EC);              \
+        __builtin_trap();         \
+    }
+#endif
 
 #ifndef AC_FAST_FAIL
 #define AC_FAST_FAIL(EC) \
@@ -115,11 +131,11 @@ namespace ac {
     }
 
     [[nodiscard]] inline size_t ptr_to_size_t(void *p) {
-        return *reinterpret_cast<size_t *>(&p);
+        return reinterpret_cast<size_t>(p);
     }
 
     [[nodiscard]] inline void *size_t_to_ptr(size_t v) {
-        return *reinterpret_cast<void **>(&v);
+        return reinterpret_cast<void *>(v);
     }
 
     template<typename T>
@@ -137,6 +153,7 @@ namespace ac {
             T o_;
             char c_;
         } unused_type_t;
+        static_cast<void>(sizeof(unused_type_t));
 
         ZeroMemory(v, sizeof(T));
     }
@@ -159,15 +176,22 @@ namespace ac {
 
     inline constexpr unsigned long long filetime_ctime_epoch_diff = 116444736000000000ULL;
 
+    //
+    // FILETIME counts 100 nanosecond intervals. Convert explicitly
+    // because system_clock period is implementation defined.
+    //
+    using filetime_duration = std::chrono::duration<long long, std::ratio<1LL, 10'000'000LL>>;
+
     [[nodiscard]] inline FILETIME system_clock_time_point_to_filetime(
         std::chrono::system_clock::time_point time_point) noexcept {
-        ULARGE_INTEGER ull;
-        ull.QuadPart = time_point.time_since_epoch().count();
-        ull.QuadPart += filetime_ctime_epoch_diff;
+        unsigned long long ull = std::chrono::duration_cast<filetime_duration>(
+                                     time_point.time_since_epoch())
+                                     .count();
+        ull += filetime_ctime_epoch_diff;
 
         FILETIME ft;
-        ft.dwHighDateTime = ull.HighPart;
-        ft.dwLowDateTime = ull.LowPart;
+        ft.dwHighDateTime = get_high_dword(ull);
+        ft.dwLowDateTime = get_low_dword(ull);
 
         return ft;
     }
@@ -175,13 +199,14 @@ namespace ac {
     [[nodiscard]] inline std::chrono::system_clock::time_point filetime_to_system_clock_time_point(
         FILETIME const &ft) noexcept {
         long long ul = make_qword(ft.dwLowDateTime, ft.dwHighDateTime);
-        if (ul > filetime_ctime_epoch_diff) {
+        if (ul > static_cast<long long>(filetime_ctime_epoch_diff)) {
             ul -= filetime_ctime_epoch_diff;
         } else {
             ul = 0;
         }
         return std::chrono::system_clock::time_point{
-            std::chrono::system_clock::time_point::duration{ul}};
+            std::chrono::duration_cast<std::chrono::system_clock::duration>(
+                filetime_duration{ul})};
     }
 
     [[nodiscard]] inline DWORD try_resize(cbuffer *b, size_t new_size) noexcept {
@@ -343,6 +368,8 @@ namespace ac {
         return err;
     }
 
+#ifdef _WIN32
+
     class cpp_set_lang_guard {
     public:
         explicit cpp_set_lang_guard(wchar_t const *language) noexcept
@@ -607,6 +634,8 @@ namespace ac {
         return value;
     }
 
+#endif // _WIN32
+
     template<typename G>
     class scope_guard: private G {
     public:
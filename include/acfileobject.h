@@ -7,8 +7,17 @@
 #include "ackernelobject.h"
 #include "actp.h"
 
+#ifndef _WIN32
+#include <filesystem>
+
+#include <fcntl.h>
+#include <sys/types.h>
+#endif
+
 namespace ac {
 
+#ifdef _WIN32
+
     template<typename>
     struct get_file_info;
     template<>
@@ -918,6 +927,290 @@ namespace ac {
         std::wstring name_;
     };
 
+#else // _WIN32
+
+    namespace details {
+        [[nodiscard]] inline std::string to_native_path(wchar_t const *name) {
+            return std::filesystem::path{name}.string();
+        }
+    } // namespace details
+
+    //
+    // Subset of file_object that is backed by a file descriptor.
+    // Overlapped IO is performed synchronously on the calling thread
+    // and then completion is delivered the same way Win32 does it for
+    // a handle bound to a completion port: through the io_handler that
+    // handle is bound to, or by signaling OVERLAPPED::hEvent.
+    // FILE_FLAG_NO_BUFFERING is not mapped to O_DIRECT because O_DIRECT
+    // rejects buffers that are not aligned on the logical block size.
+    //
+    class file_object: public kernel_object {
+    public:
+        [[nodiscard]] static DWORD try_erase(wchar_t const *name) noexcept {
+            if (0 != ::unlink(details::to_native_path(name).c_str())) {
+                return GetLastError();
+            }
+            return ERROR_SUCCESS;
+        }
+
+        static void erase(wchar_t const *name) {
+            if (0 != ::unlink(details::to_native_path(name).c_str())) {
+                AC_THROW(GetLastError(), "unlink");
+            }
+        }
+
+        file_object() {
+        }
+        //
+        // Duplicates handle
+        //
+        file_object(file_object const &f)
+            : kernel_object(f)
+            , name_(f.name_) {
+        }
+
+        file_object(file_object &&f) noexcept
+            : kernel_object(std::move(f))
+            , name_(std::move(f.name_)) {
+        }
+
+        file_object(wchar_t const *name,
+                    DWORD desiered_access,
+                    DWORD share_mode,
+                    DWORD creation_disposition,
+                    DWORD flag_and_attributes = FILE_ATTRIBUTE_NORMAL) {
+            create(name, desiered_access, share_mode, creation_disposition, flag_and_attributes);
+        }
+
+        const file_object &operator=(file_object const &f) {
+            if (&f != this) {
+                kernel_object::operator=(f);
+                name_ = f.name_;
+            }
+            return *this;
+        };
+
+        const file_object &operator=(file_object &&f) noexcept {
+            if (&f != this) {
+                kernel_object::operator=(std::move(f));
+                name_ = std::move(f.name_);
+            }
+            return *this;
+        };
+        //
+        // Share mode has no equivalent and is ignored
+        //
+        [[nodiscard]] DWORD try_create(wchar_t const *name,
+                                       DWORD desiered_access,
+                                       DWORD share_mode,
+                                       DWORD creation_disposition,
+                                       DWORD flag_and_attributes = FILE_ATTRIBUTE_NORMAL) {
+            close();
+
+            int flags = O_CLOEXEC;
+
+            if ((desiered_access & GENERIC_READ) && (desiered_access & GENERIC_WRITE)) {
+                flags |= O_RDWR;
+            } else if (desiered_access & GENERIC_WRITE) {
+                flags |= O_WRONLY;
+            } else {
+                flags |= O_RDONLY;
+            }
+
+            switch (creation_disposition) {
+            case CREATE_NEW:
+                flags |= O_CREAT | O_EXCL;
+                break;
+            case CREATE_ALWAYS:
+                flags |= O_CREAT | O_TRUNC;
+                break;
+            case OPEN_ALWAYS:
+                flags |= O_CREAT;
+                break;
+            case TRUNCATE_EXISTING:
+                flags |= O_TRUNC;
+                break;
+            case OPEN_EXISTING:
+                [[fallthrough]];
+            default:
+                break;
+            }
+
+            if (flag_and_attributes & FILE_FLAG_WRITE_THROUGH) {
+                flags |= O_DSYNC;
+            }
+
+            int fd = ::open(details::to_native_path(name).c_str(), flags, 0666);
+            if (fd < 0) {
+                return GetLastError();
+            }
+
+            attach((new details::handle_object{details::handle_object::kind_t::file, true, true, fd})
+                       ->to_handle());
+
+            name_ = name;
+
+            return ERROR_SUCCESS;
+        };
+
+        void create(wchar_t const *name,
+                    DWORD desiered_access,
+                    DWORD share_mode,
+                    DWORD creation_disposition,
+                    DWORD flag_and_attributes = FILE_ATTRIBUTE_NORMAL) {
+            DWORD error = try_create(
+                name, desiered_access, share_mode, creation_disposition, flag_and_attributes);
+            if (ERROR_SUCCESS != error) {
+                AC_THROW(error, "open");
+            }
+        };
+
+        std::wstring const &get_name() const {
+            return name_;
+        }
+
+        void close() {
+            kernel_object::close();
+            name_.clear();
+        };
+
+        void resize(long long pos) {
+            if (0 != ::ftruncate(get_fd(), pos)) {
+                AC_THROW(GetLastError(), "ftruncate");
+            }
+        }
+        //
+        // Returns false if EOF was reached
+        //
+        bool read(LPVOID buffer, DWORD number_of_bytes_to_read, DWORD *number_of_bytes_read) {
+            ssize_t rc = ::read(get_fd(), buffer, number_of_bytes_to_read);
+            if (rc < 0) {
+                AC_THROW(GetLastError(), "read");
+            }
+            *number_of_bytes_read = static_cast<DWORD>(rc);
+            return (*number_of_bytes_read != 0);
+        }
+        //
+        // Returns true if IO completed synchronosly and
+        // false otherwise
+        //
+        [[nodiscard]] bool read(LPVOID buffer,
+                                DWORD number_of_bytes_to_read,
+                                DWORD *bytes_read,
+                                bool *is_eof,
+                                OVERLAPPED *o) {
+            ssize_t rc = ::pread(get_fd(), buffer, number_of_bytes_to_read, get_offset(o));
+            if (rc < 0) {
+                AC_THROW(GetLastError(), "pread");
+            }
+            if (0 == rc && 0 != number_of_bytes_to_read) {
+                if (is_eof) {
+                    *is_eof = true;
+                } else {
+                    AC_THROW(ERROR_HANDLE_EOF, "pread");
+                }
+            } else {
+                complete_io(o, ERROR_SUCCESS, static_cast<ULONG_PTR>(rc));
+            }
+            if (bytes_read) {
+                *bytes_read = static_cast<DWORD>(rc);
+            }
+            return true;
+        }
+        //
+        // Synchronosly writes to the file.
+        // Returns number of bytes written to the file
+        //
+        DWORD write(VOID const *buffer, DWORD number_of_bytes_to_write) {
+            ssize_t rc = ::write(get_fd(), buffer, number_of_bytes_to_write);
+            if (rc < 0) {
+                AC_THROW(GetLastError(), "write");
+            }
+            return static_cast<DWORD>(rc);
+        }
+        //
+        // Returns true if IO completed synchronosly and
+        // returns false otherwise
+        //
+        [[nodiscard]] bool write(VOID const *buffer,
+                                 DWORD number_of_bytes_to_write,
+                                 OVERLAPPED *o,
+                                 DWORD *number_of_bytes_wrote = nullptr) {
+            if (!o) {
+                DWORD number_of_bytes_wrote_tmp = write(buffer, number_of_bytes_to_write);
+                if (number_of_bytes_wrote) {
+                    *number_of_bytes_wrote = number_of_bytes_wrote_tmp;
+                }
+                return true;
+            }
+
+            ssize_t rc = ::pwrite(get_fd(), buffer, number_of_bytes_to_write, get_offset(o));
+            if (rc < 0) {
+                AC_THROW(GetLastError(), "pwrite");
+            }
+
+            if (number_of_bytes_wrote) {
+                *number_of_bytes_wrote = static_cast<DWORD>(rc);
+            }
+
+            complete_io(o, ERROR_SUCCESS, static_cast<ULONG_PTR>(rc));
+
+            return true;
+        }
+
+        [[nodiscard]] DWORD write_sync(VOID const *buffer, LONGLONG offset, DWORD number_of_bytes_to_write) {
+            ssize_t rc = ::pwrite(get_fd(), buffer, number_of_bytes_to_write, offset);
+            if (rc < 0) {
+                AC_THROW(GetLastError(), "pwrite");
+            }
+            return static_cast<DWORD>(rc);
+        }
+
+        DWORD read_sync(LPVOID buffer, LONGLONG offset, DWORD number_of_bytes_to_read, bool *is_eof) {
+            ssize_t rc = ::pread(get_fd(), buffer, number_of_bytes_to_read, offset);
+            if (rc < 0) {
+                AC_THROW(GetLastError(), "pread");
+            }
+            DWORD number_of_bytes_read = static_cast<DWORD>(rc);
+            //
+            // If we read less than requested then we've reached EOF
+            //
+            if (number_of_bytes_to_read > number_of_bytes_read) {
+                *is_eof = true;
+            }
+            return number_of_bytes_read;
+        }
+
+        void swap(file_object &other) {
+            kernel_object::swap(other);
+            std::swap(other.name_, name_);
+        }
+
+    protected:
+        [[nodiscard]] int get_fd() const noexcept {
+            return details::handle_object::from_handle(get_handle())->fd();
+        }
+
+        [[nodiscard]] static off_t get_offset(OVERLAPPED const *o) noexcept {
+            return static_cast<off_t>(make_qword(o->Offset, o->OffsetHigh));
+        }
+
+        void complete_io(OVERLAPPED *o, ULONG error, ULONG_PTR bytes_transferred) noexcept {
+            o->Internal = error;
+            o->InternalHigh = bytes_transferred;
+            if (!details::handle_object::from_handle(get_handle())
+                     ->complete_io(o, error, bytes_transferred)) {
+                if (o->hEvent) {
+                    details::handle_object::from_handle(o->hEvent)->set();
+                }
+            }
+        }
+
+        std::wstring name_;
+    };
+
+#endif // _WIN32
+
     inline void swap(file_object &lhs, file_object &rhs) {
         lhs.swap(rhs);
     }
@@ -965,7 +1258,7 @@ namespace ac {
 
         void try_delete() noexcept {
             if (is_armed()) {
-                if (DeleteFileW(name_.c_str())) {
+                if (ERROR_SUCCESS == file_object::try_erase(name_.c_str())) {
                     disarm();
                 }
             }
@@ -1085,6 +1378,8 @@ namespace ac {
         files_t files_;
     };
 
+#ifdef _WIN32
+
     class directory_iterator {
     public:
 
@@ -1437,6 +1732,8 @@ namespace ac {
         return result;
     }
 
+#endif // _WIN32
+
 } // namespace ac
 
 #endif //_AC_HELPERS_WIN32_LIBRARY_FILE_OBJECT_HEADER_
\ No newline at end of file
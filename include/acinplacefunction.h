@@ -0,0 +1,149 @@
+#ifndef _AC_HELPERS_WIN32_LIBRARY_INPLACE_FUNCTION_HEADER_
+#define _AC_HELPERS_WIN32_LIBRARY_INPLACE_FUNCTION_HEADER_
+
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace ac {
+
+    template<typename Signature,
+             std::size_t Capacity = 64,
+             std::size_t Alignment = alignof(std::max_align_t)>
+    class inplace_function;
+
+    namespace details {
+        template<typename T>
+        struct is_inplace_function: std::false_type {};
+
+        template<typename Signature, std::size_t Capacity, std::size_t Alignment>
+        struct is_inplace_function<inplace_function<Signature, Capacity, Alignment>>: std::true_type {};
+    } // namespace details
+
+    //
+    // Move only callable wrapper, similar to std::move_only_function,
+    // that always stores callable inside of the object. Callables that
+    // do not fit into Capacity bytes are rejected at compile time, so
+    // constructing an inplace_function never allocates.
+    //
+    template<typename R, typename... Args, std::size_t Capacity, std::size_t Alignment>
+    class inplace_function<R(Args...), Capacity, Alignment> final {
+    public:
+        static constexpr std::size_t capacity{Capacity};
+        static constexpr std::size_t alignment{Alignment};
+
+        inplace_function() noexcept = default;
+
+        inplace_function(std::nullptr_t) noexcept {
+        }
+
+        template<typename F,
+                 typename D = std::decay_t<F>,
+                 typename = std::enable_if_t<!details::is_inplace_function<D>::value &&
+                                             std::is_invocable_r_v<R, D &, Args...>>>
+        inplace_function(F &&f) noexcept(std::is_nothrow_constructible_v<D, F>) {
+            static_assert(sizeof(D) <= Capacity,
+                          "Callable does not fit into inplace_function, "
+                          "reduce captures or increase capacity");
+            static_assert(Alignment % alignof(D) == 0,
+                          "Callable alignment is not supported by inplace_function");
+            static_assert(std::is_nothrow_move_constructible_v<D>,
+                          "Callable stored in inplace_function must be nothrow move constructible");
+            ::new (static_cast<void *>(&storage_)) D(std::forward<F>(f));
+            vtable_ = &vtable_for<D>;
+        }
+
+        inplace_function(inplace_function const &) = delete;
+        inplace_function &operator=(inplace_function const &) = delete;
+
+        inplace_function(inplace_function &&other) noexcept {
+            move_from(other);
+        }
+
+        inplace_function &operator=(inplace_function &&other) noexcept {
+            if (&other != this) {
+                reset();
+                move_from(other);
+            }
+            return *this;
+        }
+
+        inplace_function &operator=(std::nullptr_t) noexcept {
+            reset();
+            return *this;
+        }
+
+        ~inplace_function() noexcept {
+            reset();
+        }
+
+        R operator()(Args... args) {
+            return vtable_->invoke(&storage_, std::forward<Args>(args)...);
+        }
+
+        explicit operator bool() const noexcept {
+            return nullptr != vtable_;
+        }
+
+        void swap(inplace_function &other) noexcept {
+            inplace_function tmp{std::move(other)};
+            other = std::move(*this);
+            *this = std::move(tmp);
+        }
+
+    private:
+        struct vtable_t {
+            R (*invoke)(void *, Args &&...);
+            void (*relocate)(void *to, void *from) noexcept;
+            void (*destroy)(void *) noexcept;
+        };
+
+        template<typename D>
+        static constexpr vtable_t vtable_for{
+            [](void *f, Args &&...args) -> R {
+                return std::invoke(*static_cast<D *>(f), std::forward<Args>(args)...);
+            },
+            [](void *to, void *from) noexcept {
+                ::new (to) D(std::move(*static_cast<D *>(from)));
+                static_cast<D *>(from)->~D();
+            },
+            [](void *f) noexcept { static_cast<D *>(f)->~D(); }};
+
+        void move_from(inplace_function &other) noexcept {
+            if (other.vtable_) {
+                other.vtable_->relocate(&storage_, &other.storage_);
+                vtable_ = other.vtable_;
+                other.vtable_ = nullptr;
+            }
+        }
+
+        void reset() noexcept {
+            if (vtable_) {
+                vtable_->destroy(&storage_);
+                vtable_ = nullptr;
+            }
+        }
+
+        vtable_t const *vtable_{nullptr};
+        alignas(Alignment) std::byte storage_[Capacity];
+    };
+
+    template<typename Signature, std::size_t Capacity, std::size_t Alignment>
+    inline void swap(inplace_function<Signature, Capacity, Alignment> &lhs,
+                     inplace_function<Signature, Capacity, Alignment> &rhs) noexcept {
+        lhs.swap(rhs);
+    }
+
+    template<typename Signature, std::size_t Capacity, std::size_t Alignment>
+    [[nodiscard]] inline bool operator==(inplace_function<Signature, Capacity, Alignment> const &f,
+                                         std::nullptr_t) noexcept {
+        return !f;
+    }
+
+} // namespace ac
+
+#endif //_AC_HELPERS_WIN32_LIBRARY_INPLACE_FUNCTION_HEADER_
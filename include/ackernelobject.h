@@ -5,6 +5,8 @@
 
 namespace ac {
 
+#ifdef _WIN32
+
     inline [[nodiscard]] DWORD wait_single_object(HANDLE h, DWORD milliseconds = INFINITE) {
         AC_CODDING_ERROR_IF(NULL == h);
         DWORD rc = WaitForSingleObject(h, milliseconds);
@@ -601,6 +603,229 @@ namespace ac {
         }
     };
 
+#else // _WIN32
+
+    //
+    // Kernel objects are emulated by ac::details::handle_object.
+    // Only objects used by the library are supported: events
+    // and files (see acfileobject.h).
+    //
+    [[nodiscard]] inline DWORD wait_single_object(HANDLE h, DWORD milliseconds = INFINITE) {
+        AC_CODDING_ERROR_IF(nullptr == h);
+        details::blocking_region region;
+        DWORD rc = details::handle_object::from_handle(h)->wait(milliseconds);
+        AC_CODDING_ERROR_IF(WAIT_FAILED == rc);
+        return rc;
+    }
+
+    class kernel_object {
+    public:
+        kernel_object() noexcept
+            : h_{nullptr} {
+        }
+
+        explicit kernel_object(HANDLE h, bool duplicate_handle = false)
+            : h_(nullptr) {
+            if (duplicate_handle) {
+                if (h != nullptr) {
+                    duplicate(h);
+                }
+            } else {
+                attach(h);
+            }
+        }
+
+        kernel_object(kernel_object const &ko)
+            : h_(nullptr) {
+            if (ko.is_valid()) {
+                duplicate(ko.h_);
+            }
+        }
+
+        kernel_object(kernel_object &&ko) noexcept
+            : h_(ko.h_) {
+            ko.h_ = nullptr;
+        }
+
+        virtual ~kernel_object() noexcept {
+            close();
+        }
+
+        kernel_object &operator=(kernel_object &&ko) noexcept {
+            if (this != &ko) {
+                close();
+                h_ = ko.h_;
+                ko.h_ = nullptr;
+            }
+            return *this;
+        }
+
+        kernel_object &operator=(kernel_object const &ko) {
+            if (&ko != this) {
+                close();
+                if (ko.is_valid()) {
+                    duplicate(ko);
+                }
+            }
+            return *this;
+        }
+
+        void close() noexcept {
+            if (is_valid()) {
+                details::handle_object::from_handle(h_)->release();
+                h_ = nullptr;
+            }
+        }
+
+        [[nodiscard]] bool is_valid() const noexcept {
+            return h_ != nullptr;
+        }
+
+        explicit operator bool() const noexcept {
+            return is_valid();
+        }
+
+        [[nodiscard]] HANDLE const get_handle() const noexcept {
+            return h_;
+        }
+
+        [[nodiscard]] HANDLE get_handle() noexcept {
+            return h_;
+        }
+
+        void attach(HANDLE h) noexcept {
+            close();
+            h_ = h;
+        }
+
+        [[nodiscard]] HANDLE detach() noexcept {
+            HANDLE th = h_;
+            h_ = nullptr;
+            return th;
+        }
+        //
+        // Duplicated handle refers to the same object
+        //
+        void duplicate(HANDLE h) noexcept {
+            close();
+            AC_CODDING_ERROR_IF(nullptr == h);
+            details::handle_object::from_handle(h)->add_ref();
+            h_ = h;
+        }
+
+        void duplicate(kernel_object const &ko) noexcept {
+            duplicate(ko.h_);
+        }
+
+        [[nodiscard]] DWORD wait(DWORD milliseconds = INFINITE) const noexcept {
+            return wait_single_object(h_, milliseconds);
+        }
+
+        void swap(kernel_object &other) noexcept {
+            HANDLE h = other.h_;
+            other.h_ = h_;
+            h_ = h;
+        }
+
+        bool is_same_object(HANDLE h) noexcept {
+            return h_ == h;
+        }
+
+        bool is_same_object(kernel_object const &rhs) noexcept {
+            return h_ == rhs.h_;
+        }
+
+    private:
+        HANDLE h_;
+    };
+
+    inline void swap(kernel_object &lhs, kernel_object &rhs) noexcept {
+        lhs.swap(rhs);
+    }
+
+    inline bool operator==(kernel_object const &lhs, kernel_object const &rhs) noexcept {
+        return lhs.get_handle() == rhs.get_handle();
+    }
+
+    inline bool operator!=(kernel_object const &lhs, kernel_object const &rhs) noexcept {
+        return lhs.get_handle() != rhs.get_handle();
+    }
+
+    inline bool operator<(kernel_object const &lhs, kernel_object const &rhs) noexcept {
+        return lhs.get_handle() < rhs.get_handle();
+    }
+
+    inline bool operator<=(kernel_object const &lhs, kernel_object const &rhs) noexcept {
+        return lhs.get_handle() <= rhs.get_handle();
+    }
+
+    inline bool operator>(kernel_object const &lhs, kernel_object const &rhs) noexcept {
+        return lhs.get_handle() > rhs.get_handle();
+    }
+
+    inline bool operator>=(kernel_object const &lhs, kernel_object const &rhs) noexcept {
+        return lhs.get_handle() >= rhs.get_handle();
+    }
+
+    // Encapsulates operations on event object. Named events are not supported.
+    class event: public kernel_object {
+    public:
+        enum event_type_t : bool { manuel = true, automatic = false };
+        enum event_state_t : bool { signaled = true, unsignaled = false };
+
+        event() {
+        }
+
+        explicit event(event_type_t event_type, event_state_t event_state = unsignaled) {
+            create(event_type, event_state);
+        }
+
+        // Duplicating or taking ownership
+        explicit event(HANDLE h, bool duplicate_handle = false)
+            : kernel_object(h, duplicate_handle) {
+        }
+
+        event(event const &other)
+            : kernel_object(other) {
+        }
+
+        event(event &&other) noexcept
+            : kernel_object(std::move(other)) {
+        }
+
+        event &operator=(event const &other) {
+            kernel_object::operator=(other);
+            return *this;
+        }
+
+        event &operator=(event &&other) noexcept {
+            kernel_object::operator=(std::move(other));
+            return *this;
+        }
+
+        bool create(event_type_t event_type = manuel, event_state_t event_state = unsignaled) {
+            close();
+            details::handle_object *h = new details::handle_object{
+                details::handle_object::kind_t::event, event_type == manuel, event_state == signaled};
+            attach(h->to_handle());
+            return true;
+        }
+
+        void pulse() noexcept {
+            details::handle_object::from_handle(get_handle())->pulse();
+        }
+
+        void reset() noexcept {
+            details::handle_object::from_handle(get_handle())->reset();
+        }
+
+        void set() noexcept {
+            details::handle_object::from_handle(get_handle())->set();
+        }
+    };
+
+#endif // _WIN32
+
 } // namespace ac
 
 #endif //_AC_HELPERS_WIN32_LIBRARY_KERNEL_OBJECT_HEADER_
\ No newline at end of file
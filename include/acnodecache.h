@@ -0,0 +1,193 @@
+#ifndef _AC_HELPERS_WIN32_LIBRARY_NODE_CACHE_HEADER_
+#define _AC_HELPERS_WIN32_LIBRARY_NODE_CACHE_HEADER_
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <mutex>
+#include <new>
+#include <utility>
+
+namespace ac::tp {
+
+    namespace details {
+        //
+        // Recycles memory of fixed size nodes. Each thread keeps a small
+        // free list, and exchanges whole batches of nodes with a shared
+        // list, so a node can be allocated on one thread and freed on
+        // another while the lock is taken once per batch_size nodes.
+        // When there is no free batch, a batch is carved from a shared
+        // slab, so nodes of a type are packed together, and the heap
+        // sees one allocation per slab. Memory is returned to the heap
+        // only when the process exits.
+        //
+        template<typename T>
+        class node_cache final {
+        public:
+            static constexpr size_t batch_size{64};
+            static constexpr size_t slab_size{64 * 1024};
+
+            node_cache() = delete;
+
+            template<typename... A>
+            [[nodiscard]] static T *create(A &&...args) {
+                void *block = allocate();
+                try {
+                    return ::new (block) T{std::forward<A>(args)...};
+                } catch (...) {
+                    deallocate(block);
+                    throw;
+                }
+            }
+
+            static void destroy(T *node) noexcept {
+                node->~T();
+                deallocate(node);
+            }
+
+        private:
+            struct free_block {
+                free_block *next_;
+                free_block *next_batch_;
+                size_t count_;
+            };
+
+            static constexpr size_t block_alignment{std::max(alignof(T), alignof(free_block))};
+            static constexpr size_t block_size{(std::max(sizeof(T), sizeof(free_block)) + block_alignment - 1) /
+                                               block_alignment * block_alignment};
+            static constexpr size_t blocks_per_slab{std::max(batch_size, slab_size / block_size)};
+
+            struct shared_cache {
+                void push_batch(free_block *batch, size_t count) noexcept {
+                    batch->count_ = count;
+                    std::lock_guard<std::mutex> lock{lock_};
+                    batch->next_batch_ = batches_;
+                    batches_ = batch;
+                }
+
+                //
+                // Takes a batch that was freed, or carves
+                // a new one from the slab
+                //
+                [[nodiscard]] free_block *pop_batch(size_t *count) {
+                    std::lock_guard<std::mutex> lock{lock_};
+                    free_block *batch = batches_;
+                    if (batch) {
+                        batches_ = batch->next_batch_;
+                        *count = batch->count_;
+                        return batch;
+                    }
+                    if (0 == slab_left_) {
+                        slab_ = static_cast<std::byte *>(
+                            ::operator new(blocks_per_slab * block_size, std::align_val_t{block_alignment}));
+                        slab_left_ = blocks_per_slab;
+                    }
+                    size_t const carved = std::min(batch_size, slab_left_);
+                    slab_left_ -= carved;
+                    free_block *head{nullptr};
+                    for (size_t i = carved; i > 0; --i) {
+                        head = ::new (slab_ + (slab_left_ + i - 1) * block_size) free_block{head, nullptr, 0};
+                    }
+                    *count = carved;
+                    return head;
+                }
+
+                std::mutex lock_;
+                free_block *batches_{nullptr};
+                std::byte *slab_{nullptr};
+                size_t slab_left_{0};
+            };
+
+            //
+            // Nodes freed after the thread cache was destroyed, for
+            // instance by destructors of static objects that run after
+            // thread_local objects of the main thread, go straight to
+            // the shared list
+            //
+            struct local_cache {
+                ~local_cache() noexcept {
+                    if (head_) {
+                        shared().push_batch(head_, count_);
+                    }
+                    head_ = nullptr;
+                    count_ = 0;
+                    thread_exited() = true;
+                }
+
+                free_block *head_{nullptr};
+                size_t count_{0};
+            };
+
+            [[nodiscard]] static shared_cache &shared() noexcept {
+                static shared_cache *cache{new shared_cache{}};
+                return *cache;
+            }
+
+            [[nodiscard]] static local_cache &local() noexcept {
+                thread_local local_cache cache;
+                return cache;
+            }
+            //
+            // Trivially destructible, so it can be read at any
+            // point of thread exit
+            //
+            [[nodiscard]] static bool &thread_exited() noexcept {
+                thread_local bool exited{false};
+                return exited;
+            }
+
+            [[nodiscard]] static void *allocate() {
+                if (thread_exited()) {
+                    size_t count{0};
+                    free_block *block = shared().pop_batch(&count);
+                    if (1 < count) {
+                        shared().push_batch(block->next_, count - 1);
+                    }
+                    return block;
+                }
+                local_cache &cache = local();
+                if (nullptr == cache.head_) {
+                    cache.head_ = shared().pop_batch(&cache.count_);
+                }
+                free_block *block = cache.head_;
+                cache.head_ = block->next_;
+                --cache.count_;
+                return block;
+            }
+
+            static void deallocate(void *p) noexcept {
+                if (thread_exited()) {
+                    shared().push_batch(::new (p) free_block{nullptr, nullptr, 0}, 1);
+                    return;
+                }
+                local_cache &cache = local();
+                cache.head_ = ::new (p) free_block{cache.head_, nullptr, 0};
+                ++cache.count_;
+                if (cache.count_ >= 2 * batch_size) {
+                    free_block *first = cache.head_;
+                    free_block *last = first;
+                    for (size_t i = 1; i < batch_size; ++i) {
+                        last = last->next_;
+                    }
+                    cache.head_ = last->next_;
+                    cache.count_ -= batch_size;
+                    last->next_ = nullptr;
+                    shared().push_batch(first, batch_size);
+                }
+            }
+        };
+        //
+        // Deleter of objects created with node_cache
+        //
+        template<typename T>
+        struct node_cache_deleter final {
+            void operator()(T *node) const noexcept {
+                node_cache<T>::destroy(node);
+            }
+        };
+    } // namespace details
+
+} // namespace ac::tp
+
+#endif //_AC_HELPERS_WIN32_LIBRARY_NODE_CACHE_HEADER_
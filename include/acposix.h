@@ -0,0 +1,436 @@
+#ifndef _AC_HELPERS_WIN32_LIBRARY_POSIX_HEADER_
+#define _AC_HELPERS_WIN32_LIBRARY_POSIX_HEADER_
+
+#pragma once
+
+//
+// Subset of Win32 types, constants and handle semantics that ac headers
+// depend on. Only included on platforms where windows.h is not available.
+// Error codes are mapped to errno values so AC_THROW(GetLastError(), ...)
+// produces meaningful messages through std::system_category.
+//
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <climits>
+#include <ctime>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include <unistd.h>
+
+using BYTE = std::uint8_t;
+using WORD = std::uint16_t;
+using DWORD = std::uint32_t;
+using LONG = std::int32_t;
+using ULONG = std::uint32_t;
+using LONGLONG = std::int64_t;
+using ULONGLONG = std::uint64_t;
+using ULONG_PTR = std::uintptr_t;
+using SIZE_T = std::size_t;
+using BOOL = int;
+using VOID = void;
+using PVOID = void *;
+using LPVOID = void *;
+using HANDLE = void *;
+using HMODULE = void *;
+
+#ifndef TRUE
+#define TRUE 1
+#endif
+
+#ifndef FALSE
+#define FALSE 0
+#endif
+
+#define INFINITE 0xFFFFFFFF
+
+#define ERROR_SUCCESS 0
+#define ERROR_INVALID_HANDLE EBADF
+#define ERROR_NOT_ENOUGH_MEMORY ENOMEM
+#define ERROR_INVALID_PARAMETER EINVAL
+#define ERROR_HANDLE_EOF ENODATA
+#define ERROR_ALREADY_EXISTS EEXIST
+#define ERROR_ENVVAR_NOT_FOUND ENOENT
+#define ERROR_ARITHMETIC_OVERFLOW EOVERFLOW
+#define ERROR_IO_PENDING EINPROGRESS
+#define ERROR_INVALID_STATE EINVAL
+#define ERROR_TIMEOUT ETIMEDOUT
+
+#define WAIT_OBJECT_0 0x00000000
+#define WAIT_ABANDONED_0 0x00000080
+#define WAIT_TIMEOUT 0x00000102
+#define WAIT_FAILED 0xFFFFFFFF
+
+#define GENERIC_READ 0x80000000
+#define GENERIC_WRITE 0x40000000
+
+#define FILE_SHARE_READ 0x00000001
+#define FILE_SHARE_WRITE 0x00000002
+#define FILE_SHARE_DELETE 0x00000004
+
+#define CREATE_NEW 1
+#define CREATE_ALWAYS 2
+#define OPEN_EXISTING 3
+#define OPEN_ALWAYS 4
+#define TRUNCATE_EXISTING 5
+
+#define FILE_ATTRIBUTE_NORMAL 0x00000080
+#define FILE_FLAG_WRITE_THROUGH 0x80000000
+#define FILE_FLAG_OVERLAPPED 0x40000000
+#define FILE_FLAG_NO_BUFFERING 0x20000000
+
+#define INVALID_HANDLE_VALUE (reinterpret_cast<HANDLE>(static_cast<std::intptr_t>(-1)))
+
+typedef enum _TP_CALLBACK_PRIORITY {
+    TP_CALLBACK_PRIORITY_HIGH,
+    TP_CALLBACK_PRIORITY_NORMAL,
+    TP_CALLBACK_PRIORITY_LOW,
+    TP_CALLBACK_PRIORITY_INVALID,
+    TP_CALLBACK_PRIORITY_COUNT = TP_CALLBACK_PRIORITY_INVALID
+} TP_CALLBACK_PRIORITY;
+
+typedef DWORD TP_WAIT_RESULT;
+
+typedef struct _TP_POOL_STACK_INFORMATION {
+    SIZE_T StackReserve;
+    SIZE_T StackCommit;
+} TP_POOL_STACK_INFORMATION, *PTP_POOL_STACK_INFORMATION;
+
+typedef struct _FILETIME {
+    DWORD dwLowDateTime;
+    DWORD dwHighDateTime;
+} FILETIME, *PFILETIME;
+
+typedef struct _OVERLAPPED {
+    ULONG_PTR Internal;
+    ULONG_PTR InternalHigh;
+    DWORD Offset;
+    DWORD OffsetHigh;
+    HANDLE hEvent;
+} OVERLAPPED, *LPOVERLAPPED;
+
+[[nodiscard]] inline DWORD GetLastError() noexcept {
+    return static_cast<DWORD>(errno);
+}
+
+inline void SetLastError(DWORD error) noexcept {
+    errno = static_cast<int>(error);
+}
+
+[[nodiscard]] inline DWORD GetCurrentThreadId() noexcept {
+    return static_cast<DWORD>(gettid());
+}
+
+inline void Sleep(DWORD milliseconds) noexcept {
+    std::this_thread::sleep_for(std::chrono::milliseconds{milliseconds});
+}
+
+inline void GetSystemTimeAsFileTime(FILETIME *ft) noexcept {
+    //
+    // FILETIME counts 100 nanosecond intervals since 1601-01-01
+    //
+    timespec ts{};
+    clock_gettime(CLOCK_REALTIME, &ts);
+    unsigned long long v = static_cast<unsigned long long>(ts.tv_sec) * 10'000'000ULL +
+                           static_cast<unsigned long long>(ts.tv_nsec) / 100ULL +
+                           116444736000000000ULL;
+    ft->dwLowDateTime = static_cast<DWORD>(v & 0x00000000FFFFFFFFULL);
+    ft->dwHighDateTime = static_cast<DWORD>(v >> 32ULL);
+}
+
+#define ZeroMemory(D, S) std::memset((D), 0, (S))
+
+#define __fastfail(EC) __builtin_trap()
+
+namespace ac::details {
+
+    //
+    // Marks a region where calling thread may block. Thread pool
+    // workers install a handler, so the pool can run another worker
+    // while this one is blocked. Nested regions only notify once.
+    // On threads without a handler this does nothing.
+    //
+    class blocking_region final {
+    public:
+        using handler_t = void (*)(void *context, bool entering) noexcept;
+
+        blocking_region() noexcept
+            : notify_{nullptr != handler_ && 0 == depth_} {
+            ++depth_;
+            if (notify_) {
+                handler_(context_, true);
+            }
+        }
+
+        blocking_region(blocking_region const &) = delete;
+        blocking_region &operator=(blocking_region const &) = delete;
+
+        ~blocking_region() noexcept {
+            --depth_;
+            if (notify_) {
+                handler_(context_, false);
+            }
+        }
+
+        static void set_handler(handler_t handler, void *context) noexcept {
+            handler_ = handler;
+            context_ = context;
+        }
+
+    private:
+        inline static thread_local handler_t handler_{nullptr};
+        inline static thread_local void *context_{nullptr};
+        inline static thread_local unsigned int depth_{0};
+        bool notify_;
+    };
+
+    //
+    // Registration of a thread pool wait on a handle. When handle
+    // gets signaled it is unlinked from the handle and satisfied_
+    // is called while handle lock is held, so unregister_wait
+    // returning false guarantees satisfied_ has already returned.
+    //
+    struct wait_block {
+        wait_block *next_{nullptr};
+        wait_block *prev_{nullptr};
+        bool linked_{false};
+        void (*satisfied_)(wait_block *) noexcept {nullptr};
+        void *context_{nullptr};
+    };
+
+    using io_completion_routine = void (*)(void *context,
+                                           OVERLAPPED *overlapped,
+                                           ULONG error,
+                                           ULONG_PTR bytes_transferred) noexcept;
+
+    //
+    // Object behind a HANDLE. Kernel objects are emulated in user mode:
+    // an event is a flag guarded by a mutex, and a file is a descriptor.
+    // Files are always signaled, same as a Win32 file with no pending IO.
+    //
+    class handle_object final {
+    public:
+        enum class kind_t { event, file };
+
+        handle_object(kind_t kind, bool manual_reset, bool signaled, int fd = -1) noexcept
+            : kind_{kind}
+            , manual_reset_{manual_reset}
+            , signaled_{signaled}
+            , fd_{fd} {
+        }
+
+        handle_object(handle_object const &) = delete;
+        handle_object &operator=(handle_object const &) = delete;
+
+        [[nodiscard]] static handle_object *from_handle(HANDLE h) noexcept {
+            return static_cast<handle_object *>(h);
+        }
+
+        [[nodiscard]] HANDLE to_handle() noexcept {
+            return static_cast<HANDLE>(this);
+        }
+
+        [[nodiscard]] kind_t kind() const noexcept {
+            return kind_;
+        }
+
+        [[nodiscard]] int fd() const noexcept {
+            return fd_;
+        }
+
+        void add_ref() noexcept {
+            std::lock_guard<std::mutex> lock{lock_};
+            ++references_;
+        }
+
+        void release() noexcept {
+            bool last = false;
+            {
+                std::lock_guard<std::mutex> lock{lock_};
+                last = (0 == --references_);
+            }
+            if (last) {
+                if (fd_ >= 0) {
+                    ::close(fd_);
+                }
+                delete this;
+            }
+        }
+
+        void set() noexcept {
+            std::lock_guard<std::mutex> lock{lock_};
+            signaled_ = true;
+            satisfy_waiters();
+            if (signaled_) {
+                if (manual_reset_) {
+                    cv_.notify_all();
+                } else {
+                    cv_.notify_one();
+                }
+            }
+        }
+
+        void reset() noexcept {
+            std::lock_guard<std::mutex> lock{lock_};
+            signaled_ = false;
+        }
+
+        //
+        // Releases current waiters without leaving the event signaled
+        //
+        void pulse() noexcept {
+            std::lock_guard<std::mutex> lock{lock_};
+            signaled_ = true;
+            satisfy_waiters();
+            if (signaled_) {
+                ++pulse_generation_;
+                cv_.notify_all();
+            }
+            signaled_ = false;
+        }
+
+        [[nodiscard]] DWORD wait(DWORD milliseconds) noexcept {
+            std::unique_lock<std::mutex> lock{lock_};
+            unsigned long long const generation{pulse_generation_};
+            auto const is_signaled = [this, generation] {
+                return signaled_ || generation != pulse_generation_;
+            };
+            if (INFINITE == milliseconds) {
+                cv_.wait(lock, is_signaled);
+            } else if (!cv_.wait_for(lock, std::chrono::milliseconds{milliseconds}, is_signaled)) {
+                return WAIT_TIMEOUT;
+            }
+            if (signaled_) {
+                consume();
+            }
+            return WAIT_OBJECT_0;
+        }
+        //
+        // Returns true if handle was signaled, and the wait was
+        // satisfied right away. In that case wait block is not
+        // linked and satisfied_ is not called.
+        //
+        [[nodiscard]] bool register_wait(wait_block *block) noexcept {
+            std::lock_guard<std::mutex> lock{lock_};
+            if (signaled_) {
+                consume();
+                return true;
+            }
+            block->prev_ = waiters_tail_;
+            block->next_ = nullptr;
+            if (waiters_tail_) {
+                waiters_tail_->next_ = block;
+            } else {
+                waiters_head_ = block;
+            }
+            waiters_tail_ = block;
+            block->linked_ = true;
+            return false;
+        }
+        //
+        // Returns false if block is not linked anymore, that
+        // is wait was already satisfied or it was never registered.
+        //
+        [[nodiscard]] bool unregister_wait(wait_block *block) noexcept {
+            std::lock_guard<std::mutex> lock{lock_};
+            if (!block->linked_) {
+                return false;
+            }
+            unlink(block);
+            return true;
+        }
+
+        [[nodiscard]] bool bind_io(io_completion_routine routine, void *context) noexcept {
+            std::lock_guard<std::mutex> lock{lock_};
+            if (io_routine_) {
+                return false;
+            }
+            io_routine_ = routine;
+            io_context_ = context;
+            return true;
+        }
+
+        void unbind_io() noexcept {
+            std::lock_guard<std::mutex> lock{lock_};
+            io_routine_ = nullptr;
+            io_context_ = nullptr;
+        }
+        //
+        // Delivers IO completion to the bound io handler. Returns false
+        // if handle is not bound to an io handler.
+        //
+        [[nodiscard]] bool complete_io(OVERLAPPED *overlapped,
+                                       ULONG error,
+                                       ULONG_PTR bytes_transferred) noexcept {
+            io_completion_routine routine{nullptr};
+            void *context{nullptr};
+            {
+                std::lock_guard<std::mutex> lock{lock_};
+                routine = io_routine_;
+                context = io_context_;
+            }
+            if (routine) {
+                routine(context, overlapped, error, bytes_transferred);
+                return true;
+            }
+            return false;
+        }
+
+    private:
+        ~handle_object() noexcept = default;
+
+        void consume() noexcept {
+            if (!manual_reset_) {
+                signaled_ = false;
+            }
+        }
+
+        void unlink(wait_block *block) noexcept {
+            if (block->prev_) {
+                block->prev_->next_ = block->next_;
+            } else {
+                waiters_head_ = block->next_;
+            }
+            if (block->next_) {
+                block->next_->prev_ = block->prev_;
+            } else {
+                waiters_tail_ = block->prev_;
+            }
+            block->next_ = nullptr;
+            block->prev_ = nullptr;
+            block->linked_ = false;
+        }
+        //
+        // Auto reset event satisfies only the first waiter and
+        // stays unsignaled, manual reset event satisfies everyone
+        //
+        void satisfy_waiters() noexcept {
+            while (signaled_ && waiters_head_) {
+                wait_block *block = waiters_head_;
+                unlink(block);
+                consume();
+                block->satisfied_(block);
+            }
+        }
+
+        kind_t kind_;
+        bool manual_reset_;
+        bool signaled_;
+        int fd_;
+        long references_{1};
+        unsigned long long pulse_generation_{0};
+        std::mutex lock_;
+        std::condition_variable cv_;
+        wait_block *waiters_head_{nullptr};
+        wait_block *waiters_tail_{nullptr};
+        io_completion_routine io_routine_{nullptr};
+        void *io_context_{nullptr};
+    };
+
+} // namespace ac::details
+
+#endif //_AC_HELPERS_WIN32_LIBRARY_POSIX_HEADER_
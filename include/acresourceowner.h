@@ -3,6 +3,12 @@
 
 #pragma once
 
+#include "accommon.h"
+
+#ifndef _WIN32
+#include <shared_mutex>
+#endif
+
 namespace ac {
 
     template<typename T>
@@ -301,6 +307,8 @@ namespace ac {
         return resource_owner<T, typename T::acqiure_exclusive_traits_t>{&resource, param...};
     }
 
+#ifdef _WIN32
+
     class srw_lock final {
     public:
         using acqiure_shared_traits_t = acquire_shared_traits<srw_lock>;
@@ -360,6 +368,68 @@ namespace ac {
         SRWLOCK lock_;
     };
 
+#else // _WIN32
+
+    class srw_lock final {
+    public:
+        using acqiure_shared_traits_t = acquire_shared_traits<srw_lock>;
+        using acqiure_exclusive_traits_t = acquire_exclusive_traits<srw_lock>;
+        using anti_acquire_shared_traits_t = anti_acquire_shared_traits<srw_lock>;
+        using anti_acquire_exclusive_traits_t = anti_acquire_exclusive_traits<srw_lock>;
+
+        using shared_lock_guard =
+            resource_owner<srw_lock, srw_lock::acqiure_shared_traits_t>;
+        using exclusive_lock_guard =
+            resource_owner<srw_lock, srw_lock::acqiure_exclusive_traits_t>;
+        using anti_shared_lock_guard =
+            resource_owner<srw_lock, srw_lock::anti_acquire_shared_traits_t>;
+        using anti_exclusive_lock_guard =
+            resource_owner<srw_lock, srw_lock::anti_acquire_exclusive_traits_t>;
+
+        srw_lock() noexcept {
+        }
+
+        srw_lock(srw_lock const &) = delete;
+        srw_lock(srw_lock &&) = delete;
+
+        srw_lock &operator=(srw_lock const &) = delete;
+        srw_lock &operator=(srw_lock &&) = delete;
+
+        ~srw_lock() noexcept {
+        }
+
+        void acquire_exclusive() noexcept {
+            lock_.lock();
+        }
+
+        [[nodiscard]] bool try_acquire_exclusive() noexcept {
+            return lock_.try_lock();
+        }
+
+        void release_exclusive() noexcept {
+            lock_.unlock();
+        }
+
+        void acquire_shared() noexcept {
+            lock_.lock_shared();
+        }
+
+        [[nodiscard]] bool try_acquire_shared() noexcept {
+            return lock_.try_lock_shared();
+        }
+
+        void release_shared() noexcept {
+            lock_.unlock_shared();
+        }
+
+    private:
+        friend class condition_variable;
+
+        std::shared_mutex lock_;
+    };
+
+#endif // _WIN32
+
     class rw_lock final {
     public:
         using acqiure_shared_traits_t = acquire_shared_traits<rw_lock>;
@@ -8,6 +8,13 @@
 #include "ackernelobject.h"
 #include "acresourceowner.h"
 
+#include <algorithm>
+#include <thread>
+
+#ifndef _WIN32
+#include <sched.h>
+#endif
+
 namespace ac {
 
     class rundown_exception: public std::system_error {
@@ -32,7 +39,7 @@ namespace ac {
 
         struct noop_rundown_base {
             bool try_start(bool restart) {
-                restart;
+                static_cast<void>(restart);
                 return true;
             }
 
@@ -164,9 +171,9 @@ namespace ac {
         rundown_counter(rundown_counter &&) = delete;
         rundown_counter &operator=(rundown_counter &&) = delete;
 
-        template<typename... T>
-        explicit rundown_counter(T &&...Args) {
-            AC_CODDING_ERROR_IF_NOT(this->try_start(false, std::forward<T>(Args)...));
+        template<typename... A>
+        explicit rundown_counter(A &&...Args) {
+            AC_CODDING_ERROR_IF_NOT(this->try_start(false, std::forward<A>(Args)...));
         }
 
         ~rundown_counter() {
@@ -203,9 +210,9 @@ namespace ac {
         // Threads that do acquire with memory_rder_acquire will see
         // all changes done in (1)
         //
-        template<typename... T>
-        std::pair<bool, bool> restart(T &&...Args) {
-            bool result = this->try_start(true, std::forward<T>(Args)...);
+        template<typename... A>
+        std::pair<bool, bool> restart(A &&...Args) {
+            bool result = this->try_start(true, std::forward<A>(Args)...);
             if (result) {
                 counter_t value = counter_.exchange(INIT_VALUE, std::memory_order_release);
                 AC_CODDING_ERROR_IF_NOT(is_canceled(value) && is_idle(value));
@@ -445,7 +452,7 @@ namespace ac {
         }
 
         bool try_start_impl(bool restart) {
-            restart;
+            static_cast<void>(restart);
             return true;
         }
 
@@ -462,6 +469,283 @@ namespace ac {
         }
     };
 
+    namespace details {
+        //
+        // Processor that thread runs on now. Thread can be moved
+        // to another processor right after this returns.
+        //
+        [[nodiscard]] inline unsigned int current_cpu() noexcept {
+#ifdef _WIN32
+            return GetCurrentProcessorNumber();
+#else
+            int const cpu = sched_getcpu();
+            return 0 <= cpu ? static_cast<unsigned int>(cpu) : 0;
+#endif
+        }
+    } // namespace details
+
+    //
+    // Rundown counter that keeps a count per processor, each one on
+    // its own cache line, so threads that acquire and release on
+    // different processors do not contend on the same word. Acquire
+    // is one CAS on the shard of the current processor, and release
+    // is one fetch_sub on the shard of the processor it runs on,
+    // which does not have to be the one that acquired.
+    //
+    // Count of a shard can wrap below zero, only the sum of shards
+    // is meaningful, and it is taken once, when rundown starts. Low
+    // bit of every shard is its cancelation bit. Rundown sets it on
+    // each shard, and sums counts it saw. Release that finds its
+    // shard canceled was not in that sum, and takes the reference
+    // from remaining_ instead.
+    //
+    // Policy hooks are the same as for rundown_counter. Count is not
+    // known while rundown is running, so has_work is called when
+    // rundown starts with references outstanding, and no_work when
+    // the last of them is released, right before rundown_complete.
+    // There is no max_count, and object takes a cache line per
+    // processor, so use it only for locks that many threads take.
+    //
+    template<typename T = details::noop_rundown_base>
+    class sharded_rundown_counter: public T {
+    protected:
+        using base_t = T;
+
+    public:
+        using counter_t = std::uint64_t;
+
+    protected:
+        static constexpr counter_t CANCEL_BIT = 1;
+        static constexpr counter_t INCR = 2;
+
+        static constexpr std::uint32_t RUNNING = 0;
+        static constexpr std::uint32_t RUNNING_DOWN = 1;
+        static constexpr std::uint32_t RUNDOWN_COMPLETE = 2;
+
+        constexpr static bool is_canceled(counter_t value) {
+            return (value & CANCEL_BIT);
+        }
+
+        struct alignas(64) shard {
+            std::atomic<counter_t> value_{0};
+        };
+
+        [[nodiscard]] shard &current_shard() const {
+            return shards_[details::current_cpu() % shard_count_];
+        }
+
+    public:
+        sharded_rundown_counter(sharded_rundown_counter const &) = delete;
+        sharded_rundown_counter &operator=(sharded_rundown_counter const &) = delete;
+        sharded_rundown_counter(sharded_rundown_counter &&) = delete;
+        sharded_rundown_counter &operator=(sharded_rundown_counter &&) = delete;
+
+        template<typename... A>
+        explicit sharded_rundown_counter(A &&...Args)
+            : shard_count_{std::max(1U, std::thread::hardware_concurrency())}
+            , shards_{std::make_unique<shard[]>(shard_count_)} {
+            AC_CODDING_ERROR_IF_NOT(this->try_start(false, std::forward<A>(Args)...));
+        }
+
+        ~sharded_rundown_counter() {
+            AC_CODDING_ERROR_IF_NOT(is_rundown_complete());
+        }
+        //
+        // Cancels shards one at a time. Reference can be acquired on a
+        // shard that is not canceled yet, and released on one that is,
+        // but then it is counted in the sum and taken from remaining_
+        // by release, so the two meet at zero once sum is added.
+        // Returns true if rundown is complete.
+        //
+        bool start_rundown() {
+            std::uint32_t expected{RUNNING};
+            if (!state_.compare_exchange_strong(expected, RUNNING_DOWN, std::memory_order_acq_rel)) {
+                return RUNDOWN_COMPLETE == state_.load(std::memory_order_acquire);
+            }
+            counter_t sum{0};
+            for (unsigned int i = 0; i < shard_count_; ++i) {
+                sum += shards_[i].value_.fetch_or(CANCEL_BIT, std::memory_order_acq_rel) & ~CANCEL_BIT;
+            }
+            std::int64_t const outstanding{static_cast<std::int64_t>(sum / INCR)};
+            if (0 != outstanding) {
+                this->has_work();
+            }
+            bool const idle{0 == outstanding + remaining_.fetch_add(outstanding, std::memory_order_acq_rel)};
+            if (idle) {
+                state_.store(RUNDOWN_COMPLETE, std::memory_order_release);
+            }
+            return idle;
+        }
+        //
+        // Clears cancelation bit of every shard, and keeps the counts.
+        // Count of a shard does not have to be zero, only their sum is.
+        // Acquires fail until state is published, so no reference can
+        // be released on a shard that is still canceled and take
+        // remaining_ below zero after it was reset.
+        //
+        template<typename... A>
+        std::pair<bool, bool> restart(A &&...Args) {
+            AC_CODDING_ERROR_IF_NOT(is_rundown_complete(std::memory_order_acquire));
+            bool result = this->try_start(true, std::forward<A>(Args)...);
+            if (result) {
+                for (unsigned int i = 0; i < shard_count_; ++i) {
+                    shards_[i].value_.fetch_and(~CANCEL_BIT, std::memory_order_relaxed);
+                }
+                remaining_.store(0, std::memory_order_relaxed);
+                state_.store(RUNNING, std::memory_order_release);
+            }
+            return std::make_pair(result, false /*is_idle*/);
+        }
+
+        explicit operator bool() const {
+            return is_running();
+        }
+
+        bool is_running(std::memory_order order = std::memory_order_relaxed) const {
+            return RUNNING == state_.load(order);
+        }
+
+        bool is_running_down(std::memory_order order = std::memory_order_relaxed) const {
+            return RUNNING_DOWN == state_.load(order);
+        }
+
+        bool is_rundown_complete(std::memory_order order = std::memory_order_relaxed) const {
+            return RUNDOWN_COMPLETE == state_.load(order);
+        }
+        //
+        // Only for logging, walks all shards
+        //
+        counter_t count(std::memory_order const order = std::memory_order_relaxed) const {
+            if (is_running_down(order)) {
+                return static_cast<counter_t>(remaining_.load(order));
+            }
+            if (is_rundown_complete(order)) {
+                return 0;
+            }
+            counter_t sum{0};
+            for (unsigned int i = 0; i < shard_count_; ++i) {
+                sum += shards_[i].value_.load(order) & ~CANCEL_BIT;
+            }
+            return sum / INCR;
+        }
+        //
+        // Uses memory order acquire to make sure we will see any changes
+        // done by the thread that reset rundown. Shard line is owned by
+        // the current processor, so CAS rarely retries. Failed acquire
+        // does not touch the shard, so nothing has to be given back
+        // after rundown summed it.
+        //
+        bool try_acquire() {
+            if (!is_running(std::memory_order_acquire)) {
+                return false;
+            }
+            shard &s = current_shard();
+            counter_t value = s.value_.load(std::memory_order_relaxed);
+            do {
+                if (is_canceled(value)) {
+                    return false;
+                }
+            } while (!s.value_.compare_exchange_weak(
+                value, value + INCR, std::memory_order_acquire, std::memory_order_relaxed));
+            return true;
+        }
+
+        void acquire() {
+            if (!try_acquire()) {
+                throw rundown_exception();
+            }
+        }
+        //
+        // Release on a shard that is still running is a plain decrement.
+        // Once shard is canceled its count was already summed, and the
+        // reference is taken from remaining_.
+        //
+        void release() {
+            counter_t value = current_shard().value_.fetch_sub(INCR, std::memory_order_release);
+            if (is_canceled(value)) {
+                if (1 == remaining_.fetch_sub(1, std::memory_order_acq_rel)) {
+                    state_.store(RUNDOWN_COMPLETE, std::memory_order_release);
+                    this->no_work();
+                    this->rundown_complete();
+                }
+            }
+        }
+
+    protected:
+        unsigned int shard_count_;
+        std::unique_ptr<shard[]> shards_;
+        //
+        // References outstanding once rundown started. Releases that
+        // come before the sum is added take it below zero.
+        //
+        std::atomic<std::int64_t> remaining_{0};
+        std::atomic<std::uint32_t> state_{RUNNING};
+    };
+
+    class sharded_rundown
+        : public sharded_rundown_counter<ac::details::crtp_rundown_base<sharded_rundown>> {
+        using base_t = sharded_rundown_counter<ac::details::crtp_rundown_base<sharded_rundown>>;
+
+    public:
+        sharded_rundown() {
+        }
+
+        ~sharded_rundown() {
+            join();
+        }
+
+        bool start_rundown() {
+            bool just_stopped = base_t::start_rundown();
+            if (just_stopped) {
+                wake_joiners();
+            }
+            return just_stopped;
+        }
+
+        void restart() {
+            bool result = false;
+            bool is_idle = false;
+            std::tie(result, is_idle) = base_t::restart();
+            AC_CODDING_ERROR_IF_NOT(result);
+        }
+
+        void join() {
+            if (!start_rundown()) {
+                for (;;) {
+                    std::uint32_t current_state = state_.load(std::memory_order_acquire);
+                    if (RUNDOWN_COMPLETE == current_state) {
+                        break;
+                    }
+                    wait_on_address::wait(state_address(), current_state);
+                }
+            }
+        }
+
+        bool try_start_impl(bool restart) {
+            static_cast<void>(restart);
+            return true;
+        }
+
+        void has_work_impl() {
+        }
+
+        void no_work_impl() {
+        }
+
+        void rundown_complete_impl() {
+            wake_joiners();
+        }
+
+    private:
+        [[nodiscard]] std::uint32_t const volatile *state_address() const {
+            return reinterpret_cast<std::uint32_t const volatile *>(&state_);
+        }
+
+        void wake_joiners() {
+            wait_on_address::wake_all(state_address());
+        }
+    };
+
     template< typename T>
     class join_guard {
     public:
@@ -533,6 +817,9 @@ namespace ac {
     using slim_rundown_lock = resource_owner<slim_rundown>;
     using slim_rundown_join = join_guard<slim_rundown>;
 
+    using sharded_rundown_lock = resource_owner<sharded_rundown>;
+    using sharded_rundown_join = join_guard<sharded_rundown>;
+
 
 } // namespace ac
 
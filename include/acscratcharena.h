@@ -0,0 +1,128 @@
+#ifndef _AC_HELPERS_WIN32_LIBRARY_SCRATCH_ARENA_HEADER_
+#define _AC_HELPERS_WIN32_LIBRARY_SCRATCH_ARENA_HEADER_
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <new>
+
+namespace ac::tp {
+
+    namespace details {
+        //
+        // Bump allocator that each thread owns. Memory is taken from
+        // a list of chunks, and deallocate does nothing. Owner takes
+        // a mark, and rewinding to the mark reclaims everything that
+        // was allocated after it at once. Marks nest, so a callback
+        // that runs other callbacks inline keeps its own allocations.
+        //
+        // Chunks are kept when arena is rewound, so once the arena
+        // grew to what callbacks of a thread use, allocation is a
+        // pointer bump and never reaches the heap. Chunks are freed
+        // when the thread exits.
+        //
+        class scratch_arena final: public std::pmr::memory_resource {
+            struct chunk;
+
+        public:
+            static constexpr size_t chunk_size{64 * 1024};
+
+            struct mark {
+                chunk *chunk_{nullptr};
+                std::byte *top_{nullptr};
+            };
+
+            scratch_arena() noexcept {
+            }
+
+            scratch_arena(scratch_arena const &) = delete;
+            scratch_arena &operator=(scratch_arena const &) = delete;
+
+            ~scratch_arena() noexcept override {
+                while (head_) {
+                    chunk *next{head_->next_};
+                    ::operator delete(head_, std::align_val_t{alignof(chunk)});
+                    head_ = next;
+                }
+            }
+
+            [[nodiscard]] static scratch_arena &current() noexcept {
+                thread_local scratch_arena arena;
+                return arena;
+            }
+
+            [[nodiscard]] mark get_mark() const noexcept {
+                return mark{current_, top_};
+            }
+            //
+            // Reclaims everything allocated after the mark
+            //
+            void rewind(mark const &m) noexcept {
+                current_ = m.chunk_;
+                top_ = m.top_;
+                end_ = current_ ? current_->data() + current_->size_ : nullptr;
+            }
+
+        private:
+            struct alignas(std::max_align_t) chunk {
+                chunk *next_;
+                size_t size_;
+
+                [[nodiscard]] std::byte *data() noexcept {
+                    return reinterpret_cast<std::byte *>(this + 1);
+                }
+            };
+
+            void *do_allocate(size_t bytes, size_t alignment) override {
+                std::byte *p{align(top_, alignment)};
+                if (current_ && p <= end_ && bytes <= static_cast<size_t>(end_ - p)) {
+                    top_ = p + bytes;
+                    return p;
+                }
+                return allocate_from_next_chunk(bytes, alignment);
+            }
+
+            void do_deallocate(void *, size_t, size_t) noexcept override {
+            }
+
+            [[nodiscard]] bool do_is_equal(std::pmr::memory_resource const &other) const noexcept override {
+                return this == &other;
+            }
+
+            [[nodiscard]] static std::byte *align(std::byte *p, size_t alignment) noexcept {
+                std::uintptr_t const address{reinterpret_cast<std::uintptr_t>(p)};
+                return p + ((alignment - address % alignment) % alignment);
+            }
+            //
+            // Moves to the chunk after the current one. Chunk that
+            // is kept there is reused if request fits in it, otherwise
+            // a new chunk is inserted in front of it.
+            //
+            [[nodiscard]] void *allocate_from_next_chunk(size_t bytes, size_t alignment) {
+                size_t const needed{bytes + (alignment > alignof(chunk) ? alignment : 0)};
+                chunk **link{current_ ? &current_->next_ : &head_};
+                if (nullptr == *link || (*link)->size_ < needed) {
+                    size_t const size{needed > chunk_size ? needed : chunk_size};
+                    void *memory{::operator new(sizeof(chunk) + size, std::align_val_t{alignof(chunk)})};
+                    *link = ::new (memory) chunk{*link, size};
+                }
+                current_ = *link;
+                end_ = current_->data() + current_->size_;
+                std::byte *p{align(current_->data(), alignment)};
+                top_ = p + bytes;
+                return p;
+            }
+
+            chunk *head_{nullptr};
+            chunk *current_{nullptr};
+            std::byte *top_{nullptr};
+            std::byte *end_{nullptr};
+        };
+
+    } // namespace details
+
+} // namespace ac::tp
+
+#endif //_AC_HELPERS_WIN32_LIBRARY_SCRATCH_ARENA_HEADER_
@@ -7,6 +7,16 @@
 #include "accommon.h"
 #include "acresourceowner.h"
 #include "acrundown.h"
+#include "acinplacefunction.h"
+#include "acnodecache.h"
+#include "acscratcharena.h"
+
+#include <mutex>
+#include <ranges>
+
+#ifndef _WIN32
+#include "actpengine.h"
+#endif
 
 namespace ac::tp {
 
@@ -41,7 +51,7 @@ namespace ac::tp {
     using time_point = clock::time_point;
     using period = clock::period;
 
-    extern __declspec(selectany) duration const infinite_duration = duration{-1};
+    inline duration const infinite_duration = duration{-1};
 
     [[nodiscard]] inline std::chrono::duration<long long, std::ratio<1, 10000000>> operator"" _ns100(
         unsigned long long v) {
@@ -61,33 +71,214 @@ namespace ac::tp {
     class timer_work_item;
     class wait_work_item;
     class io_handler;
+    class cleanup_group;
+
+    //
+    // Callback objects made with make() come from the node cache of
+    // their type, so creating and destroying them takes memory from a
+    // per-thread free list rather than from the heap
+    //
+    using work_item_ptr = std::unique_ptr<work_item, details::node_cache_deleter<work_item>>;
+    using timer_work_item_ptr = std::unique_ptr<timer_work_item, details::node_cache_deleter<timer_work_item>>;
+    using wait_work_item_ptr = std::unique_ptr<wait_work_item, details::node_cache_deleter<wait_work_item>>;
+    using io_handler_ptr = std::unique_ptr<io_handler, details::node_cache_deleter<io_handler>>;
+
+    //
+    // Callbacks are stored inline in the work items and in the submit_work
+    // nodes, so submitting work does not allocate. Callables that capture
+    // more than that do not compile. Define AC_TP_CALLBACK_INPLACE_CAPACITY
+    // before including this header to change the capacity.
+    //
+#ifndef AC_TP_CALLBACK_INPLACE_CAPACITY
+#define AC_TP_CALLBACK_INPLACE_CAPACITY 64
+#endif
 
-    using work_item_ptr = std::unique_ptr<work_item>;
-    using timer_work_item_ptr = std::unique_ptr<timer_work_item>;
-    using wait_work_item_ptr = std::unique_ptr<wait_work_item>;
-    using io_handler_ptr = std::unique_ptr<io_handler>;
+    inline constexpr size_t callback_inplace_capacity{AC_TP_CALLBACK_INPLACE_CAPACITY};
 
-    typedef std::move_only_function<void(callback_instance &)> work_item_callback; // see help for the CreateThreadpoolWork
-    typedef std::move_only_function<void(callback_instance &)> timer_work_item_callback; // see help for the CreateThreadpoolTimer
-    typedef std::move_only_function<void(callback_instance &, TP_WAIT_RESULT)> wait_work_item_callback; // see help for the CreateThreadpoolWait
+    typedef inplace_function<void(callback_instance &), callback_inplace_capacity> work_item_callback; // see help for the CreateThreadpoolWork
+    typedef inplace_function<void(callback_instance &), callback_inplace_capacity> timer_work_item_callback; // see help for the CreateThreadpoolTimer
+    typedef inplace_function<void(callback_instance &, TP_WAIT_RESULT), callback_inplace_capacity> wait_work_item_callback; // see help for the CreateThreadpoolWait
     typedef std::move_only_function<void(callback_instance &, OVERLAPPED *, ULONG, ULONG_PTR)> io_callback; // see help for the CreateThreadpoolIo
 
     struct optional_callback_parameters {
         std::optional<TP_CALLBACK_PRIORITY> priority;
         std::optional<callback_runs_long> runs_long;
         std::optional<void *> module;
+        //
+        // Runs callback on workers of this NUMA node. Only honored
+        // by pools that have a worker group per NUMA node, and
+        // ignored by the Win32 thread pool.
+        //
+        std::optional<unsigned long> numa_node;
     };
 
     namespace details {
+        //
+        // Link of a callback object into the cleanup group it was
+        // created in. Group closes its members, and marks them closed
+        // so their destructors do not close them again.
+        //
+        struct cleanup_member {
+            using close_t = void (*)(cleanup_member *member, bool cancel_pending) noexcept;
+
+            void join_cleanup_group(cleanup_group *group, close_t close = nullptr);
+
+            [[nodiscard]] bool leave_cleanup_group() noexcept;
+
+            cleanup_group *group_{nullptr};
+            //
+            // Position in the members of the group
+            //
+            size_t index_{0};
+            close_t close_{nullptr};
+            bool closed_{false};
+        };
+    } // namespace details
+
+    //
+    // Closes all callback objects created through it in one pass.
+    // Pending callbacks are canceled, callbacks that are running are
+    // waited for, and destructors of closed members do not wait or
+    // close anything, so shutdown does not pay a round trip per
+    // object. Members can still be destroyed one by one, and group
+    // can be reused once close_members returns.
+    //
+    // Members must not be used or destroyed while close_members runs,
+    // and members that outlive it can only be destroyed.
+    //
+    class cleanup_group final {
+    public:
+        cleanup_group() {
+#ifdef _WIN32
+            group_ = CreateThreadpoolCleanupGroup();
+            if (nullptr == group_) {
+                AC_THROW(GetLastError(), "CreateThreadpoolCleanupGroup");
+            }
+#endif
+        }
+
+        cleanup_group(cleanup_group const &) = delete;
+        cleanup_group(cleanup_group &&) = delete;
+        cleanup_group &operator=(cleanup_group const &) = delete;
+        cleanup_group &operator=(cleanup_group &&) = delete;
+
+        ~cleanup_group() noexcept {
+            close_members(true);
+#ifdef _WIN32
+            CloseThreadpoolCleanupGroup(group_);
+            group_ = nullptr;
+#endif
+        }
+        //
+        // Closes all members. With cancel_pending callbacks that did
+        // not start yet do not run.
+        //
+        void close_members(bool cancel_pending = true) noexcept {
+#ifdef _WIN32
+            CloseThreadpoolCleanupGroupMembers(group_, cancel_pending ? TRUE : FALSE, nullptr);
+#endif
+            std::vector<details::cleanup_member *> members;
+            {
+                std::lock_guard<std::mutex> lock{lock_};
+                members.swap(members_);
+                for (details::cleanup_member *member : members) {
+                    member->group_ = nullptr;
+                }
+            }
+            //
+            // Members are visited from an array rather than through
+            // links, so loads of the next members do not wait for
+            // the current one
+            //
+            for (details::cleanup_member *member : members) {
+#ifndef _WIN32
+                member->close_(member, cancel_pending);
+#endif
+                member->closed_ = true;
+            }
+        }
+
+        [[nodiscard]] size_t size() const noexcept {
+            std::lock_guard<std::mutex> lock{lock_};
+            return members_.size();
+        }
+
+#ifdef _WIN32
+        [[nodiscard]] PTP_CLEANUP_GROUP get_handle() const noexcept {
+            return group_;
+        }
+#endif
+
         template<typename C>
-        inline VOID CALLBACK submit_work_worker(PTP_CALLBACK_INSTANCE instance,
-                                                PVOID context) noexcept {
-            std::unique_ptr<C> cb{reinterpret_cast<C *>(context)};
-            callback_instance inst{instance};
-            (*cb)(inst);
+        [[nodiscard]] work_item_ptr make_work_item(thread_pool &pool,
+                                                   C &&callback,
+                                                   optional_callback_parameters const *params = nullptr);
+
+        template<typename C>
+        [[nodiscard]] timer_work_item_ptr make_timer_work_item(thread_pool &pool,
+                                                               C &&callback,
+                                                               optional_callback_parameters const *params = nullptr);
+
+        template<typename C>
+        [[nodiscard]] wait_work_item_ptr make_wait_work_item(thread_pool &pool,
+                                                             C &&callback,
+                                                             optional_callback_parameters const *params = nullptr);
+
+        template<typename C>
+        [[nodiscard]] io_handler_ptr make_io_handler(thread_pool &pool,
+                                                     HANDLE handle,
+                                                     C &&callback,
+                                                     optional_callback_parameters const *params = nullptr);
+        //
+        // Called by callback objects before they create
+        // anything they would have to undo
+        //
+        void add(details::cleanup_member *member) {
+            std::lock_guard<std::mutex> lock{lock_};
+            members_.push_back(member);
+            member->index_ = members_.size() - 1;
+            member->group_ = this;
+        }
+        //
+        // Last member takes the place of the removed one
+        //
+        void remove(details::cleanup_member *member) noexcept {
+            std::lock_guard<std::mutex> lock{lock_};
+            details::cleanup_member *last{members_.back()};
+            members_[member->index_] = last;
+            last->index_ = member->index_;
+            members_.pop_back();
+            member->group_ = nullptr;
+        }
+
+    private:
+#ifdef _WIN32
+        PTP_CLEANUP_GROUP group_{nullptr};
+#endif
+        mutable std::mutex lock_;
+        std::vector<details::cleanup_member *> members_;
+    };
+
+    namespace details {
+        inline void cleanup_member::join_cleanup_group(cleanup_group *group, close_t close) {
+            close_ = close;
+            if (group) {
+                group->add(this);
+            }
+        }
+        //
+        // Returns true if group already closed the object
+        //
+        inline bool cleanup_member::leave_cleanup_group() noexcept {
+            if (group_) {
+                group_->remove(this);
+            }
+            return closed_;
         }
     } // namespace details
 
+#ifdef _WIN32
+
     //
     // A helper class that should not be used directly.
     // The concept of environment is incapsulated inside the cancelation
@@ -144,6 +335,18 @@ namespace ac::tp {
                                PTP_CLEANUP_GROUP_CANCEL_CALLBACK cancel_callback) noexcept {
             SetThreadpoolCallbackCleanupGroup(&environment_, cleanup_group, cancel_callback);
         }
+        //
+        // Callback objects created with this environment
+        // join the group
+        //
+        void set_cleanup_group(cleanup_group *group) noexcept {
+            cleanup_group_ = group;
+            SetThreadpoolCallbackCleanupGroup(&environment_, group ? group->get_handle() : nullptr, nullptr);
+        }
+
+        [[nodiscard]] cleanup_group *get_cleanup_group() const noexcept {
+            return cleanup_group_;
+        }
 
         void set_callback_optional_parameters(optional_callback_parameters const *params) {
             if (params) {
@@ -180,6 +383,7 @@ namespace ac::tp {
         }
 
         TP_CALLBACK_ENVIRON environment_{};
+        cleanup_group *cleanup_group_{nullptr};
     };
 
     //
@@ -193,6 +397,12 @@ namespace ac::tp {
             : instance_{instance} {
         }
 
+        ~callback_instance() noexcept {
+            if (scratch_) {
+                scratch_->rewind(scratch_mark_);
+            }
+        }
+
         callback_instance(callback_instance const &) = delete;
         callback_instance &operator=(callback_instance const &) = delete;
         callback_instance(callback_instance const &&) = delete;
@@ -221,35 +431,108 @@ namespace ac::tp {
         [[nodiscard]] bool may_run_long() noexcept {
             return (CallbackMayRunLong(instance_) ? true : false);
         }
+        //
+        // Memory resource for temporaries of this callback, for
+        // instance std::pmr::vector or std::pmr::string. Allocation
+        // is a pointer bump in an arena of the thread, and everything
+        // allocated from it is reclaimed at once when callback returns,
+        // so nothing allocated from it can outlive the callback or be
+        // handed to another thread.
+        //
+        [[nodiscard]] std::pmr::memory_resource &get_scratch_resource() noexcept {
+            if (nullptr == scratch_) {
+                scratch_ = &details::scratch_arena::current();
+                scratch_mark_ = scratch_->get_mark();
+            }
+            return *scratch_;
+        }
+        //
+        // Guard for a region where callback blocks. Win32 thread pool
+        // has no notion of a blocking region, the closest is to let it
+        // know that callback may run long, so it can start another
+        // thread if it has to.
+        //
+        class blocking_scope final {
+        public:
+            explicit blocking_scope(callback_instance &instance) noexcept {
+                (void) instance.may_run_long();
+            }
+
+            blocking_scope(blocking_scope const &) = delete;
+            blocking_scope &operator=(blocking_scope const &) = delete;
+        };
 
     private:
         PTP_CALLBACK_INSTANCE instance_;
+        details::scratch_arena *scratch_{nullptr};
+        details::scratch_arena::mark scratch_mark_;
     };
 
-    class work_item final {
-    protected:
+    namespace details {
+        struct submit_work_context {
+            work_item_callback callback_;
+        };
+
+        inline VOID CALLBACK submit_work_worker(PTP_CALLBACK_INSTANCE instance,
+                                                PVOID context) noexcept {
+            submit_work_context *ctx{static_cast<submit_work_context *>(context)};
+            {
+                callback_instance inst{instance};
+                ctx->callback_(inst);
+            }
+            node_cache<submit_work_context>::destroy(ctx);
+        }
+
+        template<typename C>
+        inline void submit_work(C &&callback, PTP_CALLBACK_ENVIRON environment) {
+            submit_work_context *ctx{
+                node_cache<submit_work_context>::create(std::forward<C>(callback))};
+            if (!TrySubmitThreadpoolCallback(&submit_work_worker, ctx, environment)) {
+                DWORD const error{GetLastError()};
+                node_cache<submit_work_context>::destroy(ctx);
+                AC_THROW(error, "TrySubmitThreadpoolCallback");
+            }
+        }
+        //
+        // Thread pool does not have a batch submit,
+        // each callback is queued separately
+        //
+        template<std::ranges::input_range R>
+        inline void submit_work_batch(R &&range, PTP_CALLBACK_ENVIRON environment) {
+            for (auto &&callback : range) {
+                submit_work(std::forward<decltype(callback)>(callback), environment);
+            }
+        }
+    } // namespace details
+
+    class work_item final: private details::cleanup_member {
     public:
         template<typename C>
         static [[nodiscard]] work_item_ptr make(C &&callback,
                                                 callback_environment const *environment = nullptr) {
-            return std::make_unique<work_item>(std::forward<C>(callback), environment);
+            return work_item_ptr{details::node_cache<work_item>::create(
+                std::forward<C>(callback), environment)};
         }
 
         template<typename C>
         static [[nodiscard]] work_item_ptr make(C &&callback,
                                                 optional_callback_parameters const *optional_parameters) {
-            return std::make_unique<work_item>(std::forward<C>(callback), optional_parameters);
+            return work_item_ptr{details::node_cache<work_item>::create(
+                std::forward<C>(callback), optional_parameters)};
         }
 
         template<typename C>
         explicit work_item(C &&callback, callback_environment const *environment = nullptr)
             : callback_(std::forward<C>(callback)) {
+            join_cleanup_group(environment ? environment->get_cleanup_group() : nullptr);
             work_ = CreateThreadpoolWork(&work_item::run_callback,
                                          this,
                                          environment ? environment->get_handle() : nullptr);
 
             if (nullptr == work_) {
-                AC_THROW(GetLastError(), "CreateThreadpoolWork");
+                DWORD const error{GetLastError()};
+                (void) leave_cleanup_group();
+                AC_THROW(error, "CreateThreadpoolWork");
             }
         }
 
@@ -268,14 +551,25 @@ namespace ac::tp {
         }
 
         ~work_item() noexcept {
-            join();
-            CloseThreadpoolWork(work_);
+            if (!leave_cleanup_group()) {
+                join();
+                CloseThreadpoolWork(work_);
+            }
             work_ = nullptr;
         }
 
         void post() noexcept {
             SubmitThreadpoolWork(work_);
         }
+        //
+        // Thread pool does not have a batch submit,
+        // each post is queued separately
+        //
+        void post(std::uint32_t count) noexcept {
+            for (std::uint32_t i = 0; i < count; ++i) {
+                SubmitThreadpoolWork(work_);
+            }
+        }
 
         void join() noexcept {
             WaitForThreadpoolWorkCallbacks(work_, FALSE);
@@ -310,30 +604,34 @@ namespace ac::tp {
         PTP_WORK work_{nullptr};
     };
 
-    class timer_work_item final {
+    class timer_work_item final: private details::cleanup_member {
     public:
         template<typename C>
         static [[nodiscard]] timer_work_item_ptr make(
             C &&callback, callback_environment const *environment = nullptr) {
-            return std::make_unique<timer_work_item>(std::forward<C>(callback), environment);
+            return timer_work_item_ptr{details::node_cache<timer_work_item>::create(
+                std::forward<C>(callback), environment)};
         }
 
         template<typename C>
         static [[nodiscard]] timer_work_item_ptr make(
             C &&callback, optional_callback_parameters const *optional_parameters) {
-            return std::make_unique<timer_work_item>(std::forward<C>(callback),
-                                                     optional_parameters);
+            return timer_work_item_ptr{details::node_cache<timer_work_item>::create(
+                std::forward<C>(callback), optional_parameters)};
         }
 
         template<typename C>
         explicit timer_work_item(C &&callback, callback_environment const *environment = nullptr)
             : callback_(std::forward<C>(callback)) {
+            join_cleanup_group(environment ? environment->get_cleanup_group() : nullptr);
             timer_ = CreateThreadpoolTimer(&timer_work_item::run_callback,
                                            this,
                                            environment ? environment->get_handle() : nullptr);
 
             if (nullptr == timer_) {
-                AC_THROW(GetLastError(), "CreateThreadpoolTimer");
+                DWORD const error{GetLastError()};
+                (void) leave_cleanup_group();
+                AC_THROW(error, "CreateThreadpoolTimer");
             }
         }
 
@@ -352,8 +650,10 @@ namespace ac::tp {
         }
 
         ~timer_work_item() noexcept {
-            join();
-            CloseThreadpoolTimer(timer_);
+            if (!leave_cleanup_group()) {
+                join();
+                CloseThreadpoolTimer(timer_);
+            }
             timer_ = nullptr;
         }
 
@@ -421,30 +721,34 @@ namespace ac::tp {
         PTP_TIMER timer_{nullptr};
     };
 
-    class wait_work_item final {
+    class wait_work_item final: private details::cleanup_member {
     public:
         template<typename C>
         static [[nodiscard]] wait_work_item_ptr make(C &&callback,
                                                      callback_environment const *environment = nullptr) {
-            return std::make_unique<wait_work_item>(std::forward<C>(callback), environment);
+            return wait_work_item_ptr{details::node_cache<wait_work_item>::create(
+                std::forward<C>(callback), environment)};
         }
 
         template<typename C>
         static [[nodiscard]] wait_work_item_ptr make(C &&callback,
                                                      optional_callback_parameters const *optional_parameters) {
-            return std::make_unique<wait_work_item>(std::forward<C>(callback),
-                                                    optional_parameters);
+            return wait_work_item_ptr{details::node_cache<wait_work_item>::create(
+                std::forward<C>(callback), optional_parameters)};
         }
 
         template<typename C>
         explicit wait_work_item(C &&callback, callback_environment const *environment = nullptr)
             : callback_(std::forward<C>(callback)) {
+            join_cleanup_group(environment ? environment->get_cleanup_group() : nullptr);
             wait_ = CreateThreadpoolWait(&wait_work_item::run_callback,
                                          this,
                                          environment ? environment->get_handle() : nullptr);
 
             if (nullptr == wait_) {
-                AC_THROW(GetLastError(), "CreateThreadpoolWait");
+                DWORD const error{GetLastError()};
+                (void) leave_cleanup_group();
+                AC_THROW(error, "CreateThreadpoolWait");
             }
         }
 
@@ -463,8 +767,10 @@ namespace ac::tp {
         }
 
         ~wait_work_item() noexcept {
-            join();
-            CloseThreadpoolWait(wait_);
+            if (!leave_cleanup_group()) {
+                join();
+                CloseThreadpoolWait(wait_);
+            }
             wait_ = nullptr;
         }
 
@@ -524,188 +830,1282 @@ namespace ac::tp {
         PTP_WAIT wait_{nullptr};
     };
 
-    class io_guard final {
-    public:
-        io_guard() = default;
+#else // _WIN32
 
-        explicit io_guard(io_handler *handler) noexcept;
+    using queue_wait_histogram = details::queue_wait_histogram;
+    using concurrency_adjustment = details::concurrency_adjustment;
 
-        io_guard(io_guard const &) = delete;
-        io_guard &operator=(io_guard const &) = delete;
+    namespace details {
+        //
+        // Task that owns a callback passed to submit_work. Same as
+        // TrySubmitThreadpoolCallback it runs once and frees itself.
+        //
+        struct submit_work_task final: public task {
+            template<typename C>
+            explicit submit_work_task(C &&callback)
+                : callback_(std::forward<C>(callback)) {
+                execute_ = &submit_work_task::run;
+            }
 
-        io_guard(io_guard &&other) noexcept
-            : handler_(other.handler_) {
-            other.handler_ = nullptr;
-        }
+            static void run(task *t, callback_frame &frame) noexcept;
+            //
+            // Task that took a slot of queue capacity, and gives it
+            // back once callback returns
+            //
+            static void run_admitted(task *t, callback_frame &frame) noexcept;
 
-        io_guard &operator=(io_guard &&other) noexcept {
-            if (&other != this) {
-                handler_ = other.handler_;
-                other.handler_ = nullptr;
+            work_item_callback callback_;
+        };
+
+        template<typename C>
+        inline void submit_work(pool_engine *pool, callback_options const &options, C &&callback) {
+            submit_work_task *t{node_cache<submit_work_task>::create(std::forward<C>(callback))};
+            options.apply(t);
+            pool->submit(t);
+        }
+        //
+        // Builds a chain of tasks, and queues it with one queue
+        // operation. Nothing is queued if any callback fails to move
+        // into its task.
+        //
+        template<std::ranges::input_range R>
+        inline void submit_work_batch(pool_engine *pool, callback_options const &options, R &&range) {
+            task *first{nullptr};
+            task **tail{&first};
+            size_t count{0};
+            try {
+                for (auto &&callback : range) {
+                    submit_work_task *t{node_cache<submit_work_task>::create(
+                        std::forward<decltype(callback)>(callback))};
+                    options.apply(t);
+                    *tail = t;
+                    tail = &t->next_;
+                    ++count;
+                }
+            } catch (...) {
+                while (first) {
+                    task *next = first->next_;
+                    node_cache<submit_work_task>::destroy(static_cast<submit_work_task *>(first));
+                    first = next;
+                }
+                throw;
             }
-            return *this;
+            pool->submit_batch(first, count);
+        }
+        //
+        // Queues callback that was admitted by the pool, and gives
+        // the slot back if callback fails to move into its task
+        //
+        template<typename C>
+        inline void submit_admitted_work(pool_engine *pool, callback_options const &options, C &&callback) {
+            submit_work_task *t{nullptr};
+            try {
+                t = node_cache<submit_work_task>::create(std::forward<C>(callback));
+            } catch (...) {
+                pool->release_admission();
+                throw;
+            }
+            t->execute_ = &submit_work_task::run_admitted;
+            options.apply(t);
+            pool->submit(t);
         }
 
-        ~io_guard() noexcept;
-
-        void failed_start_io() noexcept;
-
-        [[nodiscard]] bool is_armed() const noexcept {
-            return nullptr != handler_;
+        [[nodiscard]] inline std::optional<steady_clock::time_point> to_wait_due_time(duration const &timeout) noexcept {
+            if (timeout == infinite_duration) {
+                return std::nullopt;
+            }
+            return steady_clock::now() + std::chrono::duration_cast<steady_clock::duration>(timeout);
         }
+    } // namespace details
 
-        operator bool() const noexcept {
-            return is_armed();
+    //
+    // A helper class that should not be used directly.
+    // Carries pool and callback parameters to the constructors
+    // of the callback objects.
+    // Persistence and library are accepted for compatibility,
+    // but are not honored by this engine.
+    //
+    class callback_environment final {
+    public:
+        callback_environment() noexcept {
         }
 
-        void disarm() noexcept {
-            handler_ = nullptr;
+        explicit callback_environment(optional_callback_parameters const &optional_parameters) noexcept
+            : callback_environment() {
+            set_callback_optional_parameters(optional_parameters);
         }
 
-    private:
-        io_handler *handler_{nullptr};
-    };
+        explicit callback_environment(optional_callback_parameters const *optional_parameters) noexcept
+            : callback_environment() {
+            if (optional_parameters) {
+                set_callback_optional_parameters(optional_parameters);
+            }
+        }
 
-    class io_handler final {
-        friend class io_guard;
+        callback_environment(callback_environment &) = delete;
+        callback_environment(callback_environment &&) = delete;
+        callback_environment &operator=(callback_environment &) = delete;
+        callback_environment &operator=(callback_environment &&) = delete;
 
-    public:
-        template<typename C>
-        static [[nodiscard]] io_handler_ptr make(HANDLE handle,
-                                                 C &&callback,
-                                                 callback_environment const *environment = nullptr) {
-            return std::make_unique<io_handler>(handle, std::forward<C>(callback), environment);
+        void set_callback_runs_long() noexcept {
+            runs_long_ = true;
         }
 
-        template<typename C>
-        static [[nodiscard]] io_handler_ptr make(HANDLE handle,
-                                                 C &&callback,
-                                                 optional_callback_parameters const *optional_parameters) {
-            return std::make_unique<io_handler>(
-                handle, std::forward<C>(callback), optional_parameters);
+        void set_callback_persistent() noexcept {
         }
 
-        template<typename C>
-        explicit io_handler(HANDLE handle, C &&callback, callback_environment const *environment = nullptr)
-            : callback_(std::forward<C>(callback))
-            , io_(nullptr) {
-            io_ = CreateThreadpoolIo(handle,
-                                     &io_handler::run_callback,
-                                     this,
-                                     environment ? environment->get_handle() : nullptr);
-
-            if (nullptr == io_) {
-                AC_THROW(GetLastError(), "CreateThreadpoolIo");
-            }
+        void set_callback_priority(TP_CALLBACK_PRIORITY priority) noexcept {
+            options_.priority_ = priority;
         }
 
-        template<typename C>
-        io_handler(HANDLE handle, C &&callback, ac::tp::optional_callback_parameters const *optional_parameters)
-            : callback_(std::forward<C>(callback)) {
-            io_ = CreateThreadpoolIo(
-                handle,
-                &io_handler::run_callback,
-                this,
-                optional_parameters ? callback_environment{optional_parameters}.get_handle()
-                                    : nullptr);
-
-            if (nullptr == io_) {
-                AC_THROW(GetLastError(), "CreateThreadpoolIo");
-            }
+        void set_thread_pool(details::pool_engine *pool = nullptr) noexcept {
+            pool_ = pool;
         }
 
-        ~io_handler() noexcept {
-            WaitForThreadpoolIoCallbacks(io_, FALSE);
-            CloseThreadpoolIo(io_);
-            io_ = nullptr;
+        void set_callback_numa_node(unsigned long numa_node) noexcept {
+            options_.numa_node_ = static_cast<std::uint32_t>(numa_node);
         }
 
+        void set_library(void *) noexcept {
+        }
         //
-        // Call this method every time before issuing an assync IO.
+        // Callback objects created with this environment
+        // join the group
         //
-        [[nodiscard]] io_guard start_io() noexcept {
-            return io_guard{this};
+        void set_cleanup_group(cleanup_group *group) noexcept {
+            cleanup_group_ = group;
+        }
+
+        [[nodiscard]] cleanup_group *get_cleanup_group() const noexcept {
+            return cleanup_group_;
+        }
+
+        void set_callback_optional_parameters(optional_callback_parameters const *params) noexcept {
+            if (params) {
+                set_callback_optional_parameters(*params);
+            }
         }
 
+        void set_callback_optional_parameters(optional_callback_parameters const &params) noexcept {
+            if (params.runs_long == callback_runs_long::yes) {
+                set_callback_runs_long();
+            }
+            if (params.priority) {
+                set_callback_priority(params.priority.value());
+            }
+            if (params.module) {
+                set_library(params.module.value());
+            }
+            if (params.numa_node) {
+                set_callback_numa_node(params.numa_node.value());
+            }
+        }
         //
-        // According to MSDN you MUST call this method whenever
-        // IO operation has completed synchronously with an error
-        // code other than indicating that operation is pending.
-        // Whenever possible prefer using io_guard instead of calling
-        // this method directly.
+        // Callback objects that were not associated with a pool
+        // run on the process default pool
         //
-        void failed_start_io() noexcept {
-            CancelThreadpoolIo(io_);
+        [[nodiscard]] details::pool_engine *get_pool() const {
+            return pool_ ? pool_ : details::default_pool();
         }
 
-        void join() noexcept {
-            WaitForThreadpoolIoCallbacks(io_, FALSE);
+        [[nodiscard]] TP_CALLBACK_PRIORITY get_priority() const noexcept {
+            return options_.priority_;
         }
 
-    private:
-        void internal_start_io() noexcept {
-            StartThreadpoolIo(io_);
+        [[nodiscard]] details::callback_options const &get_callback_options() const noexcept {
+            return options_;
         }
 
-        static void CALLBACK run_callback(PTP_CALLBACK_INSTANCE instance,
-                                          void *context,
-                                          void *overlapped,
-                                          ULONG result,
-                                          ULONG_PTR bytes_transferred,
-                                          PTP_IO io) noexcept {
-            io_handler *handler = static_cast<io_handler *>(context);
-            AC_CODDING_ERROR_IF_NOT(handler->io_ == io);
-            handler->run(instance, static_cast<OVERLAPPED *>(overlapped), result, bytes_transferred);
+        [[nodiscard]] bool get_runs_long() const noexcept {
+            return runs_long_;
         }
 
-        void run(PTP_CALLBACK_INSTANCE instance,
-                 OVERLAPPED *overlapped,
-                 ULONG result,
+    private:
+        details::pool_engine *pool_{nullptr};
+        details::callback_options options_;
+        cleanup_group *cleanup_group_{nullptr};
+        bool runs_long_{false};
+    };
+
+    //
+    // This is just a helper class that is passed to each callback function and
+    // provides an access to the call instance. Do not create instance of this
+    // class on your own.
+    //
+    class callback_instance final {
+    public:
+        explicit callback_instance(details::callback_frame &frame) noexcept
+            : frame_{&frame} {
+        }
+
+        ~callback_instance() noexcept {
+            if (scratch_) {
+                scratch_->rewind(scratch_mark_);
+            }
+        }
+
+        callback_instance(callback_instance const &) = delete;
+        callback_instance &operator=(callback_instance const &) = delete;
+        callback_instance(callback_instance const &&) = delete;
+        callback_instance operator=(callback_instance const &&) = delete;
+
+        void set_event_on_callback_return(HANDLE event) noexcept {
+            frame_->event_on_return_ = event;
+        }
+
+        [[nodiscard]] bool may_run_long() noexcept {
+            if (!frame_->may_run_long_) {
+                frame_->may_run_long_ = frame_->pool_->callback_may_run_long();
+            }
+            return frame_->may_run_long_;
+        }
+        //
+        // Memory resource for temporaries of this callback, for
+        // instance std::pmr::vector or std::pmr::string. Allocation
+        // is a pointer bump in an arena of the thread, and everything
+        // allocated from it is reclaimed at once when callback returns,
+        // so nothing allocated from it can outlive the callback or be
+        // handed to another thread.
+        //
+        [[nodiscard]] std::pmr::memory_resource &get_scratch_resource() noexcept {
+            if (nullptr == scratch_) {
+                scratch_ = &details::scratch_arena::current();
+                scratch_mark_ = scratch_->get_mark();
+            }
+            return *scratch_;
+        }
+        //
+        // NUMA node of the worker group running this callback,
+        // or empty if pool does not have a group per NUMA node
+        //
+        [[nodiscard]] std::optional<unsigned long> get_numa_node() const noexcept {
+            std::uint32_t const node{frame_->pool_->get_current_numa_node()};
+            if (details::any_numa_node == node) {
+                return std::nullopt;
+            }
+            return node;
+        }
+        //
+        // Guard for a region where callback blocks. While callback is
+        // blocked pool may start a compensating worker, which retires
+        // when a blocked callback leaves the region. Waits through
+        // wait_single_object and wait_on_address::wait are treated
+        // as blocking regions automatically.
+        //
+        class blocking_scope final {
+        public:
+            explicit blocking_scope(callback_instance &) noexcept {
+            }
+
+            blocking_scope(blocking_scope const &) = delete;
+            blocking_scope &operator=(blocking_scope const &) = delete;
+
+        private:
+            ac::details::blocking_region region_;
+        };
+
+    private:
+        details::callback_frame *frame_;
+        details::scratch_arena *scratch_{nullptr};
+        details::scratch_arena::mark scratch_mark_;
+    };
+
+    namespace details {
+        inline void submit_work_task::run(task *t, callback_frame &frame) noexcept {
+            submit_work_task *self{static_cast<submit_work_task *>(t)};
+            {
+                callback_instance inst{frame};
+                self->callback_(inst);
+            }
+            frame.on_callback_return();
+            node_cache<submit_work_task>::destroy(self);
+        }
+
+        inline void submit_work_task::run_admitted(task *t, callback_frame &frame) noexcept {
+            run(t, frame);
+            frame.pool_->release_admission();
+        }
+    } // namespace details
+
+    class work_item final: private details::cleanup_member {
+    public:
+        template<typename C>
+        [[nodiscard]] static work_item_ptr make(C &&callback,
+                                                callback_environment const *environment = nullptr) {
+            return work_item_ptr{details::node_cache<work_item>::create(
+                std::forward<C>(callback), environment)};
+        }
+
+        template<typename C>
+        [[nodiscard]] static work_item_ptr make(C &&callback,
+                                                optional_callback_parameters const *optional_parameters) {
+            return work_item_ptr{details::node_cache<work_item>::create(
+                std::forward<C>(callback), optional_parameters)};
+        }
+
+        template<typename C>
+        explicit work_item(C &&callback, callback_environment const *environment = nullptr)
+            : callback_(std::forward<C>(callback))
+            , object_{environment ? environment->get_pool() : details::default_pool(),
+                      &work_item::run_callback,
+                      this,
+                      environment ? environment->get_callback_options() : details::callback_options{}} {
+            join_cleanup_group(environment ? environment->get_cleanup_group() : nullptr, &work_item::close_member);
+        }
+
+        template<typename C>
+        work_item(C &&callback, optional_callback_parameters const *optional_parameters)
+            : callback_(std::forward<C>(callback))
+            , object_{callback_environment{optional_parameters}.get_pool(),
+                      &work_item::run_callback,
+                      this,
+                      callback_environment{optional_parameters}.get_callback_options()} {
+        }
+
+        ~work_item() noexcept {
+            if (!leave_cleanup_group()) {
+                join();
+            }
+        }
+
+        void post() noexcept {
+            object_.post();
+        }
+        //
+        // Queues count callbacks, and wakes up to count idle workers
+        //
+        void post(std::uint32_t count) noexcept {
+            object_.post(count);
+        }
+
+        void join() noexcept {
+            object_.join(false);
+        }
+
+        void cancel_and_join() noexcept {
+            object_.join(true);
+        }
+
+    private:
+        static void close_member(details::cleanup_member *member, bool cancel_pending) noexcept {
+            static_cast<work_item *>(member)->object_.join(cancel_pending);
+        }
+
+        static void run_callback(void *context, details::callback_frame &frame) noexcept {
+            work_item *work_item_raw = static_cast<work_item *>(context);
+            work_item_raw->run(frame);
+        }
+
+        void run(details::callback_frame &frame) noexcept {
+            callback_instance inst{frame};
+            callback_(inst);
+        }
+        //
+        // Delegate that should be called when work
+        // item got executed
+        //
+        work_item_callback callback_;
+        //
+        // Posts of the work item are queued to the pool
+        // through this object
+        //
+        details::callback_object object_;
+    };
+
+    class timer_work_item final: private details::cleanup_member {
+    public:
+        template<typename C>
+        [[nodiscard]] static timer_work_item_ptr make(
+            C &&callback, callback_environment const *environment = nullptr) {
+            return timer_work_item_ptr{details::node_cache<timer_work_item>::create(
+                std::forward<C>(callback), environment)};
+        }
+
+        template<typename C>
+        [[nodiscard]] static timer_work_item_ptr make(
+            C &&callback, optional_callback_parameters const *optional_parameters) {
+            return timer_work_item_ptr{details::node_cache<timer_work_item>::create(
+                std::forward<C>(callback), optional_parameters)};
+        }
+
+        template<typename C>
+        explicit timer_work_item(C &&callback, callback_environment const *environment = nullptr)
+            : callback_(std::forward<C>(callback))
+            , object_{environment ? environment->get_pool() : details::default_pool(),
+                      &timer_work_item::run_callback,
+                      this,
+                      environment ? environment->get_callback_options() : details::callback_options{}} {
+            initialize_timer();
+            join_cleanup_group(environment ? environment->get_cleanup_group() : nullptr, &timer_work_item::close_member);
+        }
+
+        template<typename C>
+        timer_work_item(C &&callback, ac::tp::optional_callback_parameters const *optional_parameters)
+            : callback_(std::forward<C>(callback))
+            , object_{callback_environment{optional_parameters}.get_pool(),
+                      &timer_work_item::run_callback,
+                      this,
+                      callback_environment{optional_parameters}.get_callback_options()} {
+            initialize_timer();
+        }
+
+        ~timer_work_item() noexcept {
+            if (!leave_cleanup_group()) {
+                join();
+            }
+        }
+
+        [[nodiscard]] bool is_set() noexcept {
+            return details::timer_queue::instance().is_armed(&timer_);
+        }
+
+        void schedule(duration const &due_time,
+                      miliseconds period = miliseconds{0},
+                      miliseconds window_length = miliseconds{0}) noexcept {
+            details::timer_queue::instance().arm(
+                &timer_,
+                details::steady_clock::now() +
+                    std::chrono::duration_cast<details::steady_clock::duration>(due_time),
+                period,
+                window_length);
+        }
+
+        void schedule(time_point const &due_time,
+                      miliseconds period = miliseconds{0},
+                      miliseconds window_length = miliseconds{0}) noexcept {
+            details::timer_queue::instance().arm(
+                &timer_, details::to_steady_time_point(due_time), period, window_length);
+        }
+
+        void join() noexcept {
+            details::timer_queue::instance().disarm(&timer_);
+            object_.join(false);
+        }
+
+        void cancel_and_join() noexcept {
+            details::timer_queue::instance().disarm(&timer_);
+            object_.join(true);
+        }
+
+    private:
+        void initialize_timer() noexcept {
+            timer_.expired_ = &timer_work_item::on_timer_expired;
+            timer_.context_ = this;
+        }
+
+        static void close_member(details::cleanup_member *member, bool cancel_pending) noexcept {
+            timer_work_item *self{static_cast<timer_work_item *>(member)};
+            details::timer_queue::instance().disarm(&self->timer_);
+            self->object_.join(cancel_pending);
+        }
+
+        static void on_timer_expired(details::timer_entry *timer, details::dispatch_batch &batch) noexcept {
+            static_cast<timer_work_item *>(timer->context_)->object_.post(batch);
+        }
+
+        static void run_callback(void *context, details::callback_frame &frame) noexcept {
+            timer_work_item *work_item = static_cast<timer_work_item *>(context);
+            work_item->run(frame);
+        }
+
+        void run(details::callback_frame &frame) noexcept {
+            callback_instance inst{frame};
+            { callback_(inst); }
+        }
+
+        //
+        // Delegate that should be called when work
+        // item got executed
+        //
+        timer_work_item_callback callback_;
+        //
+        // Expirations of the timer are queued to the pool
+        // through this object
+        //
+        details::callback_object object_;
+        //
+        // Registration with the timer queue
+        //
+        details::timer_entry timer_;
+    };
+
+    class wait_work_item final: private details::cleanup_member {
+    public:
+        template<typename C>
+        [[nodiscard]] static wait_work_item_ptr make(C &&callback,
+                                                     callback_environment const *environment = nullptr) {
+            return wait_work_item_ptr{details::node_cache<wait_work_item>::create(
+                std::forward<C>(callback), environment)};
+        }
+
+        template<typename C>
+        [[nodiscard]] static wait_work_item_ptr make(C &&callback,
+                                                     optional_callback_parameters const *optional_parameters) {
+            return wait_work_item_ptr{details::node_cache<wait_work_item>::create(
+                std::forward<C>(callback), optional_parameters)};
+        }
+
+        template<typename C>
+        explicit wait_work_item(C &&callback, callback_environment const *environment = nullptr)
+            : callback_(std::forward<C>(callback))
+            , object_{environment ? environment->get_pool() : details::default_pool(),
+                      &wait_work_item::run_callback,
+                      this,
+                      environment ? environment->get_callback_options() : details::callback_options{}} {
+            initialize_wait();
+            join_cleanup_group(environment ? environment->get_cleanup_group() : nullptr, &wait_work_item::close_member);
+        }
+
+        template<typename C>
+        wait_work_item(C &&callback, ac::tp::optional_callback_parameters const *optional_parameters)
+            : callback_(std::forward<C>(callback))
+            , object_{callback_environment{optional_parameters}.get_pool(),
+                      &wait_work_item::run_callback,
+                      this,
+                      callback_environment{optional_parameters}.get_callback_options()} {
+            initialize_wait();
+        }
+
+        ~wait_work_item() noexcept {
+            if (!leave_cleanup_group()) {
+                cancel_wait();
+                join();
+            }
+        }
+
+        void schedule_wait(HANDLE handle, duration const &due_time = infinite_duration) noexcept {
+            register_wait(handle, details::to_wait_due_time(due_time));
+        }
+
+        void schedule_wait(HANDLE handle, time_point const &due_time) noexcept {
+            register_wait(handle, details::to_steady_time_point(due_time));
+        }
+
+        void join() noexcept {
+            object_.join(false);
+        }
+
+        void cancel_and_join() noexcept {
+            cancel_wait();
+            object_.join(true);
+        }
+
+    private:
+        void initialize_wait() noexcept {
+            wait_block_.satisfied_ = &wait_work_item::on_wait_satisfied;
+            wait_block_.context_ = this;
+            timer_.expired_ = &wait_work_item::on_wait_timeout;
+            timer_.context_ = this;
+        }
+
+        static void close_member(details::cleanup_member *member, bool cancel_pending) noexcept {
+            wait_work_item *self{static_cast<wait_work_item *>(member)};
+            self->cancel_wait();
+            self->object_.join(cancel_pending);
+        }
+        //
+        // Handle lock arbitrates between signal and timeout. Whoever
+        // unlinks wait block from the handle completes the wait.
+        //
+        void register_wait(HANDLE handle,
+                           std::optional<details::steady_clock::time_point> due_time) noexcept {
+            cancel_wait();
+            if (nullptr == handle) {
+                return;
+            }
+            handle_ = ac::details::handle_object::from_handle(handle);
+            handle_->add_ref();
+            if (handle_->register_wait(&wait_block_)) {
+                complete_wait(WAIT_OBJECT_0);
+            } else if (due_time) {
+                details::timer_queue::instance().arm(
+                    &timer_, due_time.value(), details::steady_clock::duration::zero());
+            }
+        }
+
+        void cancel_wait() noexcept {
+            if (handle_) {
+                (void) handle_->unregister_wait(&wait_block_);
+                details::timer_queue::instance().disarm(&timer_);
+                handle_->release();
+                handle_ = nullptr;
+            }
+        }
+
+        void complete_wait(TP_WAIT_RESULT wait_result) noexcept {
+            wait_result_.store(wait_result, std::memory_order_relaxed);
+            object_.post();
+        }
+
+        static void on_wait_satisfied(ac::details::wait_block *block) noexcept {
+            static_cast<wait_work_item *>(block->context_)->complete_wait(WAIT_OBJECT_0);
+        }
+
+        static void on_wait_timeout(details::timer_entry *timer, details::dispatch_batch &batch) noexcept {
+            wait_work_item *work_item = static_cast<wait_work_item *>(timer->context_);
+            if (work_item->handle_->unregister_wait(&work_item->wait_block_)) {
+                work_item->wait_result_.store(WAIT_TIMEOUT, std::memory_order_relaxed);
+                work_item->object_.post(batch);
+            }
+        }
+
+        static void run_callback(void *context, details::callback_frame &frame) noexcept {
+            wait_work_item *work_item = static_cast<wait_work_item *>(context);
+            work_item->run(frame, work_item->wait_result_.load(std::memory_order_relaxed));
+        }
+
+        void run(details::callback_frame &frame, TP_WAIT_RESULT wait_result) noexcept {
+            callback_instance inst{frame};
+            { callback_(inst, wait_result); }
+        }
+
+        //
+        // Delegate that should be called when work
+        // item got executed
+        //
+        wait_work_item_callback callback_;
+        //
+        // Completed waits are queued to the pool
+        // through this object
+        //
+        details::callback_object object_;
+        //
+        // Registration with the handle, and with the
+        // timer queue if wait has a timeout. Handle is
+        // referenced while wait is registered.
+        //
+        ac::details::handle_object *handle_{nullptr};
+        ac::details::wait_block wait_block_;
+        details::timer_entry timer_;
+        std::atomic<TP_WAIT_RESULT> wait_result_{WAIT_OBJECT_0};
+    };
+
+#endif // _WIN32
+
+    class io_guard final {
+    public:
+        io_guard() = default;
+
+        explicit io_guard(io_handler *handler) noexcept;
+
+        io_guard(io_guard const &) = delete;
+        io_guard &operator=(io_guard const &) = delete;
+
+        io_guard(io_guard &&other) noexcept
+            : handler_(other.handler_) {
+            other.handler_ = nullptr;
+        }
+
+        io_guard &operator=(io_guard &&other) noexcept {
+            if (&other != this) {
+                handler_ = other.handler_;
+                other.handler_ = nullptr;
+            }
+            return *this;
+        }
+
+        ~io_guard() noexcept;
+
+        void failed_start_io() noexcept;
+
+        [[nodiscard]] bool is_armed() const noexcept {
+            return nullptr != handler_;
+        }
+
+        operator bool() const noexcept {
+            return is_armed();
+        }
+
+        void disarm() noexcept {
+            handler_ = nullptr;
+        }
+
+    private:
+        io_handler *handler_{nullptr};
+    };
+
+#ifdef _WIN32
+
+    class io_handler final: private details::cleanup_member {
+        friend class io_guard;
+
+    public:
+        template<typename C>
+        static [[nodiscard]] io_handler_ptr make(HANDLE handle,
+                                                 C &&callback,
+                                                 callback_environment const *environment = nullptr) {
+            return io_handler_ptr{details::node_cache<io_handler>::create(
+                handle, std::forward<C>(callback), environment)};
+        }
+
+        template<typename C>
+        static [[nodiscard]] io_handler_ptr make(HANDLE handle,
+                                                 C &&callback,
+                                                 optional_callback_parameters const *optional_parameters) {
+            return io_handler_ptr{details::node_cache<io_handler>::create(
+                 handle, std::forward<C>(callback), optional_parameters)};
+        }
+
+        template<typename C>
+        explicit io_handler(HANDLE handle, C &&callback, callback_environment const *environment = nullptr)
+            : callback_(std::forward<C>(callback))
+            , io_(nullptr) {
+            join_cleanup_group(environment ? environment->get_cleanup_group() : nullptr);
+            io_ = CreateThreadpoolIo(handle,
+                                     &io_handler::run_callback,
+                                     this,
+                                     environment ? environment->get_handle() : nullptr);
+
+            if (nullptr == io_) {
+                DWORD const error{GetLastError()};
+                (void) leave_cleanup_group();
+                AC_THROW(error, "CreateThreadpoolIo");
+            }
+        }
+
+        template<typename C>
+        io_handler(HANDLE handle, C &&callback, ac::tp::optional_callback_parameters const *optional_parameters)
+            : callback_(std::forward<C>(callback)) {
+            io_ = CreateThreadpoolIo(
+                handle,
+                &io_handler::run_callback,
+                this,
+                optional_parameters ? callback_environment{optional_parameters}.get_handle()
+                                    : nullptr);
+
+            if (nullptr == io_) {
+                AC_THROW(GetLastError(), "CreateThreadpoolIo");
+            }
+        }
+
+        ~io_handler() noexcept {
+            if (!leave_cleanup_group()) {
+                WaitForThreadpoolIoCallbacks(io_, FALSE);
+                CloseThreadpoolIo(io_);
+            }
+            io_ = nullptr;
+        }
+
+        //
+        // Call this method every time before issuing an assync IO.
+        //
+        [[nodiscard]] io_guard start_io() noexcept {
+            return io_guard{this};
+        }
+
+        //
+        // According to MSDN you MUST call this method whenever
+        // IO operation has completed synchronously with an error
+        // code other than indicating that operation is pending.
+        // Whenever possible prefer using io_guard instead of calling
+        // this method directly.
+        //
+        void failed_start_io() noexcept {
+            CancelThreadpoolIo(io_);
+        }
+
+        void join() noexcept {
+            WaitForThreadpoolIoCallbacks(io_, FALSE);
+        }
+
+    private:
+        [[nodiscard]] bool internal_start_io() noexcept {
+            StartThreadpoolIo(io_);
+            return true;
+        }
+
+        static void CALLBACK run_callback(PTP_CALLBACK_INSTANCE instance,
+                                          void *context,
+                                          void *overlapped,
+                                          ULONG result,
+                                          ULONG_PTR bytes_transferred,
+                                          PTP_IO io) noexcept {
+            io_handler *handler = static_cast<io_handler *>(context);
+            AC_CODDING_ERROR_IF_NOT(handler->io_ == io);
+            handler->run(instance, static_cast<OVERLAPPED *>(overlapped), result, bytes_transferred);
+        }
+
+        void run(PTP_CALLBACK_INSTANCE instance,
+                 OVERLAPPED *overlapped,
+                 ULONG result,
                  ULONG_PTR bytes_transferred) noexcept {
             callback_instance inst{instance};
             callback_(inst, overlapped, result, bytes_transferred);
         }
 
-        io_callback callback_;
-        PTP_IO io_{nullptr};
+        io_callback callback_;
+        PTP_IO io_{nullptr};
+    };
+
+#else // _WIN32
+
+    //
+    // Handle is bound to the io_handler the same way a handle is bound
+    // to a completion port. Each completion is queued to the pool as a
+    // separate task, so completions run concurrently. start_io reserves
+    // the task from a node cache, so completing IO never allocates and
+    // cannot fail.
+    //
+    class io_handler final: private details::cleanup_member {
+        friend class io_guard;
+
+    public:
+        template<typename C>
+        [[nodiscard]] static io_handler_ptr make(HANDLE handle,
+                                                 C &&callback,
+                                                 callback_environment const *environment = nullptr) {
+            return io_handler_ptr{details::node_cache<io_handler>::create(
+                handle, std::forward<C>(callback), environment)};
+        }
+
+        template<typename C>
+        [[nodiscard]] static io_handler_ptr make(HANDLE handle,
+                                                 C &&callback,
+                                                 optional_callback_parameters const *optional_parameters) {
+            return io_handler_ptr{details::node_cache<io_handler>::create(
+                 handle, std::forward<C>(callback), optional_parameters)};
+        }
+
+        template<typename C>
+        explicit io_handler(HANDLE handle, C &&callback, callback_environment const *environment = nullptr)
+            : callback_(std::forward<C>(callback))
+            , pool_{environment ? environment->get_pool() : details::default_pool()}
+            , options_{environment ? environment->get_callback_options() : details::callback_options{}} {
+            join_cleanup_group(environment ? environment->get_cleanup_group() : nullptr, &io_handler::close_member);
+            try {
+                bind(handle);
+            } catch (...) {
+                (void) leave_cleanup_group();
+                throw;
+            }
+        }
+
+        template<typename C>
+        io_handler(HANDLE handle, C &&callback, ac::tp::optional_callback_parameters const *optional_parameters)
+            : callback_(std::forward<C>(callback))
+            , pool_{callback_environment{optional_parameters}.get_pool()}
+            , options_{callback_environment{optional_parameters}.get_callback_options()} {
+            bind(handle);
+        }
+
+        ~io_handler() noexcept {
+            if (!leave_cleanup_group()) {
+                close();
+            }
+        }
+
+        //
+        // Call this method every time before issuing an assync IO.
+        // Returns a guard that is not armed if completion could not
+        // be reserved, IO must not be issued in that case.
+        //
+        [[nodiscard]] io_guard start_io() noexcept {
+            return io_guard{this};
+        }
+
+        //
+        // Gives back completion reserved by start_io when IO
+        // failed to start. Prefer io_guard to calling it directly.
+        //
+        void failed_start_io() noexcept {
+            completion *c{take_reserved()};
+            if (c) {
+                details::node_cache<completion>::destroy(c);
+            }
+        }
+
+        void join() noexcept {
+            for (;;) {
+                std::uint32_t pending = pending_.load(std::memory_order_acquire);
+                if (0 == pending) {
+                    break;
+                }
+                (void) wait_on_address::try_wait(details::address_of(pending_), pending);
+            }
+        }
+
+    private:
+        struct completion final: public details::task {
+            io_handler *handler_;
+            OVERLAPPED *overlapped_;
+            ULONG error_;
+            ULONG_PTR bytes_transferred_;
+        };
+
+        void bind(HANDLE handle) {
+            if (nullptr == handle || INVALID_HANDLE_VALUE == handle) {
+                AC_THROW(ERROR_INVALID_HANDLE, "bind_io");
+            }
+            handle_ = ac::details::handle_object::from_handle(handle);
+            if (!handle_->bind_io(&io_handler::on_io_completion, this)) {
+                AC_THROW(ERROR_INVALID_PARAMETER, "bind_io");
+            }
+            handle_->add_ref();
+        }
+
+        [[nodiscard]] bool internal_start_io() noexcept {
+            completion *c{nullptr};
+            try {
+                c = details::node_cache<completion>::create();
+            } catch (...) {
+                return false;
+            }
+            std::lock_guard<std::mutex> lock{reserved_lock_};
+            c->next_ = reserved_;
+            reserved_ = c;
+            return true;
+        }
+
+        [[nodiscard]] completion *take_reserved() noexcept {
+            std::lock_guard<std::mutex> lock{reserved_lock_};
+            completion *c{reserved_};
+            if (c) {
+                reserved_ = static_cast<completion *>(std::exchange(c->next_, nullptr));
+            }
+            return c;
+        }
+        //
+        // Completions that were already queued still run
+        //
+        void close() noexcept {
+            handle_->unbind_io();
+            join();
+            handle_->release();
+            handle_ = nullptr;
+            while (completion *c = take_reserved()) {
+                details::node_cache<completion>::destroy(c);
+            }
+        }
+
+        static void close_member(details::cleanup_member *member, bool) noexcept {
+            static_cast<io_handler *>(member)->close();
+        }
+
+        static void on_io_completion(void *context,
+                                     OVERLAPPED *overlapped,
+                                     ULONG error,
+                                     ULONG_PTR bytes_transferred) noexcept {
+            io_handler *handler = static_cast<io_handler *>(context);
+            completion *c{handler->take_reserved()};
+            //
+            // IO was issued without start_io
+            //
+            AC_CODDING_ERROR_IF(nullptr == c);
+            c->execute_ = &io_handler::run_callback;
+            handler->options_.apply(c);
+            c->handler_ = handler;
+            c->overlapped_ = overlapped;
+            c->error_ = error;
+            c->bytes_transferred_ = bytes_transferred;
+            handler->pending_.fetch_add(1, std::memory_order_relaxed);
+            handler->pool_->submit(c);
+        }
+
+        static void run_callback(details::task *t, details::callback_frame &frame) noexcept {
+            completion *c{static_cast<completion *>(t)};
+            io_handler *handler{c->handler_};
+            OVERLAPPED *overlapped{c->overlapped_};
+            ULONG const error{c->error_};
+            ULONG_PTR const bytes_transferred{c->bytes_transferred_};
+            details::node_cache<completion>::destroy(c);
+            handler->run(frame, overlapped, error, bytes_transferred);
+            frame.on_callback_return();
+            if (1 == handler->pending_.fetch_sub(1, std::memory_order_acq_rel)) {
+                wait_on_address::wake_all(details::address_of(handler->pending_));
+            }
+        }
+
+        void run(details::callback_frame &frame,
+                 OVERLAPPED *overlapped,
+                 ULONG result,
+                 ULONG_PTR bytes_transferred) noexcept {
+            callback_instance inst{frame};
+            callback_(inst, overlapped, result, bytes_transferred);
+        }
+
+        io_callback callback_;
+        details::pool_engine *pool_;
+        details::callback_options options_;
+        ac::details::handle_object *handle_{nullptr};
+        //
+        // Number of completions that are queued or running
+        //
+        std::atomic<std::uint32_t> pending_{0};
+        //
+        // Completion for every IO that was started
+        // and did not complete yet
+        //
+        std::mutex reserved_lock_;
+        completion *reserved_{nullptr};
+    };
+
+#endif // _WIN32
+
+    inline io_guard::io_guard(io_handler *handler) noexcept
+        : handler_(handler) {
+        if (!handler_->internal_start_io()) {
+            handler_ = nullptr;
+        }
+    }
+
+    inline io_guard ::~io_guard() noexcept {
+        if (handler_) {
+            handler_->failed_start_io();
+        }
+    }
+
+    inline void io_guard::failed_start_io() noexcept {
+        handler_->failed_start_io();
+        handler_ = nullptr;
+    }
+
+    //
+    // Some helpers built on top of the pool are only available with
+    // the thread pool engine, and do not compile on Win32:
+    //
+    // - parallel_for, parallel_reduce and parallel_scan (actpparallel.h)
+    //   split a range only when there is an idle worker, and Win32
+    //   thread pool does not report how many workers are idle.
+    // - task_graph (actpgraph.h) embeds engine tasks in its nodes, so
+    //   running a graph does not allocate a work object for every node,
+    //   and helps the pool from wait with run_one.
+    // - future returned by thread_pool::async (actpfuture.h) is itself
+    //   an engine task, and get() helps the pool with run_one.
+    //
+#ifdef _WIN32
+
+    class thread_pool final {
+    public:
+        explicit thread_pool(unsigned long min_threads = ULONG_MAX,
+                             unsigned long max_threads = ULONG_MAX,
+                             PTP_POOL_STACK_INFORMATION stack_information = nullptr)
+            : pool_(nullptr) {
+            pool_ = CreateThreadpool(nullptr);
+
+            if (nullptr == pool_) {
+                AC_THROW(GetLastError(), "CreateThreadPool");
+            }
+
+            if (ULONG_MAX != max_threads) {
+                set_max_thread_count(max_threads);
+            }
+
+            if (ULONG_MAX != min_threads) {
+                set_min_thread_count(min_threads);
+            }
+
+            if (stack_information) {
+                set_stack_information(stack_information);
+            }
+        }
+
+        thread_pool(thread_pool &) = delete;
+        thread_pool &operator=(thread_pool &) = delete;
+
+        ~thread_pool() noexcept {
+            if (pool_) {
+                CloseThreadpool(pool_);
+                pool_ = nullptr;
+            }
+        }
+
+        thread_pool(thread_pool &&other) noexcept
+            : pool_{other.pool_} {
+            other.pool_ = nullptr;
+        }
+
+        thread_pool &operator=(thread_pool &&other) noexcept {
+            if (&other != this) {
+                pool_ = other.pool_;
+                other.pool_ = nullptr;
+            }
+            return *this;
+        }
+
+        [[nodiscard]] PTP_POOL get_handle() noexcept {
+            return pool_;
+        }
+
+        template<typename C>
+        [[nodiscard]] work_item_ptr make_work_item(
+            C &&callback, optional_callback_parameters const *params = nullptr) {
+            callback_environment environment;
+            environment.set_thread_pool(pool_);
+            environment.set_callback_optional_parameters(params);
+            return work_item::make(std::forward<C>(callback), &environment);
+        }
+
+        template<typename C>
+        [[nodiscard]] timer_work_item_ptr make_timer_work_item(
+            C &&callback, optional_callback_parameters const *params = nullptr) {
+            callback_environment environment;
+            environment.set_thread_pool(pool_);
+            environment.set_callback_optional_parameters(params);
+            return timer_work_item::make(std::forward<C>(callback), &environment);
+        }
+
+        template<typename C>
+        [[nodiscard]] wait_work_item_ptr make_wait_work_item(
+            C &&callback, optional_callback_parameters const *params = nullptr) {
+            callback_environment environment;
+            environment.set_thread_pool(pool_);
+            environment.set_callback_optional_parameters(params);
+            return wait_work_item::make(std::forward<C>(callback), &environment);
+        }
+
+        template<typename C>
+        [[nodiscard]] io_handler_ptr make_io_handler(
+            HANDLE handle, C &&callback, optional_callback_parameters const *params = nullptr) {
+            callback_environment environment;
+            environment.set_thread_pool(pool_);
+            environment.set_callback_optional_parameters(params);
+            return io_handler::make(handle, std::forward<C>(callback), &environment);
+        }
+
+        template<typename C>
+        inline void submit_work(C &&callback) {
+            details::submit_work(std::forward<C>(callback), nullptr);
+        }
+
+        template<typename C>
+        void submit_work(C &&callback, optional_callback_parameters const *params) {
+            callback_environment environment;
+            environment.set_thread_pool(pool_);
+            environment.set_callback_optional_parameters(params);
+            details::submit_work(std::forward<C>(callback), environment.get_handle());
+        }
+
+        template<std::ranges::input_range R>
+        void submit_work_batch(R &&range, optional_callback_parameters const *params = nullptr) {
+            callback_environment environment;
+            environment.set_thread_pool(pool_);
+            environment.set_callback_optional_parameters(params);
+            details::submit_work_batch(std::forward<R>(range), environment.get_handle());
+        }
+
+        template<typename C>
+        [[nodiscard]] work_item_ptr post(C &&callback,
+                                         optional_callback_parameters const *params = nullptr) {
+            work_item_ptr work_item{make_work_item(std::forward<C>(callback), params)};
+            work_item->post();
+            return work_item;
+        }
+
+        template<typename C>
+        [[nodiscard]] timer_work_item_ptr schedule(
+            C &&callback,
+            time_point const &due_time,
+            miliseconds period = miliseconds{0},
+            miliseconds window_length = miliseconds{0},
+            optional_callback_parameters const *params = nullptr) {
+            timer_work_item_ptr timer_work_item{
+                make_timer_work_item(std::forward<C>(callback), params)};
+            timer_work_item->schedule(due_time, period, window_length);
+            return timer_work_item;
+        }
+
+        template<typename C>
+        [[nodiscard]] timer_work_item_ptr schedule(
+            C &&callback,
+            duration const &due_time,
+            miliseconds period = miliseconds{0},
+            miliseconds window_length = miliseconds{0},
+            optional_callback_parameters const *params = nullptr) {
+            timer_work_item_ptr timer_work_item{
+                make_timer_work_item(std::forward<C>(callback), params)};
+            timer_work_item->schedule(due_time, period, window_length);
+            return timer_work_item;
+        }
+
+        template<typename C>
+        [[nodiscard]] wait_work_item_ptr schedule_wait(
+            C &&callback,
+            HANDLE handle,
+            duration const &due_time = infinite_duration,
+            optional_callback_parameters const *params = nullptr) {
+            wait_work_item_ptr wait_work_item{
+                make_wait_work_item(std::forward<C>(callback), params)};
+            wait_work_item->schedule_wait(handle, due_time);
+            return wait_work_item;
+        }
+
+        template<typename C>
+        [[nodiscard]] wait_work_item_ptr schedule_wait(C &&callback,
+                                                       HANDLE handle,
+                                                       time_point const &due_time,
+                                                       optional_callback_parameters const *params = nullptr) {
+            wait_work_item_ptr wait_work_item{
+                make_wait_work_item(std::forward<C>(callback), params)};
+            wait_work_item->schedule_wait(handle, due_time);
+            return wait_work_item;
+        }
+
+        void get_stack_information(PTP_POOL_STACK_INFORMATION stack_information) noexcept {
+            QueryThreadpoolStackInformation(pool_, stack_information);
+        }
+
+    private:
+        void set_stack_information(PTP_POOL_STACK_INFORMATION stack_information) noexcept {
+            SetThreadpoolStackInformation(pool_, stack_information);
+        }
+
+        void set_max_thread_count(unsigned long max_threads) noexcept {
+            SetThreadpoolThreadMaximum(pool_, max_threads);
+        }
+
+        void set_min_thread_count(unsigned long min_threads) noexcept {
+            SetThreadpoolThreadMinimum(pool_, min_threads);
+        }
+
+        PTP_POOL pool_{nullptr};
     };
 
-    inline io_guard::io_guard(io_handler *handler) noexcept
-        : handler_(handler) {
-        handler_->internal_start_io();
+    template<typename C>
+    inline void submit_work(C &&callback) {
+        details::submit_work(std::forward<C>(callback), nullptr);
     }
 
-    inline io_guard ::~io_guard() noexcept {
-        if (handler_) {
-            handler_->failed_start_io();
-        }
+    template<typename C>
+    inline void submit_work(C &&callback, optional_callback_parameters const *params) {
+        callback_environment environment{params};
+        details::submit_work(std::forward<C>(callback), params ? environment.get_handle() : nullptr);
     }
 
-    inline void io_guard::failed_start_io() noexcept {
-        handler_->failed_start_io();
-        handler_ = nullptr;
+    template<std::ranges::input_range R>
+    inline void submit_work_batch(R &&range, optional_callback_parameters const *params = nullptr) {
+        callback_environment environment{params};
+        details::submit_work_batch(std::forward<R>(range), params ? environment.get_handle() : nullptr);
     }
 
-    class thread_pool final {
-    public:
-        explicit thread_pool(unsigned long min_threads = ULONG_MAX,
-                             unsigned long max_threads = ULONG_MAX,
-                             PTP_POOL_STACK_INFORMATION stack_information = nullptr)
-            : pool_(nullptr) {
-            pool_ = CreateThreadpool(nullptr);
+#else // _WIN32
 
-            if (nullptr == pool_) {
-                AC_THROW(GetLastError(), "CreateThreadPool");
-            }
+    //
+    // With per_numa_node pool creates a group of workers for every
+    // NUMA node that has CPUs, pins them to CPUs of the node, and gives
+    // every group its own run queues. Topology is read from
+    // /sys/devices/system/node. On a machine with one node, or if
+    // topology is not available, pool has a single group.
+    //
+    enum class worker_groups {
+        single,
+        per_numa_node,
+    };
 
-            if (ULONG_MAX != max_threads) {
-                set_max_thread_count(max_threads);
-            }
+    namespace exec {
+        class scheduler;
+    } // namespace exec
 
-            if (ULONG_MAX != min_threads) {
-                set_min_thread_count(min_threads);
-            }
+    template<typename T>
+    class future;
 
+    class thread_pool final {
+    public:
+        explicit thread_pool(unsigned long min_threads = ULONG_MAX,
+                             unsigned long max_threads = ULONG_MAX,
+                             PTP_POOL_STACK_INFORMATION stack_information = nullptr,
+                             worker_groups groups = worker_groups::single)
+            : pool_{std::make_unique<details::pool_engine>(
+                  min_threads, max_threads, worker_groups::per_numa_node == groups)} {
             if (stack_information) {
                 set_stack_information(stack_information);
             }
@@ -714,35 +2114,21 @@ namespace ac::tp {
         thread_pool(thread_pool &) = delete;
         thread_pool &operator=(thread_pool &) = delete;
 
-        ~thread_pool() noexcept {
-            if (pool_) {
-                CloseThreadpool(pool_);
-                pool_ = nullptr;
-            }
-        }
+        ~thread_pool() noexcept = default;
 
-        thread_pool(thread_pool &&other) noexcept
-            : pool_{other.pool_} {
-            other.pool_ = nullptr;
-        }
+        thread_pool(thread_pool &&other) noexcept = default;
 
-        thread_pool &operator=(thread_pool &&other) noexcept {
-            if (&other != this) {
-                pool_ = other.pool_;
-                other.pool_ = nullptr;
-            }
-            return *this;
-        }
+        thread_pool &operator=(thread_pool &&other) noexcept = default;
 
-        [[nodiscard]] PTP_POOL get_handle() noexcept {
-            return pool_;
+        [[nodiscard]] details::pool_engine *get_handle() noexcept {
+            return pool_.get();
         }
 
         template<typename C>
         [[nodiscard]] work_item_ptr make_work_item(
             C &&callback, optional_callback_parameters const *params = nullptr) {
             callback_environment environment;
-            environment.set_thread_pool(pool_);
+            environment.set_thread_pool(pool_.get());
             environment.set_callback_optional_parameters(params);
             return work_item::make(std::forward<C>(callback), &environment);
         }
@@ -751,7 +2137,7 @@ namespace ac::tp {
         [[nodiscard]] timer_work_item_ptr make_timer_work_item(
             C &&callback, optional_callback_parameters const *params = nullptr) {
             callback_environment environment;
-            environment.set_thread_pool(pool_);
+            environment.set_thread_pool(pool_.get());
             environment.set_callback_optional_parameters(params);
             return timer_work_item::make(std::forward<C>(callback), &environment);
         }
@@ -760,7 +2146,7 @@ namespace ac::tp {
         [[nodiscard]] wait_work_item_ptr make_wait_work_item(
             C &&callback, optional_callback_parameters const *params = nullptr) {
             callback_environment environment;
-            environment.set_thread_pool(pool_);
+            environment.set_thread_pool(pool_.get());
             environment.set_callback_optional_parameters(params);
             return wait_work_item::make(std::forward<C>(callback), &environment);
         }
@@ -769,36 +2155,168 @@ namespace ac::tp {
         [[nodiscard]] io_handler_ptr make_io_handler(
             HANDLE handle, C &&callback, optional_callback_parameters const *params = nullptr) {
             callback_environment environment;
-            environment.set_thread_pool(pool_);
+            environment.set_thread_pool(pool_.get());
             environment.set_callback_optional_parameters(params);
             return io_handler::make(handle, std::forward<C>(callback), &environment);
         }
 
         template<typename C>
         inline void submit_work(C &&callback) {
-            std::unique_ptr<C> cb{new C{std::forward<C>(callback)}};
-            if (TrySubmitThreadpoolCallback(
-                    &details::submit_work_worker<C>, cb.get(), nullptr)) {
-                cb.release();
-            } else {
-                AC_THROW(GetLastError(), "TrySubmitThreadpoolCallback");
-            }
-            return;
+            details::submit_work(pool_.get(), details::callback_options{}, std::forward<C>(callback));
         }
 
         template<typename C>
         void submit_work(C &&callback, optional_callback_parameters const *params) {
-            std::unique_ptr<C> cb{new C{std::forward<C>(callback)}};
             callback_environment environment;
-            environment.set_thread_pool(pool_);
+            environment.set_thread_pool(pool_.get());
             environment.set_callback_optional_parameters(params);
-            if (TrySubmitThreadpoolCallback(
-                    &details::submit_work_worker<C>, cb.get(), environment.get_handle())) {
-                cb.release();
-            } else {
-                AC_THROW(GetLastError(), "TrySubmitThreadpoolCallback");
+            details::submit_work(environment.get_pool(), environment.get_callback_options(), std::forward<C>(callback));
+        }
+        //
+        // Queues all callables from the range with one queue operation,
+        // and wakes up to as many idle workers as there are callables
+        //
+        template<std::ranges::input_range R>
+        void submit_work_batch(R &&range, optional_callback_parameters const *params = nullptr) {
+            callback_environment environment;
+            environment.set_thread_pool(pool_.get());
+            environment.set_callback_optional_parameters(params);
+            details::submit_work_batch(environment.get_pool(), environment.get_callback_options(), std::forward<R>(range));
+        }
+        //
+        // Callbacks with the same key run one at a time in the order
+        // they were submitted, on the worker the key hashes to, so state
+        // of the key stays in the cache of one core. Keys are mapped to
+        // workers with a consistent hash, when pool grows only a share
+        // of keys moves to the new worker.
+        //
+        template<typename K, typename C>
+        void submit_keyed(K const &key, C &&callback) {
+            details::submit_work_task *t{
+                details::node_cache<details::submit_work_task>::create(std::forward<C>(callback))};
+            try {
+                pool_->submit_keyed(static_cast<std::uint64_t>(std::hash<K>{}(key)), t);
+            } catch (...) {
+                details::node_cache<details::submit_work_task>::destroy(t);
+                throw;
+            }
+        }
+        //
+        // Limits how many callbacks queued with try_submit_work and
+        // submit_work_or_wait can wait or run at the same time, so under
+        // overload memory and queue wait stay bounded. Zero, the
+        // default, means unbounded. submit_work is never bounded.
+        //
+        void set_queue_capacity(std::uint32_t capacity) noexcept {
+            pool_->set_queue_capacity(capacity);
+        }
+
+        [[nodiscard]] std::uint32_t get_queue_capacity() const noexcept {
+            return pool_->get_queue_capacity();
+        }
+        //
+        // Number of bounded callbacks that are queued or running
+        //
+        [[nodiscard]] std::uint32_t get_admitted_count() const noexcept {
+            return pool_->get_admitted_count();
+        }
+        //
+        // Returns false and does not touch callback
+        // if pool is at queue capacity
+        //
+        template<typename C>
+        [[nodiscard]] bool try_submit_work(C &&callback, optional_callback_parameters const *params = nullptr) {
+            callback_environment environment;
+            environment.set_thread_pool(pool_.get());
+            environment.set_callback_optional_parameters(params);
+            if (!environment.get_pool()->try_admit()) {
+                return false;
             }
-            return;
+            details::submit_admitted_work(
+                environment.get_pool(), environment.get_callback_options(), std::forward<C>(callback));
+            return true;
+        }
+        //
+        // Waits for queue capacity, and then queues callback. Worker
+        // of this pool runs queued work while it waits.
+        //
+        template<typename C>
+        void submit_work_or_wait(C &&callback, optional_callback_parameters const *params = nullptr) {
+            callback_environment environment;
+            environment.set_thread_pool(pool_.get());
+            environment.set_callback_optional_parameters(params);
+            environment.get_pool()->admit_or_wait();
+            details::submit_admitted_work(
+                environment.get_pool(), environment.get_callback_options(), std::forward<C>(callback));
+        }
+        //
+        // Queues resume once pool is below queue capacity, or right
+        // away if it is below capacity now. Resume does not take a slot,
+        // producer that finds pool full leaves resume instead of
+        // blocking, and calls try_submit_work again from it.
+        //
+        template<typename C>
+        void submit_on_capacity(C &&resume, optional_callback_parameters const *params = nullptr) {
+            callback_environment environment;
+            environment.set_thread_pool(pool_.get());
+            environment.set_callback_optional_parameters(params);
+            details::submit_work_task *t{
+                details::node_cache<details::submit_work_task>::create(std::forward<C>(resume))};
+            environment.get_callback_options().apply(t);
+            environment.get_pool()->submit_on_capacity(t);
+        }
+
+        //
+        // Runs callback on this pool, and returns future of its
+        // result, defined in actpfuture.h
+        //
+        template<typename C>
+        [[nodiscard]] future<std::invoke_result_t<std::decay_t<C> &>> async(
+            C &&callback, optional_callback_parameters const *params = nullptr);
+        //
+        // Sender/receiver scheduler of this pool, defined in actpexec.h
+        //
+        [[nodiscard]] exec::scheduler get_scheduler(optional_callback_parameters const *params = nullptr) noexcept;
+        //
+        // co_await pool.schedule() resumes the coroutine on a worker
+        // of this pool
+        //
+        [[nodiscard]] details::schedule_awaiter schedule(
+            optional_callback_parameters const *params = nullptr) noexcept {
+            callback_environment environment;
+            environment.set_thread_pool(pool_.get());
+            environment.set_callback_optional_parameters(params);
+            return details::schedule_awaiter{environment.get_pool(), environment.get_callback_options()};
+        }
+        //
+        // co_await pool.sleep_for(d) resumes the coroutine on a worker
+        // of this pool after d has passed
+        //
+        [[nodiscard]] details::sleep_awaiter sleep_for(
+            duration const &due_time, optional_callback_parameters const *params = nullptr) noexcept {
+            callback_environment environment;
+            environment.set_thread_pool(pool_.get());
+            environment.set_callback_optional_parameters(params);
+            return details::sleep_awaiter{
+                environment.get_pool(),
+                details::steady_clock::now() +
+                    std::chrono::duration_cast<details::steady_clock::duration>(due_time),
+                environment.get_callback_options()};
+        }
+        //
+        // co_await pool.wait_for(handle, timeout) resumes the coroutine on
+        // a worker of this pool, and returns WAIT_OBJECT_0 or WAIT_TIMEOUT
+        //
+        [[nodiscard]] details::wait_awaiter wait_for(HANDLE handle,
+                                                     duration const &timeout = infinite_duration,
+                                                     optional_callback_parameters const *params = nullptr) noexcept {
+            callback_environment environment;
+            environment.set_thread_pool(pool_.get());
+            environment.set_callback_optional_parameters(params);
+            return details::wait_awaiter{environment.get_pool(),
+                                         handle,
+                                         details::to_wait_due_time(timeout),
+                                         environment.get_callback_options()};
         }
 
         template<typename C>
@@ -857,53 +2375,208 @@ namespace ac::tp {
             wait_work_item->schedule_wait(handle, due_time);
             return wait_work_item;
         }
-
+        //
+        // Workers use default std::thread stack
+        //
         void get_stack_information(PTP_POOL_STACK_INFORMATION stack_information) noexcept {
-            QueryThreadpoolStackInformation(pool_, stack_information);
+            stack_information->StackReserve = stack_information_.StackReserve;
+            stack_information->StackCommit = stack_information_.StackCommit;
         }
 
-    private:
-        void set_stack_information(PTP_POOL_STACK_INFORMATION stack_information) noexcept {
-            SetThreadpoolStackInformation(pool_, stack_information);
+        [[nodiscard]] unsigned long get_thread_count() const noexcept {
+            return pool_->get_thread_count();
         }
 
-        void set_max_thread_count(unsigned long max_threads) noexcept {
-            SetThreadpoolThreadMaximum(pool_, max_threads);
+        [[nodiscard]] size_t get_worker_group_count() const noexcept {
+            return pool_->get_group_count();
+        }
+        //
+        // Lets a hill climbing controller pick the number of workers
+        // between min and max thread count, based on callbacks completed
+        // per sample interval. Decisions are available through
+        // get_concurrency_adjustments.
+        //
+        [[nodiscard]] bool enable_adaptive_concurrency(
+            std::chrono::milliseconds sample_interval = std::chrono::milliseconds{100}) noexcept {
+            return pool_->enable_adaptive_concurrency(sample_interval);
         }
 
-        void set_min_thread_count(unsigned long min_threads) noexcept {
-            SetThreadpoolThreadMinimum(pool_, min_threads);
+        void disable_adaptive_concurrency() noexcept {
+            pool_->disable_adaptive_concurrency();
+        }
+        //
+        // Worker count controller is aiming for, or
+        // zero if controller is not enabled
+        //
+        [[nodiscard]] unsigned long get_target_thread_count() const noexcept {
+            return pool_->get_adaptive_target();
         }
 
-        PTP_POOL pool_{nullptr};
+        [[nodiscard]] std::vector<concurrency_adjustment> get_concurrency_adjustments() const {
+            return pool_->get_concurrency_adjustments();
+        }
+        //
+        // Number of workers that were started because
+        // a callback entered a blocking region
+        //
+        [[nodiscard]] std::uint64_t get_compensation_count() const noexcept {
+            return pool_->get_compensation_count();
+        }
+        //
+        // Keyed work is taken from the worker it hashes to by other
+        // workers only when more than backlog callbacks of the lane wait
+        //
+        void set_keyed_backlog(std::uint32_t backlog) noexcept {
+            pool_->set_keyed_backlog(backlog);
+        }
+
+        [[nodiscard]] std::uint32_t get_keyed_backlog() const noexcept {
+            return pool_->get_keyed_backlog();
+        }
+        //
+        // Time callbacks of the given priority waited in the queues
+        // before they started running. Subtract an earlier snapshot
+        // to get statistics for an interval. Collected only while
+        // recording is enabled, it is off by default, so callbacks
+        // do not pay for clock reads nobody looks at.
+        //
+        void enable_queue_wait_histogram(bool enable = true) noexcept {
+            pool_->set_record_queue_wait(enable);
+        }
+
+        [[nodiscard]] bool is_queue_wait_histogram_enabled() const noexcept {
+            return pool_->get_record_queue_wait();
+        }
+
+        [[nodiscard]] queue_wait_histogram get_queue_wait_histogram(TP_CALLBACK_PRIORITY priority) const noexcept {
+            return pool_->get_queue_wait_histogram(priority);
+        }
+
+    private:
+        void set_stack_information(PTP_POOL_STACK_INFORMATION stack_information) noexcept {
+            stack_information_ = *stack_information;
+        }
+
+        std::unique_ptr<details::pool_engine> pool_;
+        TP_POOL_STACK_INFORMATION stack_information_{};
     };
 
     template<typename C>
-    inline [[nodiscard]] work_item_ptr make_work_item(
+    inline void submit_work(C &&callback) {
+        details::submit_work(details::default_pool(), details::callback_options{}, std::forward<C>(callback));
+    }
+
+    template<typename C>
+    inline void submit_work(C &&callback, optional_callback_parameters const *params) {
+        callback_environment environment{params};
+        details::submit_work(environment.get_pool(), environment.get_callback_options(), std::forward<C>(callback));
+    }
+
+    template<std::ranges::input_range R>
+    inline void submit_work_batch(R &&range, optional_callback_parameters const *params = nullptr) {
+        callback_environment environment{params};
+        details::submit_work_batch(environment.get_pool(), environment.get_callback_options(), std::forward<R>(range));
+    }
+
+    namespace details {
+        //
+        // Awaiting outside of a thread pool resumes on the default pool,
+        // and on a worker it resumes on the pool of that worker
+        //
+        [[nodiscard]] inline pool_engine *current_or_default_pool() {
+            pool_engine *pool{pool_engine::current()};
+            return pool ? pool : default_pool();
+        }
+    } // namespace details
+
+    [[nodiscard]] inline details::schedule_awaiter schedule() {
+        return details::schedule_awaiter{details::current_or_default_pool()};
+    }
+
+    [[nodiscard]] inline details::sleep_awaiter sleep_for(duration const &due_time) {
+        return details::sleep_awaiter{
+            details::current_or_default_pool(),
+            details::steady_clock::now() + std::chrono::duration_cast<details::steady_clock::duration>(due_time)};
+    }
+
+    [[nodiscard]] inline details::wait_awaiter wait_for(HANDLE handle, duration const &timeout = infinite_duration) {
+        return details::wait_awaiter{
+            details::current_or_default_pool(), handle, details::to_wait_due_time(timeout)};
+    }
+
+#endif // _WIN32
+
+    template<typename C>
+    inline work_item_ptr cleanup_group::make_work_item(thread_pool &pool,
+                                                       C &&callback,
+                                                       optional_callback_parameters const *params) {
+        callback_environment environment;
+        environment.set_thread_pool(pool.get_handle());
+        environment.set_callback_optional_parameters(params);
+        environment.set_cleanup_group(this);
+        return work_item::make(std::forward<C>(callback), &environment);
+    }
+
+    template<typename C>
+    inline timer_work_item_ptr cleanup_group::make_timer_work_item(thread_pool &pool,
+                                                                   C &&callback,
+                                                                   optional_callback_parameters const *params) {
+        callback_environment environment;
+        environment.set_thread_pool(pool.get_handle());
+        environment.set_callback_optional_parameters(params);
+        environment.set_cleanup_group(this);
+        return timer_work_item::make(std::forward<C>(callback), &environment);
+    }
+
+    template<typename C>
+    inline wait_work_item_ptr cleanup_group::make_wait_work_item(thread_pool &pool,
+                                                                 C &&callback,
+                                                                 optional_callback_parameters const *params) {
+        callback_environment environment;
+        environment.set_thread_pool(pool.get_handle());
+        environment.set_callback_optional_parameters(params);
+        environment.set_cleanup_group(this);
+        return wait_work_item::make(std::forward<C>(callback), &environment);
+    }
+
+    template<typename C>
+    inline io_handler_ptr cleanup_group::make_io_handler(thread_pool &pool,
+                                                         HANDLE handle,
+                                                         C &&callback,
+                                                         optional_callback_parameters const *params) {
+        callback_environment environment;
+        environment.set_thread_pool(pool.get_handle());
+        environment.set_callback_optional_parameters(params);
+        environment.set_cleanup_group(this);
+        return io_handler::make(handle, std::forward<C>(callback), &environment);
+    }
+
+    template<typename C>
+    [[nodiscard]] inline work_item_ptr make_work_item(
         C &&callback, optional_callback_parameters const *params = nullptr) {
         return work_item::make(std::forward<C>(callback), params);
     }
 
     template<typename C>
-    inline [[nodiscard]] timer_work_item_ptr make_timer_work_item(
+    [[nodiscard]] inline timer_work_item_ptr make_timer_work_item(
         C &&callback, optional_callback_parameters const *params = nullptr) {
         return timer_work_item::make(std::forward<C>(callback), params);
     }
 
     template<typename C>
-    inline [[nodiscard]] wait_work_item_ptr make_wait_work_item(
+    [[nodiscard]] inline wait_work_item_ptr make_wait_work_item(
         C &&callback, optional_callback_parameters const *params = nullptr) {
         return wait_work_item::make(std::forward<C>(callback), params);
     }
 
     template<typename C>
-    inline [[nodiscard]] io_handler_ptr make_io_handler(
+    [[nodiscard]] inline io_handler_ptr make_io_handler(
         HANDLE handle, C &&callback, optional_callback_parameters const *params = nullptr) {
         return io_handler::make(handle, std::forward<C>(callback), params);
     }
 
     template<typename C>
-    inline [[nodiscard]] work_item_ptr post(C &&callback,
+    [[nodiscard]] inline work_item_ptr post(C &&callback,
                                             optional_callback_parameters const *params = nullptr) {
         work_item_ptr work_item{work_item::make(std::forward<C>(callback), params)};
         work_item->post();
@@ -911,32 +2584,7 @@ namespace ac::tp {
     }
 
     template<typename C>
-    inline void submit_work(C &&callback) {
-        std::unique_ptr<C> cb{new C{std::forward<C>(callback)}};
-        if (TrySubmitThreadpoolCallback(&details::submit_work_worker<C>, cb.get(), nullptr)) {
-            cb.release();
-        } else {
-            AC_THROW(GetLastError(), "TrySubmitThreadpoolCallback");
-        }
-        return;
-    }
-
-    template<typename C>
-    inline void submit_work(C &&callback, optional_callback_parameters const *params) {
-        std::unique_ptr<C> cb{new C{std::forward<C>(callback)}};
-        if (TrySubmitThreadpoolCallback(
-                &details::submit_work_worker<C>,
-                cb.get(),
-                params ? callback_environment{params}.get_handle() : nullptr)) {
-            cb.release();
-        } else {
-            AC_THROW(GetLastError(), "TrySubmitThreadpoolCallback");
-        }
-        return;
-    }
-
-    template<typename C>
-    inline [[nodiscard]] timer_work_item_ptr schedule(
+    [[nodiscard]] inline timer_work_item_ptr schedule(
         C &&callback,
         time_point const &due_time,
         miliseconds period = miliseconds{0},
@@ -949,7 +2597,7 @@ namespace ac::tp {
     }
 
     template<typename C>
-    inline [[nodiscard]] timer_work_item_ptr schedule(
+    [[nodiscard]] inline timer_work_item_ptr schedule(
         C &&callback,
         duration const &due_time,
         miliseconds period = miliseconds{0},
@@ -962,7 +2610,7 @@ namespace ac::tp {
     }
 
     template<typename C>
-    inline [[nodiscard]] wait_work_item_ptr schedule_wait(
+    [[nodiscard]] inline wait_work_item_ptr schedule_wait(
         C &&callback,
         HANDLE handle,
         duration const &due_time = infinite_duration,
@@ -974,7 +2622,7 @@ namespace ac::tp {
     }
 
     template<typename C>
-    inline [[nodiscard]] wait_work_item_ptr schedule_wait(
+    [[nodiscard]] inline wait_work_item_ptr schedule_wait(
         C &&callback,
         HANDLE handle,
         time_point const &due_time,
@@ -0,0 +1,495 @@
+#ifndef _AC_HELPERS_WIN32_LIBRARY_THREAD_POOL_CORO_HEADER_
+#define _AC_HELPERS_WIN32_LIBRARY_THREAD_POOL_CORO_HEADER_
+
+#pragma once
+
+//
+// Coroutine support for ac::tp. A request handler can be written as
+// one coroutine instead of a chain of work items:
+//
+//   ac::tp::task<DWORD> handle(ac::tp::thread_pool &pool, ac::tp::async_io &io) {
+//       co_await pool.schedule();
+//       ac::tp::io_result r{co_await io.read(buffer, size, offset)};
+//       co_await pool.sleep_for(10ms);
+//       co_return r.error;
+//   }
+//
+// Awaiters are stored in the coroutine frame and link themselves into
+// pool queues, timer queue, and handle wait lists, so the coroutine
+// frame is the only allocation. Coroutine resumes on the worker that
+// completed the operation, and a finished task resumes its awaiter
+// inline on the same worker.
+//
+// Only available with the thread pool engine. Win32 thread pool would
+// need a work, timer or wait object created for every await.
+//
+
+#include "actp.h"
+#include "acfileobject.h"
+
+#include <coroutine>
+#include <exception>
+#include <optional>
+#include <utility>
+
+#ifndef _WIN32
+
+namespace ac::tp {
+
+    template<typename T = void>
+    class task;
+
+    namespace details {
+
+        class task_promise_base {
+        public:
+            //
+            // Symmetric transfer to the awaiting coroutine, so it runs
+            // on this thread without growing the stack
+            //
+            struct final_awaiter {
+                [[nodiscard]] bool await_ready() const noexcept {
+                    return false;
+                }
+
+                template<typename P>
+                [[nodiscard]] std::coroutine_handle<> await_suspend(std::coroutine_handle<P> finished) noexcept {
+                    return finished.promise().continuation_;
+                }
+
+                void await_resume() const noexcept {
+                }
+            };
+
+            [[nodiscard]] std::suspend_always initial_suspend() const noexcept {
+                return {};
+            }
+
+            [[nodiscard]] final_awaiter final_suspend() const noexcept {
+                return {};
+            }
+
+            void unhandled_exception() noexcept {
+                exception_ = std::current_exception();
+            }
+
+            void set_continuation(std::coroutine_handle<> continuation) noexcept {
+                continuation_ = continuation;
+            }
+
+        protected:
+            void rethrow_if_failed() const {
+                if (exception_) {
+                    std::rethrow_exception(exception_);
+                }
+            }
+
+        private:
+            std::coroutine_handle<> continuation_{std::noop_coroutine()};
+            std::exception_ptr exception_;
+        };
+
+        template<typename T>
+        class task_promise final: public task_promise_base {
+        public:
+            [[nodiscard]] ac::tp::task<T> get_return_object() noexcept;
+
+            template<typename U>
+            void return_value(U &&value) noexcept(std::is_nothrow_constructible_v<T, U>) {
+                value_.emplace(std::forward<U>(value));
+            }
+
+            [[nodiscard]] T take_result() {
+                rethrow_if_failed();
+                return std::move(value_.value());
+            }
+
+        private:
+            std::optional<T> value_;
+        };
+
+        template<>
+        class task_promise<void> final: public task_promise_base {
+        public:
+            [[nodiscard]] ac::tp::task<void> get_return_object() noexcept;
+
+            void return_void() const noexcept {
+            }
+
+            void take_result() const {
+                rethrow_if_failed();
+            }
+        };
+
+        //
+        // Coroutine that starts right away and frees its frame when
+        // it finishes. Same as a callback, it must not throw.
+        //
+        struct detached_task {
+            struct promise_type {
+                [[nodiscard]] detached_task get_return_object() const noexcept {
+                    return {};
+                }
+
+                [[nodiscard]] std::suspend_never initial_suspend() const noexcept {
+                    return {};
+                }
+
+                [[nodiscard]] std::suspend_never final_suspend() const noexcept {
+                    return {};
+                }
+
+                void return_void() const noexcept {
+                }
+
+                void unhandled_exception() const noexcept {
+                    AC_CRASH_APPLICATION();
+                }
+            };
+        };
+
+        template<typename T>
+        detached_task signal_when_done(ac::tp::task<T> &t, std::atomic<std::uint32_t> &done);
+
+    } // namespace details
+
+    //
+    // Lazily started coroutine. It starts when it is awaited, and
+    // when it finishes it resumes the awaiting coroutine inline.
+    // Exception thrown by the coroutine is rethrown to the awaiter.
+    //
+    template<typename T>
+    class [[nodiscard]] task final {
+    public:
+        static_assert(!std::is_reference_v<T>, "task does not support references");
+
+        using promise_type = details::task_promise<T>;
+
+        task() noexcept = default;
+
+        explicit task(std::coroutine_handle<promise_type> coroutine) noexcept
+            : coroutine_{coroutine} {
+        }
+
+        task(task const &) = delete;
+        task &operator=(task const &) = delete;
+
+        task(task &&other) noexcept
+            : coroutine_{std::exchange(other.coroutine_, nullptr)} {
+        }
+
+        task &operator=(task &&other) noexcept {
+            if (&other != this) {
+                destroy();
+                coroutine_ = std::exchange(other.coroutine_, nullptr);
+            }
+            return *this;
+        }
+
+        ~task() noexcept {
+            destroy();
+        }
+
+        [[nodiscard]] bool is_valid() const noexcept {
+            return static_cast<bool>(coroutine_);
+        }
+
+        [[nodiscard]] bool is_ready() const noexcept {
+            return coroutine_ && coroutine_.done();
+        }
+
+        [[nodiscard]] auto operator co_await() && noexcept {
+            struct awaiter {
+                [[nodiscard]] bool await_ready() const noexcept {
+                    return coroutine_.done();
+                }
+
+                [[nodiscard]] std::coroutine_handle<> await_suspend(std::coroutine_handle<> continuation) noexcept {
+                    coroutine_.promise().set_continuation(continuation);
+                    return coroutine_;
+                }
+
+                T await_resume() {
+                    return coroutine_.promise().take_result();
+                }
+
+                std::coroutine_handle<promise_type> coroutine_;
+            };
+            AC_CODDING_ERROR_IF_NOT(coroutine_);
+            return awaiter{coroutine_};
+        }
+
+    private:
+        template<typename U>
+        friend U sync_wait(task<U> t);
+
+        template<typename U>
+        friend details::detached_task details::signal_when_done(task<U> &t, std::atomic<std::uint32_t> &done);
+
+        //
+        // Runs task to completion without taking the result
+        //
+        [[nodiscard]] auto when_ready() noexcept {
+            struct awaiter {
+                [[nodiscard]] bool await_ready() const noexcept {
+                    return coroutine_.done();
+                }
+
+                [[nodiscard]] std::coroutine_handle<> await_suspend(std::coroutine_handle<> continuation) noexcept {
+                    coroutine_.promise().set_continuation(continuation);
+                    return coroutine_;
+                }
+
+                void await_resume() const noexcept {
+                }
+
+                std::coroutine_handle<promise_type> coroutine_;
+            };
+            return awaiter{coroutine_};
+        }
+
+        T take_result() {
+            return coroutine_.promise().take_result();
+        }
+
+        void destroy() noexcept {
+            if (coroutine_) {
+                coroutine_.destroy();
+                coroutine_ = nullptr;
+            }
+        }
+
+        std::coroutine_handle<promise_type> coroutine_;
+    };
+
+    namespace details {
+
+        template<typename T>
+        inline ac::tp::task<T> task_promise<T>::get_return_object() noexcept {
+            return ac::tp::task<T>{std::coroutine_handle<task_promise<T>>::from_promise(*this)};
+        }
+
+        inline ac::tp::task<void> task_promise<void>::get_return_object() noexcept {
+            return ac::tp::task<void>{std::coroutine_handle<task_promise<void>>::from_promise(*this)};
+        }
+
+        inline detached_task run_detached(ac::tp::task<void> t) {
+            co_await std::move(t);
+        }
+        //
+        // Wakes sync_wait up once task is done. Waking a futex on the
+        // address of a counter that sync_wait already destroyed is benign.
+        //
+        template<typename T>
+        inline detached_task signal_when_done(ac::tp::task<T> &t, std::atomic<std::uint32_t> &done) {
+            co_await t.when_ready();
+            done.store(1, std::memory_order_release);
+            wait_on_address::wake_all(address_of(done));
+        }
+
+    } // namespace details
+
+    //
+    // Starts the task, and lets it run to completion on its own.
+    // Same as a callback, task must not throw.
+    //
+    inline void spawn(task<void> t) {
+        (void) details::run_detached(std::move(t));
+    }
+
+    //
+    // Runs the task, and blocks calling thread until it is done.
+    // On a pool worker the wait is a blocking region, so the pool
+    // can start another worker to run the task.
+    //
+    template<typename T>
+    inline T sync_wait(task<T> t) {
+        std::atomic<std::uint32_t> done{0};
+        (void) details::signal_when_done(t, done);
+        {
+            ac::details::blocking_region region;
+            while (0 == done.load(std::memory_order_acquire)) {
+                (void) wait_on_address::try_wait(details::address_of(done), std::uint32_t{0});
+            }
+        }
+        return t.take_result();
+    }
+
+    struct io_result {
+        ULONG error{ERROR_SUCCESS};
+        ULONG_PTR bytes_transferred{0};
+    };
+
+    namespace details {
+        //
+        // Read or write issued through async_io. OVERLAPPED of the
+        // operation is the operation itself, so io handler completion
+        // finds it, and calls completed_. Awaiters and senders embed
+        // the operation, so issuing IO does not allocate.
+        //
+        class io_operation: public OVERLAPPED {
+        public:
+            enum class operation_t {
+                read,
+                write,
+            };
+
+            using completed_t = void (*)(io_operation *) noexcept;
+
+            io_operation(io_handler *handler,
+                         file_object *file,
+                         operation_t operation,
+                         void const *buffer,
+                         DWORD size,
+                         long long offset,
+                         completed_t completed) noexcept
+                : OVERLAPPED{}
+                , handler_{handler}
+                , file_{file}
+                , operation_{operation}
+                , buffer_{buffer}
+                , size_{size}
+                , completed_{completed} {
+                Offset = get_low_dword(static_cast<ULONGLONG>(offset));
+                OffsetHigh = get_high_dword(static_cast<ULONGLONG>(offset));
+            }
+
+            io_operation(io_operation const &) = delete;
+            io_operation &operator=(io_operation const &) = delete;
+            //
+            // Returns false if operation completed without a completion,
+            // that is reading at the end of file. Once IO is issued
+            // completed_ might be already running on a worker, so nothing
+            // in the operation can be touched after that.
+            //
+            [[nodiscard]] bool issue() {
+                file_object *file{file_};
+                io_guard guard{handler_->start_io()};
+                if (!guard) {
+                    AC_THROW(ERROR_NOT_ENOUGH_MEMORY, "start_io");
+                }
+                bool is_eof{false};
+                if (operation_t::read == operation_) {
+                    (void) file->read(const_cast<void *>(buffer_), size_, nullptr, &is_eof, this);
+                } else {
+                    (void) file->write(buffer_, size_, this);
+                }
+                if (is_eof) {
+                    result_ = io_result{ERROR_HANDLE_EOF, 0};
+                    return false;
+                }
+                guard.disarm();
+                return true;
+            }
+
+            [[nodiscard]] io_result const &get_result() const noexcept {
+                return result_;
+            }
+
+            static void on_io_completion(callback_instance &,
+                                         OVERLAPPED *overlapped,
+                                         ULONG error,
+                                         ULONG_PTR bytes_transferred) noexcept {
+                io_operation *self = static_cast<io_operation *>(overlapped);
+                self->result_ = io_result{error, bytes_transferred};
+                self->completed_(self);
+            }
+
+        private:
+            io_handler *handler_;
+            file_object *file_;
+            operation_t operation_;
+            void const *buffer_;
+            DWORD size_;
+            completed_t completed_;
+            io_result result_;
+        };
+
+        class io_awaiter final: public io_operation {
+        public:
+            io_awaiter(io_handler *handler,
+                       file_object *file,
+                       operation_t operation,
+                       void const *buffer,
+                       DWORD size,
+                       long long offset) noexcept
+                : io_operation{handler, file, operation, buffer, size, offset, &io_awaiter::resume} {
+            }
+
+            [[nodiscard]] bool await_ready() const noexcept {
+                return false;
+            }
+
+            [[nodiscard]] bool await_suspend(std::coroutine_handle<> continuation) {
+                continuation_ = continuation;
+                return issue();
+            }
+
+            [[nodiscard]] io_result await_resume() const noexcept {
+                return get_result();
+            }
+
+        private:
+            static void resume(io_operation *operation) noexcept {
+                static_cast<io_awaiter *>(operation)->continuation_.resume();
+            }
+
+            std::coroutine_handle<> continuation_;
+        };
+    } // namespace details
+
+    //
+    // File bound to an io_handler that resumes coroutines awaiting
+    // read and write. Same as io_handler, it must not be destroyed by
+    // a coroutine it resumed, because destructor waits for completions.
+    //
+    class async_io final {
+    public:
+        explicit async_io(file_object &file, callback_environment const *environment = nullptr)
+            : file_{&file}
+            , handler_{io_handler::make(file.get_handle(), &details::io_operation::on_io_completion, environment)} {
+        }
+
+        async_io(file_object &file, optional_callback_parameters const *optional_parameters)
+            : file_{&file}
+            , handler_{io_handler::make(
+                  file.get_handle(), &details::io_operation::on_io_completion, optional_parameters)} {
+        }
+
+        async_io(async_io const &) = delete;
+        async_io &operator=(async_io const &) = delete;
+
+        ~async_io() noexcept = default;
+
+        [[nodiscard]] details::io_awaiter read(void *buffer, DWORD size, long long offset) noexcept {
+            return details::io_awaiter{
+                handler_.get(), file_, details::io_operation::operation_t::read, buffer, size, offset};
+        }
+
+        [[nodiscard]] details::io_awaiter write(void const *buffer, DWORD size, long long offset) noexcept {
+            return details::io_awaiter{
+                handler_.get(), file_, details::io_operation::operation_t::write, buffer, size, offset};
+        }
+
+        void join() noexcept {
+            handler_->join();
+        }
+
+        [[nodiscard]] io_handler *get_io_handler() const noexcept {
+            return handler_.get();
+        }
+
+        [[nodiscard]] file_object *get_file() const noexcept {
+            return file_;
+        }
+
+    private:
+        file_object *file_;
+        io_handler_ptr handler_;
+    };
+
+} // namespace ac::tp
+
+#endif // _WIN32
+
+#endif //_AC_HELPERS_WIN32_LIBRARY_THREAD_POOL_CORO_HEADER_
@@ -0,0 +1,2809 @@
+#ifndef _AC_HELPERS_WIN32_LIBRARY_THREAD_POOL_ENGINE_HEADER_
+#define _AC_HELPERS_WIN32_LIBRARY_THREAD_POOL_ENGINE_HEADER_
+
+#pragma once
+
+//
+// Execution engine behind ac::tp classes on platforms that do not
+// have the Win32 thread pool. Nothing in this header is meant to be
+// used directly, use classes from actp.h instead.
+//
+
+#include "accommon.h"
+#include "acwaitonaddress.h"
+#include "acnodecache.h"
+
+#include <algorithm>
+#include <bit>
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <condition_variable>
+#include <coroutine>
+#include <optional>
+
+#include <pthread.h>
+#include <sched.h>
+
+namespace ac::tp::details {
+
+    class pool_engine;
+    struct callback_frame;
+
+    [[nodiscard]] inline std::uint32_t const volatile *address_of(
+        std::atomic<std::uint32_t> const &value) noexcept {
+        return reinterpret_cast<std::uint32_t const volatile *>(&value);
+    }
+
+    //
+    // Nanoseconds on the steady clock, used to time how long
+    // tasks wait in the queues
+    //
+    [[nodiscard]] inline std::int64_t steady_now_ns() noexcept {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   std::chrono::steady_clock::now().time_since_epoch())
+            .count();
+    }
+
+    //
+    // Task is not bound to a NUMA node, and runs on the node
+    // of the submitter
+    //
+    inline constexpr std::uint32_t any_numa_node{UINT32_MAX};
+
+    //
+    // Unit of work queued to a pool. Link is intrusive so posting
+    // a callback object does not allocate. Pool stamps the task
+    // with the time it was queued.
+    //
+    struct task {
+        task *next_{nullptr};
+        void (*execute_)(task *, callback_frame &) noexcept {nullptr};
+        std::int64_t queued_ns_{0};
+        TP_CALLBACK_PRIORITY priority_{TP_CALLBACK_PRIORITY_NORMAL};
+        std::uint32_t numa_node_{any_numa_node};
+    };
+
+    //
+    // Parameters callback environment passes down to the
+    // tasks of a callback object
+    //
+    struct callback_options {
+        TP_CALLBACK_PRIORITY priority_{TP_CALLBACK_PRIORITY_NORMAL};
+        std::uint32_t numa_node_{any_numa_node};
+
+        void apply(task *t) const noexcept {
+            t->priority_ = priority_;
+            t->numa_node_ = numa_node_;
+        }
+    };
+
+    struct numa_node {
+        std::uint32_t id_{0};
+        std::vector<int> cpus_;
+    };
+
+    //
+    // Parses lists like "0-3,8-11" used by sysfs
+    //
+    [[nodiscard]] inline std::vector<int> parse_cpu_list(std::string const &list) {
+        std::vector<int> cpus;
+        char const *cur = list.c_str();
+        while (*cur) {
+            char *end{nullptr};
+            long const first = std::strtol(cur, &end, 10);
+            if (end == cur) {
+                break;
+            }
+            long last = first;
+            cur = end;
+            if ('-' == *cur) {
+                last = std::strtol(cur + 1, &end, 10);
+                cur = end;
+            }
+            for (long cpu = first; cpu <= last; ++cpu) {
+                cpus.push_back(static_cast<int>(cpu));
+            }
+            while (*cur && (',' == *cur || std::isspace(static_cast<unsigned char>(*cur)))) {
+                ++cur;
+            }
+        }
+        return cpus;
+    }
+    //
+    // Reads NUMA nodes that have CPUs from sysfs. Returns an empty
+    // vector if topology is not available.
+    //
+    [[nodiscard]] inline std::vector<numa_node> read_numa_topology(
+        std::string const &root = "/sys/devices/system/node") {
+        std::vector<numa_node> nodes;
+        std::ifstream online{root + "/online"};
+        std::string list;
+        if (!std::getline(online, list)) {
+            return nodes;
+        }
+        for (int id : parse_cpu_list(list)) {
+            std::ifstream cpulist{root + "/node" + std::to_string(id) + "/cpulist"};
+            std::string cpus;
+            if (std::getline(cpulist, cpus)) {
+                numa_node node{static_cast<std::uint32_t>(id), parse_cpu_list(cpus)};
+                if (!node.cpus_.empty()) {
+                    nodes.push_back(std::move(node));
+                }
+            }
+        }
+        return nodes;
+    }
+
+    //
+    // State of a callback running on a worker. Actions requested through
+    // callback_instance are performed when callback returns.
+    //
+    struct callback_frame {
+        explicit callback_frame(pool_engine *pool) noexcept
+            : pool_{pool} {
+        }
+
+        callback_frame(callback_frame const &) = delete;
+        callback_frame &operator=(callback_frame const &) = delete;
+
+        void on_callback_return() noexcept {
+            if (event_on_return_) {
+                ac::details::handle_object::from_handle(event_on_return_)->set();
+                event_on_return_ = nullptr;
+            }
+        }
+
+        pool_engine *pool_;
+        HANDLE event_on_return_{nullptr};
+        bool may_run_long_{false};
+    };
+
+    //
+    // Intrusive FIFO of tasks. size_ is updated with sequentially
+    // consistent operations, and that is what idle workers check
+    // after they published themselves on the idle list.
+    //
+    class task_queue final {
+    public:
+        task_queue() noexcept = default;
+
+        task_queue(task_queue const &) = delete;
+        task_queue &operator=(task_queue const &) = delete;
+
+        void push(task *t) noexcept {
+            t->next_ = nullptr;
+            std::lock_guard<std::mutex> lock{lock_};
+            if (tail_) {
+                tail_->next_ = t;
+            } else {
+                head_ = t;
+                head_queued_ns_.store(t->queued_ns_, std::memory_order_relaxed);
+            }
+            tail_ = t;
+            size_.fetch_add(1, std::memory_order_seq_cst);
+        }
+
+        //
+        // Appends tasks linked through next_ with one lock acquisition
+        //
+        void push_chain(task *first, task *last, size_t count) noexcept {
+            last->next_ = nullptr;
+            std::lock_guard<std::mutex> lock{lock_};
+            if (tail_) {
+                tail_->next_ = first;
+            } else {
+                head_ = first;
+                head_queued_ns_.store(first->queued_ns_, std::memory_order_relaxed);
+            }
+            tail_ = last;
+            size_.fetch_add(count, std::memory_order_seq_cst);
+        }
+
+        [[nodiscard]] task *pop() noexcept {
+            return pop_if([](task const *) noexcept { return true; });
+        }
+        //
+        // Pops the oldest task only if predicate accepts it
+        //
+        template<typename P>
+        [[nodiscard]] task *pop_if(P &&predicate) noexcept {
+            if (empty()) {
+                return nullptr;
+            }
+            std::lock_guard<std::mutex> lock{lock_};
+            task *t = head_;
+            if (t && predicate(t)) {
+                head_ = t->next_;
+                if (nullptr == head_) {
+                    tail_ = nullptr;
+                } else {
+                    head_queued_ns_.store(head_->queued_ns_, std::memory_order_relaxed);
+                }
+                t->next_ = nullptr;
+                size_.fetch_sub(1, std::memory_order_relaxed);
+                return t;
+            }
+            return nullptr;
+        }
+
+        //
+        // True if queue has the oldest task and predicate accepts it
+        //
+        template<typename P>
+        [[nodiscard]] bool front_if(P &&predicate) const noexcept {
+            if (empty()) {
+                return false;
+            }
+            std::lock_guard<std::mutex> lock{lock_};
+            return head_ && predicate(head_);
+        }
+
+        [[nodiscard]] bool empty() const noexcept {
+            return 0 == size_.load(std::memory_order_seq_cst);
+        }
+
+        [[nodiscard]] size_t size() const noexcept {
+            return size_.load(std::memory_order_relaxed);
+        }
+        //
+        // When the oldest task was queued. Only meaningful
+        // if queue is not empty.
+        //
+        [[nodiscard]] std::int64_t head_queued_ns() const noexcept {
+            return head_queued_ns_.load(std::memory_order_relaxed);
+        }
+
+    private:
+        mutable std::mutex lock_;
+        task *head_{nullptr};
+        task *tail_{nullptr};
+        std::atomic<size_t> size_{0};
+        std::atomic<std::int64_t> head_queued_ns_{0};
+    };
+
+    //
+    // Chase-Lev work stealing deque. Only the owner pushes and pops at
+    // the bottom, thieves take from the top. Ring grows when it is full,
+    // and retired rings are kept until the deque is destroyed because a
+    // thief might still be reading from them.
+    //
+    class work_stealing_deque final {
+    public:
+        static constexpr std::int64_t initial_capacity{256};
+
+        work_stealing_deque() {
+            rings_.emplace_back(std::make_unique<ring>(initial_capacity));
+            ring_.store(rings_.back().get(), std::memory_order_relaxed);
+        }
+
+        work_stealing_deque(work_stealing_deque const &) = delete;
+        work_stealing_deque &operator=(work_stealing_deque const &) = delete;
+        //
+        // Owner only
+        //
+        void push(task *t) {
+            std::int64_t const b = bottom_.load(std::memory_order_relaxed);
+            std::int64_t const top = top_.load(std::memory_order_acquire);
+            ring *r = ring_.load(std::memory_order_relaxed);
+            if (b - top > r->capacity_ - 1) {
+                r = grow(r, top, b);
+            }
+            r->put(b, t);
+            std::atomic_thread_fence(std::memory_order_release);
+            bottom_.store(b + 1, std::memory_order_relaxed);
+        }
+        //
+        // Owner only. Takes most recently pushed task.
+        //
+        [[nodiscard]] task *pop() noexcept {
+            std::int64_t const b = bottom_.load(std::memory_order_relaxed) - 1;
+            ring *r = ring_.load(std::memory_order_relaxed);
+            bottom_.store(b, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            std::int64_t top = top_.load(std::memory_order_relaxed);
+            task *t{nullptr};
+            if (top <= b) {
+                t = r->get(b);
+                if (top == b) {
+                    //
+                    // Last element, race with thieves for it
+                    //
+                    if (!top_.compare_exchange_strong(
+                            top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+                        t = nullptr;
+                    }
+                    bottom_.store(b + 1, std::memory_order_relaxed);
+                }
+            } else {
+                bottom_.store(b + 1, std::memory_order_relaxed);
+            }
+            return t;
+        }
+        //
+        // Any thread. Takes least recently pushed task. Returns
+        // nullptr if deque is empty or if we lost a race.
+        //
+        [[nodiscard]] task *steal() noexcept {
+            std::int64_t top = top_.load(std::memory_order_acquire);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            std::int64_t const b = bottom_.load(std::memory_order_acquire);
+            if (top < b) {
+                ring *r = ring_.load(std::memory_order_acquire);
+                task *t = r->get(top);
+                if (top_.compare_exchange_strong(
+                        top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+                    return t;
+                }
+            }
+            return nullptr;
+        }
+
+        [[nodiscard]] bool empty() const noexcept {
+            std::int64_t const b = bottom_.load(std::memory_order_seq_cst);
+            std::int64_t const top = top_.load(std::memory_order_seq_cst);
+            return b <= top;
+        }
+
+    private:
+        struct ring {
+            explicit ring(std::int64_t capacity)
+                : capacity_{capacity}
+                , slots_{std::make_unique<std::atomic<task *>[]>(static_cast<size_t>(capacity))} {
+            }
+
+            [[nodiscard]] task *get(std::int64_t i) const noexcept {
+                return slots_[static_cast<size_t>(i & (capacity_ - 1))].load(std::memory_order_relaxed);
+            }
+
+            void put(std::int64_t i, task *t) noexcept {
+                slots_[static_cast<size_t>(i & (capacity_ - 1))].store(t, std::memory_order_relaxed);
+            }
+
+            std::int64_t capacity_;
+            std::unique_ptr<std::atomic<task *>[]> slots_;
+        };
+
+        ring *grow(ring *old_ring, std::int64_t top, std::int64_t bottom) {
+            rings_.emplace_back(std::make_unique<ring>(old_ring->capacity_ * 2));
+            ring *new_ring = rings_.back().get();
+            for (std::int64_t i = top; i < bottom; ++i) {
+                new_ring->put(i, old_ring->get(i));
+            }
+            ring_.store(new_ring, std::memory_order_release);
+            return new_ring;
+        }
+
+        alignas(64) std::atomic<std::int64_t> top_{0};
+        alignas(64) std::atomic<std::int64_t> bottom_{0};
+        std::atomic<ring *> ring_{nullptr};
+        std::vector<std::unique_ptr<ring>> rings_;
+    };
+
+    //
+    // Histogram of the time tasks spent in the queues. Buckets below
+    // 16 ns are exact, above that every power of two is split into 4
+    // buckets, so a percentile is accurate to 25%.
+    //
+    class queue_wait_histogram final {
+    public:
+        static constexpr size_t bucket_count{256};
+
+        [[nodiscard]] static constexpr size_t bucket_of(std::uint64_t ns) noexcept {
+            if (ns < 16) {
+                return static_cast<size_t>(ns);
+            }
+            size_t const exponent = static_cast<size_t>(std::bit_width(ns)) - 1;
+            return 16 + (exponent - 4) * 4 + static_cast<size_t>((ns >> (exponent - 2)) & 3);
+        }
+        //
+        // Largest value that falls into the bucket
+        //
+        [[nodiscard]] static constexpr std::uint64_t bucket_limit(size_t bucket) noexcept {
+            if (bucket < 16) {
+                return bucket;
+            }
+            size_t const exponent = (bucket - 16) / 4 + 4;
+            std::uint64_t const first = (4 + (bucket - 16) % 4) << (exponent - 2);
+            return first + (std::uint64_t{1} << (exponent - 2)) - 1;
+        }
+
+        void add(size_t bucket, std::uint64_t count) noexcept {
+            buckets_[bucket] += count;
+        }
+
+        [[nodiscard]] std::uint64_t count() const noexcept {
+            std::uint64_t total{0};
+            for (std::uint64_t c : buckets_) {
+                total += c;
+            }
+            return total;
+        }
+        //
+        // Upper bound of the wait time that fraction of tasks did
+        // not exceed, for example percentile(0.99) for p99
+        //
+        [[nodiscard]] std::chrono::nanoseconds percentile(double fraction) const noexcept {
+            std::uint64_t const total{count()};
+            if (0 == total) {
+                return std::chrono::nanoseconds{0};
+            }
+            std::uint64_t const rank{std::max<std::uint64_t>(
+                1, static_cast<std::uint64_t>(std::ceil(fraction * static_cast<double>(total))))};
+            std::uint64_t seen{0};
+            for (size_t i = 0; i < bucket_count; ++i) {
+                seen += buckets_[i];
+                if (seen >= rank) {
+                    return std::chrono::nanoseconds{bucket_limit(i)};
+                }
+            }
+            return std::chrono::nanoseconds{bucket_limit(bucket_count - 1)};
+        }
+        //
+        // Removes samples of an earlier snapshot, so the difference
+        // of two snapshots describes the interval between them
+        //
+        queue_wait_histogram &operator-=(queue_wait_histogram const &other) noexcept {
+            for (size_t i = 0; i < bucket_count; ++i) {
+                buckets_[i] -= std::min(buckets_[i], other.buckets_[i]);
+            }
+            return *this;
+        }
+
+    private:
+        std::uint64_t buckets_[bucket_count]{};
+    };
+
+    //
+    // Change of the worker count made by the concurrency controller
+    //
+    struct concurrency_adjustment {
+        enum class reason_t {
+            //
+            // Throughput went up after the last move,
+            // keep moving in the same direction
+            //
+            climb,
+            //
+            // Throughput went down after the last move,
+            // move back
+            //
+            reverse,
+            //
+            // Throughput did not change, extra workers
+            // did not help, so remove one
+            //
+            trim,
+            //
+            // There is queued work, but nothing completed during
+            // the interval, workers are blocked
+            //
+            starvation,
+            //
+            // First move after pool was idle
+            //
+            probe,
+        };
+
+        std::chrono::steady_clock::time_point time_{};
+        unsigned long from_{0};
+        unsigned long to_{0};
+        //
+        // Completed callbacks per second measured over the last
+        // interval with from_ workers
+        //
+        double throughput_{0};
+        reason_t reason_{reason_t::probe};
+    };
+
+    struct worker {
+        std::thread thread_;
+        //
+        // Work submitted by callbacks running on this worker
+        //
+        work_stealing_deque deque_;
+        //
+        // Keyed lanes that hash to this worker
+        //
+        task_queue affine_;
+        //
+        // Worker parks on this word while it is on the idle list
+        //
+        std::atomic<std::uint32_t> wake_{0};
+        worker *next_idle_{nullptr};
+        bool idle_{false};
+        std::atomic<bool> exited_{false};
+        std::uint32_t steal_seed_{0};
+        std::uint32_t picks_{0};
+        //
+        // Index of the worker group
+        //
+        std::uint32_t group_{0};
+        //
+        // Callbacks this worker completed, sampled by the
+        // concurrency controller
+        //
+        std::atomic<std::uint64_t> completed_{0};
+        //
+        // Worker is in a blocking region, and a compensating
+        // worker was started for it
+        //
+        bool compensated_{false};
+        //
+        // Queue wait histograms, one per priority. Only the worker
+        // updates them, others read them to build a snapshot.
+        //
+        std::atomic<std::uint64_t> queue_wait_[TP_CALLBACK_PRIORITY_COUNT][queue_wait_histogram::bucket_count]{};
+    };
+
+    //
+    // Jump consistent hash (Lamping, Veach). Maps key to one of buckets,
+    // and when number of buckets grows by one only 1/buckets keys move.
+    //
+    [[nodiscard]] inline std::uint32_t jump_consistent_hash(std::uint64_t key, std::uint32_t buckets) noexcept {
+        std::int64_t bucket{-1};
+        std::int64_t next{0};
+        while (next < static_cast<std::int64_t>(buckets)) {
+            bucket = next;
+            key = key * 2862933555777941757ULL + 1;
+            next = static_cast<std::int64_t>(static_cast<double>(bucket + 1) *
+                                             (static_cast<double>(1LL << 31) / static_cast<double>((key >> 33) + 1)));
+        }
+        return static_cast<std::uint32_t>(bucket);
+    }
+
+    //
+    // Serial queue of keyed work. Keys hash to a lane, and lane runs
+    // its tasks one at a time in the order they were submitted.
+    // Lane itself is a task that is queued to the worker it has
+    // affinity with.
+    //
+    struct keyed_lane final: public task {
+        pool_engine *pool_{nullptr};
+        std::uint32_t index_{0};
+        //
+        // Submitted tasks, newest first
+        //
+        std::atomic<task *> posted_{nullptr};
+        //
+        // Tasks taken from posted_ that did not run yet, oldest first
+        //
+        task *ready_{nullptr};
+        //
+        // Tasks submitted that did not run yet
+        //
+        std::atomic<std::uint32_t> pending_{0};
+    };
+
+    //
+    // Pool of std::thread workers. Each worker owns a work stealing
+    // deque. Work submitted from a callback goes to the deque of the
+    // worker it runs on, and is popped LIFO while caches are warm. Work
+    // submitted from other threads goes to a shared injection queue.
+    // Workers that ran out of work steal FIFO from their peers.
+    //
+    // High and low priority work always goes through the injection
+    // queue of its priority. Workers take higher priority work first,
+    // but one pick out of aging_share goes to lower priority work that
+    // waited for more than priority_aging per priority level, so a
+    // flood of higher priority work cannot starve it. Normal work on
+    // deques and affine queues is not stamped, and gets that pick
+    // without waiting.
+    //
+    // Pool created per NUMA node has one group of workers per node.
+    // Workers are pinned to CPUs of their node, and every group has
+    // its own injection queues. Work goes to the group of the node it
+    // was bound to, or to the group of the submitter. Workers look at
+    // other groups only when there is nothing left in their own.
+    //
+    // Workers that could not find work park on a futex and are linked
+    // into an idle stack, so a submission wakes at most one worker, and
+    // the most recently parked worker (with the warmest cache) goes first.
+    //
+    // Keyed work goes to one of the keyed lanes. Lanes are mapped to
+    // workers with a consistent hash, and lane is queued to the affine
+    // queue of its worker. Other workers take a lane from there only
+    // when its backlog is above the keyed backlog, or the worker exited.
+    //
+    // Bounded submitters take a slot of queue capacity before they
+    // submit, and the task gives it back when it is done. Submitter
+    // that finds pool at capacity either fails, blocks on a futex, or
+    // leaves a resume task that is queued when a slot frees up.
+    //
+    class pool_engine final {
+    public:
+        static constexpr unsigned long default_max_threads{512};
+        //
+        // Worker objects are never freed while pool is alive, so
+        // thieves can scan them without a lock. Thread count is
+        // capped at the number of slots.
+        //
+        static constexpr unsigned long max_worker_slots{1024};
+        static constexpr std::chrono::nanoseconds priority_aging{std::chrono::milliseconds{10}};
+        static constexpr std::uint32_t aging_share{8};
+        static constexpr size_t max_concurrency_adjustments{256};
+        //
+        // Relative change of throughput that hill climbing
+        // treats as noise
+        //
+        static constexpr double throughput_noise{0.05};
+        //
+        // Keyed lanes run this many tasks before they yield the worker
+        //
+        static constexpr std::uint32_t keyed_batch_size{64};
+        static constexpr std::uint32_t default_keyed_backlog{64};
+        //
+        // Submitter that hits queue capacity retries this many
+        // times, yielding the CPU, before it blocks
+        //
+        static constexpr std::uint32_t capacity_spin_count{32};
+
+        explicit pool_engine(unsigned long min_threads = ULONG_MAX,
+                             unsigned long max_threads = ULONG_MAX,
+                             bool per_numa_node = false)
+            : pool_engine{min_threads, max_threads, per_numa_node ? read_numa_topology() : std::vector<numa_node>{}} {
+        }
+        //
+        // Pool has a group of workers per node of the topology,
+        // or a single group if topology has less than two nodes
+        //
+        pool_engine(unsigned long min_threads, unsigned long max_threads, std::vector<numa_node> topology) {
+            if (topology.size() < 2) {
+                groups_.push_back(std::make_unique<worker_group>());
+            } else {
+                for (numa_node &node : topology) {
+                    groups_.push_back(std::make_unique<worker_group>());
+                    groups_.back()->node_ = std::move(node);
+                    for (int cpu : groups_.back()->node_.cpus_) {
+                        if (static_cast<size_t>(cpu) >= cpu_to_group_.size()) {
+                            cpu_to_group_.resize(static_cast<size_t>(cpu) + 1, 0);
+                        }
+                        cpu_to_group_[static_cast<size_t>(cpu)] =
+                            static_cast<std::uint32_t>(groups_.size() - 1);
+                    }
+                }
+            }
+            max_threads_ = (ULONG_MAX == max_threads) ? default_max_threads : max_threads;
+            min_threads_ = (ULONG_MAX == min_threads) ? 0 : min_threads;
+            if (max_threads_ < min_threads_) {
+                max_threads_ = min_threads_;
+            }
+            max_threads_ = std::clamp(max_threads_, 1UL, max_worker_slots);
+            min_threads_ = std::min(min_threads_, max_threads_);
+            std::lock_guard<std::mutex> lock{threads_lock_};
+            grow_to(target_thread_count());
+        }
+
+        pool_engine(pool_engine const &) = delete;
+        pool_engine &operator=(pool_engine const &) = delete;
+        //
+        // Runs all queued work before returning
+        //
+        ~pool_engine() noexcept {
+            (void) stop_controller();
+            //
+            // Resume callbacks still waiting for capacity
+            // run with the rest of queued work
+            //
+            while (task *t = capacity_resumes_.pop()) {
+                submit(t);
+            }
+            {
+                std::lock_guard<std::mutex> lock{idle_lock_};
+                shutdown_ = true;
+            }
+            wake_all_idle();
+            std::lock_guard<std::mutex> lock{threads_lock_};
+            unsigned long const count = slot_count_.load(std::memory_order_relaxed);
+            for (unsigned long i = 0; i < count; ++i) {
+                worker *w = slots_[i].load(std::memory_order_relaxed);
+                if (w->thread_.joinable()) {
+                    w->thread_.join();
+                }
+            }
+            //
+            // Workers that are still running steal from peers,
+            // so none is freed until all of them exited
+            //
+            for (unsigned long i = 0; i < count; ++i) {
+                delete slots_[i].load(std::memory_order_relaxed);
+            }
+        }
+        //
+        // Submissions from a worker of this pool go to the
+        // worker's own deque
+        //
+        void submit(task *t) noexcept {
+            normalize_priority(t);
+            std::uint32_t const group = target_group(t);
+            if (TP_CALLBACK_PRIORITY_NORMAL == t->priority_ && this == current_pool_ &&
+                group == current_worker_->group_) {
+                try {
+                    stamp(t, false);
+                    current_worker_->deque_.push(t);
+                    //
+                    // Pairs with the idle worker publishing itself
+                    // and then checking deques
+                    //
+                    std::atomic_thread_fence(std::memory_order_seq_cst);
+                    wake_one(group);
+                    return;
+                } catch (...) {
+                    //
+                    // Deque could not grow, fall back to the
+                    // injection queue
+                    //
+                }
+            }
+            stamp(t, true);
+            groups_[group]->queues_[t->priority_].push(t);
+            wake_one(group);
+        }
+        //
+        // Submits count tasks linked through next_, and wakes up
+        // to count idle workers at once
+        //
+        void submit_batch(task *first, size_t count) noexcept {
+            if (0 == count) {
+                return;
+            }
+            bool const local = (this == current_pool_);
+            //
+            // Chains are per priority, and are flushed when
+            // next task goes to a different group
+            //
+            task *heads[TP_CALLBACK_PRIORITY_COUNT]{};
+            task *tails[TP_CALLBACK_PRIORITY_COUNT]{};
+            size_t counts[TP_CALLBACK_PRIORITY_COUNT]{};
+            std::uint32_t chain_group{0};
+            auto const flush = [&]() noexcept {
+                for (int priority = 0; priority < TP_CALLBACK_PRIORITY_COUNT; ++priority) {
+                    if (heads[priority]) {
+                        groups_[chain_group]->queues_[priority].push_chain(
+                            heads[priority], tails[priority], counts[priority]);
+                        heads[priority] = nullptr;
+                        tails[priority] = nullptr;
+                        counts[priority] = 0;
+                    }
+                }
+            };
+            while (first) {
+                task *next = first->next_;
+                normalize_priority(first);
+                std::uint32_t const group = target_group(first);
+                bool pushed = false;
+                if (local && TP_CALLBACK_PRIORITY_NORMAL == first->priority_ &&
+                    group == current_worker_->group_) {
+                    try {
+                        stamp(first, false);
+                        current_worker_->deque_.push(first);
+                        pushed = true;
+                    } catch (...) {
+                    }
+                }
+                if (!pushed) {
+                    stamp(first, true);
+                    if (group != chain_group) {
+                        flush();
+                        chain_group = group;
+                    }
+                    int const priority = first->priority_;
+                    first->next_ = nullptr;
+                    if (tails[priority]) {
+                        tails[priority]->next_ = first;
+                    } else {
+                        heads[priority] = first;
+                    }
+                    tails[priority] = first;
+                    ++counts[priority];
+                }
+                first = next;
+            }
+            flush();
+            if (local) {
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+            }
+            wake_many(count);
+        }
+        //
+        // Tasks with the same key run one at a time in the order they
+        // were submitted, on the worker the key hashes to
+        //
+        void submit_keyed(std::uint64_t key, task *t) {
+            keyed_lane *lane = get_keyed_lane(key);
+            //
+            // Count goes up before the task is visible, so the lane
+            // never runs more tasks than it was counted
+            //
+            std::uint32_t const pending{lane->pending_.fetch_add(1, std::memory_order_acq_rel)};
+            t->next_ = lane->posted_.load(std::memory_order_relaxed);
+            while (!lane->posted_.compare_exchange_weak(
+                t->next_, t, std::memory_order_release, std::memory_order_relaxed)) {
+            }
+            if (0 == pending) {
+                schedule_lane(lane);
+            } else if (pending == keyed_backlog_.load(std::memory_order_relaxed)) {
+                //
+                // Lane just went over the backlog, idle workers
+                // do not see it until somebody wakes them
+                //
+                wake_one(lane_owner(lane)->group_);
+            }
+        }
+        //
+        // Lane is stolen from the worker it has affinity with only
+        // when it has more than backlog tasks waiting
+        //
+        void set_keyed_backlog(std::uint32_t backlog) noexcept {
+            keyed_backlog_.store(backlog, std::memory_order_relaxed);
+        }
+
+        [[nodiscard]] std::uint32_t get_keyed_backlog() const noexcept {
+            return keyed_backlog_.load(std::memory_order_relaxed);
+        }
+
+        //
+        // Bounds the number of admitted tasks that did not finish yet.
+        // Zero means unbounded. Only tasks admitted with try_admit or
+        // admit_or_wait count, submit does not check capacity.
+        //
+        void set_queue_capacity(std::uint32_t capacity) noexcept {
+            queue_capacity_.store(capacity, std::memory_order_seq_cst);
+            //
+            // Waiters recheck against the new capacity
+            //
+            if (0 != capacity_waiters_.load(std::memory_order_seq_cst)) {
+                wait_on_address::wake_all(address_of(admitted_));
+            }
+            while (has_capacity() && resume_one()) {
+            }
+        }
+
+        [[nodiscard]] std::uint32_t get_queue_capacity() const noexcept {
+            return queue_capacity_.load(std::memory_order_relaxed);
+        }
+        //
+        // Number of admitted tasks that did not finish yet
+        //
+        [[nodiscard]] std::uint32_t get_admitted_count() const noexcept {
+            return admitted_.load(std::memory_order_relaxed);
+        }
+        //
+        // Takes a slot of queue capacity. Returns false if
+        // pool is at capacity.
+        //
+        [[nodiscard]] bool try_admit() noexcept {
+            std::uint32_t admitted{admitted_.load(std::memory_order_relaxed)};
+            do {
+                std::uint32_t const capacity{queue_capacity_.load(std::memory_order_relaxed)};
+                if (0 != capacity && capacity <= admitted) {
+                    return false;
+                }
+            } while (!admitted_.compare_exchange_weak(
+                admitted, admitted + 1, std::memory_order_acquire, std::memory_order_relaxed));
+            return true;
+        }
+        //
+        // Takes a slot of queue capacity, waiting for one if pool is at
+        // capacity. Retries a few times first, and a worker of this pool
+        // runs queued work before it blocks.
+        //
+        void admit_or_wait() noexcept {
+            for (std::uint32_t spin = 0; spin < capacity_spin_count; ++spin) {
+                if (try_admit()) {
+                    return;
+                }
+                std::this_thread::yield();
+            }
+            if (this == current_pool_) {
+                while (run_one()) {
+                    if (try_admit()) {
+                        return;
+                    }
+                }
+            }
+            ac::details::blocking_region region;
+            capacity_waiters_.fetch_add(1, std::memory_order_seq_cst);
+            for (;;) {
+                std::uint32_t const admitted{admitted_.load(std::memory_order_seq_cst)};
+                if (try_admit()) {
+                    break;
+                }
+                (void) wait_on_address::try_wait(address_of(admitted_), admitted);
+            }
+            capacity_waiters_.fetch_sub(1, std::memory_order_relaxed);
+        }
+        //
+        // Called when an admitted task is done. Wakes up one blocked
+        // submitter, and queues one resume task.
+        //
+        void release_admission() noexcept {
+            admitted_.fetch_sub(1, std::memory_order_seq_cst);
+            if (0 != capacity_waiters_.load(std::memory_order_seq_cst)) {
+                wait_on_address::wake_single(address_of(admitted_));
+            }
+            if (!capacity_resumes_.empty()) {
+                (void) resume_one();
+            }
+        }
+        //
+        // Queues resume once pool is below capacity. Resume is not
+        // admitted, it is expected to retry try_admit.
+        //
+        void submit_on_capacity(task *resume) noexcept {
+            capacity_resumes_.push(resume);
+            //
+            // Pairs with release_admission dropping the count
+            // and then checking for resume tasks
+            //
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (has_capacity()) {
+                (void) resume_one();
+            }
+        }
+
+        //
+        // Queue wait costs two clock reads per task, so it
+        // is recorded only while it is enabled
+        //
+        void set_record_queue_wait(bool record) noexcept {
+            record_queue_wait_.store(record, std::memory_order_relaxed);
+        }
+
+        [[nodiscard]] bool get_record_queue_wait() const noexcept {
+            return record_queue_wait_.load(std::memory_order_relaxed);
+        }
+        //
+        // Snapshot of the queue wait times of tasks with the given
+        // priority, collected from all workers since pool was created
+        //
+        [[nodiscard]] queue_wait_histogram get_queue_wait_histogram(TP_CALLBACK_PRIORITY priority) const noexcept {
+            queue_wait_histogram histogram;
+            int const index = normalize(priority);
+            unsigned long const count = slot_count_.load(std::memory_order_acquire);
+            for (unsigned long i = 0; i < count; ++i) {
+                worker const *w = slots_[i].load(std::memory_order_acquire);
+                for (size_t bucket = 0; bucket < queue_wait_histogram::bucket_count; ++bucket) {
+                    histogram.add(bucket, w->queue_wait_[index][bucket].load(std::memory_order_relaxed));
+                }
+            }
+            return histogram;
+        }
+
+        //
+        // Number of worker groups, one per NUMA node that has CPUs,
+        // or one if pool is not split by NUMA node
+        //
+        [[nodiscard]] size_t get_group_count() const noexcept {
+            return groups_.size();
+        }
+        //
+        // NUMA node of the worker running the callback, or any_numa_node
+        // if calling thread is not a worker of a pool split by NUMA node
+        //
+        [[nodiscard]] std::uint32_t get_current_numa_node() const noexcept {
+            if (this != current_pool_ || groups_.size() < 2) {
+                return any_numa_node;
+            }
+            return groups_[current_worker_->group_]->node_.id_;
+        }
+
+        [[nodiscard]] unsigned long get_idle_count() const noexcept {
+            return idle_count_.load(std::memory_order_relaxed);
+        }
+
+        [[nodiscard]] static pool_engine *current() noexcept {
+            return current_pool_;
+        }
+
+        [[nodiscard]] unsigned long get_thread_count() const noexcept {
+            return thread_count_.load(std::memory_order_relaxed);
+        }
+
+        [[nodiscard]] unsigned long get_min_thread_count() const noexcept {
+            return min_threads_;
+        }
+
+        [[nodiscard]] unsigned long get_max_thread_count() const noexcept {
+            return max_threads_;
+        }
+
+        void set_max_thread_count(unsigned long max_threads) noexcept {
+            std::lock_guard<std::mutex> lock{threads_lock_};
+            max_threads_ = std::clamp(max_threads, 1UL, max_worker_slots);
+            if (min_threads_ > max_threads_) {
+                min_threads_ = max_threads_;
+            }
+            //
+            // Extra workers retire next time they run out of work
+            //
+            wake_all_idle();
+        }
+
+        [[nodiscard]] bool set_min_thread_count(unsigned long min_threads) noexcept {
+            std::lock_guard<std::mutex> lock{threads_lock_};
+            min_threads_ = std::min(min_threads, max_worker_slots);
+            if (max_threads_ < min_threads_) {
+                max_threads_ = min_threads_;
+            }
+            try {
+                grow_to(target_thread_count());
+            } catch (...) {
+                return false;
+            }
+            return true;
+        }
+        //
+        // Starts hill climbing controller. Every sample_interval it
+        // measures completed callbacks per second, and moves the target
+        // worker count by one between min and max, keeping the
+        // direction while throughput improves. Workers above the target
+        // retire after finishing their current callback.
+        //
+        [[nodiscard]] bool enable_adaptive_concurrency(std::chrono::milliseconds sample_interval) noexcept {
+            std::lock_guard<std::mutex> lock{controller_lock_};
+            if (controller_.joinable()) {
+                sample_interval_ = sample_interval;
+                return true;
+            }
+            sample_interval_ = sample_interval;
+            controller_stop_ = false;
+            {
+                std::lock_guard<std::mutex> threads_lock{threads_lock_};
+                adaptive_target_.store(std::clamp(thread_count_.load(std::memory_order_relaxed),
+                                                  std::max(1UL, min_threads_),
+                                                  max_threads_),
+                                       std::memory_order_relaxed);
+            }
+            try {
+                controller_ = std::thread{[this] { run_controller(); }};
+            } catch (...) {
+                adaptive_target_.store(0, std::memory_order_relaxed);
+                return false;
+            }
+            return true;
+        }
+        //
+        // Stops the controller, and grows pool back to the
+        // default worker count
+        //
+        void disable_adaptive_concurrency() noexcept {
+            if (!stop_controller()) {
+                return;
+            }
+            std::lock_guard<std::mutex> lock{threads_lock_};
+            try {
+                grow_to(target_thread_count());
+            } catch (...) {
+            }
+        }
+        //
+        // Worker count the controller is aiming for, zero
+        // if controller is not running
+        //
+        [[nodiscard]] unsigned long get_adaptive_target() const noexcept {
+            return adaptive_target_.load(std::memory_order_relaxed);
+        }
+        //
+        // Most recent adjustments, oldest first
+        //
+        [[nodiscard]] std::vector<concurrency_adjustment> get_concurrency_adjustments() const {
+            std::lock_guard<std::mutex> lock{controller_lock_};
+            std::vector<concurrency_adjustment> result;
+            result.reserve(adjustments_.size());
+            for (size_t i = 0; i < adjustments_.size(); ++i) {
+                result.push_back(adjustments_[(next_adjustment_ + i) % adjustments_.size()]);
+            }
+            return result;
+        }
+
+        [[nodiscard]] std::uint64_t get_compensation_count() const noexcept {
+            return compensation_count_.load(std::memory_order_relaxed);
+        }
+
+        [[nodiscard]] std::uint64_t get_completed_count() const noexcept {
+            std::uint64_t completed{0};
+            unsigned long const count = slot_count_.load(std::memory_order_acquire);
+            for (unsigned long i = 0; i < count; ++i) {
+                completed += slots_[i].load(std::memory_order_acquire)->completed_.load(std::memory_order_relaxed);
+            }
+            return completed;
+        }
+        //
+        // Same contract as CallbackMayRunLong. Returns true if there is
+        // another thread available to process callbacks. If there is no
+        // idle worker, and we are below maximum then we start one.
+        //
+        [[nodiscard]] bool callback_may_run_long() noexcept {
+            if (0 != idle_count_.load(std::memory_order_relaxed)) {
+                return true;
+            }
+            std::lock_guard<std::mutex> lock{threads_lock_};
+            if (thread_count_.load(std::memory_order_relaxed) < max_threads_) {
+                try {
+                    start_worker();
+                    return true;
+                } catch (...) {
+                }
+            }
+            return false;
+        }
+        //
+        // Runs one queued task on the calling thread, so a thread that
+        // waits for a result helps the pool instead of blocking.
+        // Worker of this pool looks for work same way it does in its
+        // loop, other threads take from injection queues and then steal.
+        // Returns false if there was nothing to run.
+        //
+        [[nodiscard]] bool run_one() noexcept {
+            if (this == current_pool_) {
+                task *t = find_work(current_worker_);
+                if (nullptr == t) {
+                    return false;
+                }
+                execute(current_worker_, t);
+                return true;
+            }
+            task *t = find_external_work();
+            if (nullptr == t) {
+                return false;
+            }
+            callback_frame frame{this};
+            t->execute_(t, frame);
+            return true;
+        }
+
+    private:
+        [[nodiscard]] bool has_capacity() const noexcept {
+            std::uint32_t const capacity{queue_capacity_.load(std::memory_order_seq_cst)};
+            return 0 == capacity || admitted_.load(std::memory_order_seq_cst) < capacity;
+        }
+
+        [[nodiscard]] bool resume_one() noexcept {
+            task *t = capacity_resumes_.pop();
+            if (nullptr == t) {
+                return false;
+            }
+            submit(t);
+            return true;
+        }
+        //
+        // Injection queues, one per priority. Normal priority work
+        // submitted outside of the pool goes to the normal queue.
+        //
+        struct worker_group {
+            task_queue queues_[TP_CALLBACK_PRIORITY_COUNT];
+            numa_node node_;
+        };
+
+        [[nodiscard]] unsigned long target_thread_count() const noexcept {
+            unsigned long hardware_threads = std::thread::hardware_concurrency();
+            if (0 == hardware_threads) {
+                hardware_threads = 1;
+            }
+            return std::max(min_threads_, std::min(max_threads_, hardware_threads));
+        }
+        //
+        // Caller must hold threads_lock_
+        //
+        void grow_to(unsigned long thread_count) {
+            while (thread_count_.load(std::memory_order_relaxed) < thread_count) {
+                start_worker();
+            }
+        }
+        //
+        // Caller must hold threads_lock_
+        //
+        void start_worker() {
+            worker *w = reuse_exited_worker();
+            if (nullptr == w) {
+                unsigned long const slot = slot_count_.load(std::memory_order_relaxed);
+                if (slot == max_worker_slots) {
+                    AC_THROW(ERROR_NOT_ENOUGH_MEMORY, "start_worker");
+                }
+                w = new worker{};
+                w->steal_seed_ = (static_cast<std::uint32_t>(slot) * 2654435761U) | 1U;
+                w->group_ = static_cast<std::uint32_t>(slot % groups_.size());
+                slots_[slot].store(w, std::memory_order_release);
+                slot_count_.store(slot + 1, std::memory_order_release);
+            }
+            w->exited_ = false;
+            thread_count_.fetch_add(1, std::memory_order_relaxed);
+            try {
+                w->thread_ = std::thread{[this, w] { run_worker(w); }};
+            } catch (...) {
+                w->exited_ = true;
+                thread_count_.fetch_sub(1, std::memory_order_relaxed);
+                throw;
+            }
+        }
+        //
+        // Caller must hold threads_lock_
+        //
+        [[nodiscard]] worker *reuse_exited_worker() noexcept {
+            for (unsigned long i = 0; i < slot_count_.load(std::memory_order_relaxed); ++i) {
+                worker *w = slots_[i].load(std::memory_order_relaxed);
+                if (w->exited_) {
+                    if (w->thread_.joinable()) {
+                        w->thread_.join();
+                    }
+                    return w;
+                }
+            }
+            return nullptr;
+        }
+
+        void run_worker(worker *w) noexcept {
+            current_pool_ = this;
+            current_worker_ = w;
+            if (1 < groups_.size()) {
+                pin_to_node(groups_[w->group_]->node_);
+            }
+            ac::details::blocking_region::set_handler(&pool_engine::on_blocking_region, this);
+            for (;;) {
+                if (task *t = find_work(w)) {
+                    execute(w, t);
+                    if ((should_retire() || has_compensation_debt()) && retire(w)) {
+                        break;
+                    }
+                    continue;
+                }
+                if (!park(w)) {
+                    break;
+                }
+            }
+            ac::details::blocking_region::set_handler(nullptr, nullptr);
+            current_worker_ = nullptr;
+            current_pool_ = nullptr;
+        }
+
+        [[nodiscard]] static int normalize(TP_CALLBACK_PRIORITY priority) noexcept {
+            return (priority >= TP_CALLBACK_PRIORITY_HIGH && priority < TP_CALLBACK_PRIORITY_COUNT)
+                       ? priority
+                       : TP_CALLBACK_PRIORITY_NORMAL;
+        }
+
+        static void normalize_priority(task *t) noexcept {
+            t->priority_ = static_cast<TP_CALLBACK_PRIORITY>(normalize(t->priority_));
+        }
+        //
+        // Aging compares against the time the oldest task of the low
+        // and normal injection queues was queued, so tasks that go
+        // there are always stamped. Other tasks are stamped only while
+        // queue wait is recorded, zero means task was not stamped.
+        //
+        void stamp(task *t, bool injected) noexcept {
+            if ((injected && TP_CALLBACK_PRIORITY_HIGH != t->priority_) ||
+                record_queue_wait_.load(std::memory_order_relaxed)) {
+                t->queued_ns_ = steady_now_ns();
+            } else {
+                t->queued_ns_ = 0;
+            }
+        }
+
+        //
+        // Best effort, worker that could not be pinned still runs
+        //
+        static void pin_to_node(numa_node const &node) noexcept {
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            for (int cpu : node.cpus_) {
+                if (cpu < CPU_SETSIZE) {
+                    CPU_SET(cpu, &set);
+                }
+            }
+            (void) pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+        }
+        //
+        // Group of the node task is bound to, otherwise group
+        // of the submitting worker or of the current CPU
+        //
+        [[nodiscard]] std::uint32_t target_group(task const *t) const noexcept {
+            if (1 == groups_.size()) {
+                return 0;
+            }
+            if (any_numa_node != t->numa_node_) {
+                for (size_t i = 0; i < groups_.size(); ++i) {
+                    if (groups_[i]->node_.id_ == t->numa_node_) {
+                        return static_cast<std::uint32_t>(i);
+                    }
+                }
+            }
+            if (this == current_pool_) {
+                return current_worker_->group_;
+            }
+            int const cpu = sched_getcpu();
+            if (0 <= cpu && static_cast<size_t>(cpu) < cpu_to_group_.size()) {
+                return cpu_to_group_[static_cast<size_t>(cpu)];
+            }
+            return 0;
+        }
+
+        [[nodiscard]] task *find_work(worker *w) noexcept {
+            worker_group &home = *groups_[w->group_];
+            if (task *t = find_group_work(w, home)) {
+                return t;
+            }
+            if (1 == groups_.size()) {
+                return nullptr;
+            }
+            //
+            // Local work ran out, look at injection queues of the
+            // other groups, and then steal from any worker
+            //
+            for (size_t i = 1; i < groups_.size(); ++i) {
+                worker_group &remote = *groups_[(w->group_ + i) % groups_.size()];
+                for (task_queue &queue : remote.queues_) {
+                    if (task *t = queue.pop()) {
+                        return t;
+                    }
+                }
+            }
+            return steal(w, false);
+        }
+
+        [[nodiscard]] task *find_group_work(worker *w, worker_group &group) noexcept {
+            bool const has_high = !group.queues_[TP_CALLBACK_PRIORITY_HIGH].empty();
+            bool const has_low = !group.queues_[TP_CALLBACK_PRIORITY_LOW].empty();
+            if (!has_high && !has_low) {
+                return find_normal_work(w, group);
+            }
+            //
+            // Every aging_share pick goes to lower priority work that
+            // waited longer than the aging threshold
+            //
+            if (0 == (++w->picks_ % aging_share)) {
+                if (task *t = find_aged_work(w, group, has_high, has_low)) {
+                    return t;
+                }
+            }
+            if (has_high) {
+                if (task *t = group.queues_[TP_CALLBACK_PRIORITY_HIGH].pop()) {
+                    return t;
+                }
+            }
+            if (task *t = find_normal_work(w, group)) {
+                return t;
+            }
+            return group.queues_[TP_CALLBACK_PRIORITY_LOW].pop();
+        }
+
+        [[nodiscard]] task *find_aged_work(worker *w, worker_group &group, bool has_high, bool has_low) noexcept {
+            std::int64_t const now = steady_now_ns();
+            task_queue &low = group.queues_[TP_CALLBACK_PRIORITY_LOW];
+            if (has_low && now - low.head_queued_ns() > 2 * priority_aging.count()) {
+                if (task *t = low.pop()) {
+                    return t;
+                }
+            }
+            if (!has_high) {
+                return nullptr;
+            }
+            task_queue const &normal = group.queues_[TP_CALLBACK_PRIORITY_NORMAL];
+            if (!normal.empty() && now - normal.head_queued_ns() > priority_aging.count()) {
+                return find_normal_work(w, group);
+            }
+            //
+            // Work submitted by workers is not stamped, so its age
+            // is unknown
+            //
+            if (task *t = w->affine_.pop()) {
+                return t;
+            }
+            if (task *t = w->deque_.pop()) {
+                return t;
+            }
+            return steal(w, 1 < groups_.size());
+        }
+
+        [[nodiscard]] task *find_normal_work(worker *w, worker_group &group) noexcept {
+            if (task *t = w->affine_.pop()) {
+                return t;
+            }
+            if (task *t = w->deque_.pop()) {
+                return t;
+            }
+            if (task *t = group.queues_[TP_CALLBACK_PRIORITY_NORMAL].pop()) {
+                return t;
+            }
+            return steal(w, 1 < groups_.size());
+        }
+        //
+        // Visit peers starting at a random one, so thieves
+        // do not all hammer the same deque
+        //
+        [[nodiscard]] task *steal(worker *w, bool same_group_only) noexcept {
+            unsigned long const count = slot_count_.load(std::memory_order_acquire);
+            w->steal_seed_ ^= w->steal_seed_ << 13;
+            w->steal_seed_ ^= w->steal_seed_ >> 17;
+            w->steal_seed_ ^= w->steal_seed_ << 5;
+            unsigned long const start = w->steal_seed_ % count;
+            for (unsigned long i = 0; i < count; ++i) {
+                worker *victim = slots_[(start + i) % count].load(std::memory_order_acquire);
+                if (victim != w && (!same_group_only || victim->group_ == w->group_)) {
+                    if (task *t = victim->deque_.steal()) {
+                        return t;
+                    }
+                    if (task *t = steal_lane(victim)) {
+                        return t;
+                    }
+                }
+            }
+            return nullptr;
+        }
+
+        //
+        // Lanes are created on the first keyed submission
+        //
+        [[nodiscard]] keyed_lane *get_keyed_lane(std::uint64_t key) {
+            std::call_once(lanes_once_, [this] {
+                lane_count_ = static_cast<std::uint32_t>(std::clamp(4 * max_threads_, 64UL, 4096UL));
+                lanes_ = std::make_unique<keyed_lane[]>(lane_count_);
+                for (std::uint32_t i = 0; i < lane_count_; ++i) {
+                    lanes_[i].pool_ = this;
+                    lanes_[i].index_ = i;
+                    lanes_[i].execute_ = &pool_engine::run_lane;
+                }
+            });
+            //
+            // Mix the key, std::hash of integers is identity
+            //
+            key ^= key >> 33;
+            key *= 0xff51afd7ed558ccdULL;
+            key ^= key >> 33;
+            return &lanes_[key % lane_count_];
+        }
+
+        [[nodiscard]] worker *lane_owner(keyed_lane const *lane) const noexcept {
+            unsigned long const slots = slot_count_.load(std::memory_order_acquire);
+            return slots_[jump_consistent_hash(lane->index_, static_cast<std::uint32_t>(slots))].load(
+                std::memory_order_acquire);
+        }
+
+        void schedule_lane(keyed_lane *lane) noexcept {
+            worker *w = lane_owner(lane);
+            stamp(lane, false);
+            w->affine_.push(lane);
+            if (w->exited_.load(std::memory_order_acquire) ||
+                lane->pending_.load(std::memory_order_relaxed) > keyed_backlog_.load(std::memory_order_relaxed)) {
+                //
+                // Somebody else has to take it
+                //
+                wake_one(w->group_);
+            } else if (w != current_worker_ && 0 != idle_count_.load(std::memory_order_seq_cst) && remove_idle(w)) {
+                wake(w);
+            }
+        }
+        //
+        // Runs up to keyed_batch_size tasks of the lane, and queues
+        // lane again if there are more
+        //
+        static void run_lane(task *t, callback_frame &frame) noexcept {
+            keyed_lane *lane = static_cast<keyed_lane *>(t);
+            std::uint32_t ran{0};
+            while (ran < keyed_batch_size) {
+                if (nullptr == lane->ready_) {
+                    task *posted = lane->posted_.exchange(nullptr, std::memory_order_acquire);
+                    while (posted) {
+                        task *next = posted->next_;
+                        posted->next_ = lane->ready_;
+                        lane->ready_ = posted;
+                        posted = next;
+                    }
+                    if (nullptr == lane->ready_) {
+                        break;
+                    }
+                }
+                task *item = lane->ready_;
+                lane->ready_ = item->next_;
+                item->next_ = nullptr;
+                item->execute_(item, frame);
+                ++ran;
+            }
+            if (0 < ran && current_worker_) {
+                current_worker_->completed_.store(
+                    current_worker_->completed_.load(std::memory_order_relaxed) + ran - 1, std::memory_order_relaxed);
+            }
+            if (ran != lane->pending_.fetch_sub(ran, std::memory_order_acq_rel)) {
+                lane->pool_->schedule_lane(lane);
+            }
+        }
+        //
+        // Lane is taken from another worker if it is over the backlog,
+        // or if that worker exited
+        //
+        [[nodiscard]] auto lane_stealable(worker const *victim) const noexcept {
+            bool const exited = victim->exited_.load(std::memory_order_acquire);
+            std::uint32_t const backlog = keyed_backlog_.load(std::memory_order_relaxed);
+            return [exited, backlog](task const *t) noexcept {
+                return exited || static_cast<keyed_lane const *>(t)->pending_.load(std::memory_order_relaxed) > backlog;
+            };
+        }
+
+        [[nodiscard]] task *steal_lane(worker *victim) noexcept {
+            if (victim->affine_.empty()) {
+                return nullptr;
+            }
+            return victim->affine_.pop_if(lane_stealable(victim));
+        }
+        //
+        // Injection queues are visited in priority order
+        //
+        [[nodiscard]] task *find_external_work() noexcept {
+            for (std::unique_ptr<worker_group> const &group : groups_) {
+                for (task_queue &queue : group->queues_) {
+                    if (task *t = queue.pop()) {
+                        return t;
+                    }
+                }
+            }
+            unsigned long const count = slot_count_.load(std::memory_order_acquire);
+            for (unsigned long i = 0; i < count; ++i) {
+                if (task *t = slots_[i].load(std::memory_order_acquire)->deque_.steal()) {
+                    return t;
+                }
+            }
+            return nullptr;
+        }
+
+        //
+        // Lanes queued to another worker count only if self could
+        // steal them, otherwise an idle worker would keep spinning
+        // while a lane waits for its busy owner
+        //
+        [[nodiscard]] bool has_work(worker const *self) const noexcept {
+            for (std::unique_ptr<worker_group> const &group : groups_) {
+                for (task_queue const &queue : group->queues_) {
+                    if (!queue.empty()) {
+                        return true;
+                    }
+                }
+            }
+            unsigned long const count = slot_count_.load(std::memory_order_acquire);
+            for (unsigned long i = 0; i < count; ++i) {
+                worker const *w = slots_[i].load(std::memory_order_acquire);
+                if (!w->deque_.empty()) {
+                    return true;
+                }
+                if (w == self ? !w->affine_.empty() : w->affine_.front_if(lane_stealable(w))) {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        void execute(worker *w, task *t) noexcept {
+            if (0 != t->queued_ns_ && record_queue_wait_.load(std::memory_order_relaxed)) {
+                std::int64_t const waited = steady_now_ns() - t->queued_ns_;
+                std::atomic<std::uint64_t> &bucket =
+                    w->queue_wait_[t->priority_][queue_wait_histogram::bucket_of(
+                        static_cast<std::uint64_t>(std::max<std::int64_t>(waited, 0)))];
+                bucket.store(bucket.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            }
+            callback_frame frame{this};
+            t->execute_(t, frame);
+            w->completed_.store(w->completed_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        }
+        //
+        // Worker above the target count leaves while there is still
+        // work. Whatever is left on its deque is stolen by peers.
+        //
+        [[nodiscard]] bool retire(worker *w) noexcept {
+            {
+                std::lock_guard<std::mutex> lock{idle_lock_};
+                if (!should_retire() && !take_compensation_debt()) {
+                    return false;
+                }
+                thread_count_.fetch_sub(1, std::memory_order_relaxed);
+                w->exited_ = true;
+            }
+            if (!w->deque_.empty() || !w->affine_.empty()) {
+                wake_one(w->group_);
+            }
+            return true;
+        }
+        //
+        // Returns false if worker has to exit
+        //
+        [[nodiscard]] bool park(worker *w) noexcept {
+            w->wake_.store(0, std::memory_order_relaxed);
+            bool exiting{false};
+            {
+                std::lock_guard<std::mutex> lock{idle_lock_};
+                if (shutdown_ || should_retire() || take_compensation_debt()) {
+                    thread_count_.fetch_sub(1, std::memory_order_relaxed);
+                    w->exited_ = true;
+                    exiting = true;
+                } else {
+                    w->next_idle_ = idle_head_;
+                    w->idle_ = true;
+                    idle_head_ = w;
+                    idle_count_.fetch_add(1, std::memory_order_seq_cst);
+                }
+            }
+            if (exiting) {
+                //
+                // Lanes that were queued to us are taken by peers
+                //
+                if (!w->affine_.empty()) {
+                    wake_one(w->group_);
+                }
+                return false;
+            }
+            //
+            // Submitter pushes work and then checks idle count, we've
+            // published ourselves as idle and now check the queues.
+            // At least one of us will see the other one.
+            //
+            if (has_work(w) && remove_idle(w)) {
+                return true;
+            }
+            while (0 == w->wake_.load(std::memory_order_acquire)) {
+                (void) wait_on_address::try_wait(address_of(w->wake_), std::uint32_t{0});
+            }
+            return true;
+        }
+
+        //
+        // Blocked workers do not count against the adaptive target
+        //
+        [[nodiscard]] bool should_retire() const noexcept {
+            unsigned long const count = thread_count_.load(std::memory_order_relaxed);
+            unsigned long const target = adaptive_target_.load(std::memory_order_relaxed);
+            unsigned long const active = count - std::min(count, blocked_count_.load(std::memory_order_relaxed));
+            return count > min_threads_ && (count > max_threads_ || (0 != target && active > target));
+        }
+        //
+        // Called when a callback enters and leaves a blocking region.
+        // If there is no idle worker to take over, starts one. When
+        // the callback leaves the region, one worker owes retirement,
+        // and whichever worker runs out of work or finishes a callback
+        // first pays it off.
+        //
+        static void on_blocking_region(void *context, bool entering) noexcept {
+            pool_engine *self = static_cast<pool_engine *>(context);
+            worker *w = current_worker_;
+            if (entering) {
+                self->blocked_count_.fetch_add(1, std::memory_order_relaxed);
+                if (0 == self->idle_count_.load(std::memory_order_relaxed)) {
+                    std::lock_guard<std::mutex> lock{self->threads_lock_};
+                    if (self->thread_count_.load(std::memory_order_relaxed) < self->max_threads_) {
+                        try {
+                            self->start_worker();
+                            w->compensated_ = true;
+                            self->compensation_count_.fetch_add(1, std::memory_order_relaxed);
+                        } catch (...) {
+                        }
+                    }
+                }
+            } else {
+                self->blocked_count_.fetch_sub(1, std::memory_order_relaxed);
+                if (w->compensated_) {
+                    w->compensated_ = false;
+                    self->compensation_debt_.fetch_add(1, std::memory_order_relaxed);
+                }
+            }
+        }
+
+        [[nodiscard]] bool has_compensation_debt() const noexcept {
+            return 0 != compensation_debt_.load(std::memory_order_relaxed);
+        }
+
+        //
+        // Debt is dropped when there is nobody left to retire, for
+        // example when extra workers already retired because maximum
+        // went down, otherwise every callback would keep checking it
+        //
+        [[nodiscard]] bool take_compensation_debt() noexcept {
+            if (thread_count_.load(std::memory_order_relaxed) <= min_threads_) {
+                if (has_compensation_debt()) {
+                    compensation_debt_.store(0, std::memory_order_relaxed);
+                }
+                return false;
+            }
+            unsigned long debt = compensation_debt_.load(std::memory_order_relaxed);
+            while (0 != debt) {
+                if (compensation_debt_.compare_exchange_weak(debt, debt - 1, std::memory_order_relaxed)) {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        //
+        // Returns false if controller was not running
+        //
+        [[nodiscard]] bool stop_controller() noexcept {
+            {
+                std::lock_guard<std::mutex> lock{controller_lock_};
+                if (!controller_.joinable()) {
+                    return false;
+                }
+                controller_stop_ = true;
+                controller_cv_.notify_all();
+            }
+            controller_.join();
+            adaptive_target_.store(0, std::memory_order_relaxed);
+            return true;
+        }
+
+        void run_controller() noexcept {
+            std::unique_lock<std::mutex> lock{controller_lock_};
+            std::uint64_t last_completed = get_completed_count();
+            std::chrono::steady_clock::time_point last_sample = std::chrono::steady_clock::now();
+            while (!controller_cv_.wait_for(lock, sample_interval_, [this] { return controller_stop_; })) {
+                std::uint64_t const completed = get_completed_count();
+                std::chrono::steady_clock::time_point const now = std::chrono::steady_clock::now();
+                double const seconds = std::chrono::duration<double>(now - last_sample).count();
+                double const throughput = static_cast<double>(completed - last_completed) / std::max(seconds, 1e-6);
+                last_completed = completed;
+                last_sample = now;
+                adjust_concurrency(now, completed, throughput);
+            }
+        }
+        //
+        // One hill climbing step. Caller must hold controller_lock_
+        //
+        void adjust_concurrency(std::chrono::steady_clock::time_point now,
+                                std::uint64_t completed,
+                                double throughput) noexcept {
+            using reason_t = concurrency_adjustment::reason_t;
+            unsigned long const current = adaptive_target_.load(std::memory_order_relaxed);
+            if (!has_work(nullptr)) {
+                //
+                // Pool keeps up, nothing to measure
+                //
+                last_throughput_ = -1.0;
+                last_completed_ = completed;
+                return;
+            }
+            reason_t reason{reason_t::probe};
+            if (completed == last_completed_) {
+                reason = reason_t::starvation;
+                direction_ = 1;
+            } else if (last_throughput_ < 0 || last_target_ == current) {
+                reason = reason_t::probe;
+            } else {
+                long const last_move = (current > last_target_) ? 1 : -1;
+                if (throughput > last_throughput_ * (1.0 + throughput_noise)) {
+                    reason = reason_t::climb;
+                    direction_ = last_move;
+                } else if (throughput < last_throughput_ * (1.0 - throughput_noise)) {
+                    reason = reason_t::reverse;
+                    direction_ = -last_move;
+                } else {
+                    reason = reason_t::trim;
+                    direction_ = -1;
+                }
+            }
+            last_completed_ = completed;
+            last_throughput_ = throughput;
+            last_target_ = current;
+
+            unsigned long next{current};
+            {
+                std::lock_guard<std::mutex> threads_lock{threads_lock_};
+                unsigned long const low = std::max(1UL, min_threads_);
+                if (direction_ > 0) {
+                    next = std::min(current + 1, max_threads_);
+                } else if (current > low) {
+                    next = current - 1;
+                }
+                next = std::clamp(next, low, max_threads_);
+                if (next == current) {
+                    //
+                    // Hit min or max, probe the other way next time
+                    //
+                    direction_ = -direction_;
+                    return;
+                }
+                adaptive_target_.store(next, std::memory_order_relaxed);
+                try {
+                    grow_to(next);
+                } catch (...) {
+                }
+            }
+            concurrency_adjustment const adjustment{now, current, next, throughput, reason};
+            if (adjustments_.size() < max_concurrency_adjustments) {
+                adjustments_.push_back(adjustment);
+            } else {
+                adjustments_[next_adjustment_] = adjustment;
+                next_adjustment_ = (next_adjustment_ + 1) % max_concurrency_adjustments;
+            }
+        }
+        //
+        // Returns false if someone already popped us from the idle list
+        // and is about to wake us up.
+        //
+        [[nodiscard]] bool remove_idle(worker *w) noexcept {
+            std::lock_guard<std::mutex> lock{idle_lock_};
+            if (!w->idle_) {
+                return false;
+            }
+            worker **cur = &idle_head_;
+            while (*cur != w) {
+                cur = &(*cur)->next_idle_;
+            }
+            *cur = w->next_idle_;
+            w->next_idle_ = nullptr;
+            w->idle_ = false;
+            idle_count_.fetch_sub(1, std::memory_order_relaxed);
+            return true;
+        }
+
+        //
+        // Prefers an idle worker of the group work was queued to
+        //
+        void wake_one(std::uint32_t group) noexcept {
+            if (0 == idle_count_.load(std::memory_order_seq_cst)) {
+                return;
+            }
+            worker *w{nullptr};
+            {
+                std::lock_guard<std::mutex> lock{idle_lock_};
+                worker **cur = &idle_head_;
+                if (1 < groups_.size()) {
+                    while (*cur && (*cur)->group_ != group) {
+                        cur = &(*cur)->next_idle_;
+                    }
+                    if (nullptr == *cur) {
+                        cur = &idle_head_;
+                    }
+                }
+                w = *cur;
+                if (w) {
+                    *cur = w->next_idle_;
+                    w->next_idle_ = nullptr;
+                    w->idle_ = false;
+                    idle_count_.fetch_sub(1, std::memory_order_relaxed);
+                }
+            }
+            if (w) {
+                wake(w);
+            }
+        }
+
+        void wake_many(size_t count) noexcept {
+            if (0 == idle_count_.load(std::memory_order_seq_cst)) {
+                return;
+            }
+            worker *w{nullptr};
+            {
+                std::lock_guard<std::mutex> lock{idle_lock_};
+                worker **tail = &w;
+                for (; 0 < count && idle_head_; --count) {
+                    worker *cur = idle_head_;
+                    idle_head_ = cur->next_idle_;
+                    cur->idle_ = false;
+                    idle_count_.fetch_sub(1, std::memory_order_relaxed);
+                    *tail = cur;
+                    tail = &cur->next_idle_;
+                }
+                *tail = nullptr;
+            }
+            while (w) {
+                worker *next = w->next_idle_;
+                w->next_idle_ = nullptr;
+                wake(w);
+                w = next;
+            }
+        }
+
+        void wake_all_idle() noexcept {
+            worker *w{nullptr};
+            {
+                std::lock_guard<std::mutex> lock{idle_lock_};
+                w = idle_head_;
+                idle_head_ = nullptr;
+                for (worker *cur = w; cur; cur = cur->next_idle_) {
+                    cur->idle_ = false;
+                }
+                idle_count_.store(0, std::memory_order_relaxed);
+            }
+            while (w) {
+                worker *next = w->next_idle_;
+                w->next_idle_ = nullptr;
+                wake(w);
+                w = next;
+            }
+        }
+
+        static void wake(worker *w) noexcept {
+            w->wake_.store(1, std::memory_order_release);
+            wait_on_address::wake_single(address_of(w->wake_));
+        }
+
+        inline static thread_local pool_engine *current_pool_{nullptr};
+        inline static thread_local worker *current_worker_{nullptr};
+        std::vector<std::unique_ptr<worker_group>> groups_;
+        std::vector<std::uint32_t> cpu_to_group_;
+
+        std::atomic<worker *> slots_[max_worker_slots]{};
+        std::atomic<unsigned long> slot_count_{0};
+
+        std::once_flag lanes_once_;
+        std::unique_ptr<keyed_lane[]> lanes_;
+        std::uint32_t lane_count_{0};
+        std::atomic<std::uint32_t> keyed_backlog_{default_keyed_backlog};
+        std::atomic<bool> record_queue_wait_{false};
+
+        std::atomic<std::uint32_t> queue_capacity_{0};
+        std::atomic<std::uint32_t> admitted_{0};
+        std::atomic<std::uint32_t> capacity_waiters_{0};
+        //
+        // Resume tasks waiting for the pool to go below capacity
+        //
+        task_queue capacity_resumes_;
+
+        std::mutex idle_lock_;
+        worker *idle_head_{nullptr};
+        std::atomic<unsigned long> idle_count_{0};
+        bool shutdown_{false};
+
+        std::mutex threads_lock_;
+        std::atomic<unsigned long> thread_count_{0};
+        unsigned long min_threads_{0};
+        unsigned long max_threads_{default_max_threads};
+        //
+        // Blocking regions
+        //
+        std::atomic<unsigned long> blocked_count_{0};
+        std::atomic<unsigned long> compensation_debt_{0};
+        std::atomic<std::uint64_t> compensation_count_{0};
+        //
+        // Concurrency controller. adaptive_target_ is zero
+        // when controller is not running.
+        //
+        mutable std::mutex controller_lock_;
+        std::condition_variable controller_cv_;
+        std::thread controller_;
+        bool controller_stop_{false};
+        std::chrono::milliseconds sample_interval_{100};
+        std::atomic<unsigned long> adaptive_target_{0};
+        std::uint64_t last_completed_{0};
+        double last_throughput_{-1.0};
+        unsigned long last_target_{0};
+        long direction_{1};
+        std::vector<concurrency_adjustment> adjustments_;
+        size_t next_adjustment_{0};
+    };
+    //
+    // Pool used by callback objects that were not associated with a
+    // pool, same as the process default pool on Windows. It is never
+    // destroyed, so callbacks can still run during static destruction.
+    //
+    [[nodiscard]] inline pool_engine *default_pool() {
+        static pool_engine *pool{new pool_engine{}};
+        return pool;
+    }
+    //
+    // Tasks collected on the timer thread, grouped by pool. Each
+    // group is queued with one submit_batch call when batch is
+    // flushed, so all workers needed for the batch wake up at once.
+    //
+    class dispatch_batch final {
+    public:
+        static constexpr size_t max_groups{8};
+
+        dispatch_batch() noexcept = default;
+
+        dispatch_batch(dispatch_batch const &) = delete;
+        dispatch_batch &operator=(dispatch_batch const &) = delete;
+
+        ~dispatch_batch() noexcept {
+            flush();
+        }
+
+        void add(pool_engine *pool, task *t) noexcept {
+            t->next_ = nullptr;
+            group *g = find_group(pool);
+            if (nullptr == g) {
+                if (max_groups == group_count_) {
+                    flush();
+                }
+                g = &groups_[group_count_++];
+                g->pool_ = pool;
+                g->first_ = t;
+            } else {
+                g->last_->next_ = t;
+            }
+            g->last_ = t;
+            ++g->count_;
+        }
+
+        void flush() noexcept {
+            for (size_t i = 0; i < group_count_; ++i) {
+                groups_[i].pool_->submit_batch(groups_[i].first_, groups_[i].count_);
+                groups_[i] = group{};
+            }
+            group_count_ = 0;
+        }
+
+    private:
+        struct group {
+            pool_engine *pool_{nullptr};
+            task *first_{nullptr};
+            task *last_{nullptr};
+            size_t count_{0};
+        };
+
+        [[nodiscard]] group *find_group(pool_engine *pool) noexcept {
+            for (size_t i = 0; i < group_count_; ++i) {
+                if (groups_[i].pool_ == pool) {
+                    return &groups_[i];
+                }
+            }
+            return nullptr;
+        }
+
+        group groups_[max_groups];
+        size_t group_count_{0};
+    };
+    //
+    // Callback object that can be posted many times. Posts that arrive
+    // while the object is already queued are folded into pending_, and
+    // the same intrusive task is requeued, so posting never allocates.
+    // Callbacks from different posts can run concurrently.
+    //
+    // refs_ counts queued task and tickets plus running callbacks, join
+    // waits for it to drop to zero.
+    //
+    class callback_object;
+    //
+    // Extra queue entry for a callback object, used when a batch of posts
+    // should start running on several workers at once
+    //
+    struct callback_ticket final: public task {
+        callback_object *object_{nullptr};
+    };
+
+    class callback_object: public task {
+    public:
+        using invoke_t = void (*)(void *context, callback_frame &) noexcept;
+
+        callback_object(pool_engine *pool,
+                        invoke_t invoke,
+                        void *context,
+                        callback_options const &options = callback_options{}) noexcept
+            : pool_{pool}
+            , invoke_{invoke}
+            , context_{context} {
+            execute_ = &callback_object::execute;
+            options.apply(this);
+        }
+
+        callback_object(callback_object const &) = delete;
+        callback_object &operator=(callback_object const &) = delete;
+
+        ~callback_object() noexcept {
+            join(true);
+        }
+
+        [[nodiscard]] pool_engine *get_pool() const noexcept {
+            return pool_;
+        }
+
+        void post() noexcept {
+            pending_.fetch_add(1, std::memory_order_seq_cst);
+            schedule();
+        }
+        //
+        // Queues count callbacks. Besides the intrusive task, queues up to
+        // one ticket per idle worker, so the batch fans out right away.
+        // If tickets cannot be allocated, the intrusive task still
+        // drains all pending callbacks.
+        //
+        void post(std::uint32_t count) noexcept {
+            if (0 == count) {
+                return;
+            }
+            pending_.fetch_add(count, std::memory_order_seq_cst);
+            schedule();
+            size_t const extra = std::min<size_t>(count - 1, pool_->get_idle_count());
+            task *first{nullptr};
+            size_t queued{0};
+            for (; queued < extra; ++queued) {
+                callback_ticket *ticket{nullptr};
+                try {
+                    ticket = node_cache<callback_ticket>::create();
+                } catch (...) {
+                    break;
+                }
+                ticket->execute_ = &callback_object::execute_ticket;
+                ticket->priority_ = priority_;
+                ticket->numa_node_ = numa_node_;
+                ticket->object_ = this;
+                ticket->next_ = first;
+                first = ticket;
+                add_ref();
+            }
+            pool_->submit_batch(first, queued);
+        }
+        //
+        // Same as post(), but if the object has to be queued, it is
+        // added to the batch instead of being submitted right away
+        //
+        void post(dispatch_batch &batch) noexcept {
+            pending_.fetch_add(1, std::memory_order_seq_cst);
+            if (!queued_.exchange(true, std::memory_order_seq_cst)) {
+                add_ref();
+                batch.add(pool_, this);
+            }
+        }
+
+        void join(bool cancel_pending) noexcept {
+            if (cancel_pending) {
+                pending_.store(0, std::memory_order_seq_cst);
+            }
+            for (;;) {
+                std::uint32_t refs = refs_.load(std::memory_order_acquire);
+                if (0 == refs) {
+                    //
+                    // post might be between incrementing pending_
+                    // and queueing the task
+                    //
+                    if (0 == pending_.load(std::memory_order_seq_cst)) {
+                        break;
+                    }
+                    std::this_thread::yield();
+                    continue;
+                }
+                (void) wait_on_address::try_wait(address_of(refs_), refs);
+            }
+        }
+
+    private:
+        void schedule() noexcept {
+            if (!queued_.exchange(true, std::memory_order_seq_cst)) {
+                add_ref();
+                pool_->submit(this);
+            }
+        }
+
+        [[nodiscard]] bool try_take_pending() noexcept {
+            std::uint32_t pending = pending_.load(std::memory_order_seq_cst);
+            while (0 != pending) {
+                if (pending_.compare_exchange_weak(pending, pending - 1, std::memory_order_seq_cst)) {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        void add_ref() noexcept {
+            refs_.fetch_add(1, std::memory_order_relaxed);
+        }
+        //
+        // Object can be destroyed as soon as refs_ drops to zero.
+        // Waking a futex on the address of a destroyed object is benign.
+        //
+        void release() noexcept {
+            if (1 == refs_.fetch_sub(1, std::memory_order_acq_rel)) {
+                wait_on_address::wake_all(address_of(refs_));
+            }
+        }
+
+        static void execute(task *t, callback_frame &frame) noexcept {
+            callback_object *self = static_cast<callback_object *>(t);
+            self->queued_.store(false, std::memory_order_seq_cst);
+            bool const run = self->try_take_pending();
+            if (run) {
+                self->add_ref();
+                if (0 != self->pending_.load(std::memory_order_seq_cst)) {
+                    self->schedule();
+                }
+            }
+            self->release();
+            if (run) {
+                self->invoke_(self->context_, frame);
+                frame.on_callback_return();
+                self->release();
+            }
+        }
+
+        static void execute_ticket(task *t, callback_frame &frame) noexcept {
+            callback_ticket *ticket = static_cast<callback_ticket *>(t);
+            callback_object *self = ticket->object_;
+            node_cache<callback_ticket>::destroy(ticket);
+            if (self->try_take_pending()) {
+                self->invoke_(self->context_, frame);
+                frame.on_callback_return();
+            }
+            self->release();
+        }
+
+        pool_engine *pool_;
+        invoke_t invoke_;
+        void *context_;
+        std::atomic<std::uint32_t> pending_{0};
+        std::atomic<std::uint32_t> refs_{0};
+        std::atomic<bool> queued_{false};
+    };
+
+    using steady_clock = std::chrono::steady_clock;
+
+    struct timer_entry {
+        //
+        // Link in the timing wheel slot
+        //
+        timer_entry *next_{nullptr};
+        timer_entry *prev_{nullptr};
+        std::uint64_t expires_{0};
+        std::uint32_t level_{0};
+        std::uint32_t slot_{0};
+        steady_clock::time_point due_{};
+        steady_clock::duration period_{0};
+        //
+        // Timer may expire anywhere between due_ and due_ + window_
+        //
+        steady_clock::duration window_{0};
+        void (*expired_)(timer_entry *, dispatch_batch &) noexcept {nullptr};
+        void *context_{nullptr};
+        bool armed_{false};
+        bool firing_{false};
+    };
+    //
+    // Process wide hashed hierarchical timing wheel with 1 millisecond
+    // ticks. Level 0 has 256 slots of one tick, every next level has 64
+    // slots that are 64 times wider. A timer is hashed into a slot by
+    // its expiration tick, so arm and disarm are O(1) list operations.
+    // When level 0 wraps around, next slot of the level above is
+    // cascaded down. Timer thread sleeps until the first tick that has
+    // anything to expire or to cascade, found through per level bitmaps.
+    //
+    // Timer with a tolerance window expires on the roundest tick of
+    // the window, one with the most trailing zero bits. Timers with
+    // overlapping windows tend to pick the same tick, and expire on
+    // the same wakeup.
+    //
+    // All timers that expire on a tick are collected in one batch, and
+    // their callbacks are queued to pools with one submit per pool.
+    // expired_ is called on the timer thread, and it is expected to only
+    // post a callback object to the batch.
+    //
+    class timer_queue final {
+    public:
+        static constexpr std::uint32_t level_count{5};
+        static constexpr std::uint32_t root_bits{8};
+        static constexpr std::uint32_t level_bits{6};
+        static constexpr std::uint32_t root_slots{1U << root_bits};
+        static constexpr std::uint32_t level_slots{1U << level_bits};
+        static constexpr std::uint64_t max_ticks{(1ULL << (root_bits + (level_count - 1) * level_bits)) - 1};
+
+        [[nodiscard]] static timer_queue &instance() {
+            static timer_queue *queue{new timer_queue{}};
+            return *queue;
+        }
+
+        timer_queue(timer_queue const &) = delete;
+        timer_queue &operator=(timer_queue const &) = delete;
+
+        void arm(timer_entry *entry,
+                 steady_clock::time_point due,
+                 steady_clock::duration period,
+                 steady_clock::duration window = steady_clock::duration::zero()) noexcept {
+            std::lock_guard<std::mutex> lock{lock_};
+            if (entry->armed_) {
+                unlink(entry);
+            }
+            entry->due_ = due;
+            entry->period_ = period;
+            entry->window_ = std::max(window, steady_clock::duration::zero());
+            insert(entry);
+            if (entry->expires_ < wakeup_tick_) {
+                cv_.notify_one();
+            }
+        }
+        //
+        // After this method returns expired_ is not running,
+        // and will not be called until timer is armed again.
+        //
+        void disarm(timer_entry *entry) noexcept {
+            std::unique_lock<std::mutex> lock{lock_};
+            if (entry->armed_) {
+                unlink(entry);
+            }
+            if (entry->firing_ && std::this_thread::get_id() != thread_.get_id()) {
+                fired_cv_.wait(lock, [entry] { return !entry->firing_; });
+            }
+        }
+
+        [[nodiscard]] bool is_armed(timer_entry const *entry) noexcept {
+            std::lock_guard<std::mutex> lock{lock_};
+            return entry->armed_;
+        }
+        //
+        // Number of times timer thread woke up to expire timers
+        //
+        [[nodiscard]] std::uint64_t get_wakeup_count() const noexcept {
+            return wakeup_count_.load(std::memory_order_relaxed);
+        }
+
+    private:
+        timer_queue()
+            : origin_{steady_clock::now()} {
+            thread_ = std::thread{[this] { run(); }};
+        }
+
+        ~timer_queue() noexcept = delete;
+
+        [[nodiscard]] std::uint64_t to_tick(steady_clock::time_point time) const noexcept {
+            if (time <= origin_) {
+                return 0;
+            }
+            //
+            // Round up, so timer never fires early
+            //
+            auto const since_origin = time - origin_;
+            std::uint64_t tick = static_cast<std::uint64_t>(
+                std::chrono::duration_cast<std::chrono::milliseconds>(since_origin).count());
+            if (std::chrono::milliseconds{tick} < since_origin) {
+                ++tick;
+            }
+            return tick;
+        }
+
+        //
+        // Last tick that has started, rounded down
+        //
+        [[nodiscard]] std::uint64_t elapsed_ticks() const noexcept {
+            return static_cast<std::uint64_t>(
+                std::chrono::duration_cast<std::chrono::milliseconds>(steady_clock::now() - origin_).count());
+        }
+
+        //
+        // Picks the tick in [due, due + window] with the most trailing
+        // zero bits. Everything above the highest bit where the first
+        // and the last tick of the window differ is common to all ticks
+        // of the window, so the roundest one is the last tick with all
+        // bits below that cleared.
+        //
+        [[nodiscard]] std::uint64_t coalesced_tick(timer_entry const *entry) const noexcept {
+            std::uint64_t const first = to_tick(entry->due_);
+            if (entry->window_ <= steady_clock::duration::zero()) {
+                return first;
+            }
+            std::uint64_t const window = static_cast<std::uint64_t>(
+                std::chrono::duration_cast<std::chrono::milliseconds>(entry->window_).count());
+            std::uint64_t const last = first + std::min(window, max_ticks);
+            if (last == first) {
+                return first;
+            }
+            std::uint64_t const low_bits = (std::uint64_t{1} << (std::bit_width(first ^ last) - 1)) - 1;
+            return last & ~low_bits;
+        }
+
+        [[nodiscard]] steady_clock::time_point to_time_point(std::uint64_t tick) const noexcept {
+            return origin_ + std::chrono::milliseconds{tick};
+        }
+
+        [[nodiscard]] static constexpr std::uint32_t level_shift(std::uint32_t level) noexcept {
+            return 0 == level ? 0 : root_bits + (level - 1) * level_bits;
+        }
+
+        [[nodiscard]] static constexpr std::uint32_t level_mask(std::uint32_t level) noexcept {
+            return 0 == level ? root_slots - 1 : level_slots - 1;
+        }
+        //
+        // Caller must hold lock_
+        //
+        void insert(timer_entry *entry) noexcept {
+            entry->expires_ = std::max(coalesced_tick(entry), current_tick_);
+            std::uint64_t const delta = std::min(entry->expires_ - current_tick_, max_ticks);
+            std::uint64_t const expires = current_tick_ + delta;
+            std::uint32_t level = 0;
+            while (level + 1 < level_count && delta >= (1ULL << level_shift(level + 1))) {
+                ++level;
+            }
+            std::uint32_t const slot =
+                static_cast<std::uint32_t>(expires >> level_shift(level)) & level_mask(level);
+            link(entry, level, slot);
+        }
+
+        void link(timer_entry *entry, std::uint32_t level, std::uint32_t slot) noexcept {
+            timer_entry *&head = slots_[level][slot];
+            entry->level_ = level;
+            entry->slot_ = slot;
+            entry->prev_ = nullptr;
+            entry->next_ = head;
+            if (head) {
+                head->prev_ = entry;
+            }
+            head = entry;
+            occupied_[level][slot / 64] |= (1ULL << (slot % 64));
+            entry->armed_ = true;
+        }
+
+        void unlink(timer_entry *entry) noexcept {
+            if (entry->prev_) {
+                entry->prev_->next_ = entry->next_;
+            } else {
+                slots_[entry->level_][entry->slot_] = entry->next_;
+                if (nullptr == entry->next_) {
+                    occupied_[entry->level_][entry->slot_ / 64] &= ~(1ULL << (entry->slot_ % 64));
+                }
+            }
+            if (entry->next_) {
+                entry->next_->prev_ = entry->prev_;
+            }
+            entry->next_ = nullptr;
+            entry->prev_ = nullptr;
+            entry->armed_ = false;
+        }
+        //
+        // Detaches all timers from a slot
+        //
+        [[nodiscard]] timer_entry *take_slot(std::uint32_t level, std::uint32_t slot) noexcept {
+            timer_entry *head = slots_[level][slot];
+            slots_[level][slot] = nullptr;
+            occupied_[level][slot / 64] &= ~(1ULL << (slot % 64));
+            for (timer_entry *entry = head; entry; entry = entry->next_) {
+                entry->armed_ = false;
+            }
+            return head;
+        }
+        //
+        // First occupied slot at or after start in cyclic order, or
+        // slots count if level is empty
+        //
+        [[nodiscard]] std::uint32_t next_occupied(std::uint32_t level, std::uint32_t start) const noexcept {
+            std::uint32_t const slots = level_mask(level) + 1;
+            std::uint32_t const words = (slots + 63) / 64;
+            for (std::uint32_t i = 0; i <= words; ++i) {
+                std::uint32_t const word = ((start / 64) + i) % words;
+                std::uint64_t bits = occupied_[level][word];
+                if (0 == i) {
+                    bits &= ~0ULL << (start % 64);
+                } else if (i == words) {
+                    bits &= (start % 64) ? ~(~0ULL << (start % 64)) : 0;
+                }
+                if (bits) {
+                    return word * 64 + static_cast<std::uint32_t>(std::countr_zero(bits));
+                }
+            }
+            return slots;
+        }
+        //
+        // First tick that has timers to expire, or a non empty slot
+        // to cascade. Caller must hold lock_
+        //
+        [[nodiscard]] std::uint64_t next_event_tick() const noexcept {
+            std::uint64_t next = UINT64_MAX;
+            std::uint32_t const root_start = static_cast<std::uint32_t>(current_tick_) & level_mask(0);
+            std::uint32_t const root_slot = next_occupied(0, root_start);
+            if (root_slot != root_slots) {
+                next = current_tick_ + ((root_slot - root_start) & level_mask(0));
+            }
+            for (std::uint32_t level = 1; level < level_count; ++level) {
+                std::uint32_t const shift = level_shift(level);
+                //
+                // First tick at or after current that is at the
+                // boundary of the slots of this level
+                //
+                std::uint64_t const boundary = (current_tick_ + (1ULL << shift) - 1) >> shift;
+                std::uint32_t const start = static_cast<std::uint32_t>(boundary) & level_mask(level);
+                std::uint32_t const slot = next_occupied(level, start);
+                if (slot != level_slots) {
+                    std::uint64_t const tick = (boundary + ((slot - start) & level_mask(level))) << shift;
+                    next = std::min(next, tick);
+                }
+            }
+            return next;
+        }
+        //
+        // Processes current tick: cascades slots of the upper levels
+        // that start on this tick, then collects expired timers.
+        // Caller must hold lock_
+        //
+        void run_tick(std::uint64_t now_tick) noexcept {
+            for (std::uint32_t level = 1; level < level_count; ++level) {
+                std::uint32_t const shift = level_shift(level);
+                if (0 != (current_tick_ & ((1ULL << shift) - 1))) {
+                    break;
+                }
+                std::uint32_t const slot = static_cast<std::uint32_t>(current_tick_ >> shift) & level_mask(level);
+                timer_entry *entry = take_slot(level, slot);
+                while (entry) {
+                    timer_entry *next = entry->next_;
+                    insert(entry);
+                    entry = next;
+                }
+            }
+            timer_entry *entry = take_slot(0, static_cast<std::uint32_t>(current_tick_) & level_mask(0));
+            while (entry) {
+                timer_entry *next = entry->next_;
+                entry->next_ = nullptr;
+                if (entry->expires_ > current_tick_) {
+                    //
+                    // Beyond the range of the wheel, rehash it
+                    //
+                    insert(entry);
+                } else {
+                    expire(entry, now_tick);
+                }
+                entry = next;
+            }
+        }
+
+        //
+        // Periodic timer that fell behind skips missed periods, so it
+        // expires at most once while timer thread catches up
+        //
+        void expire(timer_entry *entry, std::uint64_t now_tick) noexcept {
+            if (entry->period_ > steady_clock::duration::zero()) {
+                steady_clock::time_point const now = to_time_point(now_tick);
+                entry->due_ += entry->period_;
+                if (entry->due_ <= now) {
+                    entry->due_ = now + entry->period_;
+                }
+                insert(entry);
+            }
+            entry->firing_ = true;
+            expired_.push_back(entry);
+        }
+
+        void run() noexcept {
+            std::unique_lock<std::mutex> lock{lock_};
+            expired_.reserve(1024);
+            for (;;) {
+                std::uint64_t const now_tick = elapsed_ticks();
+                for (;;) {
+                    std::uint64_t const next = next_event_tick();
+                    if (next > now_tick) {
+                        current_tick_ = std::max(current_tick_, std::min(next, now_tick + 1));
+                        wakeup_tick_ = next;
+                        break;
+                    }
+                    current_tick_ = next;
+                    run_tick(now_tick);
+                    ++current_tick_;
+                }
+                if (!expired_.empty()) {
+                    dispatch(lock);
+                    continue;
+                }
+                if (UINT64_MAX == wakeup_tick_) {
+                    cv_.wait(lock);
+                } else {
+                    cv_.wait_until(lock, to_time_point(wakeup_tick_));
+                }
+            }
+        }
+        //
+        // Calls expired_ for all collected timers outside of the lock.
+        // Batch is flushed after firing_ is cleared, so a callback
+        // that frees its timer entry, such as a resumed coroutine,
+        // finds the entry released by the timer thread.
+        //
+        void dispatch(std::unique_lock<std::mutex> &lock) noexcept {
+            wakeup_count_.fetch_add(1, std::memory_order_relaxed);
+            dispatch_batch batch;
+            lock.unlock();
+            for (timer_entry *entry : expired_) {
+                entry->expired_(entry, batch);
+            }
+            lock.lock();
+            for (timer_entry *entry : expired_) {
+                entry->firing_ = false;
+            }
+            expired_.clear();
+            fired_cv_.notify_all();
+            lock.unlock();
+            batch.flush();
+            lock.lock();
+        }
+
+        steady_clock::time_point const origin_;
+        std::mutex lock_;
+        std::condition_variable cv_;
+        std::condition_variable fired_cv_;
+        timer_entry *slots_[level_count][root_slots]{};
+        std::uint64_t occupied_[level_count][root_slots / 64]{};
+        std::uint64_t current_tick_{0};
+        std::uint64_t wakeup_tick_{UINT64_MAX};
+        std::atomic<std::uint64_t> wakeup_count_{0};
+        std::vector<timer_entry *> expired_;
+        std::thread thread_;
+    };
+
+    [[nodiscard]] inline steady_clock::time_point to_steady_time_point(
+        std::chrono::system_clock::time_point const &due_time) noexcept {
+        return steady_clock::now() +
+               std::chrono::duration_cast<steady_clock::duration>(due_time -
+                                                                  std::chrono::system_clock::now());
+    }
+
+    //
+    // Awaiters below live in the coroutine frame, and carry the task
+    // that resumes the coroutine, so awaiting does not allocate.
+    // Coroutine is resumed inline on the worker that runs the task.
+    //
+    // Resumes awaiting coroutine on a worker of the pool
+    //
+    class schedule_awaiter final: public task {
+    public:
+        explicit schedule_awaiter(pool_engine *pool, callback_options const &options = callback_options{}) noexcept
+            : pool_{pool} {
+            execute_ = &schedule_awaiter::resume;
+            options.apply(this);
+        }
+
+        schedule_awaiter(schedule_awaiter const &) = delete;
+        schedule_awaiter &operator=(schedule_awaiter const &) = delete;
+
+        [[nodiscard]] bool await_ready() const noexcept {
+            return false;
+        }
+
+        void await_suspend(std::coroutine_handle<> continuation) noexcept {
+            continuation_ = continuation;
+            pool_->submit(this);
+        }
+
+        void await_resume() const noexcept {
+        }
+
+    private:
+        static void resume(task *t, callback_frame &) noexcept {
+            static_cast<schedule_awaiter *>(t)->continuation_.resume();
+        }
+
+        pool_engine *pool_;
+        std::coroutine_handle<> continuation_;
+    };
+    //
+    // Resumes awaiting coroutine on a worker of the pool once due time
+    // has passed. Timer thread only adds the task to its batch.
+    //
+    class sleep_awaiter final: public task {
+    public:
+        sleep_awaiter(pool_engine *pool,
+                      steady_clock::time_point due,
+                      callback_options const &options = callback_options{}) noexcept
+            : pool_{pool}
+            , due_{due} {
+            execute_ = &sleep_awaiter::resume;
+            options.apply(this);
+            timer_.expired_ = &sleep_awaiter::on_expired;
+            timer_.context_ = this;
+        }
+
+        sleep_awaiter(sleep_awaiter const &) = delete;
+        sleep_awaiter &operator=(sleep_awaiter const &) = delete;
+
+        [[nodiscard]] bool await_ready() const noexcept {
+            return due_ <= steady_clock::now();
+        }
+
+        void await_suspend(std::coroutine_handle<> continuation) noexcept {
+            continuation_ = continuation;
+            timer_queue::instance().arm(&timer_, due_, steady_clock::duration::zero());
+        }
+        //
+        // Batch might have been flushed before timer thread was done
+        // with the entry, disarm waits for it before frame can go away
+        //
+        void await_resume() noexcept {
+            if (continuation_) {
+                timer_queue::instance().disarm(&timer_);
+            }
+        }
+
+    private:
+        static void on_expired(timer_entry *timer, dispatch_batch &batch) noexcept {
+            sleep_awaiter *self = static_cast<sleep_awaiter *>(timer->context_);
+            batch.add(self->pool_, self);
+        }
+
+        static void resume(task *t, callback_frame &) noexcept {
+            static_cast<sleep_awaiter *>(t)->continuation_.resume();
+        }
+
+        pool_engine *pool_;
+        steady_clock::time_point due_;
+        std::coroutine_handle<> continuation_;
+        timer_entry timer_;
+    };
+    //
+    // Resumes awaiting coroutine on a worker of the pool when handle
+    // gets signaled or wait times out. Same as wait_work_item, whoever
+    // unlinks wait block from the handle completes the wait. Because
+    // handle may get signaled while timer is still being armed,
+    // await_suspend and completion both drop a reference, and the last
+    // one queues the task, or resumes coroutine right away if that is
+    // await_suspend.
+    //
+    class wait_awaiter final: public task {
+    public:
+        wait_awaiter(pool_engine *pool,
+                     HANDLE handle,
+                     std::optional<steady_clock::time_point> due,
+                     callback_options const &options = callback_options{}) noexcept
+            : pool_{pool}
+            , handle_{ac::details::handle_object::from_handle(handle)}
+            , due_{due} {
+            AC_CODDING_ERROR_IF(nullptr == handle_);
+            execute_ = &wait_awaiter::resume;
+            options.apply(this);
+            wait_block_.satisfied_ = &wait_awaiter::on_wait_satisfied;
+            wait_block_.context_ = this;
+            timer_.expired_ = &wait_awaiter::on_wait_timeout;
+            timer_.context_ = this;
+        }
+
+        wait_awaiter(wait_awaiter const &) = delete;
+        wait_awaiter &operator=(wait_awaiter const &) = delete;
+
+        [[nodiscard]] bool await_ready() const noexcept {
+            return false;
+        }
+
+        [[nodiscard]] bool await_suspend(std::coroutine_handle<> continuation) noexcept {
+            continuation_ = continuation;
+            handle_->add_ref();
+            if (handle_->register_wait(&wait_block_)) {
+                wait_result_ = WAIT_OBJECT_0;
+                return false;
+            }
+            if (due_) {
+                timer_queue::instance().arm(&timer_, due_.value(), steady_clock::duration::zero());
+            }
+            return 1 != references_.fetch_sub(1, std::memory_order_acq_rel);
+        }
+        //
+        // Returns WAIT_OBJECT_0 or WAIT_TIMEOUT
+        //
+        [[nodiscard]] TP_WAIT_RESULT await_resume() noexcept {
+            if (due_) {
+                timer_queue::instance().disarm(&timer_);
+            }
+            handle_->release();
+            return wait_result_;
+        }
+
+    private:
+        void complete(TP_WAIT_RESULT wait_result, dispatch_batch *batch) noexcept {
+            wait_result_ = wait_result;
+            if (1 == references_.fetch_sub(1, std::memory_order_acq_rel)) {
+                if (batch) {
+                    batch->add(pool_, this);
+                } else {
+                    pool_->submit(this);
+                }
+            }
+        }
+
+        static void on_wait_satisfied(ac::details::wait_block *block) noexcept {
+            static_cast<wait_awaiter *>(block->context_)->complete(WAIT_OBJECT_0, nullptr);
+        }
+
+        static void on_wait_timeout(timer_entry *timer, dispatch_batch &batch) noexcept {
+            wait_awaiter *self = static_cast<wait_awaiter *>(timer->context_);
+            if (self->handle_->unregister_wait(&self->wait_block_)) {
+                self->complete(WAIT_TIMEOUT, &batch);
+            }
+        }
+
+        static void resume(task *t, callback_frame &) noexcept {
+            static_cast<wait_awaiter *>(t)->continuation_.resume();
+        }
+
+        pool_engine *pool_;
+        ac::details::handle_object *handle_;
+        std::optional<steady_clock::time_point> due_;
+        std::coroutine_handle<> continuation_;
+        ac::details::wait_block wait_block_;
+        timer_entry timer_;
+        TP_WAIT_RESULT wait_result_{WAIT_OBJECT_0};
+        std::atomic<std::uint32_t> references_{2};
+    };
+
+} // namespace ac::tp::details
+
+#endif //_AC_HELPERS_WIN32_LIBRARY_THREAD_POOL_ENGINE_HEADER_
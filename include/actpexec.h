@@ -0,0 +1,911 @@
+#ifndef _AC_HELPERS_WIN32_LIBRARY_THREAD_POOL_EXEC_HEADER_
+#define _AC_HELPERS_WIN32_LIBRARY_THREAD_POOL_EXEC_HEADER_
+
+#pragma once
+
+//
+// Senders and receivers for ac::tp, shaped after std::execution
+// (P2300), until the standard library ships it:
+//
+//   ac::tp::exec::scheduler sch{pool.get_scheduler()};
+//   auto work = ac::tp::exec::when_all(sch.schedule() | ac::tp::exec::then([] { return 1; }),
+//                                      sch.schedule_after(10ms) | ac::tp::exec::then([] { return 2; }));
+//   auto [a, b] = ac::tp::exec::sync_wait(std::move(work)).value();
+//
+// A sender describes work, connect binds it to a receiver and returns
+// an operation state, and start runs it. Receiver has set_value,
+// set_error taking std::exception_ptr, and set_stopped, all noexcept.
+// Sender lists values it completes with in value_types, a std::tuple.
+// Customization is done with member functions rather than tag_invoke.
+//
+// Operation states are not movable, and are returned by value from
+// connect, so they live on the stack or in the frame of the caller.
+// Tasks queued to the pool, timer entries and OVERLAPPED are embedded
+// in the operation states, so connect and start never allocate.
+//
+// Stop tokens are not supported, nothing in this header completes
+// with set_stopped, but adaptors forward it.
+//
+
+#include "actp.h"
+#include "actpcoro.h"
+
+#include <array>
+#include <exception>
+#include <functional>
+#include <optional>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#ifndef _WIN32
+
+namespace ac::tp::exec {
+
+    template<typename S>
+    using value_types_of_t = typename std::remove_cvref_t<S>::value_types;
+
+    template<typename S, typename R>
+    [[nodiscard]] inline auto connect(S &&sender, R &&receiver) {
+        return std::forward<S>(sender).connect(std::forward<R>(receiver));
+    }
+
+    template<typename S, typename R>
+    using connect_result_t = decltype(exec::connect(std::declval<S>(), std::declval<R>()));
+
+    template<typename O>
+    inline void start(O &operation) noexcept {
+        operation.start();
+    }
+
+    class scheduler;
+
+    template<typename S>
+    concept has_completion_scheduler = requires(S const &sender) {
+        { sender.get_completion_scheduler() } -> std::same_as<scheduler>;
+    };
+
+    namespace details {
+
+        template<typename... T>
+        using tuple_cat_t = decltype(std::tuple_cat(std::declval<T>()...));
+
+        template<typename F, typename Tuple>
+        struct apply_result;
+
+        template<typename F, typename... A>
+        struct apply_result<F, std::tuple<A...>> {
+            using type = std::invoke_result_t<F, A...>;
+        };
+
+        template<typename F, typename Tuple>
+        using apply_result_t = typename apply_result<F, Tuple>::type;
+
+        template<typename T>
+        using value_tuple_t = std::conditional_t<std::is_void_v<T>, std::tuple<>, std::tuple<T>>;
+        //
+        // While start of a when_all is running, tasks of the schedule
+        // operations it starts are collected here, and are queued with
+        // one submit_batch per pool when outermost when_all is started
+        //
+        class start_batch final {
+        public:
+            start_batch() noexcept
+                : previous_{current_} {
+                if (nullptr == previous_) {
+                    current_ = &batch_;
+                }
+            }
+
+            start_batch(start_batch const &) = delete;
+            start_batch &operator=(start_batch const &) = delete;
+
+            ~start_batch() noexcept {
+                if (nullptr == previous_) {
+                    current_ = nullptr;
+                    batch_.flush();
+                }
+            }
+
+            static void submit(tp::details::pool_engine *pool, tp::details::task *t) noexcept {
+                if (current_) {
+                    current_->add(pool, t);
+                } else {
+                    pool->submit(t);
+                }
+            }
+
+        private:
+            inline static thread_local tp::details::dispatch_batch *current_{nullptr};
+            tp::details::dispatch_batch *previous_;
+            tp::details::dispatch_batch batch_;
+        };
+
+        template<typename Fn>
+        struct adaptor_closure {
+            Fn fn_;
+
+            template<typename S>
+            [[nodiscard]] friend auto operator|(S &&sender, adaptor_closure closure) {
+                return std::move(closure.fn_)(std::forward<S>(sender));
+            }
+        };
+
+    } // namespace details
+
+    //
+    // Completes on a worker of the pool
+    //
+    class schedule_sender final {
+    public:
+        using value_types = std::tuple<>;
+
+        template<typename R>
+        class operation final: public tp::details::task {
+        public:
+            operation(tp::details::pool_engine *pool, tp::details::callback_options const &options, R receiver)
+                : pool_{pool}
+                , receiver_{std::move(receiver)} {
+                execute_ = &operation::execute;
+                options.apply(this);
+            }
+
+            operation(operation const &) = delete;
+            operation &operator=(operation const &) = delete;
+
+            void start() noexcept {
+                details::start_batch::submit(pool_, this);
+            }
+
+        private:
+            static void execute(tp::details::task *t, tp::details::callback_frame &) noexcept {
+                static_cast<operation *>(t)->receiver_.set_value();
+            }
+
+            tp::details::pool_engine *pool_;
+            R receiver_;
+        };
+
+        schedule_sender(tp::details::pool_engine *pool, tp::details::callback_options const &options) noexcept
+            : pool_{pool}
+            , options_{options} {
+        }
+
+        template<typename R>
+        [[nodiscard]] operation<std::remove_cvref_t<R>> connect(R &&receiver) const {
+            return operation<std::remove_cvref_t<R>>{pool_, options_, std::forward<R>(receiver)};
+        }
+
+        [[nodiscard]] scheduler get_completion_scheduler() const noexcept;
+
+    private:
+        tp::details::pool_engine *pool_;
+        tp::details::callback_options options_;
+    };
+
+    //
+    // Completes on a worker of the pool once due time has passed.
+    // Same as timer_work_item expiry, timer thread only queues the
+    // task of the operation.
+    //
+    class timer_sender final {
+    public:
+        using value_types = std::tuple<>;
+
+        template<typename R>
+        class operation final: public tp::details::task {
+        public:
+            operation(tp::details::pool_engine *pool,
+                      tp::details::callback_options const &options,
+                      tp::details::steady_clock::time_point due,
+                      R receiver)
+                : pool_{pool}
+                , due_{due}
+                , receiver_{std::move(receiver)} {
+                execute_ = &operation::execute;
+                options.apply(this);
+                timer_.expired_ = &operation::on_expired;
+                timer_.context_ = this;
+            }
+
+            operation(operation const &) = delete;
+            operation &operator=(operation const &) = delete;
+
+            void start() noexcept {
+                tp::details::timer_queue::instance().arm(
+                    &timer_, due_, tp::details::steady_clock::duration::zero());
+            }
+
+        private:
+            static void on_expired(tp::details::timer_entry *timer, tp::details::dispatch_batch &batch) noexcept {
+                operation *self = static_cast<operation *>(timer->context_);
+                batch.add(self->pool_, self);
+            }
+            //
+            // Timer thread might still be using the entry,
+            // wait for it before receiver can free the operation
+            //
+            static void execute(tp::details::task *t, tp::details::callback_frame &) noexcept {
+                operation *self = static_cast<operation *>(t);
+                tp::details::timer_queue::instance().disarm(&self->timer_);
+                self->receiver_.set_value();
+            }
+
+            tp::details::pool_engine *pool_;
+            tp::details::steady_clock::time_point due_;
+            tp::details::timer_entry timer_;
+            R receiver_;
+        };
+
+        timer_sender(tp::details::pool_engine *pool,
+                     tp::details::callback_options const &options,
+                     tp::details::steady_clock::time_point due) noexcept
+            : pool_{pool}
+            , options_{options}
+            , due_{due} {
+        }
+
+        template<typename R>
+        [[nodiscard]] operation<std::remove_cvref_t<R>> connect(R &&receiver) const {
+            return operation<std::remove_cvref_t<R>>{pool_, options_, due_, std::forward<R>(receiver)};
+        }
+
+        [[nodiscard]] scheduler get_completion_scheduler() const noexcept;
+
+    private:
+        tp::details::pool_engine *pool_;
+        tp::details::callback_options options_;
+        tp::details::steady_clock::time_point due_;
+    };
+
+    //
+    // Handle to a pool, and to callback parameters of the
+    // work it schedules. Cheap to copy.
+    //
+    class scheduler final {
+    public:
+        explicit scheduler(tp::details::pool_engine *pool,
+                           tp::details::callback_options const &options = tp::details::callback_options{}) noexcept
+            : pool_{pool}
+            , options_{options} {
+        }
+
+        [[nodiscard]] schedule_sender schedule() const noexcept {
+            return schedule_sender{pool_, options_};
+        }
+
+        [[nodiscard]] timer_sender schedule_after(duration const &due_time) const noexcept {
+            return timer_sender{
+                pool_,
+                options_,
+                tp::details::steady_clock::now() + std::chrono::duration_cast<tp::details::steady_clock::duration>(due_time)};
+        }
+
+        [[nodiscard]] timer_sender schedule_at(time_point const &due_time) const noexcept {
+            return timer_sender{pool_, options_, tp::details::to_steady_time_point(due_time)};
+        }
+
+        [[nodiscard]] tp::details::pool_engine *get_pool() const noexcept {
+            return pool_;
+        }
+
+        [[nodiscard]] tp::details::callback_options const &get_callback_options() const noexcept {
+            return options_;
+        }
+
+        [[nodiscard]] friend bool operator==(scheduler const &lhs, scheduler const &rhs) noexcept {
+            return lhs.pool_ == rhs.pool_ && lhs.options_.priority_ == rhs.options_.priority_ &&
+                   lhs.options_.numa_node_ == rhs.options_.numa_node_;
+        }
+
+    private:
+        tp::details::pool_engine *pool_;
+        tp::details::callback_options options_;
+    };
+
+    inline scheduler schedule_sender::get_completion_scheduler() const noexcept {
+        return scheduler{pool_, options_};
+    }
+
+    inline scheduler timer_sender::get_completion_scheduler() const noexcept {
+        return scheduler{pool_, options_};
+    }
+
+    //
+    // Completes inline with the given values
+    //
+    template<typename... V>
+    class just_sender final {
+    public:
+        using value_types = std::tuple<V...>;
+
+        template<typename R>
+        class operation final {
+        public:
+            operation(std::tuple<V...> values, R receiver)
+                : values_{std::move(values)}
+                , receiver_{std::move(receiver)} {
+            }
+
+            operation(operation const &) = delete;
+            operation &operator=(operation const &) = delete;
+
+            void start() noexcept {
+                std::apply([this](V &...values) { receiver_.set_value(std::move(values)...); }, values_);
+            }
+
+        private:
+            std::tuple<V...> values_;
+            R receiver_;
+        };
+
+        explicit just_sender(V... values)
+            : values_{std::move(values)...} {
+        }
+
+        template<typename R>
+        [[nodiscard]] operation<std::remove_cvref_t<R>> connect(R &&receiver) && {
+            return operation<std::remove_cvref_t<R>>{std::move(values_), std::forward<R>(receiver)};
+        }
+
+        template<typename R>
+        [[nodiscard]] operation<std::remove_cvref_t<R>> connect(R &&receiver) const & {
+            return operation<std::remove_cvref_t<R>>{values_, std::forward<R>(receiver)};
+        }
+
+    private:
+        std::tuple<V...> values_;
+    };
+
+    template<typename... V>
+    [[nodiscard]] inline just_sender<std::decay_t<V>...> just(V &&...values) {
+        return just_sender<std::decay_t<V>...>{std::forward<V>(values)...};
+    }
+
+    //
+    // Calls f with values of the predecessor on the thread that
+    // completed it, and completes with the result. Exception thrown
+    // by f completes with set_error.
+    //
+    template<typename S, typename F>
+    class then_sender final {
+    public:
+        using result_type = details::apply_result_t<F, value_types_of_t<S>>;
+        using value_types = details::value_tuple_t<result_type>;
+
+        template<typename R>
+        class operation final {
+        public:
+            operation(S &&sender, F f, R receiver)
+                : f_{std::move(f)}
+                , receiver_{std::move(receiver)}
+                , child_{exec::connect(std::move(sender), child_receiver{this})} {
+            }
+
+            operation(operation const &) = delete;
+            operation &operator=(operation const &) = delete;
+
+            void start() noexcept {
+                exec::start(child_);
+            }
+
+        private:
+            struct child_receiver {
+                operation *operation_;
+
+                template<typename... A>
+                void set_value(A &&...values) noexcept {
+                    operation_->complete(std::forward<A>(values)...);
+                }
+
+                void set_error(std::exception_ptr error) noexcept {
+                    operation_->receiver_.set_error(std::move(error));
+                }
+
+                void set_stopped() noexcept {
+                    operation_->receiver_.set_stopped();
+                }
+            };
+
+            template<typename... A>
+            void complete(A &&...values) noexcept {
+                if constexpr (std::is_void_v<result_type>) {
+                    try {
+                        std::invoke(f_, std::forward<A>(values)...);
+                    } catch (...) {
+                        receiver_.set_error(std::current_exception());
+                        return;
+                    }
+                    receiver_.set_value();
+                } else {
+                    std::optional<result_type> result;
+                    try {
+                        result.emplace(std::invoke(f_, std::forward<A>(values)...));
+                    } catch (...) {
+                        receiver_.set_error(std::current_exception());
+                        return;
+                    }
+                    receiver_.set_value(std::move(result.value()));
+                }
+            }
+
+            F f_;
+            R receiver_;
+            connect_result_t<S, child_receiver> child_;
+        };
+
+        then_sender(S sender, F f)
+            : sender_{std::move(sender)}
+            , f_{std::move(f)} {
+        }
+
+        template<typename R>
+        [[nodiscard]] operation<std::remove_cvref_t<R>> connect(R &&receiver) && {
+            return operation<std::remove_cvref_t<R>>{std::move(sender_), std::move(f_), std::forward<R>(receiver)};
+        }
+
+        [[nodiscard]] scheduler get_completion_scheduler() const noexcept
+            requires has_completion_scheduler<S>
+        {
+            return sender_.get_completion_scheduler();
+        }
+
+    private:
+        S sender_;
+        F f_;
+    };
+
+    template<typename S, typename F>
+    [[nodiscard]] inline then_sender<std::remove_cvref_t<S>, std::decay_t<F>> then(S &&sender, F &&f) {
+        return then_sender<std::remove_cvref_t<S>, std::decay_t<F>>{std::forward<S>(sender), std::forward<F>(f)};
+    }
+
+    template<typename F>
+    [[nodiscard]] inline auto then(F &&f) {
+        auto fn = [f = std::forward<F>(f)]<typename S>(S &&sender) mutable {
+            return exec::then(std::forward<S>(sender), std::move(f));
+        };
+        return details::adaptor_closure<decltype(fn)>{std::move(fn)};
+    }
+
+    //
+    // Starts all senders, and completes with values of all of them,
+    // in order, when the last one completes. Schedule operations of
+    // children are queued with one submit_batch per pool. If any child
+    // fails, completes with the first error once all children are done.
+    //
+    template<typename... S>
+    class when_all_sender final {
+    public:
+        using value_types = details::tuple_cat_t<value_types_of_t<S>...>;
+
+        template<typename R>
+        class operation final {
+        public:
+            operation(std::tuple<S...> &&senders, R receiver)
+                : receiver_{std::move(receiver)}
+                , children_{std::move(senders), this} {
+            }
+
+            operation(operation const &) = delete;
+            operation &operator=(operation const &) = delete;
+
+            void start() noexcept {
+                if constexpr (0 == sizeof...(S)) {
+                    receiver_.set_value();
+                } else {
+                    details::start_batch batch;
+                    start_children(std::index_sequence_for<S...>{});
+                }
+            }
+
+        private:
+            template<size_t I>
+            struct child_receiver {
+                operation *operation_;
+
+                template<typename... A>
+                void set_value(A &&...values) noexcept {
+                    std::get<I>(operation_->values_).emplace(std::forward<A>(values)...);
+                    operation_->arrive();
+                }
+
+                void set_error(std::exception_ptr error) noexcept {
+                    if (!operation_->failed_.exchange(true, std::memory_order_acq_rel)) {
+                        operation_->error_ = std::move(error);
+                    }
+                    operation_->arrive();
+                }
+
+                void set_stopped() noexcept {
+                    operation_->stopped_.store(true, std::memory_order_relaxed);
+                    operation_->arrive();
+                }
+            };
+
+            template<size_t I, typename C>
+            struct child {
+                child(C &&sender, operation *parent)
+                    : operation_{exec::connect(std::move(sender), child_receiver<I>{parent})} {
+                }
+
+                connect_result_t<C, child_receiver<I>> operation_;
+            };
+
+            template<typename Sequence>
+            struct children;
+
+            template<size_t... I>
+            struct children<std::index_sequence<I...>>: child<I, S>... {
+                children(std::tuple<S...> &&senders, operation *parent)
+                    : child<I, S>{std::get<I>(std::move(senders)), parent}... {
+                }
+            };
+
+            template<size_t... I>
+            void start_children(std::index_sequence<I...>) noexcept {
+                (exec::start(static_cast<child<I, S> &>(children_).operation_), ...);
+            }
+
+            void arrive() noexcept {
+                if (1 != remaining_.fetch_sub(1, std::memory_order_acq_rel)) {
+                    return;
+                }
+                if (failed_.load(std::memory_order_relaxed)) {
+                    receiver_.set_error(std::move(error_));
+                } else if (stopped_.load(std::memory_order_relaxed)) {
+                    receiver_.set_stopped();
+                } else {
+                    std::apply(
+                        [this](auto &...values) {
+                            std::apply([this](auto &&...v) { receiver_.set_value(std::move(v)...); },
+                                       std::tuple_cat(std::move(values.value())...));
+                        },
+                        values_);
+                }
+            }
+
+            R receiver_;
+            std::tuple<std::optional<value_types_of_t<S>>...> values_;
+            std::exception_ptr error_;
+            std::atomic<bool> failed_{false};
+            std::atomic<bool> stopped_{false};
+            std::atomic<size_t> remaining_{sizeof...(S)};
+            children<std::index_sequence_for<S...>> children_;
+        };
+
+        explicit when_all_sender(S... senders)
+            : senders_{std::move(senders)...} {
+        }
+
+        template<typename R>
+        [[nodiscard]] operation<std::remove_cvref_t<R>> connect(R &&receiver) && {
+            return operation<std::remove_cvref_t<R>>{std::move(senders_), std::forward<R>(receiver)};
+        }
+
+    private:
+        std::tuple<S...> senders_;
+    };
+
+    template<typename... S>
+    [[nodiscard]] inline when_all_sender<std::remove_cvref_t<S>...> when_all(S &&...senders) {
+        return when_all_sender<std::remove_cvref_t<S>...>{std::forward<S>(senders)...};
+    }
+
+    //
+    // Once predecessor completes, calls f(i, values...) for every i in
+    // [0, shape) on the pool that predecessor completes on, or on the
+    // current or default pool. Shape is split into one chunk per worker,
+    // and chunks are queued with one submit_batch. Completes with values
+    // of the predecessor when all chunks are done.
+    //
+    template<typename S, typename Shape, typename F>
+    class bulk_sender final {
+    public:
+        using value_types = value_types_of_t<S>;
+
+        static constexpr size_t max_chunks{64};
+
+        template<typename R>
+        class operation final {
+        public:
+            operation(S &&sender, Shape shape, F f, R receiver)
+                : shape_{shape}
+                , f_{std::move(f)}
+                , receiver_{std::move(receiver)}
+                , pool_{pool_of(sender)}
+                , child_{exec::connect(std::move(sender), child_receiver{this})} {
+            }
+
+            operation(operation const &) = delete;
+            operation &operator=(operation const &) = delete;
+
+            void start() noexcept {
+                exec::start(child_);
+            }
+
+        private:
+            struct child_receiver {
+                operation *operation_;
+
+                template<typename... A>
+                void set_value(A &&...values) noexcept {
+                    operation_->values_.emplace(std::forward<A>(values)...);
+                    operation_->run_chunks();
+                }
+
+                void set_error(std::exception_ptr error) noexcept {
+                    operation_->receiver_.set_error(std::move(error));
+                }
+
+                void set_stopped() noexcept {
+                    operation_->receiver_.set_stopped();
+                }
+            };
+
+            struct chunk final: public tp::details::task {
+                operation *operation_{nullptr};
+                Shape begin_{};
+                Shape end_{};
+            };
+
+            [[nodiscard]] static tp::details::pool_engine *pool_of(S const &sender) {
+                if constexpr (has_completion_scheduler<S>) {
+                    return sender.get_completion_scheduler().get_pool();
+                } else {
+                    return tp::details::current_or_default_pool();
+                }
+            }
+
+            void run_chunks() noexcept {
+                if (shape_ <= Shape{0}) {
+                    complete();
+                    return;
+                }
+                size_t const workers{std::max<size_t>(1, pool_->get_thread_count())};
+                size_t const count{std::min({static_cast<size_t>(shape_), workers, max_chunks})};
+                Shape const step{static_cast<Shape>(static_cast<size_t>(shape_) / count)};
+                Shape const extra{static_cast<Shape>(static_cast<size_t>(shape_) % count)};
+                remaining_.store(count, std::memory_order_relaxed);
+                Shape begin{0};
+                for (size_t i = 0; i < count; ++i) {
+                    chunk &c = chunks_[i];
+                    c.execute_ = &operation::execute_chunk;
+                    c.operation_ = this;
+                    c.begin_ = begin;
+                    c.end_ = begin + step + (static_cast<Shape>(i) < extra ? Shape{1} : Shape{0});
+                    c.next_ = (i + 1 < count) ? &chunks_[i + 1] : nullptr;
+                    begin = c.end_;
+                }
+                pool_->submit_batch(&chunks_[0], count);
+            }
+
+            static void execute_chunk(tp::details::task *t, tp::details::callback_frame &) noexcept {
+                chunk *c = static_cast<chunk *>(t);
+                operation *self = c->operation_;
+                try {
+                    for (Shape i = c->begin_; i < c->end_; ++i) {
+                        std::apply([self, i](auto &...values) { std::invoke(self->f_, i, values...); },
+                                   self->values_.value());
+                    }
+                } catch (...) {
+                    if (!self->failed_.exchange(true, std::memory_order_acq_rel)) {
+                        self->error_ = std::current_exception();
+                    }
+                }
+                if (1 == self->remaining_.fetch_sub(1, std::memory_order_acq_rel)) {
+                    self->complete();
+                }
+            }
+
+            void complete() noexcept {
+                if (failed_.load(std::memory_order_relaxed)) {
+                    receiver_.set_error(std::move(error_));
+                } else {
+                    std::apply([this](auto &...values) { receiver_.set_value(std::move(values)...); },
+                               values_.value());
+                }
+            }
+
+            Shape shape_;
+            F f_;
+            R receiver_;
+            tp::details::pool_engine *pool_;
+            std::optional<value_types> values_;
+            std::array<chunk, max_chunks> chunks_;
+            std::exception_ptr error_;
+            std::atomic<bool> failed_{false};
+            std::atomic<size_t> remaining_{0};
+            connect_result_t<S, child_receiver> child_;
+        };
+
+        bulk_sender(S sender, Shape shape, F f)
+            : sender_{std::move(sender)}
+            , shape_{shape}
+            , f_{std::move(f)} {
+        }
+
+        template<typename R>
+        [[nodiscard]] operation<std::remove_cvref_t<R>> connect(R &&receiver) && {
+            return operation<std::remove_cvref_t<R>>{
+                std::move(sender_), shape_, std::move(f_), std::forward<R>(receiver)};
+        }
+
+    private:
+        S sender_;
+        Shape shape_;
+        F f_;
+    };
+
+    template<typename S, std::integral Shape, typename F>
+    [[nodiscard]] inline bulk_sender<std::remove_cvref_t<S>, Shape, std::decay_t<F>> bulk(S &&sender,
+                                                                                          Shape shape,
+                                                                                          F &&f) {
+        return bulk_sender<std::remove_cvref_t<S>, Shape, std::decay_t<F>>{
+            std::forward<S>(sender), shape, std::forward<F>(f)};
+    }
+
+    template<std::integral Shape, typename F>
+    [[nodiscard]] inline auto bulk(Shape shape, F &&f) {
+        auto fn = [shape, f = std::forward<F>(f)]<typename S>(S &&sender) mutable {
+            return exec::bulk(std::forward<S>(sender), shape, std::move(f));
+        };
+        return details::adaptor_closure<decltype(fn)>{std::move(fn)};
+    }
+
+    //
+    // Reads or writes through async_io, and completes with io_result
+    // on the worker that ran the io handler completion. Failure to
+    // issue IO completes with set_error.
+    //
+    class io_sender final {
+    public:
+        using value_types = std::tuple<io_result>;
+
+        template<typename R>
+        class operation final: public tp::details::io_operation {
+        public:
+            operation(async_io *io,
+                      operation_t kind,
+                      void const *buffer,
+                      DWORD size,
+                      long long offset,
+                      R receiver)
+                : io_operation{io->get_io_handler(), io->get_file(), kind, buffer, size, offset, &operation::completed}
+                , receiver_{std::move(receiver)} {
+            }
+
+            void start() noexcept {
+                bool pending{false};
+                try {
+                    pending = issue();
+                } catch (...) {
+                    receiver_.set_error(std::current_exception());
+                    return;
+                }
+                if (!pending) {
+                    receiver_.set_value(io_result{get_result()});
+                }
+            }
+
+        private:
+            static void completed(io_operation *o) noexcept {
+                operation *self = static_cast<operation *>(o);
+                self->receiver_.set_value(io_result{self->get_result()});
+            }
+
+            R receiver_;
+        };
+
+        io_sender(async_io *io,
+                  tp::details::io_operation::operation_t kind,
+                  void const *buffer,
+                  DWORD size,
+                  long long offset) noexcept
+            : io_{io}
+            , kind_{kind}
+            , buffer_{buffer}
+            , size_{size}
+            , offset_{offset} {
+        }
+
+        template<typename R>
+        [[nodiscard]] operation<std::remove_cvref_t<R>> connect(R &&receiver) const {
+            return operation<std::remove_cvref_t<R>>{io_, kind_, buffer_, size_, offset_, std::forward<R>(receiver)};
+        }
+
+    private:
+        async_io *io_;
+        tp::details::io_operation::operation_t kind_;
+        void const *buffer_;
+        DWORD size_;
+        long long offset_;
+    };
+
+    [[nodiscard]] inline io_sender async_read(async_io &io, void *buffer, DWORD size, long long offset) noexcept {
+        return io_sender{&io, tp::details::io_operation::operation_t::read, buffer, size, offset};
+    }
+
+    [[nodiscard]] inline io_sender async_write(async_io &io, void const *buffer, DWORD size, long long offset) noexcept {
+        return io_sender{&io, tp::details::io_operation::operation_t::write, buffer, size, offset};
+    }
+
+    namespace details {
+
+        template<typename Values>
+        struct sync_wait_state {
+            std::optional<Values> values_;
+            std::exception_ptr error_;
+            std::atomic<std::uint32_t> done_{0};
+            //
+            // Waking a futex on the address of a state that
+            // sync_wait already destroyed is benign
+            //
+            void signal() noexcept {
+                done_.store(1, std::memory_order_release);
+                wait_on_address::wake_all(tp::details::address_of(done_));
+            }
+        };
+
+        template<typename Values>
+        struct sync_wait_receiver {
+            sync_wait_state<Values> *state_;
+
+            template<typename... A>
+            void set_value(A &&...values) noexcept {
+                state_->values_.emplace(std::forward<A>(values)...);
+                state_->signal();
+            }
+
+            void set_error(std::exception_ptr error) noexcept {
+                state_->error_ = std::move(error);
+                state_->signal();
+            }
+
+            void set_stopped() noexcept {
+                state_->signal();
+            }
+        };
+
+    } // namespace details
+
+    //
+    // Starts the sender, and blocks calling thread until it completes.
+    // Returns values, or an empty optional if sender was stopped, and
+    // rethrows the error. On a pool worker the wait is a blocking
+    // region, so the pool can start another worker.
+    //
+    template<typename S>
+    inline std::optional<value_types_of_t<S>> sync_wait(S &&sender) {
+        details::sync_wait_state<value_types_of_t<S>> state;
+        auto operation{exec::connect(std::forward<S>(sender),
+                                     details::sync_wait_receiver<value_types_of_t<S>>{&state})};
+        exec::start(operation);
+        {
+            ac::details::blocking_region region;
+            while (0 == state.done_.load(std::memory_order_acquire)) {
+                (void) wait_on_address::try_wait(tp::details::address_of(state.done_), std::uint32_t{0});
+            }
+        }
+        if (state.error_) {
+            std::rethrow_exception(state.error_);
+        }
+        return std::move(state.values_);
+    }
+
+} // namespace ac::tp::exec
+
+namespace ac::tp {
+
+    inline exec::scheduler thread_pool::get_scheduler(optional_callback_parameters const *params) noexcept {
+        callback_environment environment;
+        environment.set_thread_pool(pool_.get());
+        environment.set_callback_optional_parameters(params);
+        return exec::scheduler{environment.get_pool(), environment.get_callback_options()};
+    }
+
+} // namespace ac::tp
+
+#endif // _WIN32
+
+#endif //_AC_HELPERS_WIN32_LIBRARY_THREAD_POOL_EXEC_HEADER_
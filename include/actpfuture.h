@@ -0,0 +1,374 @@
+#ifndef _AC_HELPERS_WIN32_LIBRARY_THREAD_POOL_FUTURE_HEADER_
+#define _AC_HELPERS_WIN32_LIBRARY_THREAD_POOL_FUTURE_HEADER_
+
+#pragma once
+
+//
+// Future returned by thread_pool::async.
+//
+// Shared state is a pool task that also holds the callable, so async
+// makes one allocation from the node cache. Completion is signaled
+// on a futex, and only if somebody waits. Continuations attached
+// with then() run inline on the worker that completed the future, up
+// to a bounded depth, and are queued to the pool past it.
+// Thread that calls get() runs queued work of the pool until result
+// is ready, and only then blocks.
+//
+// Only available with the thread pool engine.
+//
+
+#include "actp.h"
+
+#include <exception>
+#include <functional>
+#include <optional>
+#include <type_traits>
+
+#ifndef _WIN32
+
+namespace ac::tp {
+
+    template<typename T>
+    class future;
+
+    namespace details {
+        //
+        // Continuations that complete inline run their own continuations
+        // inline too. Past this depth continuation is queued to the pool,
+        // so a long chain of then() does not overflow the stack.
+        //
+        inline constexpr std::uint32_t max_inline_continuations{32};
+        inline thread_local std::uint32_t inline_continuations{0};
+
+        template<typename T>
+        class future_state: public task {
+        public:
+            future_state(future_state const &) = delete;
+            future_state &operator=(future_state const &) = delete;
+
+            [[nodiscard]] bool is_ready() const noexcept {
+                return ready == ready_.load(std::memory_order_acquire);
+            }
+            //
+            // Helps the pool while there is queued work,
+            // and then blocks until result is ready
+            //
+            void wait() noexcept {
+                while (!is_ready()) {
+                    if (!pool_->run_one()) {
+                        break;
+                    }
+                }
+                if (is_ready()) {
+                    return;
+                }
+                std::uint32_t expected{pending};
+                (void) ready_.compare_exchange_strong(expected, pending_waited, std::memory_order_acq_rel);
+                ac::details::blocking_region region;
+                while (!is_ready()) {
+                    (void) wait_on_address::try_wait(address_of(ready_), pending_waited);
+                }
+            }
+
+            [[nodiscard]] T take() {
+                if (error_) {
+                    std::rethrow_exception(error_);
+                }
+                if constexpr (!std::is_void_v<T>) {
+                    return std::move(value_.value());
+                }
+            }
+            //
+            // Runs continuation inline when this state completes, or
+            // queues it if the state is already complete. Continuation
+            // takes over the reference of the future.
+            //
+            void set_continuation(task *continuation) noexcept {
+                continuation->priority_ = priority_;
+                continuation->numa_node_ = numa_node_;
+                task *expected{nullptr};
+                if (!continuation_.compare_exchange_strong(expected, continuation, std::memory_order_acq_rel)) {
+                    pool_->submit(continuation);
+                }
+            }
+
+            [[nodiscard]] pool_engine *get_pool() const noexcept {
+                return pool_;
+            }
+
+            void release() noexcept {
+                if (1 == refs_.fetch_sub(1, std::memory_order_acq_rel)) {
+                    destroy_(this);
+                }
+            }
+
+        protected:
+            using destroy_t = void (*)(future_state *) noexcept;
+            using stored_t = std::conditional_t<std::is_void_v<T>, bool, T>;
+
+            future_state(pool_engine *pool, destroy_t destroy) noexcept
+                : pool_{pool}
+                , destroy_{destroy} {
+            }
+
+            ~future_state() noexcept {
+            }
+            //
+            // Calls callback with args, and stores its result or exception
+            //
+            template<typename C, typename... A>
+            void invoke(C &callback, A &&...args) noexcept {
+                try {
+                    if constexpr (std::is_void_v<T>) {
+                        std::invoke(callback, std::forward<A>(args)...);
+                        value_.emplace(true);
+                    } else {
+                        value_.emplace(std::invoke(callback, std::forward<A>(args)...));
+                    }
+                } catch (...) {
+                    error_ = std::current_exception();
+                }
+            }
+
+            void set_error(std::exception_ptr error) noexcept {
+                error_ = std::move(error);
+            }
+            //
+            // Publishes result, runs or queues continuation, and drops
+            // reference of the task. Waiter is woken up only if it asked
+            // for it.
+            //
+            void complete(callback_frame &frame) noexcept {
+                if (pending_waited == ready_.exchange(ready, std::memory_order_acq_rel)) {
+                    wait_on_address::wake_all(address_of(ready_));
+                }
+                task *continuation{continuation_.exchange(this, std::memory_order_acq_rel)};
+                if (continuation) {
+                    if (max_inline_continuations <= inline_continuations) {
+                        pool_->submit(continuation);
+                    } else {
+                        ++inline_continuations;
+                        continuation->execute_(continuation, frame);
+                        --inline_continuations;
+                    }
+                }
+                release();
+            }
+
+            std::optional<stored_t> value_;
+            std::exception_ptr error_;
+
+        private:
+            static constexpr std::uint32_t pending{0};
+            static constexpr std::uint32_t pending_waited{1};
+            static constexpr std::uint32_t ready{2};
+
+            pool_engine *pool_;
+            destroy_t destroy_;
+            //
+            // Owned by the future and by the task
+            //
+            std::atomic<std::uint32_t> refs_{2};
+            std::atomic<std::uint32_t> ready_{pending};
+            //
+            // Points to this state once it is complete
+            //
+            std::atomic<task *> continuation_{nullptr};
+
+            template<typename U, typename F, typename A>
+            friend class continuation_task;
+        };
+
+        template<typename T, typename C>
+        class async_task final: public future_state<T> {
+        public:
+            template<typename F>
+            async_task(pool_engine *pool, F &&callback)
+                : future_state<T>{pool, &async_task::destroy}
+                , callback_(std::forward<F>(callback)) {
+                this->execute_ = &async_task::run;
+            }
+
+        private:
+            static void run(task *t, callback_frame &frame) noexcept {
+                async_task *self{static_cast<async_task *>(t)};
+                self->invoke(self->callback_);
+                self->complete(frame);
+            }
+
+            static void destroy(future_state<T> *state) noexcept {
+                node_cache<async_task>::destroy(static_cast<async_task *>(state));
+            }
+
+            C callback_;
+        };
+        //
+        // Runs callback with the value of the antecedent, or passes on
+        // its exception without calling callback
+        //
+        template<typename T, typename C, typename A>
+        class continuation_task final: public future_state<T> {
+        public:
+            template<typename F>
+            continuation_task(future_state<A> *antecedent, F &&callback)
+                : future_state<T>{antecedent->get_pool(), &continuation_task::destroy}
+                , antecedent_{antecedent}
+                , callback_(std::forward<F>(callback)) {
+                this->execute_ = &continuation_task::run;
+            }
+
+        private:
+            static void run(task *t, callback_frame &frame) noexcept {
+                continuation_task *self{static_cast<continuation_task *>(t)};
+                future_state<A> *antecedent{self->antecedent_};
+                if (antecedent->error_) {
+                    self->set_error(antecedent->error_);
+                } else if constexpr (std::is_void_v<A>) {
+                    self->invoke(self->callback_);
+                } else {
+                    self->invoke(self->callback_, std::move(antecedent->value_.value()));
+                }
+                antecedent->release();
+                self->complete(frame);
+            }
+
+            static void destroy(future_state<T> *state) noexcept {
+                node_cache<continuation_task>::destroy(static_cast<continuation_task *>(state));
+            }
+
+            future_state<A> *antecedent_;
+            C callback_;
+        };
+
+        template<typename C>
+        using async_result_t = std::invoke_result_t<std::decay_t<C> &>;
+
+        template<typename C>
+        [[nodiscard]] inline future<async_result_t<C>> async(pool_engine *pool,
+                                                             callback_options const &options,
+                                                             C &&callback) {
+            using task_t = async_task<async_result_t<C>, std::decay_t<C>>;
+            task_t *t{node_cache<task_t>::create(pool, std::forward<C>(callback))};
+            options.apply(t);
+            future<async_result_t<C>> result{t};
+            pool->submit(t);
+            return result;
+        }
+
+    } // namespace details
+
+    //
+    // Move only handle to the result of thread_pool::async. Result can
+    // be taken once, either with get() or by a continuation.
+    //
+    template<typename T>
+    class future final {
+    public:
+        future() noexcept {
+        }
+
+        explicit future(details::future_state<T> *state) noexcept
+            : state_{state} {
+        }
+
+        future(future const &) = delete;
+        future &operator=(future const &) = delete;
+
+        future(future &&other) noexcept
+            : state_{std::exchange(other.state_, nullptr)} {
+        }
+
+        future &operator=(future &&other) noexcept {
+            if (this != &other) {
+                reset();
+                state_ = std::exchange(other.state_, nullptr);
+            }
+            return *this;
+        }
+
+        ~future() noexcept {
+            reset();
+        }
+
+        [[nodiscard]] bool valid() const noexcept {
+            return nullptr != state_;
+        }
+
+        [[nodiscard]] bool is_ready() const noexcept {
+            AC_CODDING_ERROR_IF_NOT(state_);
+            return state_->is_ready();
+        }
+
+        void wait() const noexcept {
+            AC_CODDING_ERROR_IF_NOT(state_);
+            state_->wait();
+        }
+        //
+        // Returns result or rethrows exception of the callable.
+        // Future is not valid after that.
+        //
+        T get() {
+            AC_CODDING_ERROR_IF_NOT(state_);
+            state_->wait();
+            future consumed{std::move(*this)};
+            return consumed.state_->take();
+        }
+        //
+        // Returns future of callback(value). Callback runs on the worker
+        // that completes this future, or is queued to the pool if this
+        // future is already complete or too many continuations already
+        // run inline. Future is not valid after that.
+        //
+        template<typename C>
+        [[nodiscard]] auto then(C &&callback) {
+            AC_CODDING_ERROR_IF_NOT(state_);
+            using callback_t = std::decay_t<C>;
+            using result_t = typename decltype(continuation_result<callback_t>())::type;
+            using task_t = details::continuation_task<result_t, callback_t, T>;
+            task_t *t{details::node_cache<task_t>::create(state_, std::forward<C>(callback))};
+            future<result_t> result{t};
+            std::exchange(state_, nullptr)->set_continuation(t);
+            return result;
+        }
+
+    private:
+        template<typename C>
+        [[nodiscard]] static auto continuation_result() noexcept {
+            if constexpr (std::is_void_v<T>) {
+                return std::type_identity<std::invoke_result_t<C &>>{};
+            } else {
+                return std::type_identity<std::invoke_result_t<C &, T>>{};
+            }
+        }
+
+        void reset() noexcept {
+            if (state_) {
+                std::exchange(state_, nullptr)->release();
+            }
+        }
+
+        details::future_state<T> *state_{nullptr};
+    };
+
+    template<typename C>
+    inline future<std::invoke_result_t<std::decay_t<C> &>> thread_pool::async(C &&callback,
+                                                                 optional_callback_parameters const *params) {
+        callback_environment environment;
+        environment.set_thread_pool(pool_.get());
+        environment.set_callback_optional_parameters(params);
+        return details::async(environment.get_pool(), environment.get_callback_options(), std::forward<C>(callback));
+    }
+    //
+    // Runs callback on the current pool, or on the default pool
+    // when called outside of a pool
+    //
+    template<typename C>
+    [[nodiscard]] inline future<details::async_result_t<C>> async(C &&callback) {
+        return details::async(details::current_or_default_pool(), details::callback_options{}, std::forward<C>(callback));
+    }
+
+} // namespace ac::tp
+
+#endif // _WIN32
+
+#endif //_AC_HELPERS_WIN32_LIBRARY_THREAD_POOL_FUTURE_HEADER_
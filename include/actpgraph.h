@@ -0,0 +1,242 @@
+#ifndef _AC_HELPERS_WIN32_LIBRARY_THREAD_POOL_GRAPH_HEADER_
+#define _AC_HELPERS_WIN32_LIBRARY_THREAD_POOL_GRAPH_HEADER_
+
+#pragma once
+
+//
+// Graph of callbacks with dependencies that runs on a thread pool.
+//
+// Node is queued as soon as all nodes it depends on are done. A
+// finishing node runs the first successor that became ready inline on
+// the same worker, and queues the rest with one batch. Nodes embed
+// their pool tasks, so running a built graph again does not allocate.
+//
+// Only available with the thread pool engine.
+//
+
+#include "actp.h"
+
+#include <deque>
+#include <exception>
+#include <vector>
+
+#ifndef _WIN32
+
+namespace ac::tp {
+
+    class task_graph final {
+    public:
+        using node_index = size_t;
+
+        task_graph() noexcept {
+        }
+
+        task_graph(task_graph const &) = delete;
+        task_graph(task_graph &&) = delete;
+        task_graph &operator=(task_graph const &) = delete;
+        task_graph &operator=(task_graph &&) = delete;
+
+        ~task_graph() noexcept {
+            AC_CODDING_ERROR_IF(is_running());
+        }
+        //
+        // Adds a node, callback is called as
+        // callback(callback_instance &)
+        //
+        template<typename C>
+        [[nodiscard]] node_index add(C &&callback) {
+            AC_CODDING_ERROR_IF(is_running());
+            nodes_.emplace_back(this, nodes_.size(), std::forward<C>(callback));
+            validated_ = false;
+            return nodes_.size() - 1;
+        }
+        //
+        // after runs only once before is done
+        //
+        void precede(node_index before, node_index after) {
+            AC_CODDING_ERROR_IF(is_running());
+            AC_CODDING_ERROR_IF(nodes_.size() <= before || nodes_.size() <= after);
+            nodes_[before].successors_.push_back(&nodes_[after]);
+            ++nodes_[after].predecessors_;
+            validated_ = false;
+        }
+
+        [[nodiscard]] size_t size() const noexcept {
+            return nodes_.size();
+        }
+
+        [[nodiscard]] bool is_running() const noexcept {
+            return 0 != outstanding_.load(std::memory_order_acquire);
+        }
+        //
+        // Queues nodes that do not depend on anything. Throws if
+        // graph has a cycle. Graph must not be changed until wait
+        // returns.
+        //
+        void start(thread_pool &pool, optional_callback_parameters const *params = nullptr) {
+            AC_CODDING_ERROR_IF(is_running());
+            if (!validated_) {
+                validate();
+            }
+            if (nodes_.empty()) {
+                return;
+            }
+            callback_environment environment;
+            environment.set_thread_pool(pool.get_handle());
+            environment.set_callback_optional_parameters(params);
+            pool_ = environment.get_pool();
+            error_ = nullptr;
+            failed_.store(false, std::memory_order_relaxed);
+            details::task *first{nullptr};
+            details::task **tail{&first};
+            size_t count{0};
+            for (node &n : nodes_) {
+                environment.get_callback_options().apply(&n);
+                n.remaining_.store(n.predecessors_, std::memory_order_relaxed);
+                if (0 == n.predecessors_) {
+                    *tail = &n;
+                    tail = &n.next_;
+                    ++count;
+                }
+            }
+            *tail = nullptr;
+            outstanding_.store(static_cast<std::uint32_t>(nodes_.size()), std::memory_order_release);
+            pool_->submit_batch(first, count);
+        }
+        //
+        // Helps the pool while there is queued work, and then waits for
+        // all nodes to finish. Rethrows first exception thrown by a
+        // node. Nodes are skipped after a node throws.
+        //
+        void wait() {
+            while (is_running()) {
+                if (!pool_->run_one()) {
+                    break;
+                }
+            }
+            std::uint32_t outstanding = outstanding_.load(std::memory_order_acquire);
+            if (0 != outstanding) {
+                ac::details::blocking_region region;
+                while (0 != outstanding) {
+                    (void) wait_on_address::try_wait(details::address_of(outstanding_), outstanding);
+                    outstanding = outstanding_.load(std::memory_order_acquire);
+                }
+            }
+            if (failed_.load(std::memory_order_acquire)) {
+                std::rethrow_exception(std::exchange(error_, nullptr));
+            }
+        }
+
+        void run(thread_pool &pool, optional_callback_parameters const *params = nullptr) {
+            start(pool, params);
+            wait();
+        }
+
+    private:
+        struct node final: public details::task {
+            template<typename C>
+            node(task_graph *graph, node_index index, C &&callback)
+                : graph_{graph}
+                , index_{index}
+                , callback_(std::forward<C>(callback)) {
+                execute_ = &task_graph::execute;
+            }
+
+            task_graph *graph_;
+            node_index index_;
+            work_item_callback callback_;
+            std::vector<node *> successors_;
+            std::uint32_t predecessors_{0};
+            std::atomic<std::uint32_t> remaining_{0};
+        };
+        //
+        // Kahn's algorithm, runs only after graph was changed
+        //
+        void validate() {
+            std::vector<std::uint32_t> remaining;
+            std::vector<node *> ready;
+            remaining.reserve(nodes_.size());
+            for (node &n : nodes_) {
+                remaining.push_back(n.predecessors_);
+                if (0 == n.predecessors_) {
+                    ready.push_back(&n);
+                }
+            }
+            size_t visited{0};
+            while (!ready.empty()) {
+                node *n = ready.back();
+                ready.pop_back();
+                ++visited;
+                for (node *successor : n->successors_) {
+                    if (0 == --remaining[successor->index_]) {
+                        ready.push_back(successor);
+                    }
+                }
+            }
+            if (visited != nodes_.size()) {
+                AC_THROW(ERROR_INVALID_PARAMETER, "task_graph has a cycle");
+            }
+            validated_ = true;
+        }
+
+        static void execute(details::task *t, details::callback_frame &frame) noexcept {
+            node *n{static_cast<node *>(t)};
+            task_graph *graph{n->graph_};
+            while (n) {
+                n = graph->run_node(n, frame);
+            }
+        }
+        //
+        // Runs node and schedules successors that became ready.
+        // Returns a successor to run inline. Graph can be gone once
+        // the last node is done, so nothing touches it after that.
+        //
+        [[nodiscard]] node *run_node(node *n, details::callback_frame &frame) noexcept {
+            if (!failed_.load(std::memory_order_relaxed)) {
+                try {
+                    callback_instance inst{frame};
+                    n->callback_(inst);
+                } catch (...) {
+                    if (!failed_.exchange(true, std::memory_order_acq_rel)) {
+                        error_ = std::current_exception();
+                    }
+                }
+            }
+            node *inline_node{nullptr};
+            details::task *first{nullptr};
+            details::task **tail{&first};
+            size_t count{0};
+            for (node *successor : n->successors_) {
+                if (1 == successor->remaining_.fetch_sub(1, std::memory_order_acq_rel)) {
+                    if (nullptr == inline_node) {
+                        inline_node = successor;
+                    } else {
+                        *tail = successor;
+                        tail = &successor->next_;
+                        ++count;
+                    }
+                }
+            }
+            *tail = nullptr;
+            if (first) {
+                pool_->submit_batch(first, count);
+            }
+            if (1 == outstanding_.fetch_sub(1, std::memory_order_acq_rel)) {
+                wait_on_address::wake_all(details::address_of(outstanding_));
+            }
+            return inline_node;
+        }
+
+        std::deque<node> nodes_;
+        bool validated_{true};
+        details::pool_engine *pool_{nullptr};
+        std::atomic<std::uint32_t> outstanding_{0};
+        std::atomic<bool> failed_{false};
+        std::exception_ptr error_;
+    };
+
+} // namespace ac::tp
+
+#endif // _WIN32
+
+#endif //_AC_HELPERS_WIN32_LIBRARY_THREAD_POOL_GRAPH_HEADER_
@@ -0,0 +1,470 @@
+#ifndef _AC_HELPERS_WIN32_LIBRARY_THREAD_POOL_PARALLEL_HEADER_
+#define _AC_HELPERS_WIN32_LIBRARY_THREAD_POOL_PARALLEL_HEADER_
+
+#pragma once
+
+//
+// Parallel loops on ac::tp::thread_pool. Calling thread runs the loop
+// too, and returns when all iterations are done.
+//
+// Range is split lazily. An executor runs its range grain iterations
+// at a time, and between chunks it splits the rest of the range in
+// half and queues the upper half only if there is an idle worker, and
+// the previous half it queued was already taken. If nobody took it,
+// the executor takes it back when it is done with its own range. Loops
+// where every worker is busy run with almost no splitting, and idle
+// workers get work in O(log n) splits.
+//
+// Loops over contiguous ranges split at cache line boundaries, so two
+// workers never write to the same cache line.
+//
+// Only available with the thread pool engine.
+//
+
+#include "actp.h"
+
+#include <algorithm>
+#include <exception>
+#include <iterator>
+#include <numeric>
+#include <optional>
+#include <ranges>
+#include <vector>
+
+#ifndef _WIN32
+
+namespace ac::tp {
+
+    inline constexpr size_t cache_line_size{64};
+
+    namespace details {
+        //
+        // Boundaries of the chunks. Split points are multiples of
+        // alignment_ counted from anchor_.
+        //
+        struct loop_partition {
+            size_t grain_{1};
+            size_t alignment_{1};
+            size_t anchor_{0};
+
+            [[nodiscard]] size_t split_point(size_t begin, size_t end) const noexcept {
+                size_t mid = begin + (end - begin) / 2;
+                if (1 < alignment_ && anchor_ <= mid) {
+                    mid = anchor_ + ((mid - anchor_) / alignment_) * alignment_;
+                }
+                return mid;
+            }
+        };
+        //
+        // Alignment and anchor that put split points of a loop over
+        // elements starting at first on cache line boundaries
+        //
+        template<typename T>
+        [[nodiscard]] inline loop_partition make_partition(T const *first, size_t grain) noexcept {
+            loop_partition partition;
+            if (0 == cache_line_size % sizeof(T)) {
+                partition.alignment_ = cache_line_size / sizeof(T);
+                size_t const misalignment{reinterpret_cast<std::uintptr_t>(first) % cache_line_size};
+                if (0 == misalignment % sizeof(T)) {
+                    partition.anchor_ = ((cache_line_size - misalignment) % cache_line_size) / sizeof(T);
+                }
+            }
+            partition.grain_ = (0 == grain) ? partition.alignment_ * 4 : grain;
+            partition.grain_ = std::max(partition.grain_, size_t{1});
+            return partition;
+        }
+
+        [[nodiscard]] inline loop_partition make_partition(size_t grain) noexcept {
+            loop_partition partition;
+            partition.grain_ = (0 == grain) ? cache_line_size : grain;
+            return partition;
+        }
+
+        struct no_result {};
+        //
+        // One parallel loop. Body is called as body(begin, end, result)
+        // for consecutive chunks of [0, count). Result is a partial
+        // result of a range, they are combined in range order.
+        //
+        // Ranges queued to the pool are owned by the loop, and are freed
+        // when the loop is done. pending_ counts ranges that are queued
+        // or running on a worker, caller waits for it to drop to zero.
+        //
+        template<typename Result, typename Body>
+        class parallel_loop final {
+        public:
+            using result_t = std::conditional_t<std::is_void_v<Result>, no_result, Result>;
+
+            parallel_loop(pool_engine *pool, loop_partition const &partition, Body &body, result_t const &identity)
+                : pool_{pool}
+                , partition_{partition}
+                , body_{body}
+                , identity_{identity} {
+            }
+
+            parallel_loop(parallel_loop const &) = delete;
+            parallel_loop &operator=(parallel_loop const &) = delete;
+
+            ~parallel_loop() noexcept {
+                range *r = ranges_.load(std::memory_order_acquire);
+                while (r) {
+                    range *next = r->all_next_;
+                    node_cache<range>::destroy(r);
+                    r = next;
+                }
+            }
+
+            [[nodiscard]] result_t run(size_t count) {
+                root_.loop_ = this;
+                root_.begin_ = 0;
+                root_.end_ = count;
+                root_.taken_.store(true, std::memory_order_relaxed);
+                process(&root_);
+                std::uint32_t pending = pending_.load(std::memory_order_acquire);
+                if (0 != pending) {
+                    ac::details::blocking_region region;
+                    while (0 != pending) {
+                        (void) wait_on_address::try_wait(address_of(pending_), pending);
+                        pending = pending_.load(std::memory_order_acquire);
+                    }
+                }
+                if (failed_.load(std::memory_order_acquire)) {
+                    std::rethrow_exception(error_);
+                }
+                return combine();
+            }
+
+        private:
+            struct range final: public task {
+                parallel_loop *loop_{nullptr};
+                size_t begin_{0};
+                size_t end_{0};
+                //
+                // Link on the stack of ranges executor queued,
+                // and on the list of all ranges of the loop
+                //
+                range *local_next_{nullptr};
+                range *all_next_{nullptr};
+                std::atomic<bool> taken_{false};
+                std::optional<result_t> result_;
+            };
+
+            static void execute(task *t, callback_frame &) noexcept {
+                range *r = static_cast<range *>(t);
+                parallel_loop *loop = r->loop_;
+                if (!r->taken_.exchange(true, std::memory_order_acq_rel)) {
+                    loop->process(r);
+                }
+                if (1 == loop->pending_.fetch_sub(1, std::memory_order_acq_rel)) {
+                    wait_on_address::wake_all(address_of(loop->pending_));
+                }
+            }
+            //
+            // Runs the range, and then ranges it queued that nobody
+            // has taken, most recently queued first
+            //
+            void process(range *r) noexcept {
+                range *stack{nullptr};
+                while (r) {
+                    run_range(r, stack);
+                    r = nullptr;
+                    while (stack && nullptr == r) {
+                        range *top = stack;
+                        stack = top->local_next_;
+                        if (!top->taken_.exchange(true, std::memory_order_acq_rel)) {
+                            r = top;
+                        }
+                    }
+                }
+            }
+
+            [[nodiscard]] bool should_split(range const *stack) const noexcept {
+                return (nullptr == stack || stack->taken_.load(std::memory_order_relaxed)) &&
+                       0 != pool_->get_idle_count();
+            }
+
+            void run_range(range *r, range *&stack) noexcept {
+                result_t result{identity_};
+                size_t begin = r->begin_;
+                try {
+                    while (r->end_ - begin > partition_.grain_) {
+                        if (failed_.load(std::memory_order_relaxed)) {
+                            return;
+                        }
+                        if (r->end_ - begin >= 2 * partition_.grain_ && should_split(stack)) {
+                            size_t const mid = partition_.split_point(begin, r->end_);
+                            if (begin < mid && mid < r->end_ && spawn(mid, r->end_, stack)) {
+                                r->end_ = mid;
+                                continue;
+                            }
+                        }
+                        body_(begin, begin + partition_.grain_, result);
+                        begin += partition_.grain_;
+                    }
+                    if (begin < r->end_ && !failed_.load(std::memory_order_relaxed)) {
+                        body_(begin, r->end_, result);
+                    }
+                    r->result_.emplace(std::move(result));
+                } catch (...) {
+                    if (!failed_.exchange(true, std::memory_order_acq_rel)) {
+                        error_ = std::current_exception();
+                    }
+                }
+            }
+
+            [[nodiscard]] bool spawn(size_t begin, size_t end, range *&stack) noexcept {
+                range *r{nullptr};
+                try {
+                    r = node_cache<range>::create();
+                } catch (...) {
+                    return false;
+                }
+                r->execute_ = &parallel_loop::execute;
+                r->loop_ = this;
+                r->begin_ = begin;
+                r->end_ = end;
+                r->all_next_ = ranges_.load(std::memory_order_relaxed);
+                while (!ranges_.compare_exchange_weak(
+                    r->all_next_, r, std::memory_order_release, std::memory_order_relaxed)) {
+                }
+                r->local_next_ = stack;
+                stack = r;
+                pending_.fetch_add(1, std::memory_order_relaxed);
+                pool_->submit(r);
+                return true;
+            }
+
+            [[nodiscard]] result_t combine() {
+                if constexpr (std::is_void_v<Result>) {
+                    return result_t{};
+                } else {
+                    range *first = ranges_.load(std::memory_order_acquire);
+                    if (nullptr == first) {
+                        return std::move(root_.result_.value());
+                    }
+                    std::vector<range *> ranges{&root_};
+                    for (range *r = first; r; r = r->all_next_) {
+                        ranges.push_back(r);
+                    }
+                    std::sort(ranges.begin(), ranges.end(), [](range const *lhs, range const *rhs) {
+                        return lhs->begin_ < rhs->begin_;
+                    });
+                    result_t result{std::move(ranges.front()->result_.value())};
+                    for (size_t i = 1; i < ranges.size(); ++i) {
+                        body_.combine(result, std::move(ranges[i]->result_.value()));
+                    }
+                    return result;
+                }
+            }
+
+            pool_engine *pool_;
+            loop_partition partition_;
+            Body &body_;
+            result_t const &identity_;
+            range root_;
+            std::atomic<range *> ranges_{nullptr};
+            std::atomic<std::uint32_t> pending_{0};
+            std::atomic<bool> failed_{false};
+            std::exception_ptr error_;
+        };
+
+        template<typename F>
+        struct for_body {
+            F &f_;
+
+            void operator()(size_t begin, size_t end, no_result &) {
+                for (size_t i = begin; i < end; ++i) {
+                    f_(i);
+                }
+            }
+        };
+
+        template<typename T, typename Map, typename Combine>
+        struct reduce_body {
+            Map &map_;
+            Combine &combine_;
+
+            void operator()(size_t begin, size_t end, T &result) {
+                for (size_t i = begin; i < end; ++i) {
+                    result = combine_(std::move(result), map_(i));
+                }
+            }
+
+            void combine(T &result, T &&other) {
+                result = combine_(std::move(result), std::move(other));
+            }
+        };
+
+        template<typename Result, typename Body>
+        [[nodiscard]] inline auto run_parallel_loop(pool_engine *pool,
+                                                    size_t count,
+                                                    loop_partition const &partition,
+                                                    Body &body,
+                                                    typename parallel_loop<Result, Body>::result_t const &identity) {
+            if (count <= partition.grain_ || 0 == pool->get_idle_count()) {
+                //
+                // Nobody would take a split, run it inline. Pool is
+                // never touched for small and empty ranges.
+                //
+                typename parallel_loop<Result, Body>::result_t result{identity};
+                if (0 != count) {
+                    body(0, count, result);
+                }
+                return result;
+            }
+            parallel_loop<Result, Body> loop{pool, partition, body, identity};
+            return loop.run(count);
+        }
+
+    } // namespace details
+
+    //
+    // Calls f(i) for every i in [first, last). Exception thrown by f
+    // stops the loop, and is rethrown once running chunks are done.
+    //
+    template<std::integral I, typename F>
+    inline void parallel_for(thread_pool &pool, I first, I last, F &&f, size_t grain = 0) {
+        if (last <= first) {
+            return;
+        }
+        auto index = [first, &f](size_t i) { f(static_cast<I>(first + static_cast<I>(i))); };
+        details::for_body<decltype(index)> body{index};
+        (void) details::run_parallel_loop<void>(pool.get_handle(),
+                                                static_cast<size_t>(last - first),
+                                                details::make_partition(grain),
+                                                body,
+                                                details::no_result{});
+    }
+    //
+    // Calls f(element) for every element of a contiguous range,
+    // chunks start on cache line boundaries
+    //
+    template<std::ranges::contiguous_range R, typename F>
+        requires std::ranges::sized_range<R>
+    inline void parallel_for(thread_pool &pool, R &&range, F &&f, size_t grain = 0) {
+        auto *data = std::ranges::data(range);
+        size_t const count{static_cast<size_t>(std::ranges::size(range))};
+        if (0 == count) {
+            return;
+        }
+        auto index = [data, &f](size_t i) { f(data[i]); };
+        details::for_body<decltype(index)> body{index};
+        (void) details::run_parallel_loop<void>(
+            pool.get_handle(), count, details::make_partition(data, grain), body, details::no_result{});
+    }
+    //
+    // Returns combine of identity and map(i) for every i in [first,
+    // last). combine has to be associative, partial results are
+    // combined in index order.
+    //
+    template<std::integral I, typename T, typename Map, typename Combine>
+    [[nodiscard]] inline T parallel_reduce(
+        thread_pool &pool, I first, I last, T identity, Map &&map, Combine &&combine, size_t grain = 0) {
+        if (last <= first) {
+            return identity;
+        }
+        auto index = [first, &map](size_t i) { return map(static_cast<I>(first + static_cast<I>(i))); };
+        details::reduce_body<T, decltype(index), std::remove_reference_t<Combine>> body{index, combine};
+        return details::run_parallel_loop<T>(
+            pool.get_handle(), static_cast<size_t>(last - first), details::make_partition(grain), body, identity);
+    }
+    //
+    // Returns combine of identity and all elements of a contiguous range
+    //
+    template<std::ranges::contiguous_range R, typename T, typename Combine>
+        requires std::ranges::sized_range<R>
+    [[nodiscard]] inline T parallel_reduce(thread_pool &pool, R &&range, T identity, Combine &&combine, size_t grain = 0) {
+        auto *data = std::ranges::data(range);
+        size_t const count{static_cast<size_t>(std::ranges::size(range))};
+        if (0 == count) {
+            return identity;
+        }
+        auto element = [data](size_t i) -> decltype(auto) { return data[i]; };
+        details::reduce_body<T, decltype(element), std::remove_reference_t<Combine>> body{element, combine};
+        return details::run_parallel_loop<T>(
+            pool.get_handle(), count, details::make_partition(data, grain), body, identity);
+    }
+    //
+    // Inclusive scan, same as std::inclusive_scan(first, last, out, op, init).
+    // op has to be associative. Input is split in blocks on cache line
+    // boundaries. First pass reduces every block, then block sums are
+    // scanned on the calling thread, and the second pass scans every
+    // block starting from the sum of the blocks before it.
+    //
+    template<std::random_access_iterator In, std::random_access_iterator Out, typename Op, typename T>
+    inline Out parallel_scan(thread_pool &pool, In first, In last, Out out, Op &&op, T init, size_t grain = 0) {
+        size_t const count{static_cast<size_t>(last - first)};
+        if (0 == count) {
+            return out;
+        }
+        details::loop_partition partition{details::make_partition(grain)};
+        if constexpr (std::contiguous_iterator<In>) {
+            partition = details::make_partition(std::to_address(first), grain);
+        }
+        size_t const workers{std::max<size_t>(1, pool.get_thread_count())};
+        size_t block_size{std::max(partition.grain_, (count + workers * 4 - 1) / (workers * 4))};
+        if (1 < partition.alignment_) {
+            block_size = ((block_size + partition.alignment_ - 1) / partition.alignment_) * partition.alignment_;
+        }
+        if (count <= block_size || 0 == pool.get_thread_count()) {
+            return std::inclusive_scan(first, last, out, op, std::move(init));
+        }
+        //
+        // First block ends on the first boundary after anchor
+        //
+        std::vector<size_t> bounds{0};
+        size_t next{partition.anchor_ ? partition.anchor_ : block_size};
+        while (next < count) {
+            bounds.push_back(next);
+            next += block_size;
+        }
+        bounds.push_back(count);
+        size_t const blocks{bounds.size() - 1};
+
+        struct alignas(cache_line_size) block_sum {
+            std::optional<T> value_;
+        };
+        std::vector<block_sum> sums(blocks);
+        parallel_for(
+            pool,
+            size_t{0},
+            blocks,
+            [&](size_t block) {
+                In it{first + static_cast<std::ptrdiff_t>(bounds[block])};
+                In const end{first + static_cast<std::ptrdiff_t>(bounds[block + 1])};
+                T sum{*it};
+                for (++it; it != end; ++it) {
+                    sum = op(std::move(sum), *it);
+                }
+                sums[block].value_.emplace(std::move(sum));
+            },
+            1);
+        //
+        // Turn block sums into the value each block starts from
+        //
+        T carry{std::move(init)};
+        for (block_sum &sum : sums) {
+            T start{carry};
+            carry = op(std::move(carry), std::move(sum.value_.value()));
+            sum.value_.emplace(std::move(start));
+        }
+        parallel_for(
+            pool,
+            size_t{0},
+            blocks,
+            [&](size_t block) {
+                (void) std::inclusive_scan(first + static_cast<std::ptrdiff_t>(bounds[block]),
+                                           first + static_cast<std::ptrdiff_t>(bounds[block + 1]),
+                                           out + static_cast<std::ptrdiff_t>(bounds[block]),
+                                           op,
+                                           std::move(sums[block].value_.value()));
+            },
+            1);
+        return out + static_cast<std::ptrdiff_t>(count);
+    }
+
+} // namespace ac::tp
+
+#endif // _WIN32
+
+#endif //_AC_HELPERS_WIN32_LIBRARY_THREAD_POOL_PARALLEL_HEADER_
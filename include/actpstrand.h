@@ -0,0 +1,200 @@
+#ifndef _AC_HELPERS_WIN32_LIBRARY_THREAD_POOL_STRAND_HEADER_
+#define _AC_HELPERS_WIN32_LIBRARY_THREAD_POOL_STRAND_HEADER_
+
+#pragma once
+
+//
+// Strand runs callbacks posted to it one at a time, in the order they
+// were posted, on workers of a thread pool.
+//
+// Callbacks are pushed to a lock free stack. Strand posts its work
+// item only when it goes from empty to non-empty, and that callback
+// runs up to batch_size callbacks before it yields the worker and
+// posts the work item again. Callbacks of a strand never run at the
+// same time, and no worker blocks waiting for a strand.
+//
+// Callbacks of one batch share the callback_instance of the work item,
+// so an action requested through it, like setting an event on return,
+// happens when the batch is done.
+//
+
+#include "actp.h"
+
+namespace ac::tp {
+
+    class strand final {
+    public:
+        static constexpr std::uint32_t default_batch_size{64};
+
+        explicit strand(thread_pool &pool,
+                        std::uint32_t batch_size = default_batch_size,
+                        optional_callback_parameters const *params = nullptr)
+            : batch_size_{batch_size ? batch_size : 1}
+            , work_{pool.make_work_item([this](callback_instance &instance) { run(instance); }, params)} {
+        }
+        //
+        // Strand on the default pool
+        //
+        explicit strand(std::uint32_t batch_size = default_batch_size)
+            : batch_size_{batch_size ? batch_size : 1}
+            , work_{make_work_item([this](callback_instance &instance) { run(instance); })} {
+        }
+
+        strand(strand const &) = delete;
+        strand(strand &&) = delete;
+        strand &operator=(strand const &) = delete;
+        strand &operator=(strand &&) = delete;
+        //
+        // Waits for posted callbacks to run
+        //
+        ~strand() noexcept {
+            join();
+        }
+        //
+        // Callback is called as callback(callback_instance &)
+        // after all callbacks posted before it
+        //
+        template<typename C>
+        void post(C &&callback) {
+            item *i{details::node_cache<item>::create(std::forward<C>(callback))};
+            //
+            // Count goes up before the callback is visible, so the
+            // work item never runs more callbacks than it was counted.
+            // Work item that finds nothing yet posts itself again.
+            //
+            bool const schedule{0 == (pending_.fetch_add(1, std::memory_order_acq_rel) & count_mask)};
+            i->next_ = posted_.load(std::memory_order_relaxed);
+            while (!posted_.compare_exchange_weak(i->next_, i, std::memory_order_release, std::memory_order_relaxed)) {
+            }
+            if (schedule) {
+                work_->post();
+            }
+        }
+        //
+        // Waits until all callbacks posted so far ran. Must not be
+        // called from a callback of this strand. Any number of threads
+        // can join at the same time.
+        //
+        void join() noexcept {
+            AC_CODDING_ERROR_IF(running_in_this_thread());
+            std::uint32_t pending{pending_.load(std::memory_order_acquire)};
+            if (0 == (pending & count_mask)) {
+                return;
+            }
+            while (0 != (pending & count_mask)) {
+                //
+                // Only the callback clears joining bit, once count
+                // drops to zero, so it cannot be lost for other joiners
+                //
+                if (0 == (pending & joining) &&
+                    !pending_.compare_exchange_weak(
+                        pending, pending | joining, std::memory_order_acq_rel, std::memory_order_acquire)) {
+                    continue;
+                }
+                wait_on_address::wait(pending_address(), pending | joining);
+                pending = pending_.load(std::memory_order_acquire);
+            }
+        }
+
+        [[nodiscard]] bool running_in_this_thread() const noexcept {
+            return this == current_;
+        }
+
+        [[nodiscard]] bool is_idle() const noexcept {
+            return 0 == (pending_.load(std::memory_order_acquire) & count_mask);
+        }
+
+    private:
+        struct item final {
+            template<typename C>
+            explicit item(C &&callback)
+                : callback_(std::forward<C>(callback)) {
+            }
+
+            item *next_{nullptr};
+            work_item_callback callback_;
+        };
+        //
+        // pending_ counts callbacks that were posted and did not run
+        // yet, high bit is set while somebody waits in join
+        //
+        static constexpr std::uint32_t joining{0x80000000};
+        static constexpr std::uint32_t count_mask{~joining};
+
+        void run(callback_instance &instance) noexcept {
+            strand const *const outer{std::exchange(current_, this)};
+            std::uint32_t ran{0};
+            while (ran < batch_size_) {
+                if (nullptr == ready_) {
+                    ready_ = take_posted();
+                    if (nullptr == ready_) {
+                        break;
+                    }
+                }
+                item *i{std::exchange(ready_, ready_->next_)};
+                i->callback_(instance);
+                details::node_cache<item>::destroy(i);
+                ++ran;
+            }
+            current_ = outer;
+            //
+            // Joiners can return as soon as the count drops to zero.
+            // Destructor of the work item waits for this callback to
+            // return, so the strand stays valid until then.
+            //
+            std::uint32_t pending{pending_.load(std::memory_order_relaxed)};
+            std::uint32_t remaining{0};
+            do {
+                remaining = (pending & count_mask) - ran;
+            } while (!pending_.compare_exchange_weak(pending,
+                                                     remaining ? (pending & joining) | remaining : 0,
+                                                     std::memory_order_acq_rel,
+                                                     std::memory_order_relaxed));
+            if (remaining) {
+                work_->post();
+            } else if (pending & joining) {
+                wait_on_address::wake_all(pending_address());
+            }
+        }
+
+        [[nodiscard]] std::uint32_t const volatile *pending_address() const noexcept {
+            return reinterpret_cast<std::uint32_t const volatile *>(&pending_);
+        }
+        //
+        // Takes everything posted so far, and reverses
+        // it to the order it was posted in
+        //
+        [[nodiscard]] item *take_posted() noexcept {
+            item *i{posted_.exchange(nullptr, std::memory_order_acquire)};
+            item *ordered{nullptr};
+            while (i) {
+                item *next{i->next_};
+                i->next_ = ordered;
+                ordered = i;
+                i = next;
+            }
+            return ordered;
+        }
+        //
+        // Posted callbacks, newest first
+        //
+        std::atomic<item *> posted_{nullptr};
+        //
+        // Callbacks taken from posted_ that did not run yet, oldest
+        // first. Only the running callback touches it.
+        //
+        item *ready_{nullptr};
+        std::atomic<std::uint32_t> pending_{0};
+        std::uint32_t batch_size_;
+        //
+        // Declared last, so it is destroyed first, and waits for the
+        // running callback before the rest of the strand goes away
+        //
+        work_item_ptr work_;
+
+        inline static thread_local strand const *current_{nullptr};
+    };
+
+} // namespace ac::tp
+
+#endif //_AC_HELPERS_WIN32_LIBRARY_THREAD_POOL_STRAND_HEADER_
@@ -3,13 +3,98 @@
 
 #pragma once
 
-#include <windows.h>
 #include "accommon.h"
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstring>
+#include <mutex>
+#include <span>
+#include <type_traits>
+
+#ifdef _WIN32
 #pragma comment(lib, "Synchronization.lib")
+#else
+#include <linux/futex.h>
+#include <linux/membarrier.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#endif
 
 namespace ac {
 
+    namespace details {
+        //
+        // Hint to the processor that thread is spinning
+        //
+        inline void cpu_relax() noexcept {
+#if defined(_WIN32)
+            YieldProcessor();
+#elif defined(__x86_64__) || defined(__i386__)
+            __builtin_ia32_pause();
+#elif defined(__aarch64__)
+            asm volatile("yield" ::: "memory");
+#else
+            std::atomic_signal_fence(std::memory_order_seq_cst);
+#endif
+        }
+
+        template<typename T>
+        using address_word_t = std::conditional_t<
+            1 == sizeof(T),
+            std::uint8_t,
+            std::conditional_t<2 == sizeof(T), std::uint16_t, std::conditional_t<4 == sizeof(T), std::uint32_t, std::uint64_t>>>;
+        //
+        // Values are compared as words of the same size,
+        // same as WaitOnAddress compares bytes
+        //
+        template<typename T>
+        [[nodiscard]] inline address_word_t<T> to_address_word(T const &value) noexcept {
+            address_word_t<T> word{0};
+            std::memcpy(&word, &value, sizeof(word));
+            return word;
+        }
+
+        template<typename T>
+        [[nodiscard]] inline address_word_t<T> load_address_word(T const volatile *address) noexcept {
+#ifdef _WIN32
+            return *reinterpret_cast<address_word_t<T> const volatile *>(address);
+#else
+            return __atomic_load_n(reinterpret_cast<address_word_t<T> const volatile *>(address), __ATOMIC_RELAXED);
+#endif
+        }
+        //
+        // Spins up to spin_count times while address holds undesired
+        // value. Returns true if value changed.
+        //
+        template<typename T>
+        [[nodiscard]] inline bool spin_on_address(T const volatile *address,
+                                                  T const &undesired_value,
+                                                  std::uint32_t spin_count) noexcept {
+            address_word_t<T> const undesired{to_address_word(undesired_value)};
+            for (std::uint32_t i = 0; i < spin_count; ++i) {
+                if (undesired != load_address_word(address)) {
+                    return true;
+                }
+                cpu_relax();
+            }
+            return false;
+        }
+        //
+        // Negative timeout is infinite. Timeouts longer than
+        // a year are infinite too, so they do not overflow.
+        //
+        template<typename R, typename P>
+        [[nodiscard]] inline std::chrono::nanoseconds to_wait_timeout(std::chrono::duration<R, P> timeout) noexcept {
+            if (timeout < std::chrono::duration<R, P>::zero() ||
+                std::chrono::duration<double>{timeout} > std::chrono::duration<double>{std::chrono::years{1}}) {
+                return std::chrono::nanoseconds{-1};
+            }
+            return std::chrono::ceil<std::chrono::nanoseconds>(timeout);
+        }
+    } // namespace details
+
 #if (_WIN32_WINNT >= 0x0600)
 
     class wait_on_address {
@@ -40,6 +125,37 @@ namespace ac {
                 AC_THROW(GetLastError(), "WaitOnAddress");
             }
         }
+        //
+        // Spins up to spin_count times before it blocks, which saves
+        // the wake up latency when value changes soon. Negative
+        // timeout is infinite. Returns false on timeout.
+        //
+        template<typename T, typename R, typename P>
+        [[nodiscard]] static bool try_wait_for(T const volatile *address,
+                                               T undesired_value,
+                                               std::chrono::duration<R, P> timeout,
+                                               std::uint32_t spin_count = 0) noexcept {
+            if (details::spin_on_address(address, undesired_value, spin_count)) {
+                return true;
+            }
+            std::chrono::nanoseconds const wait_timeout{details::to_wait_timeout(timeout)};
+            DWORD milliseconds{INFINITE};
+            if (wait_timeout.count() >= 0) {
+                milliseconds = static_cast<DWORD>(std::min<long long>(
+                    std::chrono::ceil<std::chrono::milliseconds>(wait_timeout).count(), INFINITE - 1));
+            }
+            return try_wait(address, undesired_value, milliseconds);
+        }
+
+        template<typename T, typename R, typename P>
+        static void wait_for(T const volatile *address,
+                             T undesired_value,
+                             std::chrono::duration<R, P> timeout,
+                             std::uint32_t spin_count = 0) {
+            if (!try_wait_for(address, undesired_value, timeout, spin_count)) {
+                AC_THROW(GetLastError(), "WaitOnAddress");
+            }
+        }
 
         template<typename T>
         static void wake_single(T const volatile *address) noexcept {
@@ -54,6 +170,533 @@ namespace ac {
 
 #endif //(_WIN32_WINNT >= 0x0600)
 
+#ifndef _WIN32
+
+    namespace details {
+
+        [[nodiscard]] inline timespec to_timespec(std::chrono::nanoseconds duration) noexcept {
+            timespec result{};
+            result.tv_sec = static_cast<time_t>(duration.count() / 1'000'000'000);
+            result.tv_nsec = static_cast<long>(duration.count() % 1'000'000'000);
+            return result;
+        }
+        //
+        // Deadline on CLOCK_MONOTONIC, or nullptr if timeout is infinite
+        //
+        [[nodiscard]] inline timespec *to_deadline(std::chrono::nanoseconds timeout, timespec *deadline) noexcept {
+            if (timeout.count() < 0) {
+                return nullptr;
+            }
+            clock_gettime(CLOCK_MONOTONIC, deadline);
+            *deadline = to_timespec(std::chrono::seconds{deadline->tv_sec} +
+                                    std::chrono::nanoseconds{deadline->tv_nsec} + timeout);
+            return deadline;
+        }
+        //
+        // Address and the value it must not hold
+        //
+        struct wait_entry {
+            template<typename T>
+            wait_entry(T const volatile *address, T undesired_value) noexcept
+                : address_{address}
+                , undesired_value_{to_address_word(undesired_value)}
+                , size_{sizeof(T)} {
+                static_assert(sizeof(T) == 1 || sizeof(T) == 2 || sizeof(T) == 4 || sizeof(T) == 8,
+                              "Only 1, 2 4 or 8 bytes values are supported");
+
+                static_assert(std::is_trivially_copyable<T>::value, "Only POD types are supported");
+            }
+
+            [[nodiscard]] bool holds_undesired_value() const noexcept {
+                switch (size_) {
+                case 1:
+                    return undesired_value_ == load_address_word(static_cast<std::uint8_t const volatile *>(address_));
+                case 2:
+                    return undesired_value_ == load_address_word(static_cast<std::uint16_t const volatile *>(address_));
+                case 4:
+                    return undesired_value_ == load_address_word(static_cast<std::uint32_t const volatile *>(address_));
+                default:
+                    return undesired_value_ == load_address_word(static_cast<std::uint64_t const volatile *>(address_));
+                }
+            }
+
+            void const volatile *address_;
+            std::uint64_t undesired_value_;
+            std::uint32_t size_;
+        };
+        //
+        // Futex only works on 4 bytes words, so threads that wait on
+        // values of other sizes park here, and so do threads that wait
+        // on several addresses when kernel does not have futex_waitv.
+        // Address is hashed to a bucket, and bucket keeps a list of
+        // entries parked on its addresses. Each thread sleeps on a
+        // futex of its own, and waker wakes only threads parked on the
+        // address it wakes.
+        //
+        // Waker does not take the bucket lock when nobody is parked in
+        // the bucket. Waiter counts itself in waiters_, and then reads
+        // the value. Waker writes the value, and then reads waiters_.
+        // Both sides go through a full fence, so either waiter sees the
+        // new value, or waker sees the waiter.
+        //
+        class parking_lot final {
+        public:
+            static constexpr size_t bucket_count{256};
+            static constexpr size_t max_entries{64};
+
+            parking_lot(parking_lot const &) = delete;
+            parking_lot &operator=(parking_lot const &) = delete;
+
+            [[nodiscard]] static parking_lot &instance() noexcept {
+                static parking_lot *lot{new parking_lot{}};
+                return *lot;
+            }
+            //
+            // Parks thread on every address until one of them is woken.
+            // Returns false if deadline passed before that. Deadline is
+            // on CLOCK_MONOTONIC, nullptr is infinite.
+            //
+            [[nodiscard]] bool park(wait_entry const *entries, size_t count, timespec const *deadline) noexcept {
+                AC_CODDING_ERROR_IF(0 == count || max_entries < count);
+                parked_thread &self{current_thread()};
+                self.woken_.store(0, std::memory_order_relaxed);
+                std::array<parked_entry, max_entries> parked;
+                size_t linked{0};
+                bool woken{false};
+                for (; linked < count; ++linked) {
+                    parked_entry &entry{parked[linked]};
+                    entry.address_ = entries[linked].address_;
+                    entry.thread_ = &self;
+                    entry.next_ = nullptr;
+                    bucket &b{bucket_of(entry.address_)};
+                    std::lock_guard<std::mutex> lock{b.lock_};
+                    b.waiters_.fetch_add(1, std::memory_order_relaxed);
+                    std::atomic_thread_fence(std::memory_order_seq_cst);
+                    if (!entries[linked].holds_undesired_value()) {
+                        b.waiters_.fetch_sub(1, std::memory_order_relaxed);
+                        woken = true;
+                        break;
+                    }
+                    entry.linked_ = true;
+                    *b.tail_ = &entry;
+                    b.tail_ = &entry.next_;
+                }
+                if (!woken) {
+                    woken = sleep(self, deadline);
+                }
+                //
+                // Entries that were not woken are still in their buckets,
+                // and they live on this stack
+                //
+                for (size_t i = 0; i < linked; ++i) {
+                    bucket &b{bucket_of(parked[i].address_)};
+                    std::lock_guard<std::mutex> lock{b.lock_};
+                    if (parked[i].linked_) {
+                        for (parked_entry **link = &b.head_; *link; link = &(*link)->next_) {
+                            if (&parked[i] == *link) {
+                                unlink(b, link);
+                                break;
+                            }
+                        }
+                    }
+                }
+                if (!woken && 0 != self.woken_.load(std::memory_order_acquire)) {
+                    woken = true;
+                }
+                if (!woken) {
+                    errno = ETIMEDOUT;
+                }
+                return woken;
+            }
+            //
+            // Threads are woken while bucket lock is held. Once woken_ is
+            // set, parked thread can return and park again, so nothing
+            // it owns is touched after that except for its futex. Thread
+            // that was already woken through another address does not
+            // use up a single wake.
+            //
+            void unpark(void const volatile *address, bool all) noexcept {
+                bucket &b{bucket_of(address)};
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                if (0 == b.waiters_.load(std::memory_order_relaxed)) {
+                    return;
+                }
+                std::lock_guard<std::mutex> lock{b.lock_};
+                parked_entry **link{&b.head_};
+                while (*link) {
+                    parked_entry *const entry{*link};
+                    if (address != entry->address_) {
+                        link = &entry->next_;
+                        continue;
+                    }
+                    parked_thread *const thread{entry->thread_};
+                    unlink(b, link);
+                    if (0 != thread->woken_.exchange(1, std::memory_order_release)) {
+                        continue;
+                    }
+                    syscall(SYS_futex, &thread->woken_, FUTEX_WAKE_PRIVATE, 1, nullptr, nullptr, 0);
+                    if (!all) {
+                        break;
+                    }
+                }
+            }
+
+        private:
+            struct parked_thread {
+                std::atomic<std::uint32_t> woken_{0};
+            };
+
+            struct parked_entry {
+                void const volatile *address_;
+                parked_thread *thread_;
+                parked_entry *next_;
+                bool linked_;
+            };
+
+            struct alignas(64) bucket {
+                std::mutex lock_;
+                std::atomic<std::uint32_t> waiters_{0};
+                parked_entry *head_{nullptr};
+                parked_entry **tail_{&head_};
+            };
+
+            parking_lot() noexcept {
+            }
+
+            [[nodiscard]] bucket &bucket_of(void const volatile *address) noexcept {
+                std::uint64_t const hash{
+                    static_cast<std::uint64_t>(reinterpret_cast<std::uintptr_t>(address)) * 0x9E3779B97F4A7C15ULL};
+                return buckets_[hash >> 56];
+            }
+            //
+            // Futex outlives any wait of the thread, so waker
+            // never wakes a futex that is gone
+            //
+            [[nodiscard]] static parked_thread &current_thread() noexcept {
+                thread_local parked_thread self;
+                return self;
+            }
+
+            [[nodiscard]] static bool sleep(parked_thread &self, timespec const *deadline) noexcept {
+                for (;;) {
+                    long const rc{syscall(SYS_futex,
+                                          &self.woken_,
+                                          FUTEX_WAIT_BITSET_PRIVATE,
+                                          0,
+                                          deadline,
+                                          nullptr,
+                                          FUTEX_BITSET_MATCH_ANY)};
+                    if (0 != self.woken_.load(std::memory_order_acquire)) {
+                        return true;
+                    }
+                    if (0 != rc && ETIMEDOUT == errno) {
+                        return false;
+                    }
+                }
+            }
+
+            static void unlink(bucket &b, parked_entry **link) noexcept {
+                parked_entry *const entry{*link};
+                *link = entry->next_;
+                if (b.tail_ == &entry->next_) {
+                    b.tail_ = link;
+                }
+                entry->linked_ = false;
+                b.waiters_.fetch_sub(1, std::memory_order_relaxed);
+            }
+
+            std::array<bucket, bucket_count> buckets_;
+        };
+        //
+        // Layout of struct futex_waitv, Linux 5.16 and later
+        //
+        struct futex_wait_vector {
+            std::uint64_t value_;
+            std::uint64_t address_;
+            std::uint32_t flags_;
+            std::uint32_t reserved_;
+        };
+
+#ifdef __NR_futex_waitv
+        inline constexpr long futex_waitv_syscall{__NR_futex_waitv};
+#else
+        inline constexpr long futex_waitv_syscall{449};
+#endif
+        inline constexpr std::uint32_t futex_waitv_u32{0x02};
+
+        //
+        // Set once futex_waitv returned ENOSYS
+        //
+        [[nodiscard]] inline std::atomic<bool> &futex_waitv_missing() noexcept {
+            static std::atomic<bool> missing{false};
+            return missing;
+        }
+        //
+        // 4 bytes values park only in wait_any, and only when it cannot
+        // use futex_waitv, so wakes of 4 bytes values look in the parking
+        // lot only after that happened once. Waiter that turns it on runs
+        // a memory barrier on every thread of the process with membarrier
+        // before it parks. Waker that read the flag before it was set had
+        // written the new value before that barrier, so waiter sees it.
+        // When membarrier is not available waiter cannot rely on that,
+        // and it wakes up every poll_interval to recheck values.
+        //
+        class futex_word_parking final {
+        public:
+            static constexpr std::chrono::milliseconds poll_interval{10};
+
+            futex_word_parking() = delete;
+            //
+            // Waker side, value was written before the call
+            //
+            [[nodiscard]] static bool in_use() noexcept {
+                std::atomic_signal_fence(std::memory_order_seq_cst);
+                return off != state().load(std::memory_order_relaxed);
+            }
+            //
+            // Waiter side, returns false if wakers might still miss it
+            //
+            [[nodiscard]] static bool enable() noexcept {
+                std::uint32_t current{state().load(std::memory_order_acquire)};
+                if (off == current && state().compare_exchange_strong(current, enabling, std::memory_order_seq_cst)) {
+                    current = process_memory_barrier() ? on : on_without_barrier;
+                    state().store(current, std::memory_order_release);
+                }
+                while (enabling == current) {
+                    sched_yield();
+                    current = state().load(std::memory_order_acquire);
+                }
+                return on == current;
+            }
+
+        private:
+            static constexpr std::uint32_t off{0};
+            static constexpr std::uint32_t enabling{1};
+            static constexpr std::uint32_t on{2};
+            static constexpr std::uint32_t on_without_barrier{3};
+
+            [[nodiscard]] static std::atomic<std::uint32_t> &state() noexcept {
+                static std::atomic<std::uint32_t> value{off};
+                return value;
+            }
+            //
+            // Expedited barrier sends IPIs to CPUs that run threads of
+            // this process, global one waits for RCU grace period
+            //
+            [[nodiscard]] static bool process_memory_barrier() noexcept {
+                if (0 == syscall(SYS_membarrier, MEMBARRIER_CMD_REGISTER_PRIVATE_EXPEDITED, 0, 0) &&
+                    0 == syscall(SYS_membarrier, MEMBARRIER_CMD_PRIVATE_EXPEDITED, 0, 0)) {
+                    return true;
+                }
+                return 0 == syscall(SYS_membarrier, MEMBARRIER_CMD_GLOBAL, 0, 0);
+            }
+        };
+
+    } // namespace details
+
+    //
+    // Futex based implementation. 4 bytes values wait on a futex
+    // directly, values of 1, 2 and 8 bytes park in a parking lot.
+    // Wakes of 4 bytes values also look in the parking lot once
+    // wait_any parked there because it could not use futex_waitv.
+    // Same as WaitOnAddress, returning because value has changed
+    // before we had a chance to sleep, or because of a spurious
+    // wakeup is a success. Caller has to recheck the value.
+    //
+    class wait_on_address {
+    public:
+        wait_on_address() = delete;
+        wait_on_address(wait_on_address &) = delete;
+        wait_on_address(wait_on_address &&) = delete;
+        wait_on_address &operator=(wait_on_address &) = delete;
+        wait_on_address &operator=(wait_on_address &&) = delete;
+
+        using entry = details::wait_entry;
+
+        static constexpr size_t max_wait_any{details::parking_lot::max_entries};
+
+        template<typename T>
+        [[nodiscard]] static bool try_wait(T const volatile *address,
+                                           T undesired_value,
+                                           DWORD milliseconds = INFINITE) noexcept {
+            if (INFINITE == milliseconds) {
+                return try_wait_for(address, undesired_value, std::chrono::nanoseconds{-1});
+            }
+            return try_wait_for(address, undesired_value, std::chrono::milliseconds{milliseconds});
+        }
+        //
+        // Spins up to spin_count times before it blocks, which saves
+        // the wake up latency when value changes soon. Negative
+        // timeout is infinite. Returns false on timeout.
+        //
+        template<typename T, typename R, typename P>
+        [[nodiscard]] static bool try_wait_for(T const volatile *address,
+                                               T undesired_value,
+                                               std::chrono::duration<R, P> timeout,
+                                               std::uint32_t spin_count = 0) noexcept {
+            static_assert(sizeof(T) == 1 || sizeof(T) == 2 || sizeof(T) == 4 || sizeof(T) == 8,
+                          "Only 1, 2 4 or 8 bytes values are supported");
+
+            static_assert(std::is_trivially_copyable<T>::value, "Only POD types are supported");
+
+            if (details::spin_on_address(address, undesired_value, spin_count)) {
+                return true;
+            }
+            std::chrono::nanoseconds const wait_timeout{details::to_wait_timeout(timeout)};
+            if constexpr (4 == sizeof(T)) {
+                timespec relative{};
+                timespec *relative_ptr{nullptr};
+                if (0 <= wait_timeout.count()) {
+                    relative = details::to_timespec(wait_timeout);
+                    relative_ptr = &relative;
+                }
+                long rc = syscall(SYS_futex,
+                                  const_cast<T *>(address),
+                                  FUTEX_WAIT_PRIVATE,
+                                  details::to_address_word(undesired_value),
+                                  relative_ptr,
+                                  nullptr,
+                                  0);
+                if (0 != rc && (EAGAIN == errno || EINTR == errno)) {
+                    rc = 0;
+                }
+                return 0 == rc;
+            } else {
+                timespec deadline{};
+                details::wait_entry const entry{address, undesired_value};
+                return details::parking_lot::instance().park(
+                    &entry, 1, details::to_deadline(wait_timeout, &deadline));
+            }
+        }
+        //
+        // Waits until any of the addresses does not hold its undesired
+        // value, or until it is woken. Uses futex_waitv when all values
+        // are 4 bytes, and parks on every address otherwise, or when
+        // kernel is older than 5.16. Same as try_wait, spurious wakeups
+        // are a success and caller has to recheck values. Wake of a
+        // single waiter can go to a thread that is already returning
+        // because another address changed, so use wake_all on
+        // addresses more than one thread waits on this way.
+        //
+        template<typename R, typename P>
+        [[nodiscard]] static bool try_wait_any_for(std::span<entry const> entries,
+                                                   std::chrono::duration<R, P> timeout) noexcept {
+            AC_CODDING_ERROR_IF(entries.empty() || max_wait_any < entries.size());
+            timespec deadline{};
+            timespec const *const deadline_ptr{details::to_deadline(details::to_wait_timeout(timeout), &deadline)};
+            bool const all_futex_words{std::ranges::all_of(entries, [](entry const &e) { return 4 == e.size_; })};
+            if (all_futex_words && !details::futex_waitv_missing().load(std::memory_order_relaxed)) {
+                std::array<details::futex_wait_vector, max_wait_any> vector;
+                for (size_t i = 0; i < entries.size(); ++i) {
+                    vector[i] = details::futex_wait_vector{entries[i].undesired_value_,
+                                                           reinterpret_cast<std::uintptr_t>(entries[i].address_),
+                                                           details::futex_waitv_u32 | FUTEX_PRIVATE_FLAG,
+                                                           0};
+                }
+                long const rc{syscall(details::futex_waitv_syscall,
+                                      vector.data(),
+                                      static_cast<unsigned int>(entries.size()),
+                                      0,
+                                      deadline_ptr,
+                                      CLOCK_MONOTONIC)};
+                if (0 <= rc || EAGAIN == errno || EINTR == errno) {
+                    return true;
+                }
+                if (ENOSYS != errno) {
+                    return false;
+                }
+                details::futex_waitv_missing().store(true, std::memory_order_relaxed);
+            }
+            bool const has_futex_words{std::ranges::any_of(entries, [](entry const &e) { return 4 == e.size_; })};
+            if (has_futex_words && !details::futex_word_parking::enable()) {
+                //
+                // Wakes of 4 bytes values might miss us, so wake up
+                // to recheck values, and report it as a spurious wakeup
+                //
+                timespec poll_deadline{};
+                (void) details::to_deadline(details::futex_word_parking::poll_interval, &poll_deadline);
+                if (nullptr == deadline_ptr || poll_deadline.tv_sec < deadline.tv_sec ||
+                    (poll_deadline.tv_sec == deadline.tv_sec && poll_deadline.tv_nsec < deadline.tv_nsec)) {
+                    return details::parking_lot::instance().park(entries.data(), entries.size(), &poll_deadline) ||
+                           ETIMEDOUT == errno;
+                }
+            }
+            return details::parking_lot::instance().park(entries.data(), entries.size(), deadline_ptr);
+        }
+
+        template<typename R, typename P>
+        static void wait_any_for(std::span<entry const> entries, std::chrono::duration<R, P> timeout) {
+            details::blocking_region region;
+            if (!try_wait_any_for(entries, timeout)) {
+                AC_THROW(GetLastError(), "futex_waitv");
+            }
+        }
+
+        static void wait_any(std::span<entry const> entries) {
+            wait_any_for(entries, std::chrono::nanoseconds{-1});
+        }
+
+        //
+        // Lets thread pool compensate while a callback is
+        // blocked. try_wait does not, the pool parks on it.
+        //
+        template<typename T>
+        static void wait(T const volatile *address, T undesired_value, DWORD milliseconds = INFINITE) {
+            details::blocking_region region;
+            if (!try_wait(address, undesired_value, milliseconds)) {
+                AC_THROW(GetLastError(), "futex wait");
+            }
+        }
+
+        template<typename T, typename R, typename P>
+        static void wait_for(T const volatile *address,
+                             T undesired_value,
+                             std::chrono::duration<R, P> timeout,
+                             std::uint32_t spin_count = 0) {
+            if (details::spin_on_address(address, undesired_value, spin_count)) {
+                return;
+            }
+            details::blocking_region region;
+            if (!try_wait_for(address, undesired_value, timeout)) {
+                AC_THROW(GetLastError(), "futex wait");
+            }
+        }
+
+        template<typename T>
+        static void wake_single(T const volatile *address) noexcept {
+            static_assert(sizeof(T) == 1 || sizeof(T) == 2 || sizeof(T) == 4 || sizeof(T) == 8,
+                          "Only 1, 2 4 or 8 bytes values are supported");
+            if constexpr (4 == sizeof(T)) {
+                if (0 < syscall(SYS_futex, const_cast<T *>(address), FUTEX_WAKE_PRIVATE, 1, nullptr, nullptr, 0) ||
+                    !details::futex_word_parking::in_use()) {
+                    return;
+                }
+            }
+            details::parking_lot::instance().unpark(address, false);
+        }
+
+        template<typename T>
+        static void wake_all(T const volatile *address) noexcept {
+            static_assert(sizeof(T) == 1 || sizeof(T) == 2 || sizeof(T) == 4 || sizeof(T) == 8,
+                          "Only 1, 2 4 or 8 bytes values are supported");
+            if constexpr (4 == sizeof(T)) {
+                syscall(SYS_futex,
+                        const_cast<T *>(address),
+                        FUTEX_WAKE_PRIVATE,
+                        INT_MAX,
+                        nullptr,
+                        nullptr,
+                        0);
+                if (!details::futex_word_parking::in_use()) {
+                    return;
+                }
+            }
+            details::parking_lot::instance().unpark(address, true);
+        }
+    };
+
+#endif // _WIN32
+
 } // namespace ac
 
 #endif //_AC_HELPERS_WIN32_LIBRARY_WAIT_ON_ADDRESS_HEADER_
@@ -25,5 +25,39 @@ int main() {
     test_tp_wait_work_item();
     test_tp_io_handler();
 
+    test_node_cache_after_thread_exit();
+    test_inplace_function();
+
+    test_tp_submit_work_batch();
+    test_tp_post_count();
+
+    test_tp_strand();
+    test_active_object();
+    test_tp_cleanup_group();
+    test_tp_callback_objects_after_thread_exit();
+    test_tp_scratch_arena();
+    test_sharded_rundown();
+    test_wait_on_address();
+
+#ifndef _WIN32
+    test_tp_timer_wheel();
+    test_tp_timer_coalescing();
+    test_tp_queue_wait_histogram();
+    test_tp_priority();
+    test_tp_blocking_scope();
+    test_tp_adaptive_concurrency();
+    test_tp_numa_topology();
+    test_tp_work_stealing();
+    test_tp_coroutines();
+    test_tp_exec();
+    test_tp_parallel();
+    test_tp_task_graph();
+    test_tp_future();
+    test_tp_submit_keyed();
+    test_tp_keyed_idle_peer();
+    test_tp_queue_capacity();
+    test_wait_any();
+#endif
+
     return 0;
 }
@@ -2,10 +2,21 @@
 
 #include <stdlib.h>
 
+#include <filesystem>
+#include <fstream>
+
 #include <actp.h>
+#include <acnodecache.h>
 #include <acrundown.h>
 #include <ackernelobject.h>
 #include <acfileobject.h>
+#include <actpstrand.h>
+#include <acactive.h>
+#include <actpcoro.h>
+#include <actpexec.h>
+#include <actpparallel.h>
+#include <actpgraph.h>
+#include <actpfuture.h>
 
 void test_ft_to_timepoint_conversion() {
     FILETIME ft;
@@ -647,6 +658,219 @@ void test_tp_timer_work_item() {
     printf("---- test_tp_timer_work_item complete\n");
 }
 
+#ifndef _WIN32
+
+namespace {
+    //
+    // Timer queue entry that records when it expired
+    //
+    class timer_probe final {
+    public:
+        using clock = ac::tp::details::steady_clock;
+
+        timer_probe() {
+            fired_.reserve(64);
+            entry_.expired_ = &timer_probe::on_expired;
+            entry_.context_ = this;
+        }
+
+        ~timer_probe() noexcept {
+            disarm();
+        }
+
+        timer_probe(timer_probe const &) = delete;
+        timer_probe &operator=(timer_probe const &) = delete;
+
+        void arm(clock::time_point due,
+                 clock::duration period = clock::duration::zero(),
+                 clock::duration window = clock::duration::zero()) noexcept {
+            ac::tp::details::timer_queue::instance().arm(&entry_, due, period, window);
+        }
+
+        void disarm() noexcept {
+            ac::tp::details::timer_queue::instance().disarm(&entry_);
+        }
+
+        [[nodiscard]] bool is_armed() noexcept {
+            return ac::tp::details::timer_queue::instance().is_armed(&entry_);
+        }
+
+        [[nodiscard]] std::vector<clock::time_point> fired() const {
+            std::lock_guard<std::mutex> lock{lock_};
+            return fired_;
+        }
+
+        [[nodiscard]] bool wait_fired(size_t count, std::chrono::milliseconds timeout = std::chrono::seconds{5}) const {
+            clock::time_point const deadline{clock::now() + timeout};
+            while (fired().size() < count) {
+                if (clock::now() > deadline) {
+                    return false;
+                }
+                std::this_thread::sleep_for(std::chrono::milliseconds{1});
+            }
+            return true;
+        }
+
+    private:
+        static void on_expired(ac::tp::details::timer_entry *entry, ac::tp::details::dispatch_batch &) noexcept {
+            timer_probe *self{static_cast<timer_probe *>(entry->context_)};
+            std::lock_guard<std::mutex> lock{self->lock_};
+            if (self->fired_.size() < self->fired_.capacity()) {
+                self->fired_.push_back(clock::now());
+            }
+        }
+
+        ac::tp::details::timer_entry entry_;
+        mutable std::mutex lock_;
+        std::vector<clock::time_point> fired_;
+    };
+
+} // namespace
+
+void test_tp_timer_wheel() {
+    printf("\n---- test_tp_timer_wheel started\n");
+
+    try {
+        using clock = timer_probe::clock;
+        using std::chrono::milliseconds;
+        //
+        // Timers on the root level, and the ones cascaded down from
+        // the level above, expire once and never early
+        //
+        {
+            constexpr int delays[]{0, 1, 2, 7, 100, 255, 256, 257, 300, 511, 512, 700, 1025};
+            constexpr size_t count{std::size(delays)};
+            std::vector<std::unique_ptr<timer_probe>> probes;
+            std::vector<clock::time_point> dues;
+            clock::time_point const start{clock::now()};
+            for (int delay : delays) {
+                probes.emplace_back(std::make_unique<timer_probe>());
+                dues.push_back(start + milliseconds{delay});
+                probes.back()->arm(dues.back());
+            }
+            for (size_t i = 0; i < count; ++i) {
+                AC_CODDING_ERROR_IF_NOT(probes[i]->wait_fired(1));
+            }
+            std::this_thread::sleep_for(milliseconds{20});
+            for (size_t i = 0; i < count; ++i) {
+                std::vector<clock::time_point> const fired{probes[i]->fired()};
+                AC_CODDING_ERROR_IF_NOT(1 == fired.size());
+                AC_CODDING_ERROR_IF(fired[0] < dues[i]);
+                AC_CODDING_ERROR_IF(probes[i]->is_armed());
+            }
+        }
+        //
+        // Far future timers, one on an upper level, and one beyond
+        // the range of the wheel, stay armed until canceled
+        //
+        {
+            timer_probe upper_level;
+            timer_probe beyond_wheel;
+            upper_level.arm(clock::now() + std::chrono::seconds{20});
+            beyond_wheel.arm(clock::now() + std::chrono::hours{24 * 100});
+            std::this_thread::sleep_for(milliseconds{20});
+            AC_CODDING_ERROR_IF_NOT(upper_level.is_armed());
+            AC_CODDING_ERROR_IF_NOT(beyond_wheel.is_armed());
+            upper_level.disarm();
+            beyond_wheel.disarm();
+            AC_CODDING_ERROR_IF(upper_level.is_armed());
+            AC_CODDING_ERROR_IF(beyond_wheel.is_armed());
+            AC_CODDING_ERROR_IF_NOT(upper_level.fired().empty());
+            AC_CODDING_ERROR_IF_NOT(beyond_wheel.fired().empty());
+        }
+        //
+        // Canceled timer does not expire, and rearmed timer expires
+        // once, at the new due time
+        //
+        {
+            timer_probe probe;
+            probe.arm(clock::now() + milliseconds{20});
+            probe.disarm();
+            std::this_thread::sleep_for(milliseconds{50});
+            AC_CODDING_ERROR_IF_NOT(probe.fired().empty());
+
+            probe.arm(clock::now() + milliseconds{300});
+            clock::time_point const sooner{clock::now() + milliseconds{20}};
+            probe.arm(sooner);
+            AC_CODDING_ERROR_IF_NOT(probe.wait_fired(1));
+            std::this_thread::sleep_for(milliseconds{350});
+            std::vector<clock::time_point> fired{probe.fired()};
+            AC_CODDING_ERROR_IF_NOT(1 == fired.size());
+            AC_CODDING_ERROR_IF(fired[0] < sooner);
+
+            probe.arm(clock::now() + milliseconds{10});
+            clock::time_point const later{clock::now() + milliseconds{80}};
+            probe.arm(later);
+            AC_CODDING_ERROR_IF_NOT(probe.wait_fired(2));
+            fired = probe.fired();
+            AC_CODDING_ERROR_IF(fired[1] < later);
+        }
+        //
+        // Periodic timer expires every period until canceled
+        //
+        {
+            constexpr milliseconds period{20};
+            constexpr size_t expirations{5};
+            timer_probe probe;
+            clock::time_point const due{clock::now() + milliseconds{10}};
+            probe.arm(due, period);
+            AC_CODDING_ERROR_IF_NOT(probe.wait_fired(expirations));
+            probe.disarm();
+            std::vector<clock::time_point> const fired{probe.fired()};
+            for (size_t i = 0; i < fired.size(); ++i) {
+                AC_CODDING_ERROR_IF(fired[i] < due + period * static_cast<int>(i));
+            }
+            std::this_thread::sleep_for(period * 3);
+            AC_CODDING_ERROR_IF_NOT(fired.size() == probe.fired().size());
+        }
+    } catch (std::exception const &ex) {
+        printf("---- test_tp_timer_wheel failed %s\n", ex.what());
+    }
+    printf("---- test_tp_timer_wheel complete\n");
+}
+
+void test_tp_timer_coalescing() {
+    printf("\n---- test_tp_timer_coalescing started\n");
+
+    try {
+        using clock = timer_probe::clock;
+        using std::chrono::milliseconds;
+        //
+        // Tolerance windows overlap, so timers share a few round ticks
+        // instead of waking timer thread once each. Latency covers the
+        // time timer thread takes to wake up after the tick.
+        //
+        constexpr size_t count{16};
+        constexpr milliseconds window{100};
+        constexpr milliseconds latency{20};
+        std::vector<std::unique_ptr<timer_probe>> probes;
+        std::vector<clock::time_point> dues;
+        std::uint64_t const wakeups{ac::tp::details::timer_queue::instance().get_wakeup_count()};
+        clock::time_point const start{clock::now()};
+        for (size_t i = 0; i < count; ++i) {
+            probes.emplace_back(std::make_unique<timer_probe>());
+            dues.push_back(start + milliseconds{50} + milliseconds{static_cast<int>(i)});
+            probes.back()->arm(dues.back(), clock::duration::zero(), window);
+        }
+        for (size_t i = 0; i < count; ++i) {
+            AC_CODDING_ERROR_IF_NOT(probes[i]->wait_fired(1));
+        }
+        std::uint64_t const woke{ac::tp::details::timer_queue::instance().get_wakeup_count() - wakeups};
+        printf("%zu timers expired in %llu wakeups\n", count, static_cast<unsigned long long>(woke));
+        AC_CODDING_ERROR_IF_NOT(woke < count);
+        for (size_t i = 0; i < count; ++i) {
+            clock::time_point const fired{probes[i]->fired()[0]};
+            AC_CODDING_ERROR_IF(fired < dues[i]);
+            AC_CODDING_ERROR_IF(fired > dues[i] + window + latency);
+        }
+    } catch (std::exception const &ex) {
+        printf("---- test_tp_timer_coalescing failed %s\n", ex.what());
+    }
+    printf("---- test_tp_timer_coalescing complete\n");
+}
+
+#endif // _WIN32
+
 void test_default_tp_wait_work_item() {
     printf("\n---- test_default_tp_wait_work_item started\n");
 
@@ -1282,3 +1506,2213 @@ void test_tp_io_handler() {
     }
     printf("---- test_tp_io_handler complete\n");
 }
+
+namespace {
+    struct test_node {
+        std::uint64_t value_[4]{};
+    };
+
+    using test_node_cache = ac::tp::details::node_cache<test_node>;
+    //
+    // Thread local object that is constructed before the node cache
+    // of its thread, so it is destroyed after it
+    //
+    struct node_holder {
+        ~node_holder() {
+            if (node_) {
+                test_node_cache::destroy(node_);
+            }
+            test_node_cache::destroy(test_node_cache::create());
+        }
+
+        test_node *node_{nullptr};
+    };
+} // namespace
+
+void test_node_cache_after_thread_exit() {
+    printf("\n---- test_node_cache_after_thread_exit started\n");
+
+    for (int i = 0; i < 16; ++i) {
+        std::thread{[] {
+            thread_local node_holder holder;
+            holder.node_ = test_node_cache::create();
+            std::vector<test_node *> nodes;
+            for (int j = 0; j < 100; ++j) {
+                nodes.push_back(test_node_cache::create());
+            }
+            for (test_node *node : nodes) {
+                test_node_cache::destroy(node);
+            }
+        }}.join();
+    }
+
+    printf("---- test_node_cache_after_thread_exit validating\n");
+    //
+    // Node freed twice would be handed out twice
+    //
+    std::vector<test_node *> nodes;
+    for (int i = 0; i < 4096; ++i) {
+        nodes.push_back(test_node_cache::create());
+    }
+    std::vector<test_node *> sorted{nodes};
+    std::sort(sorted.begin(), sorted.end());
+    AC_CODDING_ERROR_IF_NOT(sorted.end() == std::adjacent_find(sorted.begin(), sorted.end()));
+    for (test_node *node : nodes) {
+        test_node_cache::destroy(node);
+    }
+
+    printf("---- test_node_cache_after_thread_exit complete\n");
+}
+
+namespace {
+    //
+    // Counts live copies, so tests can check that
+    // callables are destroyed exactly once
+    //
+    struct counted_callable {
+        explicit counted_callable(std::atomic<int> *live) noexcept
+            : live_{live} {
+            live_->fetch_add(1);
+        }
+
+        counted_callable(counted_callable &&other) noexcept
+            : live_{other.live_} {
+            live_->fetch_add(1);
+        }
+
+        counted_callable(counted_callable const &) = delete;
+        counted_callable &operator=(counted_callable const &) = delete;
+
+        ~counted_callable() noexcept {
+            live_->fetch_sub(1);
+        }
+
+        int operator()(int value) const noexcept {
+            return value * 2;
+        }
+
+        std::atomic<int> *live_;
+    };
+} // namespace
+
+void test_inplace_function() {
+    printf("\n---- test_inplace_function started\n");
+
+    std::atomic<int> live{0};
+    {
+        ac::inplace_function<int(int)> empty;
+        AC_CODDING_ERROR_IF(empty);
+        AC_CODDING_ERROR_IF_NOT(empty == nullptr);
+
+        ac::inplace_function<int(int)> f{counted_callable{&live}};
+        AC_CODDING_ERROR_IF_NOT(f);
+        AC_CODDING_ERROR_IF_NOT(1 == live);
+        AC_CODDING_ERROR_IF_NOT(42 == f(21));
+        //
+        // Move relocates the callable, and leaves source empty
+        //
+        ac::inplace_function<int(int)> g{std::move(f)};
+        AC_CODDING_ERROR_IF(f);
+        AC_CODDING_ERROR_IF_NOT(1 == live);
+        AC_CODDING_ERROR_IF_NOT(8 == g(4));
+
+        ac::inplace_function<int(int)> h{[](int value) { return value + 1; }};
+        swap(g, h);
+        AC_CODDING_ERROR_IF_NOT(5 == g(4));
+        AC_CODDING_ERROR_IF_NOT(8 == h(4));
+        AC_CODDING_ERROR_IF_NOT(1 == live);
+
+        h = nullptr;
+        AC_CODDING_ERROR_IF_NOT(0 == live);
+        h = std::move(g);
+        AC_CODDING_ERROR_IF_NOT(7 == h(6));
+        //
+        // Move only captures are supported
+        //
+        ac::inplace_function<int()> owner{[p = std::make_unique<int>(7)]() { return *p; }};
+        AC_CODDING_ERROR_IF_NOT(7 == owner());
+    }
+    AC_CODDING_ERROR_IF_NOT(0 == live);
+    //
+    // Callable that fills the default capacity
+    //
+    struct full_capacity {
+        std::uint8_t bytes_[ac::tp::callback_inplace_capacity - sizeof(std::atomic<int> *)]{};
+        std::atomic<int> *executed_;
+
+        void operator()(ac::tp::callback_instance &) const {
+            executed_->fetch_add(1);
+        }
+    };
+    static_assert(sizeof(full_capacity) == ac::tp::callback_inplace_capacity);
+
+    std::atomic<int> executed{0};
+    {
+        ac::tp::thread_pool tp{2, 4};
+        ac::slim_rundown rundown;
+        {
+            ac::slim_rundown_join scoped_join(&rundown);
+            for (int i = 0; i < 100; ++i) {
+                tp.submit_work([guard = ac::slim_rundown_lock{&rundown},
+                                p = std::make_unique<int>(i),
+                                &executed](ac::tp::callback_instance &) { executed.fetch_add(1); });
+            }
+        }
+        full_capacity callable{};
+        callable.executed_ = &executed;
+        auto work{tp.make_work_item(callable)};
+        work->post();
+        work->join();
+    }
+    AC_CODDING_ERROR_IF_NOT(101 == executed);
+
+    printf("---- test_inplace_function complete\n");
+}
+
+void test_tp_submit_work_batch() {
+    printf("\n---- test_tp_submit_work_batch started\n");
+
+    try {
+        ac::tp::thread_pool tp{4, 8};
+
+        constexpr int batch_size{1000};
+        std::atomic<int> executed_count{0};
+        std::atomic<long long> executed_sum{0};
+
+        ac::slim_rundown rundown;
+        {
+            ac::slim_rundown_join scoped_join(&rundown);
+
+            auto make_callback = [&](int i) {
+                return [i, &executed_count, &executed_sum, guard = ac::slim_rundown_lock{&rundown}](
+                           ac::tp::callback_instance &) {
+                    executed_count.fetch_add(1);
+                    executed_sum.fetch_add(i);
+                };
+            };
+            std::vector<decltype(make_callback(0))> callbacks;
+            for (int i = 0; i < batch_size; ++i) {
+                callbacks.push_back(make_callback(i));
+            }
+            tp.submit_work_batch(std::ranges::subrange{std::make_move_iterator(callbacks.begin()),
+                                                       std::make_move_iterator(callbacks.end())});
+            //
+            // Batch of any input range, on the default pool
+            //
+            ac::tp::submit_work_batch(std::views::iota(batch_size, 2 * batch_size) |
+                                      std::views::transform(make_callback));
+        }
+
+        printf("---- test_tp_submit_work_batch validating\n");
+
+        AC_CODDING_ERROR_IF_NOT(executed_count == 2 * batch_size);
+        AC_CODDING_ERROR_IF_NOT(executed_sum == (2LL * batch_size - 1) * (2LL * batch_size) / 2);
+    } catch (std::exception const &ex) {
+        printf("---- test_tp_submit_work_batch failed %s\n", ex.what());
+    }
+    printf("---- test_tp_submit_work_batch complete\n");
+}
+
+void test_tp_post_count() {
+    printf("\n---- test_tp_post_count started\n");
+
+    try {
+        ac::tp::thread_pool tp{4, 8};
+
+        std::atomic<int> executed_count{0};
+        auto work{tp.make_work_item(
+            [&executed_count](ac::tp::callback_instance &) { executed_count.fetch_add(1); })};
+
+        work->post(0);
+        work->post(1);
+        work->post(500);
+        work->join();
+        AC_CODDING_ERROR_IF_NOT(executed_count == 501);
+
+        work->post(250);
+        work->join();
+        AC_CODDING_ERROR_IF_NOT(executed_count == 751);
+    } catch (std::exception const &ex) {
+        printf("---- test_tp_post_count failed %s\n", ex.what());
+    }
+    printf("---- test_tp_post_count complete\n");
+}
+
+void test_tp_strand() {
+    printf("\n---- test_tp_strand started\n");
+
+    try {
+        ac::tp::thread_pool tp{2, 4};
+        //
+        // Callbacks run one at a time, in the order they were posted
+        //
+        for (std::uint32_t batch_size : {1U, 7U, ac::tp::strand::default_batch_size}) {
+            ac::tp::strand strand{tp, batch_size};
+            constexpr int count{10'000};
+            std::vector<int> order;
+            std::atomic<int> running{0};
+            bool overlapped{false};
+            bool on_strand{true};
+            for (int i = 0; i < count; ++i) {
+                strand.post([&, i](ac::tp::callback_instance &) {
+                    if (0 != running.fetch_add(1)) {
+                        overlapped = true;
+                    }
+                    on_strand = on_strand && strand.running_in_this_thread();
+                    order.push_back(i);
+                    running.fetch_sub(1);
+                });
+            }
+            strand.join();
+            AC_CODDING_ERROR_IF_NOT(strand.is_idle());
+            AC_CODDING_ERROR_IF(overlapped);
+            AC_CODDING_ERROR_IF_NOT(on_strand);
+            AC_CODDING_ERROR_IF(strand.running_in_this_thread());
+            AC_CODDING_ERROR_IF_NOT(count == order.size());
+            for (int i = 0; i < count; ++i) {
+                AC_CODDING_ERROR_IF_NOT(i == order[i]);
+            }
+        }
+        //
+        // Several threads post and join at the same time. Every join
+        // returns, and callbacks of each poster keep their order.
+        //
+        {
+            ac::tp::strand strand{tp, 4};
+            constexpr int threads{4};
+            constexpr int posts{5'000};
+            std::vector<int> last(threads, -1);
+            bool out_of_order{false};
+            std::vector<std::thread> posters;
+            for (int t = 0; t < threads; ++t) {
+                posters.emplace_back([&, t] {
+                    for (int i = 0; i < posts; ++i) {
+                        strand.post([&, t, i](ac::tp::callback_instance &) {
+                            out_of_order = out_of_order || last[t] + 1 != i;
+                            last[t] = i;
+                        });
+                        if (0 == i % 100) {
+                            strand.join();
+                        }
+                    }
+                    strand.join();
+                });
+            }
+            for (std::thread &poster : posters) {
+                poster.join();
+            }
+            AC_CODDING_ERROR_IF_NOT(strand.is_idle());
+            AC_CODDING_ERROR_IF(out_of_order);
+            for (int t = 0; t < threads; ++t) {
+                AC_CODDING_ERROR_IF_NOT(posts - 1 == last[t]);
+            }
+        }
+        //
+        // Destructor waits for posted callbacks, strand on
+        // the default pool
+        //
+        std::atomic<int> ran{0};
+        {
+            ac::tp::strand strand;
+            for (int i = 0; i < 1000; ++i) {
+                strand.post([&ran](ac::tp::callback_instance &) { ran.fetch_add(1); });
+            }
+        }
+        AC_CODDING_ERROR_IF_NOT(1000 == ran.load());
+    } catch (std::exception const &ex) {
+        printf("---- test_tp_strand failed %s\n", ex.what());
+    }
+    printf("---- test_tp_strand complete\n");
+}
+
+namespace {
+
+    struct record_message {
+        int value;
+    };
+
+    struct stop_message {
+        ac::event *stopped;
+    };
+
+    struct block_message {
+        ac::event *started;
+        ac::event *resume;
+    };
+
+    class test_active final: public ac::active<test_active, record_message, stop_message, block_message> {
+    public:
+        explicit test_active(ac::tp::thread_pool &tp, std::uint32_t batch_size = default_batch_size)
+            : active{tp, batch_size} {
+        }
+
+        test_active() {
+        }
+
+        ~test_active() {
+            stop();
+        }
+
+        void on_message(record_message &message) {
+            out_of_order_ = out_of_order_ || (received_.empty() ? 0 : received_.back() + 1) != message.value;
+            received_.push_back(message.value);
+        }
+
+        void on_message(stop_message &message) {
+            request_stop();
+            message.stopped->set();
+        }
+
+        void on_message(block_message &message) {
+            message.started->set();
+            (void) message.resume->wait();
+        }
+
+        std::vector<int> received_;
+        bool out_of_order_{false};
+    };
+
+} // namespace
+
+void test_active_object() {
+    printf("\n---- test_active_object started\n");
+
+    try {
+        ac::tp::thread_pool tp{2, 4};
+        //
+        // Messages are handled in the order they were sent
+        //
+        for (std::uint32_t batch_size : {1U, 5U, test_active::default_batch_size}) {
+            test_active object{tp, batch_size};
+            for (int i = 0; i < 10'000; ++i) {
+                AC_CODDING_ERROR_IF_NOT(object.send(record_message{i}));
+            }
+            ac::event started{ac::event::manuel, ac::event::unsignaled};
+            ac::event resume{ac::event::manuel, ac::event::signaled};
+            AC_CODDING_ERROR_IF_NOT(object.emplace<block_message>(&started, &resume));
+            (void) started.wait();
+            object.stop();
+            AC_CODDING_ERROR_IF_NOT(object.is_stopped());
+            AC_CODDING_ERROR_IF(object.out_of_order_);
+            AC_CODDING_ERROR_IF_NOT(10'000 == object.received_.size());
+        }
+        //
+        // Messages that did not run when object stopped are dropped,
+        // and send fails after that
+        //
+        {
+            test_active object{tp};
+            ac::event started{ac::event::manuel, ac::event::unsignaled};
+            ac::event resume{ac::event::manuel, ac::event::unsignaled};
+            AC_CODDING_ERROR_IF_NOT(object.send(block_message{&started, &resume}));
+            (void) started.wait();
+            for (int i = 0; i < 100; ++i) {
+                AC_CODDING_ERROR_IF_NOT(object.send(record_message{i}));
+            }
+            object.request_stop();
+            AC_CODDING_ERROR_IF_NOT(object.is_stopped());
+            //
+            // Stopping, but handler is still running
+            //
+            AC_CODDING_ERROR_IF(object.send(record_message{100}));
+            resume.set();
+            object.stop();
+            AC_CODDING_ERROR_IF_NOT(object.received_.empty());
+        }
+        //
+        // Handler can stop the object, messages after it do not run
+        //
+        {
+            test_active object{tp};
+            ac::event stopped{ac::event::manuel, ac::event::unsignaled};
+            AC_CODDING_ERROR_IF_NOT(object.send(record_message{0}));
+            AC_CODDING_ERROR_IF_NOT(object.send(stop_message{&stopped}));
+            for (int i = 1; i < 100; ++i) {
+                (void) object.send(record_message{i});
+            }
+            (void) stopped.wait();
+            object.stop();
+            AC_CODDING_ERROR_IF_NOT(1 == object.received_.size());
+        }
+        //
+        // Object stopped while nothing is scheduled, on the default pool
+        //
+        {
+            test_active object;
+            object.stop();
+            AC_CODDING_ERROR_IF(object.send(record_message{0}));
+        }
+    } catch (std::exception const &ex) {
+        printf("---- test_active_object failed %s\n", ex.what());
+    }
+    printf("---- test_active_object complete\n");
+}
+
+void test_tp_cleanup_group() {
+    printf("\n---- test_tp_cleanup_group started\n");
+
+    try {
+        ac::tp::thread_pool tp{1, 1};
+        //
+        // With cancel_pending, callbacks that did not start are dropped,
+        // and running callback is waited for
+        //
+        {
+            ac::tp::cleanup_group group;
+            std::atomic<int> pending_ran{0};
+            std::atomic<int> timer_ran{0};
+            std::atomic<int> wait_ran{0};
+            ac::event started{ac::event::manuel, ac::event::unsignaled};
+            ac::event release{ac::event::manuel, ac::event::unsignaled};
+            ac::event never{ac::event::manuel, ac::event::unsignaled};
+            //
+            // Members are closed in the order they joined the group, so
+            // pending callbacks are canceled before the running one ends
+            //
+            ac::tp::work_item_ptr pending{
+                group.make_work_item(tp, [&pending_ran](ac::tp::callback_instance &) { pending_ran.fetch_add(1); })};
+            ac::tp::timer_work_item_ptr timer{
+                group.make_timer_work_item(tp, [&timer_ran](ac::tp::callback_instance &) { timer_ran.fetch_add(1); })};
+            ac::tp::wait_work_item_ptr wait{group.make_wait_work_item(
+                tp, [&wait_ran](ac::tp::callback_instance &, TP_WAIT_RESULT) { wait_ran.fetch_add(1); })};
+            bool blocked_done{false};
+            ac::tp::work_item_ptr blocked{
+                group.make_work_item(tp, [&started, &release, &blocked_done](ac::tp::callback_instance &) {
+                    started.set();
+                    (void) release.wait();
+                    blocked_done = true;
+                })};
+            AC_CODDING_ERROR_IF_NOT(4 == group.size());
+
+            blocked->post();
+            (void) started.wait();
+            pending->post(10);
+            timer->schedule(ac::tp::seconds{10});
+            wait->schedule_wait(never.get_handle());
+
+            std::thread closer{[&group] { group.close_members(true); }};
+            std::this_thread::sleep_for(std::chrono::milliseconds{50});
+            release.set();
+            closer.join();
+
+            AC_CODDING_ERROR_IF_NOT(blocked_done);
+            AC_CODDING_ERROR_IF_NOT(0 == group.size());
+            never.set();
+            std::this_thread::sleep_for(std::chrono::milliseconds{50});
+            AC_CODDING_ERROR_IF_NOT(0 == pending_ran.load());
+            AC_CODDING_ERROR_IF_NOT(0 == timer_ran.load());
+            AC_CODDING_ERROR_IF_NOT(0 == wait_ran.load());
+        }
+        //
+        // Without cancel_pending, queued callbacks run before
+        // close_members returns
+        //
+        {
+            ac::tp::cleanup_group group;
+            std::atomic<int> ran{0};
+            ac::event started{ac::event::manuel, ac::event::unsignaled};
+            ac::event release{ac::event::manuel, ac::event::unsignaled};
+            ac::tp::work_item_ptr blocked{group.make_work_item(tp, [&started, &release](ac::tp::callback_instance &) {
+                started.set();
+                (void) release.wait();
+            })};
+            ac::tp::work_item_ptr queued{
+                group.make_work_item(tp, [&ran](ac::tp::callback_instance &) { ran.fetch_add(1); })};
+            blocked->post();
+            (void) started.wait();
+            queued->post(10);
+            release.set();
+            group.close_members(false);
+            AC_CODDING_ERROR_IF_NOT(10 == ran.load());
+        }
+        //
+        // Member destroyed before close leaves the group,
+        // and group can be reused after close
+        //
+        {
+            ac::tp::cleanup_group group;
+            std::atomic<int> ran{0};
+            ac::tp::work_item_ptr first{
+                group.make_work_item(tp, [&ran](ac::tp::callback_instance &) { ran.fetch_add(1); })};
+            ac::tp::work_item_ptr second{
+                group.make_work_item(tp, [&ran](ac::tp::callback_instance &) { ran.fetch_add(1); })};
+            AC_CODDING_ERROR_IF_NOT(2 == group.size());
+            first.reset();
+            AC_CODDING_ERROR_IF_NOT(1 == group.size());
+            second->post();
+            second->join();
+            group.close_members();
+            AC_CODDING_ERROR_IF_NOT(0 == group.size());
+
+            ac::tp::work_item_ptr third{
+                group.make_work_item(tp, [&ran](ac::tp::callback_instance &) { ran.fetch_add(1); })};
+            AC_CODDING_ERROR_IF_NOT(1 == group.size());
+            third->post();
+            third->join();
+            AC_CODDING_ERROR_IF_NOT(2 == ran.load());
+        }
+    } catch (std::exception const &ex) {
+        printf("---- test_tp_cleanup_group failed %s\n", ex.what());
+    }
+    printf("---- test_tp_cleanup_group complete\n");
+}
+
+namespace {
+
+    std::mutex late_items_lock;
+    std::vector<ac::tp::work_item_ptr> late_items;
+
+    struct callback_objects_holder {
+        ac::tp::work_item_ptr work;
+        ac::tp::timer_work_item_ptr timer;
+        ac::tp::wait_work_item_ptr wait;
+
+        ~callback_objects_holder() {
+            //
+            // Runs after the node cache of this thread is gone.
+            // Objects are freed to, and taken from, the shared list.
+            //
+            work.reset();
+            timer.reset();
+            wait.reset();
+            for (int i = 0; i < 8; ++i) {
+                ac::tp::work_item_ptr late{ac::tp::make_work_item([](ac::tp::callback_instance &) {})};
+                late->post();
+                late->join();
+                std::lock_guard lock{late_items_lock};
+                late_items.push_back(std::move(late));
+            }
+        }
+    };
+
+} // namespace
+
+void test_tp_callback_objects_after_thread_exit() {
+    printf("\n---- test_tp_callback_objects_after_thread_exit started\n");
+
+    try {
+        ac::tp::thread_pool tp{1, 2};
+        std::atomic<int> ran{0};
+        for (int i = 0; i < 16; ++i) {
+            std::thread{[&tp, &ran] {
+                thread_local callback_objects_holder holder;
+                holder.work = tp.make_work_item([&ran](ac::tp::callback_instance &) { ran.fetch_add(1); });
+                holder.timer = tp.make_timer_work_item([](ac::tp::callback_instance &) {});
+                holder.wait = tp.make_wait_work_item([](ac::tp::callback_instance &, TP_WAIT_RESULT) {});
+                holder.work->post();
+                holder.work->join();
+            }}.join();
+        }
+        AC_CODDING_ERROR_IF_NOT(16 == ran.load());
+        //
+        // Objects created on one thread and destroyed on another
+        //
+        std::vector<ac::tp::work_item_ptr> items;
+        std::thread{[&tp, &items] {
+            for (int i = 0; i < 1000; ++i) {
+                items.push_back(tp.make_work_item([](ac::tp::callback_instance &) {}));
+            }
+        }}.join();
+        items.clear();
+        //
+        // Object freed twice would be handed out twice
+        //
+        for (int i = 0; i < 4096; ++i) {
+            items.push_back(tp.make_work_item([](ac::tp::callback_instance &) {}));
+        }
+        std::vector<ac::tp::work_item *> sorted;
+        for (ac::tp::work_item_ptr const &item : items) {
+            sorted.push_back(item.get());
+        }
+        for (ac::tp::work_item_ptr const &item : late_items) {
+            sorted.push_back(item.get());
+        }
+        std::sort(sorted.begin(), sorted.end());
+        AC_CODDING_ERROR_IF_NOT(sorted.end() == std::adjacent_find(sorted.begin(), sorted.end()));
+        items.clear();
+        late_items.clear();
+    } catch (std::exception const &ex) {
+        printf("---- test_tp_callback_objects_after_thread_exit failed %s\n", ex.what());
+    }
+    printf("---- test_tp_callback_objects_after_thread_exit complete\n");
+}
+
+void test_tp_scratch_arena() {
+    printf("\n---- test_tp_scratch_arena started\n");
+
+    try {
+        //
+        // Rewinding to a mark gives back what was allocated after it,
+        // including chunks that were added after it
+        //
+        {
+            ac::tp::details::scratch_arena arena;
+            ac::tp::details::scratch_arena::mark const empty{arena.get_mark()};
+            void *const first{arena.allocate(100)};
+            ac::tp::details::scratch_arena::mark const after_first{arena.get_mark()};
+            void *const second{arena.allocate(200)};
+            AC_CODDING_ERROR_IF(first == second);
+
+            arena.rewind(after_first);
+            AC_CODDING_ERROR_IF_NOT(second == arena.allocate(200));
+            arena.rewind(empty);
+            AC_CODDING_ERROR_IF_NOT(first == arena.allocate(100));
+
+            void *const aligned{arena.allocate(8, 64)};
+            AC_CODDING_ERROR_IF_NOT(0 == reinterpret_cast<std::uintptr_t>(aligned) % 64);
+            //
+            // Spill to the next chunk and to a chunk bigger than the
+            // default, and reuse them after rewind
+            //
+            ac::tp::details::scratch_arena::mark const before_spill{arena.get_mark()};
+            void *const spilled{arena.allocate(ac::tp::details::scratch_arena::chunk_size)};
+            void *const huge{arena.allocate(4 * ac::tp::details::scratch_arena::chunk_size)};
+            std::memset(huge, 0xAB, 4 * ac::tp::details::scratch_arena::chunk_size);
+            arena.rewind(before_spill);
+            AC_CODDING_ERROR_IF_NOT(spilled == arena.allocate(ac::tp::details::scratch_arena::chunk_size));
+            AC_CODDING_ERROR_IF_NOT(huge == arena.allocate(4 * ac::tp::details::scratch_arena::chunk_size));
+            arena.rewind(empty);
+            AC_CODDING_ERROR_IF_NOT(first == arena.allocate(100));
+        }
+        //
+        // Scratch of a callback is rewound when it returns, so the
+        // next callback on the same worker gets the same memory
+        //
+        ac::tp::thread_pool tp{1, 1};
+        std::vector<void *> addresses;
+        for (int i = 0; i < 3; ++i) {
+            ac::slim_rundown rundown;
+            ac::slim_rundown_join scoped_join(&rundown);
+            tp.submit_work([&addresses, guard = ac::slim_rundown_lock{&rundown}](ac::tp::callback_instance &instance) {
+                std::pmr::vector<int> values{&instance.get_scratch_resource()};
+                values.resize(1000);
+                std::pmr::string text{"a string that does not fit in the small string buffer",
+                                      &instance.get_scratch_resource()};
+                addresses.push_back(values.data());
+            });
+        }
+        AC_CODDING_ERROR_IF_NOT(3 == addresses.size());
+        AC_CODDING_ERROR_IF_NOT(addresses[0] == addresses[1] && addresses[1] == addresses[2]);
+    } catch (std::exception const &ex) {
+        printf("---- test_tp_scratch_arena failed %s\n", ex.what());
+    }
+    printf("---- test_tp_scratch_arena complete\n");
+}
+
+namespace {
+    //
+    // Best effort, shards are picked by the processor
+    // a thread runs on
+    //
+    void pin_to_cpu(unsigned int cpu) {
+#ifdef _WIN32
+        (void) SetThreadAffinityMask(GetCurrentThread(), DWORD_PTR{1} << cpu);
+#else
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        (void) pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#endif
+    }
+
+    template<typename F>
+    void run_on_cpu(unsigned int cpu, F &&f) {
+        std::thread{[cpu, &f] {
+            pin_to_cpu(cpu);
+            f();
+        }}.join();
+    }
+
+} // namespace
+
+void test_sharded_rundown() {
+    printf("\n---- test_sharded_rundown started\n");
+
+    try {
+        unsigned int const cpus{std::min(4U, std::max(1U, std::thread::hardware_concurrency()))};
+        constexpr int references{1000};
+        //
+        // References taken on one processor and released on another
+        // leave shards out of balance, but their sum stays right
+        //
+        ac::sharded_rundown rundown;
+        for (unsigned int from = 0; from < cpus; ++from) {
+            for (unsigned int to = 0; to < cpus; ++to) {
+                run_on_cpu(from, [&rundown] {
+                    for (int i = 0; i < references; ++i) {
+                        AC_CODDING_ERROR_IF_NOT(rundown.try_acquire());
+                    }
+                });
+                AC_CODDING_ERROR_IF_NOT(references == rundown.count());
+                run_on_cpu(to, [&rundown] {
+                    for (int i = 0; i < references; ++i) {
+                        rundown.release();
+                    }
+                });
+                AC_CODDING_ERROR_IF_NOT(0 == rundown.count());
+            }
+        }
+        //
+        // Rundown waits for references acquired on one processor and
+        // released on another after cancelation
+        //
+        for (int round = 0; round < 3; ++round) {
+            run_on_cpu(0, [&rundown] {
+                for (int i = 0; i < references; ++i) {
+                    AC_CODDING_ERROR_IF_NOT(rundown.try_acquire());
+                }
+            });
+            AC_CODDING_ERROR_IF(rundown.start_rundown());
+            AC_CODDING_ERROR_IF_NOT(rundown.is_running_down());
+            AC_CODDING_ERROR_IF(rundown.try_acquire());
+            AC_CODDING_ERROR_IF_NOT(references == rundown.count());
+
+            std::atomic<bool> joined{false};
+            std::thread joiner{[&rundown, &joined] {
+                rundown.join();
+                joined = true;
+            }};
+            run_on_cpu(cpus - 1, [&rundown] {
+                for (int i = 0; i < references - 1; ++i) {
+                    rundown.release();
+                }
+            });
+            std::this_thread::sleep_for(std::chrono::milliseconds{10});
+            AC_CODDING_ERROR_IF(joined.load());
+            AC_CODDING_ERROR_IF(rundown.is_rundown_complete());
+            rundown.release();
+            joiner.join();
+            AC_CODDING_ERROR_IF_NOT(joined.load());
+            AC_CODDING_ERROR_IF_NOT(rundown.is_rundown_complete());
+            //
+            // Restart keeps shard counts, only their sum is zero
+            //
+            rundown.restart();
+            AC_CODDING_ERROR_IF_NOT(rundown.is_running());
+            AC_CODDING_ERROR_IF_NOT(0 == rundown.count());
+        }
+        //
+        // Threads keep taking references while rundown runs, and none
+        // is held or taken once join returns
+        //
+        std::atomic<int> inside{0};
+        std::atomic<bool> acquired_after_join{false};
+        std::atomic<bool> joined{false};
+        std::vector<std::thread> threads;
+        for (unsigned int cpu = 0; cpu < 2 * cpus; ++cpu) {
+            threads.emplace_back([&, cpu] {
+                pin_to_cpu(cpu % cpus);
+                while (rundown.try_acquire()) {
+                    if (joined.load()) {
+                        acquired_after_join = true;
+                    }
+                    inside.fetch_add(1);
+                    std::this_thread::yield();
+                    inside.fetch_sub(1);
+                    rundown.release();
+                }
+            });
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds{20});
+        rundown.join();
+        joined = true;
+        AC_CODDING_ERROR_IF_NOT(0 == inside.load());
+        for (std::thread &thread : threads) {
+            thread.join();
+        }
+        AC_CODDING_ERROR_IF(acquired_after_join.load());
+        rundown.restart();
+        //
+        // Threads acquire on one processor and release on another while
+        // rundown is restarted over and over. Every rundown completes,
+        // and restarted rundown accepts references on every shard.
+        //
+        std::atomic<bool> stop{false};
+        threads.clear();
+        for (unsigned int cpu = 0; cpu < cpus; ++cpu) {
+            threads.emplace_back([&, cpu] {
+                while (!stop.load()) {
+                    pin_to_cpu(cpu);
+                    if (rundown.try_acquire()) {
+                        pin_to_cpu((cpu + 1) % cpus);
+                        rundown.release();
+                    }
+                }
+            });
+        }
+        for (int round = 0; round < 200; ++round) {
+            rundown.start_rundown();
+            std::chrono::steady_clock::time_point const deadline{std::chrono::steady_clock::now() +
+                                                                 std::chrono::seconds{10}};
+            while (!rundown.is_rundown_complete()) {
+                AC_CODDING_ERROR_IF(std::chrono::steady_clock::now() > deadline);
+                std::this_thread::yield();
+            }
+            rundown.restart();
+            AC_CODDING_ERROR_IF_NOT(rundown.is_running());
+        }
+        stop = true;
+        for (std::thread &thread : threads) {
+            thread.join();
+        }
+        for (unsigned int cpu = 0; cpu < cpus; ++cpu) {
+            run_on_cpu(cpu, [&rundown] {
+                AC_CODDING_ERROR_IF_NOT(rundown.try_acquire());
+                rundown.release();
+            });
+        }
+        AC_CODDING_ERROR_IF_NOT(0 == rundown.count());
+    } catch (std::exception const &ex) {
+        printf("---- test_sharded_rundown failed %s\n", ex.what());
+    }
+    printf("---- test_sharded_rundown complete\n");
+}
+
+namespace {
+
+    template<typename T>
+    void check_wait_on_address(T first, T second) {
+        using clock = std::chrono::steady_clock;
+        constexpr std::chrono::milliseconds timeout{20};
+        T value{first};
+        T volatile *const address{&value};
+        //
+        // Value that already differs does not block
+        //
+        AC_CODDING_ERROR_IF_NOT(ac::wait_on_address::try_wait(address, second, 0));
+        AC_CODDING_ERROR_IF_NOT(ac::wait_on_address::try_wait_for(address, second, std::chrono::hours{1}));
+        //
+        // Unchanged value times out
+        //
+        clock::time_point start{clock::now()};
+        AC_CODDING_ERROR_IF(ac::wait_on_address::try_wait(address, first, static_cast<DWORD>(timeout.count())));
+        AC_CODDING_ERROR_IF_NOT(clock::now() - start >= timeout);
+
+        start = clock::now();
+        AC_CODDING_ERROR_IF(ac::wait_on_address::try_wait_for(address, first, timeout, 100));
+        AC_CODDING_ERROR_IF_NOT(clock::now() - start >= timeout);
+
+        bool threw{false};
+        try {
+            ac::wait_on_address::wait_for(address, first, timeout);
+        } catch (std::system_error const &) {
+            threw = true;
+        }
+        AC_CODDING_ERROR_IF_NOT(threw);
+        //
+        // Waiters see the new value after wake. Wake can be spurious,
+        // so they recheck the value.
+        //
+        std::atomic<int> woken{0};
+        std::vector<std::thread> waiters;
+        for (int i = 0; i < 2; ++i) {
+            waiters.emplace_back([address, first, &woken] {
+                while (first == *address) {
+                    (void) ac::wait_on_address::try_wait(address, first);
+                }
+                woken.fetch_add(1);
+            });
+        }
+        std::this_thread::sleep_for(timeout);
+        AC_CODDING_ERROR_IF_NOT(0 == woken.load());
+        *address = second;
+        ac::wait_on_address::wake_single(address);
+        ac::wait_on_address::wake_all(address);
+        for (std::thread &waiter : waiters) {
+            waiter.join();
+        }
+        AC_CODDING_ERROR_IF_NOT(2 == woken.load());
+    }
+
+} // namespace
+
+void test_wait_on_address() {
+    printf("\n---- test_wait_on_address started\n");
+
+    try {
+        check_wait_on_address<std::uint8_t>(0x11, 0x22);
+        check_wait_on_address<std::uint16_t>(0x1111, 0x1122);
+        check_wait_on_address<std::uint32_t>(0x11111111, 0x11111122);
+        check_wait_on_address<std::uint64_t>(0x1111111111111111ULL, 0x2211111111111111ULL);
+    } catch (std::exception const &ex) {
+        printf("---- test_wait_on_address failed %s\n", ex.what());
+    }
+    printf("---- test_wait_on_address complete\n");
+}
+
+#ifndef _WIN32
+
+void test_tp_queue_wait_histogram() {
+    printf("\n---- test_tp_queue_wait_histogram started\n");
+
+    try {
+        ac::tp::thread_pool tp{2, 2};
+        ac::tp::optional_callback_parameters high;
+        high.priority = TP_CALLBACK_PRIORITY_HIGH;
+
+        auto run_callbacks = [&tp, &high](int count) {
+            ac::slim_rundown rundown;
+            ac::slim_rundown_join scoped_join(&rundown);
+            for (int i = 0; i < count; ++i) {
+                tp.submit_work([guard = ac::slim_rundown_lock{&rundown}](ac::tp::callback_instance &) {}, &high);
+            }
+        };
+        //
+        // Nothing is recorded until it is enabled
+        //
+        AC_CODDING_ERROR_IF(tp.is_queue_wait_histogram_enabled());
+        run_callbacks(100);
+        AC_CODDING_ERROR_IF_NOT(0 == tp.get_queue_wait_histogram(TP_CALLBACK_PRIORITY_HIGH).count());
+
+        tp.enable_queue_wait_histogram();
+        run_callbacks(100);
+        ac::tp::queue_wait_histogram const recorded{tp.get_queue_wait_histogram(TP_CALLBACK_PRIORITY_HIGH)};
+        AC_CODDING_ERROR_IF_NOT(100 == recorded.count());
+        AC_CODDING_ERROR_IF_NOT(0 == tp.get_queue_wait_histogram(TP_CALLBACK_PRIORITY_LOW).count());
+
+        tp.enable_queue_wait_histogram(false);
+        run_callbacks(100);
+        AC_CODDING_ERROR_IF_NOT(100 == tp.get_queue_wait_histogram(TP_CALLBACK_PRIORITY_HIGH).count());
+    } catch (std::exception const &ex) {
+        printf("---- test_tp_queue_wait_histogram failed %s\n", ex.what());
+    }
+    printf("---- test_tp_queue_wait_histogram complete\n");
+}
+
+namespace {
+    //
+    // High priority callback that keeps submitting itself until
+    // stopped. Count drops to zero once the last one is done.
+    //
+    void flood_high_priority(ac::tp::thread_pool &tp,
+                             ac::tp::optional_callback_parameters *high,
+                             std::atomic<bool> &stop,
+                             std::atomic<int> &outstanding) {
+        outstanding.fetch_add(1);
+        tp.submit_work(
+            [&tp, high, &stop, &outstanding](ac::tp::callback_instance &) {
+                if (!stop.load()) {
+                    flood_high_priority(tp, high, stop, outstanding);
+                }
+                outstanding.fetch_sub(1);
+            },
+            high);
+    }
+
+} // namespace
+
+void test_tp_priority() {
+    printf("\n---- test_tp_priority started\n");
+
+    try {
+        ac::tp::thread_pool tp{1, 1};
+        ac::tp::optional_callback_parameters high;
+        high.priority = TP_CALLBACK_PRIORITY_HIGH;
+        ac::tp::optional_callback_parameters low;
+        low.priority = TP_CALLBACK_PRIORITY_LOW;
+        //
+        // Worker takes higher priority work first
+        //
+        {
+            std::string order;
+            ac::event started{ac::event::manuel, ac::event::unsignaled};
+            ac::event release{ac::event::manuel, ac::event::unsignaled};
+            {
+                ac::slim_rundown rundown;
+                ac::slim_rundown_join scoped_join(&rundown);
+                tp.submit_work([&started, &release, guard = ac::slim_rundown_lock{&rundown}](
+                                   ac::tp::callback_instance &) {
+                    started.set();
+                    (void) release.wait();
+                });
+                (void) started.wait();
+                tp.submit_work(
+                    [&order, guard = ac::slim_rundown_lock{&rundown}](ac::tp::callback_instance &) { order += 'L'; },
+                    &low);
+                tp.submit_work(
+                    [&order, guard = ac::slim_rundown_lock{&rundown}](ac::tp::callback_instance &) { order += 'N'; });
+                tp.submit_work(
+                    [&order, guard = ac::slim_rundown_lock{&rundown}](ac::tp::callback_instance &) { order += 'H'; },
+                    &high);
+                release.set();
+            }
+            AC_CODDING_ERROR_IF_NOT("HNL" == order);
+        }
+        //
+        // Flood of high priority work does not starve low priority
+        // work, or normal work submitted by a callback, which goes
+        // to the deque of the worker
+        //
+        {
+            std::atomic<bool> stop{false};
+            std::atomic<int> outstanding{0};
+            std::atomic<bool> normal_ran{false};
+            std::atomic<bool> low_ran{false};
+            bool ran_during_flood{false};
+            ac::slim_rundown rundown;
+            {
+                ac::slim_rundown_join scoped_join(&rundown);
+                for (int i = 0; i < 4; ++i) {
+                    flood_high_priority(tp, &high, stop, outstanding);
+                }
+                tp.submit_work(
+                    [&tp, &normal_ran, &rundown, guard = ac::slim_rundown_lock{&rundown}](ac::tp::callback_instance &) {
+                        tp.submit_work([&normal_ran, guard = ac::slim_rundown_lock{&rundown}](
+                                           ac::tp::callback_instance &) { normal_ran = true; });
+                    },
+                    &high);
+                tp.submit_work([&low_ran, guard = ac::slim_rundown_lock{&rundown}](
+                                   ac::tp::callback_instance &) { low_ran = true; },
+                               &low);
+                std::chrono::steady_clock::time_point const deadline{std::chrono::steady_clock::now() +
+                                                                     std::chrono::seconds{5}};
+                while (!ran_during_flood && std::chrono::steady_clock::now() < deadline) {
+                    std::this_thread::sleep_for(std::chrono::milliseconds{1});
+                    ran_during_flood = normal_ran.load() && low_ran.load();
+                }
+                stop = true;
+            }
+            while (0 != outstanding.load()) {
+                std::this_thread::yield();
+            }
+            AC_CODDING_ERROR_IF_NOT(ran_during_flood);
+        }
+    } catch (std::exception const &ex) {
+        printf("---- test_tp_priority failed %s\n", ex.what());
+    }
+    printf("---- test_tp_priority complete\n");
+}
+
+void test_tp_blocking_scope() {
+    printf("\n---- test_tp_blocking_scope started\n");
+
+    try {
+        auto wait_until = [](auto &&condition) {
+            std::chrono::steady_clock::time_point const deadline{std::chrono::steady_clock::now() +
+                                                                 std::chrono::seconds{5}};
+            while (!condition()) {
+                if (std::chrono::steady_clock::now() > deadline) {
+                    return false;
+                }
+                std::this_thread::sleep_for(std::chrono::milliseconds{1});
+            }
+            return true;
+        };
+        auto submit_blocked = [](ac::tp::thread_pool &tp,
+                                 ac::slim_rundown &rundown,
+                                 std::atomic<int> &started,
+                                 std::atomic<bool> &release) {
+            tp.submit_work([&started, &release, guard = ac::slim_rundown_lock{&rundown}](
+                               ac::tp::callback_instance &instance) {
+                ac::tp::callback_instance::blocking_scope scope{instance};
+                started.fetch_add(1);
+                while (!release.load()) {
+                    std::this_thread::sleep_for(std::chrono::milliseconds{1});
+                }
+            });
+        };
+        //
+        // Callbacks blocked on a saturated pool start compensating
+        // workers, and pool shrinks back once they return
+        //
+        {
+            ac::tp::thread_pool tp{2, 8};
+            constexpr int blocked{4};
+            std::atomic<int> started{0};
+            std::atomic<bool> release{false};
+            {
+                ac::slim_rundown rundown;
+                ac::slim_rundown_join scoped_join(&rundown);
+                for (int i = 0; i < blocked; ++i) {
+                    submit_blocked(tp, rundown, started, release);
+                }
+                AC_CODDING_ERROR_IF_NOT(wait_until([&started] { return blocked == started.load(); }));
+                AC_CODDING_ERROR_IF_NOT(blocked - 2 <= tp.get_compensation_count());
+                AC_CODDING_ERROR_IF_NOT(blocked <= tp.get_thread_count());
+                release = true;
+            }
+            AC_CODDING_ERROR_IF_NOT(wait_until([&tp] { return 2 == tp.get_thread_count(); }));
+        }
+        //
+        // Compensating worker retired because maximum went down, so
+        // there is nobody to pay the debt off when callback returns.
+        // Debt is dropped, and does not retire the next compensating
+        // worker while its callback is still blocked.
+        //
+        {
+            ac::tp::thread_pool tp{1, 4};
+            std::atomic<int> started{0};
+            std::atomic<bool> release{false};
+            {
+                ac::slim_rundown rundown;
+                ac::slim_rundown_join scoped_join(&rundown);
+                submit_blocked(tp, rundown, started, release);
+                AC_CODDING_ERROR_IF_NOT(wait_until([&started] { return 1 == started.load(); }));
+                AC_CODDING_ERROR_IF_NOT(1 == tp.get_compensation_count());
+                tp.get_handle()->set_max_thread_count(1);
+                AC_CODDING_ERROR_IF_NOT(wait_until([&tp] { return 1 == tp.get_thread_count(); }));
+                release = true;
+            }
+            tp.get_handle()->set_max_thread_count(4);
+
+            constexpr int quick{3};
+            std::atomic<int> ran{0};
+            started = 0;
+            release = false;
+            bool ran_while_blocked{false};
+            {
+                ac::slim_rundown rundown;
+                ac::slim_rundown_join scoped_join(&rundown);
+                submit_blocked(tp, rundown, started, release);
+                AC_CODDING_ERROR_IF_NOT(wait_until([&started] { return 1 == started.load(); }));
+                for (int i = 0; i < quick; ++i) {
+                    tp.submit_work([&ran, guard = ac::slim_rundown_lock{&rundown}](ac::tp::callback_instance &) {
+                        ran.fetch_add(1);
+                    });
+                }
+                ran_while_blocked = wait_until([&ran] { return quick == ran.load(); });
+                release = true;
+            }
+            AC_CODDING_ERROR_IF_NOT(ran_while_blocked);
+            AC_CODDING_ERROR_IF_NOT(2 == tp.get_compensation_count());
+        }
+    } catch (std::exception const &ex) {
+        printf("---- test_tp_blocking_scope failed %s\n", ex.what());
+    }
+    printf("---- test_tp_blocking_scope complete\n");
+}
+
+void test_tp_adaptive_concurrency() {
+    printf("\n---- test_tp_adaptive_concurrency started\n");
+
+    try {
+        constexpr unsigned long min_threads{2};
+        constexpr unsigned long max_threads{6};
+        ac::tp::thread_pool tp{min_threads, max_threads};
+        //
+        // Keeps work queued for the duration, callbacks sleep, so
+        // throughput depends on the number of workers
+        //
+        auto run_load = [&tp](std::chrono::milliseconds duration) {
+            ac::slim_rundown rundown;
+            ac::slim_rundown_join scoped_join(&rundown);
+            std::chrono::steady_clock::time_point const end{std::chrono::steady_clock::now() + duration};
+            while (std::chrono::steady_clock::now() < end) {
+                for (int i = 0; i < 20; ++i) {
+                    tp.submit_work([guard = ac::slim_rundown_lock{&rundown}](ac::tp::callback_instance &) {
+                        std::this_thread::sleep_for(std::chrono::milliseconds{1});
+                    });
+                }
+                unsigned long const threads{tp.get_thread_count()};
+                AC_CODDING_ERROR_IF(threads < min_threads || threads > max_threads);
+                unsigned long const target{tp.get_target_thread_count()};
+                AC_CODDING_ERROR_IF(0 != target && (target < min_threads || target > max_threads));
+                std::this_thread::sleep_for(std::chrono::milliseconds{5});
+            }
+        };
+
+        AC_CODDING_ERROR_IF_NOT(0 == tp.get_target_thread_count());
+        AC_CODDING_ERROR_IF_NOT(tp.enable_adaptive_concurrency(std::chrono::milliseconds{10}));
+        AC_CODDING_ERROR_IF(0 == tp.get_target_thread_count());
+        run_load(std::chrono::milliseconds{400});
+
+        std::vector<ac::tp::concurrency_adjustment> const adjustments{tp.get_concurrency_adjustments()};
+        printf("controller made %zu adjustments\n", adjustments.size());
+        AC_CODDING_ERROR_IF(adjustments.empty());
+        for (ac::tp::concurrency_adjustment const &adjustment : adjustments) {
+            AC_CODDING_ERROR_IF(adjustment.from_ < min_threads || adjustment.from_ > max_threads);
+            AC_CODDING_ERROR_IF(adjustment.to_ < min_threads || adjustment.to_ > max_threads);
+            AC_CODDING_ERROR_IF(adjustment.from_ == adjustment.to_);
+        }
+        //
+        // Disabled controller makes no more adjustments
+        //
+        tp.disable_adaptive_concurrency();
+        AC_CODDING_ERROR_IF_NOT(0 == tp.get_target_thread_count());
+        run_load(std::chrono::milliseconds{100});
+        AC_CODDING_ERROR_IF_NOT(adjustments.size() == tp.get_concurrency_adjustments().size());
+    } catch (std::exception const &ex) {
+        printf("---- test_tp_adaptive_concurrency failed %s\n", ex.what());
+    }
+    printf("---- test_tp_adaptive_concurrency complete\n");
+}
+
+void test_tp_numa_topology() {
+    printf("\n---- test_tp_numa_topology started\n");
+
+    std::filesystem::path const root{std::filesystem::temp_directory_path() /
+                                     ("ac_test_numa_" + std::to_string(getpid()))};
+    try {
+        using ac::tp::details::parse_cpu_list;
+        using ac::tp::details::read_numa_topology;
+
+        AC_CODDING_ERROR_IF_NOT((std::vector<int>{0, 1, 2, 3, 8, 9, 10, 11}) == parse_cpu_list("0-3,8-11"));
+        AC_CODDING_ERROR_IF_NOT((std::vector<int>{5}) == parse_cpu_list("5"));
+        AC_CODDING_ERROR_IF_NOT((std::vector<int>{0}) == parse_cpu_list("0-0"));
+        AC_CODDING_ERROR_IF_NOT((std::vector<int>{1, 3, 7, 8}) == parse_cpu_list("1, 3,7-8\n"));
+        AC_CODDING_ERROR_IF_NOT(parse_cpu_list("").empty());
+        AC_CODDING_ERROR_IF_NOT(parse_cpu_list("\n").empty());
+        //
+        // Fake sysfs tree. Node 1 is offline, node 3 is online
+        // but has only memory, and node 4 has no cpulist.
+        //
+        auto write = [&root](std::string const &name, std::string const &content) {
+            std::filesystem::create_directories((root / name).parent_path());
+            std::ofstream{root / name} << content;
+        };
+        write("node0/cpulist", "0\n");
+        write("node1/cpulist", "1\n");
+        write("node2/cpulist", "0,4-6\n");
+        write("node3/cpulist", "\n");
+        write("online", "0,2-4\n");
+
+        AC_CODDING_ERROR_IF_NOT(read_numa_topology((root / "missing").string()).empty());
+        std::vector<ac::tp::details::numa_node> const topology{read_numa_topology(root.string())};
+        AC_CODDING_ERROR_IF_NOT(2 == topology.size());
+        AC_CODDING_ERROR_IF_NOT(0 == topology[0].id_);
+        AC_CODDING_ERROR_IF_NOT((std::vector<int>{0}) == topology[0].cpus_);
+        AC_CODDING_ERROR_IF_NOT(2 == topology[1].id_);
+        AC_CODDING_ERROR_IF_NOT((std::vector<int>{0, 4, 5, 6}) == topology[1].cpus_);
+        //
+        // Pool with a group per node runs work bound to a node on a
+        // worker of that node. Both workers are idle before each
+        // submission, so the one of the right group is woken up.
+        //
+        {
+            ac::tp::details::pool_engine engine{2, 2, topology};
+            AC_CODDING_ERROR_IF_NOT(2 == engine.get_group_count());
+            AC_CODDING_ERROR_IF_NOT(ac::tp::details::any_numa_node == engine.get_current_numa_node());
+            for (std::uint32_t node : {2U, 0U, 2U, 0U}) {
+                while (2 != engine.get_idle_count()) {
+                    std::this_thread::yield();
+                }
+                ac::tp::details::callback_options options;
+                options.numa_node_ = node;
+                std::atomic<std::uint32_t> ran_on{ac::tp::details::any_numa_node - 1};
+                ac::tp::details::submit_work(&engine, options, [&engine, &ran_on](ac::tp::callback_instance &) {
+                    ran_on = engine.get_current_numa_node();
+                });
+                while (ac::tp::details::any_numa_node - 1 == ran_on.load()) {
+                    std::this_thread::yield();
+                }
+                AC_CODDING_ERROR_IF_NOT(node == ran_on.load());
+            }
+        }
+        //
+        // Single node topology does not split the pool
+        //
+        {
+            ac::tp::details::pool_engine engine{1, 1, std::vector<ac::tp::details::numa_node>{topology[0]}};
+            AC_CODDING_ERROR_IF_NOT(1 == engine.get_group_count());
+        }
+    } catch (std::exception const &ex) {
+        printf("---- test_tp_numa_topology failed %s\n", ex.what());
+    }
+    std::error_code ignored;
+    std::filesystem::remove_all(root, ignored);
+    printf("---- test_tp_numa_topology complete\n");
+}
+
+void test_tp_work_stealing() {
+    printf("\n---- test_tp_work_stealing started\n");
+
+    try {
+        using ac::tp::details::task;
+        using ac::tp::details::work_stealing_deque;
+        //
+        // Owner pops the newest task, thief steals the oldest, and deque
+        // grows past its initial capacity without losing tasks
+        //
+        {
+            constexpr size_t count{4 * work_stealing_deque::initial_capacity + 3};
+            std::vector<task> tasks(count);
+            work_stealing_deque deque;
+            AC_CODDING_ERROR_IF_NOT(deque.empty());
+            AC_CODDING_ERROR_IF_NOT(nullptr == deque.pop());
+            AC_CODDING_ERROR_IF_NOT(nullptr == deque.steal());
+            for (task &t : tasks) {
+                deque.push(&t);
+            }
+            AC_CODDING_ERROR_IF(deque.empty());
+            size_t oldest{0};
+            size_t newest{count};
+            while (oldest < newest) {
+                AC_CODDING_ERROR_IF_NOT(&tasks[--newest] == deque.pop());
+                if (oldest < newest) {
+                    AC_CODDING_ERROR_IF_NOT(&tasks[oldest++] == deque.steal());
+                }
+            }
+            AC_CODDING_ERROR_IF_NOT(deque.empty());
+            AC_CODDING_ERROR_IF_NOT(nullptr == deque.pop());
+            AC_CODDING_ERROR_IF_NOT(nullptr == deque.steal());
+        }
+        //
+        // Thieves race with the owner, and every task is taken once
+        //
+        {
+            constexpr size_t count{100'000};
+            std::vector<task> tasks(count);
+            std::vector<std::atomic<int>> taken(count);
+            work_stealing_deque deque;
+            std::atomic<bool> done{false};
+            auto take = [&tasks, &taken](task *t) {
+                taken[static_cast<size_t>(t - tasks.data())].fetch_add(1);
+            };
+            std::vector<std::thread> thieves;
+            for (int i = 0; i < 3; ++i) {
+                thieves.emplace_back([&deque, &done, &take] {
+                    while (!done.load() || !deque.empty()) {
+                        if (task *t = deque.steal()) {
+                            take(t);
+                        } else {
+                            std::this_thread::yield();
+                        }
+                    }
+                });
+            }
+            for (size_t i = 0; i < count; ++i) {
+                deque.push(&tasks[i]);
+                if (0 == i % 3) {
+                    if (task *t = deque.pop()) {
+                        take(t);
+                    }
+                }
+            }
+            while (task *t = deque.pop()) {
+                take(t);
+            }
+            done = true;
+            for (std::thread &thief : thieves) {
+                thief.join();
+            }
+            for (std::atomic<int> const &times : taken) {
+                AC_CODDING_ERROR_IF_NOT(1 == times.load());
+            }
+        }
+        //
+        // Callback fans work out to the deque of its worker and waits
+        // for it, so all of it has to be stolen by other workers
+        //
+        {
+            constexpr int count{1'000};
+            ac::tp::thread_pool tp{4, 4};
+            std::atomic<int> ran{0};
+            std::atomic<int> ran_on_parent{0};
+            bool all_ran{false};
+            ac::event fanned_out{ac::event::manuel, ac::event::unsignaled};
+            {
+                ac::slim_rundown rundown;
+                ac::slim_rundown_join scoped_join(&rundown);
+                tp.submit_work([&tp,
+                                &ran,
+                                &ran_on_parent,
+                                &all_ran,
+                                &fanned_out,
+                                &rundown,
+                                guard = ac::slim_rundown_lock{&rundown}](ac::tp::callback_instance &) {
+                    std::thread::id const parent{std::this_thread::get_id()};
+                    for (int i = 0; i < count; ++i) {
+                        tp.submit_work([parent, &ran, &ran_on_parent, guard = ac::slim_rundown_lock{&rundown}](
+                                           ac::tp::callback_instance &) {
+                            if (parent == std::this_thread::get_id()) {
+                                ran_on_parent.fetch_add(1);
+                            }
+                            ran.fetch_add(1);
+                        });
+                    }
+                    fanned_out.set();
+                    std::chrono::steady_clock::time_point const deadline{std::chrono::steady_clock::now() +
+                                                                         std::chrono::seconds{5}};
+                    while (count != ran.load() && std::chrono::steady_clock::now() < deadline) {
+                        std::this_thread::sleep_for(std::chrono::milliseconds{1});
+                    }
+                    all_ran = (count == ran.load());
+                });
+                (void) fanned_out.wait();
+            }
+            AC_CODDING_ERROR_IF_NOT(all_ran);
+            AC_CODDING_ERROR_IF_NOT(0 == ran_on_parent.load());
+        }
+    } catch (std::exception const &ex) {
+        printf("---- test_tp_work_stealing failed %s\n", ex.what());
+    }
+    printf("---- test_tp_work_stealing complete\n");
+}
+
+namespace {
+
+    ac::tp::task<int> coro_add(ac::tp::thread_pool &tp, int a, int b) {
+        co_await tp.schedule();
+        co_return a + b;
+    }
+
+    ac::tp::task<int> coro_throw(ac::tp::thread_pool &tp) {
+        co_await tp.schedule();
+        AC_THROW(ERROR_INVALID_PARAMETER, "coro_throw");
+        co_return 0;
+    }
+
+} // namespace
+
+void test_tp_coroutines() {
+    printf("\n---- test_tp_coroutines started\n");
+
+    try {
+        ac::tp::thread_pool tp{1, 2};
+        //
+        // schedule moves the coroutine to a worker of the pool
+        //
+        bool const on_worker{ac::tp::sync_wait([](ac::tp::thread_pool &tp) -> ac::tp::task<bool> {
+            co_await tp.schedule();
+            co_return nullptr != ac::tp::details::pool_engine::current();
+        }(tp))};
+        AC_CODDING_ERROR_IF_NOT(on_worker);
+        AC_CODDING_ERROR_IF_NOT(nullptr == ac::tp::details::pool_engine::current());
+        //
+        // Nested tasks return values, and exceptions reach the awaiter
+        //
+        int const sum{ac::tp::sync_wait([](ac::tp::thread_pool &tp) -> ac::tp::task<int> {
+            int const a{co_await coro_add(tp, 1, 2)};
+            int const b{co_await coro_add(tp, a, 3)};
+            co_return b;
+        }(tp))};
+        AC_CODDING_ERROR_IF_NOT(6 == sum);
+
+        bool const caught{ac::tp::sync_wait([](ac::tp::thread_pool &tp) -> ac::tp::task<bool> {
+            try {
+                (void) co_await coro_throw(tp);
+            } catch (std::system_error const &) {
+                co_return true;
+            }
+            co_return false;
+        }(tp))};
+        AC_CODDING_ERROR_IF_NOT(caught);
+
+        bool sync_wait_rethrew{false};
+        try {
+            (void) ac::tp::sync_wait(coro_throw(tp));
+        } catch (std::system_error const &) {
+            sync_wait_rethrew = true;
+        }
+        AC_CODDING_ERROR_IF_NOT(sync_wait_rethrew);
+        //
+        // sleep_for resumes no earlier than requested
+        //
+        std::chrono::milliseconds const slept{ac::tp::sync_wait([](ac::tp::thread_pool &tp) -> ac::tp::task<std::chrono::milliseconds> {
+            auto const start{std::chrono::steady_clock::now()};
+            co_await tp.sleep_for(std::chrono::milliseconds{20});
+            co_return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+        }(tp))};
+        AC_CODDING_ERROR_IF_NOT(slept >= std::chrono::milliseconds{20});
+        //
+        // wait_for reports signaled handle and timeout
+        //
+        ac::event signaled_event{ac::event::manuel, ac::event::signaled};
+        ac::event idle_event{ac::event::manuel, ac::event::unsignaled};
+        DWORD const signaled{ac::tp::sync_wait([](ac::tp::thread_pool &tp, HANDLE h) -> ac::tp::task<DWORD> {
+            co_return co_await tp.wait_for(h, std::chrono::seconds{10});
+        }(tp, signaled_event.get_handle()))};
+        AC_CODDING_ERROR_IF_NOT(WAIT_OBJECT_0 == signaled);
+        DWORD const timed_out{ac::tp::sync_wait([](ac::tp::thread_pool &tp, HANDLE h) -> ac::tp::task<DWORD> {
+            co_return co_await tp.wait_for(h, std::chrono::milliseconds{10});
+        }(tp, idle_event.get_handle()))};
+        AC_CODDING_ERROR_IF_NOT(WAIT_TIMEOUT == timed_out);
+        //
+        // Spawned tasks run to completion on their own
+        //
+        std::atomic<int> spawned{0};
+        {
+            ac::slim_rundown rundown;
+            ac::slim_rundown_join scoped_join(&rundown);
+            for (int i = 0; i < 10; ++i) {
+                ac::tp::spawn([](ac::tp::thread_pool &tp, std::atomic<int> &spawned, ac::slim_rundown_lock) -> ac::tp::task<void> {
+                    co_await tp.schedule();
+                    spawned.fetch_add(1);
+                }(tp, spawned, ac::slim_rundown_lock{&rundown}));
+            }
+        }
+        AC_CODDING_ERROR_IF_NOT(10 == spawned.load());
+        //
+        // async_io round trip
+        //
+        ac::scoped_file_delete delete_file{TEST_DEFAULT_TP_IO_HANDLER_FILE_NAME};
+        ac::file_object fo;
+        fo.create(TEST_DEFAULT_TP_IO_HANDLER_FILE_NAME,
+                  GENERIC_READ | GENERIC_WRITE,
+                  FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                  OPEN_ALWAYS,
+                  FILE_FLAG_OVERLAPPED);
+        ac::tp::async_io io{fo};
+        bool const round_trip{ac::tp::sync_wait([](ac::tp::async_io &io) -> ac::tp::task<bool> {
+            char const out[]{"coroutine io"};
+            char in[sizeof(out)]{};
+            ac::tp::io_result const w{co_await io.write(out, sizeof(out), 0)};
+            if (ERROR_SUCCESS != w.error || sizeof(out) != w.bytes_transferred) {
+                co_return false;
+            }
+            ac::tp::io_result const r{co_await io.read(in, sizeof(in), 0)};
+            co_return ERROR_SUCCESS == r.error && sizeof(in) == r.bytes_transferred &&
+                0 == memcmp(in, out, sizeof(out));
+        }(io))};
+        AC_CODDING_ERROR_IF_NOT(round_trip);
+    } catch (std::exception const &ex) {
+        printf("---- test_tp_coroutines failed %s\n", ex.what());
+    }
+    printf("---- test_tp_coroutines complete\n");
+}
+
+void test_tp_exec() {
+    printf("\n---- test_tp_exec started\n");
+
+    try {
+        ac::tp::thread_pool tp{1, 2};
+        ac::tp::exec::scheduler sch{tp.get_scheduler()};
+        //
+        // schedule completes on a worker, and then passes values on
+        //
+        auto const [on_worker] = ac::tp::exec::sync_wait(sch.schedule() | ac::tp::exec::then([] {
+                                     return nullptr != ac::tp::details::pool_engine::current();
+                                 })).value();
+        AC_CODDING_ERROR_IF_NOT(on_worker);
+
+        auto const [doubled] = ac::tp::exec::sync_wait(ac::tp::exec::just(21) |
+                                                       ac::tp::exec::then([](int v) { return v * 2; }))
+                                   .value();
+        AC_CODDING_ERROR_IF_NOT(42 == doubled);
+        //
+        // when_all completes with values of all children, in order
+        //
+        auto const start{std::chrono::steady_clock::now()};
+        auto const [a, b, c] =
+            ac::tp::exec::sync_wait(ac::tp::exec::when_all(
+                                        sch.schedule() | ac::tp::exec::then([] { return 1; }),
+                                        sch.schedule_after(std::chrono::milliseconds{20}) |
+                                            ac::tp::exec::then([] { return 2; }),
+                                        ac::tp::exec::just(3)))
+                .value();
+        AC_CODDING_ERROR_IF_NOT(1 == a && 2 == b && 3 == c);
+        AC_CODDING_ERROR_IF_NOT(std::chrono::steady_clock::now() - start >= std::chrono::milliseconds{20});
+        //
+        // bulk calls f once for every index
+        //
+        constexpr int shape{1000};
+        std::vector<std::atomic<int>> hits(shape);
+        auto const [passed] = ac::tp::exec::sync_wait(sch.schedule() | ac::tp::exec::then([] { return 7; }) |
+                                                      ac::tp::exec::bulk(shape, [&hits](int i, int v) {
+                                                          hits[i].fetch_add(v);
+                                                      }))
+                                  .value();
+        AC_CODDING_ERROR_IF_NOT(7 == passed);
+        for (auto const &h : hits) {
+            AC_CODDING_ERROR_IF_NOT(7 == h.load());
+        }
+        //
+        // Errors reach sync_wait through then and when_all
+        //
+        bool then_rethrew{false};
+        try {
+            (void) ac::tp::exec::sync_wait(sch.schedule() | ac::tp::exec::then([]() -> int {
+                                               AC_THROW(ERROR_INVALID_PARAMETER, "then");
+                                           }));
+        } catch (std::system_error const &) {
+            then_rethrew = true;
+        }
+        AC_CODDING_ERROR_IF_NOT(then_rethrew);
+
+        std::atomic<int> finished{0};
+        bool when_all_rethrew{false};
+        try {
+            (void) ac::tp::exec::sync_wait(ac::tp::exec::when_all(
+                sch.schedule() | ac::tp::exec::then([]() -> int { AC_THROW(ERROR_INVALID_PARAMETER, "when_all"); }),
+                sch.schedule_after(std::chrono::milliseconds{10}) |
+                    ac::tp::exec::then([&finished] { finished.fetch_add(1); })));
+        } catch (std::system_error const &) {
+            when_all_rethrew = true;
+        }
+        AC_CODDING_ERROR_IF_NOT(when_all_rethrew);
+        //
+        // when_all waits for all children even if one of them failed
+        //
+        AC_CODDING_ERROR_IF_NOT(1 == finished.load());
+        //
+        // async_read and async_write round trip
+        //
+        ac::scoped_file_delete delete_file{TEST_DEFAULT_TP_IO_HANDLER_FILE_NAME};
+        ac::file_object fo;
+        fo.create(TEST_DEFAULT_TP_IO_HANDLER_FILE_NAME,
+                  GENERIC_READ | GENERIC_WRITE,
+                  FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                  OPEN_ALWAYS,
+                  FILE_FLAG_OVERLAPPED);
+        ac::tp::async_io io{fo};
+        char const out[]{"sender io"};
+        char in[sizeof(out)]{};
+        auto const [written] = ac::tp::exec::sync_wait(ac::tp::exec::async_write(io, out, sizeof(out), 0)).value();
+        AC_CODDING_ERROR_IF_NOT(ERROR_SUCCESS == written.error && sizeof(out) == written.bytes_transferred);
+        auto const [read] = ac::tp::exec::sync_wait(ac::tp::exec::async_read(io, in, sizeof(in), 0)).value();
+        AC_CODDING_ERROR_IF_NOT(ERROR_SUCCESS == read.error && sizeof(in) == read.bytes_transferred);
+        AC_CODDING_ERROR_IF_NOT(0 == memcmp(in, out, sizeof(out)));
+    } catch (std::exception const &ex) {
+        printf("---- test_tp_exec failed %s\n", ex.what());
+    }
+    printf("---- test_tp_exec complete\n");
+}
+
+void test_tp_parallel() {
+    printf("\n---- test_tp_parallel started\n");
+
+    try {
+        ac::tp::thread_pool tp{1, 4};
+        constexpr int count{100'000};
+        std::vector<long long> values(count);
+        std::iota(values.begin(), values.end(), 1);
+        //
+        // Every index and every element is visited exactly once
+        //
+        std::vector<std::atomic<int>> hits(count);
+        ac::tp::parallel_for(tp, 0, count, [&hits](int i) { hits[i].fetch_add(1); });
+        for (auto const &h : hits) {
+            AC_CODDING_ERROR_IF_NOT(1 == h.load());
+        }
+
+        std::vector<long long> squares{values};
+        ac::tp::parallel_for(tp, squares, [](long long &v) { v *= v; });
+        for (int i = 0; i < count; ++i) {
+            AC_CODDING_ERROR_IF_NOT(values[i] * values[i] == squares[i]);
+        }
+        //
+        // Reductions match serial results. String concatenation is not
+        // commutative, so it also checks that partial results are
+        // combined in index order.
+        //
+        long long const serial_sum{std::accumulate(values.begin(), values.end(), 0LL)};
+        AC_CODDING_ERROR_IF_NOT(serial_sum == ac::tp::parallel_reduce(tp, values, 0LL, std::plus<>{}));
+        AC_CODDING_ERROR_IF_NOT(serial_sum == ac::tp::parallel_reduce(
+                                                  tp, 0, count, 0LL, [&values](int i) { return values[i]; }, std::plus<>{}));
+
+        std::string serial_digits;
+        for (int i = 0; i < 1000; ++i) {
+            serial_digits += static_cast<char>('0' + i % 10);
+        }
+        std::string const digits{ac::tp::parallel_reduce(
+            tp,
+            0,
+            1000,
+            std::string{},
+            [](int i) { return std::string(1, static_cast<char>('0' + i % 10)); },
+            [](std::string lhs, std::string const &rhs) { return lhs + rhs; },
+            16)};
+        AC_CODDING_ERROR_IF_NOT(serial_digits == digits);
+        //
+        // Scan matches std::inclusive_scan
+        //
+        std::vector<long long> serial_scan(count);
+        std::inclusive_scan(values.begin(), values.end(), serial_scan.begin(), std::plus<>{}, 5LL);
+        std::vector<long long> scan(count);
+        auto const scan_end{ac::tp::parallel_scan(tp, values.begin(), values.end(), scan.begin(), std::plus<>{}, 5LL)};
+        AC_CODDING_ERROR_IF_NOT(scan.end() == scan_end);
+        AC_CODDING_ERROR_IF_NOT(serial_scan == scan);
+        //
+        // Empty ranges
+        //
+        ac::tp::parallel_for(tp, 5, 5, [](int) { AC_CODDING_ERROR_IF(true); });
+        AC_CODDING_ERROR_IF_NOT(7 == ac::tp::parallel_reduce(tp, 5, 5, 7, [](int i) { return i; }, std::plus<>{}));
+        //
+        // Exception stops the loop and is rethrown to the caller
+        //
+        bool rethrew{false};
+        try {
+            ac::tp::parallel_for(tp, 0, count, [](int i) {
+                if (count / 2 == i) {
+                    AC_THROW(ERROR_INVALID_PARAMETER, "parallel_for");
+                }
+            });
+        } catch (std::system_error const &) {
+            rethrew = true;
+        }
+        AC_CODDING_ERROR_IF_NOT(rethrew);
+    } catch (std::exception const &ex) {
+        printf("---- test_tp_parallel failed %s\n", ex.what());
+    }
+    printf("---- test_tp_parallel complete\n");
+}
+
+void test_tp_task_graph() {
+    printf("\n---- test_tp_task_graph started\n");
+
+    try {
+        ac::tp::thread_pool tp{1, 4};
+        //
+        // Diamond with a tail: a -> (b, c) -> d -> e
+        //
+        std::mutex lock;
+        std::vector<char> order;
+        auto record = [&lock, &order](char name) {
+            return [&lock, &order, name](ac::tp::callback_instance &) {
+                std::lock_guard guard{lock};
+                order.push_back(name);
+            };
+        };
+        ac::tp::task_graph graph;
+        auto const a{graph.add(record('a'))};
+        auto const b{graph.add(record('b'))};
+        auto const c{graph.add(record('c'))};
+        auto const d{graph.add(record('d'))};
+        auto const e{graph.add(record('e'))};
+        graph.precede(a, b);
+        graph.precede(a, c);
+        graph.precede(b, d);
+        graph.precede(c, d);
+        graph.precede(d, e);
+
+        auto position = [&order](char name) {
+            return std::find(order.begin(), order.end(), name) - order.begin();
+        };
+        for (int run = 0; run < 10; ++run) {
+            order.clear();
+            graph.run(tp);
+            AC_CODDING_ERROR_IF_NOT(5 == order.size());
+            AC_CODDING_ERROR_IF_NOT(0 == position('a'));
+            AC_CODDING_ERROR_IF_NOT(position('b') < position('d'));
+            AC_CODDING_ERROR_IF_NOT(position('c') < position('d'));
+            AC_CODDING_ERROR_IF_NOT(4 == position('e'));
+        }
+        AC_CODDING_ERROR_IF(graph.is_running());
+        //
+        // Wide graph run from a worker of a pool with a single thread
+        // completes because wait helps the pool
+        //
+        ac::tp::thread_pool single{1, 1};
+        std::atomic<int> ran{0};
+        ac::tp::task_graph wide;
+        auto const root{wide.add([](ac::tp::callback_instance &) {})};
+        for (int i = 0; i < 100; ++i) {
+            wide.precede(root, wide.add([&ran](ac::tp::callback_instance &) { ran.fetch_add(1); }));
+        }
+        {
+            ac::slim_rundown rundown;
+            ac::slim_rundown_join scoped_join(&rundown);
+            single.submit_work([&single, &wide, guard = ac::slim_rundown_lock{&rundown}](ac::tp::callback_instance &) {
+                wide.run(single);
+            });
+        }
+        AC_CODDING_ERROR_IF_NOT(100 == ran.load());
+        //
+        // Cycle is detected when graph starts
+        //
+        ac::tp::task_graph cycle;
+        auto const x{cycle.add([](ac::tp::callback_instance &) {})};
+        auto const y{cycle.add([](ac::tp::callback_instance &) {})};
+        auto const z{cycle.add([](ac::tp::callback_instance &) {})};
+        cycle.precede(x, y);
+        cycle.precede(y, z);
+        cycle.precede(z, y);
+        bool cycle_detected{false};
+        try {
+            cycle.run(tp);
+        } catch (std::system_error const &) {
+            cycle_detected = true;
+        }
+        AC_CODDING_ERROR_IF_NOT(cycle_detected);
+        AC_CODDING_ERROR_IF(cycle.is_running());
+        //
+        // Exception thrown by a node is rethrown from wait, and nodes
+        // that depend on it are skipped
+        //
+        bool skipped_ran{false};
+        ac::tp::task_graph failing;
+        auto const thrower{failing.add([](ac::tp::callback_instance &) {
+            AC_THROW(ERROR_INVALID_PARAMETER, "task_graph node");
+        })};
+        auto const skipped{failing.add([&skipped_ran](ac::tp::callback_instance &) { skipped_ran = true; })};
+        failing.precede(thrower, skipped);
+        bool rethrew{false};
+        try {
+            failing.run(tp);
+        } catch (std::system_error const &) {
+            rethrew = true;
+        }
+        AC_CODDING_ERROR_IF_NOT(rethrew);
+        AC_CODDING_ERROR_IF(skipped_ran);
+        AC_CODDING_ERROR_IF(failing.is_running());
+    } catch (std::exception const &ex) {
+        printf("---- test_tp_task_graph failed %s\n", ex.what());
+    }
+    printf("---- test_tp_task_graph complete\n");
+}
+
+void test_tp_future() {
+    printf("\n---- test_tp_future started\n");
+
+    try {
+        ac::tp::thread_pool tp{1, 4};
+        //
+        // get returns value, and then chains continuations
+        //
+        AC_CODDING_ERROR_IF_NOT(42 == tp.async([] { return 42; }).get());
+
+        std::string const chained{tp.async([] { return 20; })
+                                      .then([](int v) { return v + 1; })
+                                      .then([](int v) { return std::to_string(v * 2); })
+                                      .get()};
+        AC_CODDING_ERROR_IF_NOT("42" == chained);
+
+        std::atomic<int> ran{0};
+        tp.async([&ran] { ran.fetch_add(1); }).then([&ran] { ran.fetch_add(1); }).get();
+        AC_CODDING_ERROR_IF_NOT(2 == ran.load());
+        //
+        // Continuation attached to a complete future is queued
+        //
+        ac::tp::future<int> complete{tp.async([] { return 1; })};
+        complete.wait();
+        AC_CODDING_ERROR_IF_NOT(complete.is_ready());
+        AC_CODDING_ERROR_IF_NOT(2 == std::move(complete).then([](int v) { return v + 1; }).get());
+        //
+        // Exception is rethrown by get, and continuations are skipped
+        //
+        bool continuation_ran{false};
+        ac::tp::future<int> failed{tp.async([]() -> int { AC_THROW(ERROR_INVALID_PARAMETER, "async"); })
+                                       .then([&continuation_ran](int v) {
+                                           continuation_ran = true;
+                                           return v;
+                                       })};
+        bool rethrew{false};
+        try {
+            (void) failed.get();
+        } catch (std::system_error const &) {
+            rethrew = true;
+        }
+        AC_CODDING_ERROR_IF_NOT(rethrew);
+        AC_CODDING_ERROR_IF(continuation_ran);
+        AC_CODDING_ERROR_IF(failed.valid());
+        //
+        // Long chain built before the first future completes does not
+        // run all continuations recursively on one stack
+        //
+        constexpr int chain_length{100'000};
+        ac::event start{ac::event::manuel, ac::event::unsignaled};
+        ac::tp::future<int> chain{tp.async([&start] {
+            (void) start.wait();
+            return 0;
+        })};
+        for (int i = 0; i < chain_length; ++i) {
+            chain = std::move(chain).then([](int v) { return v + 1; });
+        }
+        start.set();
+        AC_CODDING_ERROR_IF_NOT(chain_length == chain.get());
+    } catch (std::exception const &ex) {
+        printf("---- test_tp_future failed %s\n", ex.what());
+    }
+    printf("---- test_tp_future complete\n");
+}
+
+void test_tp_submit_keyed() {
+    printf("\n---- test_tp_submit_keyed started\n");
+
+    try {
+        ac::tp::thread_pool tp{2, 4};
+        constexpr int keys{16};
+        constexpr int per_key{2'000};
+        //
+        // With backlog 0 other workers take keyed work as soon as it
+        // waits, which must not break serialization of a key
+        //
+        for (std::uint32_t backlog : {tp.get_keyed_backlog(), 0U}) {
+            tp.set_keyed_backlog(backlog);
+            struct key_state {
+                std::atomic<int> running{0};
+                int next{0};
+                bool failed{false};
+            };
+            std::vector<key_state> states(keys);
+            {
+                ac::slim_rundown rundown;
+                ac::slim_rundown_join scoped_join(&rundown);
+                for (int i = 0; i < per_key; ++i) {
+                    for (int key = 0; key < keys; ++key) {
+                        tp.submit_keyed(key,
+                                        [&state = states[key], i, guard = ac::slim_rundown_lock{&rundown}](
+                                            ac::tp::callback_instance &) {
+                                            if (0 != state.running.fetch_add(1)) {
+                                                state.failed = true;
+                                            }
+                                            if (state.next != i) {
+                                                state.failed = true;
+                                            }
+                                            state.next = i + 1;
+                                            state.running.fetch_sub(1);
+                                        });
+                    }
+                }
+            }
+            for (key_state const &state : states) {
+                AC_CODDING_ERROR_IF(state.failed);
+                AC_CODDING_ERROR_IF_NOT(per_key == state.next);
+            }
+        }
+    } catch (std::exception const &ex) {
+        printf("---- test_tp_submit_keyed failed %s\n", ex.what());
+    }
+    printf("---- test_tp_submit_keyed complete\n");
+}
+
+void test_tp_keyed_idle_peer() {
+    printf("\n---- test_tp_keyed_idle_peer started\n");
+
+    try {
+        ac::tp::thread_pool tp{2, 2};
+        constexpr std::chrono::milliseconds busy{300};
+        ac::event started{ac::event::manuel, ac::event::unsignaled};
+        ac::slim_rundown rundown;
+        {
+            ac::slim_rundown_join scoped_join(&rundown);
+            tp.submit_keyed(0, [&started, busy, guard = ac::slim_rundown_lock{&rundown}](ac::tp::callback_instance &) {
+                started.set();
+                std::this_thread::sleep_for(busy);
+            });
+            (void) started.wait();
+            //
+            // About half of the lanes queue behind the busy worker,
+            // they are under the backlog, so the other worker must
+            // not take them, and must not spin looking at them either
+            //
+            std::clock_t const cpu_start{std::clock()};
+            for (int key = 1; key < 16; ++key) {
+                tp.submit_keyed(key, [guard = ac::slim_rundown_lock{&rundown}](ac::tp::callback_instance &) {});
+            }
+            std::this_thread::sleep_for(busy * 2 / 3);
+            std::clock_t const cpu_used{std::clock() - cpu_start};
+            printf("cpu used while lanes waited %ld us\n",
+                   static_cast<long>(cpu_used * 1'000'000 / CLOCKS_PER_SEC));
+            AC_CODDING_ERROR_IF(cpu_used > CLOCKS_PER_SEC / 20);
+        }
+    } catch (std::exception const &ex) {
+        printf("---- test_tp_keyed_idle_peer failed %s\n", ex.what());
+    }
+    printf("---- test_tp_keyed_idle_peer complete\n");
+}
+
+namespace {
+
+    struct owning_callback {
+        std::unique_ptr<int> value{std::make_unique<int>(1)};
+        std::atomic<int> *ran{nullptr};
+
+        void operator()(ac::tp::callback_instance &) {
+            ran->fetch_add(*value);
+        }
+    };
+
+} // namespace
+
+void test_tp_queue_capacity() {
+    printf("\n---- test_tp_queue_capacity started\n");
+
+    try {
+        ac::tp::thread_pool tp{2, 4};
+        constexpr std::uint32_t capacity{4};
+        AC_CODDING_ERROR_IF_NOT(0 == tp.get_queue_capacity());
+        tp.set_queue_capacity(capacity);
+        AC_CODDING_ERROR_IF_NOT(capacity == tp.get_queue_capacity());
+
+        ac::event release{ac::event::manuel, ac::event::unsignaled};
+        std::atomic<int> ran{0};
+        {
+            ac::slim_rundown rundown;
+            ac::slim_rundown_join scoped_join(&rundown);
+            //
+            // Fill the pool up to capacity with callbacks that block
+            //
+            for (std::uint32_t i = 0; i < capacity; ++i) {
+                AC_CODDING_ERROR_IF_NOT(tp.try_submit_work(
+                    [&release, &ran, guard = ac::slim_rundown_lock{&rundown}](ac::tp::callback_instance &) {
+                        (void) release.wait();
+                        ran.fetch_add(1);
+                    }));
+            }
+            AC_CODDING_ERROR_IF_NOT(capacity == tp.get_admitted_count());
+            //
+            // Pool is full, callback is not queued and not moved from
+            //
+            owning_callback rejected{.ran = &ran};
+            AC_CODDING_ERROR_IF(tp.try_submit_work(std::move(rejected)));
+            AC_CODDING_ERROR_IF_NOT(rejected.value);
+            AC_CODDING_ERROR_IF_NOT(capacity == tp.get_admitted_count());
+            //
+            // submit_work is never bounded
+            //
+            tp.submit_work([&ran, guard = ac::slim_rundown_lock{&rundown}](ac::tp::callback_instance &) {
+                ran.fetch_add(1);
+            });
+            //
+            // Resume and a waiting producer go once capacity frees up
+            //
+            ac::event resumed{ac::event::manuel, ac::event::unsignaled};
+            tp.submit_on_capacity([&resumed, guard = ac::slim_rundown_lock{&rundown}](ac::tp::callback_instance &) {
+                resumed.set();
+            });
+            std::atomic<bool> producer_queued{false};
+            std::thread producer{[&tp, &ran, &rundown, &producer_queued] {
+                tp.submit_work_or_wait([&ran, guard = ac::slim_rundown_lock{&rundown}](ac::tp::callback_instance &) {
+                    ran.fetch_add(1);
+                });
+                producer_queued = true;
+            }};
+            std::this_thread::sleep_for(std::chrono::milliseconds{50});
+            AC_CODDING_ERROR_IF(producer_queued.load());
+            AC_CODDING_ERROR_IF(WAIT_OBJECT_0 == resumed.wait(0));
+
+            release.set();
+            (void) resumed.wait();
+            producer.join();
+            AC_CODDING_ERROR_IF_NOT(producer_queued.load());
+        }
+        AC_CODDING_ERROR_IF_NOT(static_cast<int>(capacity) + 2 == ran.load());
+        //
+        // Slot is given back after the callback returns
+        //
+        while (0 != tp.get_admitted_count()) {
+            std::this_thread::yield();
+        }
+        //
+        // Once there is room again try_submit_work succeeds
+        //
+        owning_callback accepted{.ran = &ran};
+        {
+            ac::slim_rundown rundown;
+            ac::slim_rundown_join scoped_join(&rundown);
+            AC_CODDING_ERROR_IF_NOT(tp.try_submit_work(
+                [guard = ac::slim_rundown_lock{&rundown}, callback = std::move(accepted)](
+                    ac::tp::callback_instance &instance) mutable { callback(instance); }));
+        }
+        AC_CODDING_ERROR_IF_NOT(static_cast<int>(capacity) + 3 == ran.load());
+    } catch (std::exception const &ex) {
+        printf("---- test_tp_queue_capacity failed %s\n", ex.what());
+    }
+    printf("---- test_tp_queue_capacity complete\n");
+}
+
+namespace {
+    //
+    // Waits on all entries, changes value of the one at index,
+    // and checks that waiter returns
+    //
+    template<typename A, typename B, typename C>
+    void check_wait_any(A &a, A a_value, B &b, B b_value, C &c, C c_value) {
+        using clock = std::chrono::steady_clock;
+        constexpr std::chrono::milliseconds timeout{20};
+        A const a_initial{a};
+        B const b_initial{b};
+        C const c_initial{c};
+        auto make_entries = [&] {
+            return std::array<ac::wait_on_address::entry, 3>{ac::wait_on_address::entry{&a, a_initial},
+                                                             ac::wait_on_address::entry{&b, b_initial},
+                                                             ac::wait_on_address::entry{&c, c_initial}};
+        };
+        auto const entries{make_entries()};
+        //
+        // Nothing changed, times out
+        //
+        clock::time_point const start{clock::now()};
+        AC_CODDING_ERROR_IF(ac::wait_on_address::try_wait_any_for(entries, timeout));
+        AC_CODDING_ERROR_IF_NOT(clock::now() - start >= timeout);
+        bool threw{false};
+        try {
+            ac::wait_on_address::wait_any_for(entries, timeout);
+        } catch (std::system_error const &) {
+            threw = true;
+        }
+        AC_CODDING_ERROR_IF_NOT(threw);
+        //
+        // Change of any one of the values wakes the waiter
+        //
+        for (int index = 0; index < 3; ++index) {
+            a = a_initial;
+            b = b_initial;
+            c = c_initial;
+            std::atomic<bool> done{false};
+            std::thread waiter{[&] {
+                auto const waiter_entries{make_entries()};
+                while (a == a_initial && b == b_initial && c == c_initial) {
+                    (void) ac::wait_on_address::try_wait_any_for(waiter_entries, std::chrono::nanoseconds{-1});
+                }
+                done = true;
+            }};
+            std::this_thread::sleep_for(timeout);
+            AC_CODDING_ERROR_IF(done.load());
+            switch (index) {
+            case 0:
+                a = a_value;
+                ac::wait_on_address::wake_all(&a);
+                break;
+            case 1:
+                b = b_value;
+                ac::wait_on_address::wake_all(&b);
+                break;
+            default:
+                c = c_value;
+                ac::wait_on_address::wake_all(&c);
+                break;
+            }
+            waiter.join();
+            AC_CODDING_ERROR_IF_NOT(done.load());
+            //
+            // Value that already differs does not block
+            //
+            AC_CODDING_ERROR_IF_NOT(ac::wait_on_address::try_wait_any_for(entries, std::chrono::hours{1}));
+        }
+        a = a_initial;
+        b = b_initial;
+        c = c_initial;
+    }
+
+} // namespace
+
+void test_wait_any() {
+    printf("\n---- test_wait_any started\n");
+
+    try {
+        //
+        // All 4 bytes values use futex_waitv, mixed sizes park
+        //
+        std::uint32_t a32{1};
+        std::uint32_t b32{2};
+        std::uint32_t c32{3};
+        check_wait_any<std::uint32_t, std::uint32_t, std::uint32_t>(a32, 10, b32, 20, c32, 30);
+
+        std::uint8_t a8{1};
+        std::uint64_t b64{2};
+        std::uint16_t c16{3};
+        check_wait_any<std::uint8_t, std::uint64_t, std::uint16_t>(a8, 10, b64, 20, c16, 30);
+        check_wait_any<std::uint8_t, std::uint32_t, std::uint64_t>(a8, 10, b32, 20, b64, 30);
+        //
+        // All entries that fit in one call
+        //
+        std::vector<std::uint32_t> words(ac::wait_on_address::max_wait_any, 0);
+        std::vector<ac::wait_on_address::entry> entries;
+        for (std::uint32_t &word : words) {
+            entries.emplace_back(&word, std::uint32_t{0});
+        }
+        std::thread waiter{[&words, &entries] {
+            while (0 == words.back()) {
+                (void) ac::wait_on_address::try_wait_any_for(std::span<ac::wait_on_address::entry const>{entries},
+                                                             std::chrono::nanoseconds{-1});
+            }
+        }};
+        std::this_thread::sleep_for(std::chrono::milliseconds{10});
+        words.back() = 1;
+        ac::wait_on_address::wake_all(&words.back());
+        waiter.join();
+        //
+        // Kernels without futex_waitv park 4 bytes values too
+        //
+        bool const missing{ac::details::futex_waitv_missing().exchange(true)};
+        check_wait_any<std::uint32_t, std::uint32_t, std::uint32_t>(a32, 10, b32, 20, c32, 30);
+        ac::details::futex_waitv_missing().store(missing);
+    } catch (std::exception const &ex) {
+        printf("---- test_wait_any failed %s\n", ex.what());
+    }
+    printf("---- test_wait_any complete\n");
+}
+
+#endif // _WIN32
@@ -15,4 +15,38 @@ void test_tp_timer_work_item();
 void test_tp_wait_work_item();
 void test_tp_io_handler();
 
+void test_node_cache_after_thread_exit();
+void test_inplace_function();
+
+void test_tp_submit_work_batch();
+void test_tp_post_count();
+
+void test_tp_strand();
+void test_active_object();
+void test_tp_cleanup_group();
+void test_tp_callback_objects_after_thread_exit();
+void test_tp_scratch_arena();
+void test_sharded_rundown();
+void test_wait_on_address();
+
+#ifndef _WIN32
+void test_tp_timer_wheel();
+void test_tp_timer_coalescing();
+void test_tp_queue_wait_histogram();
+void test_tp_priority();
+void test_tp_blocking_scope();
+void test_tp_adaptive_concurrency();
+void test_tp_numa_topology();
+void test_tp_work_stealing();
+void test_tp_coroutines();
+void test_tp_exec();
+void test_tp_parallel();
+void test_tp_task_graph();
+void test_tp_future();
+void test_tp_submit_keyed();
+void test_tp_keyed_idle_peer();
+void test_tp_queue_capacity();
+void test_wait_any();
+#endif
+
 #endif //_AC_HELPERS_WIN32_LIBRARY_TEST_DEFAULT_TP_HEADER_
\ No newline at end of file